@@ -0,0 +1,453 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "FrustumCuller.h"
+#include "ShadowCasterCuller.h"
+
+namespace
+{
+	bool ParseInt(const std::string& text, int& value)
+	{
+		char* end = nullptr;
+		long parsed = std::strtol(text.c_str(), &end, 10);
+		if (text.empty() || *end != '\0')
+		{
+			return false;
+		}
+		value = (int)parsed;
+		return true;
+	}
+
+	bool ParseFloat(const std::string& text, float& value)
+	{
+		char* end = nullptr;
+		float parsed = std::strtof(text.c_str(), &end);
+		if (text.empty() || *end != '\0')
+		{
+			return false;
+		}
+		value = parsed;
+		return true;
+	}
+
+	//Comma separated, every one positive
+	bool ParseFloatList(const std::string& text, std::vector<float>& values)
+	{
+		values.clear();
+		std::istringstream items(text);
+		std::string item;
+		float value = 0.0f;
+		while (std::getline(items, item, ','))
+		{
+			if (!ParseFloat(item, value) || !(value > 0.0f))
+			{
+				return false;
+			}
+			values.push_back(value);
+		}
+		return !values.empty();
+	}
+
+	//Comma separated, none of them empty
+	bool ParseNameList(const std::string& text, std::vector<std::string>& names)
+	{
+		names.clear();
+		std::istringstream items(text);
+		std::string item;
+		while (std::getline(items, item, ','))
+		{
+			if (item.empty())
+			{
+				return false;
+			}
+			names.push_back(item);
+		}
+		return !names.empty();
+	}
+
+	//Fixed seed runs of one feature each. They're expanded where they appear on the command line,
+	//so switches after them can still change any of it.
+	struct Scenario
+	{
+		const char* Name;
+		const char* CommandLine;
+	};
+
+	const Scenario scenarios[] =
+	{
+		{ "occlusion", "-entities 50000 -occluders 48 -seed 1 -benchmark 300" },
+		{ "visibilitycache", "-entities 100000 -moving 5 -seed 1 -benchmark 300 -validate 1 -turn 0.1" },
+		{ "indoor", "-entities 50000 -rooms 6 -seed 1 -benchmark 300" },
+		{ "pvs", "-entities 50000 -occluders 48 -pvs 2,4,8,16 -seed 1 -benchmark 300" },
+		{ "shadows", "-entities 50000 -lights 8 -shadows 3 -seed 1 -benchmark 300" },
+	};
+
+	const char* FindScenario(const std::string& name)
+	{
+		for (const Scenario& scenario : scenarios)
+		{
+			if (name == scenario.Name)
+			{
+				return scenario.CommandLine;
+			}
+		}
+		return nullptr;
+	}
+
+	//Stage names are plain identifiers, but quotes and backslashes would still break the file
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SETTINGS ------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Reads the stress scene and benchmark switches out of the command line
+/// </summary>
+/// <returns>False on an unknown switch or a missing or bad value, error says which</returns>
+bool BenchmarkSettings::Parse(const std::string& commandLine, BenchmarkSettings& settings, std::string& error)
+{
+	std::istringstream tokens(commandLine);
+	std::string option;
+	while (tokens >> option)
+	{
+		if (option == "-stress")
+		{
+			settings.UseStressScene = true;
+			continue;
+		}
+
+		std::string value;
+		if (!(tokens >> value))
+		{
+			error = option + " needs a value";
+			return false;
+		}
+
+		bool parsed = true;
+		bool sceneKnob = true;
+		int seed = 0;
+		if (option == "-entities") parsed = ParseInt(value, settings.Scene.EntityCount);
+		else if (option == "-meshes") parsed = ParseInt(value, settings.Scene.MeshVariety);
+		else if (option == "-materials") parsed = ParseInt(value, settings.Scene.MaterialVariety);
+		else if (option == "-lights") parsed = ParseInt(value, settings.Scene.LightCount);
+		else if (option == "-moving") parsed = ParseFloat(value, settings.Scene.MovingPercent);
+		else if (option == "-spacing") parsed = ParseFloat(value, settings.Scene.Spacing);
+		else if (option == "-occluders") parsed = ParseInt(value, settings.Scene.OccluderCount);
+		else if (option == "-cameras") parsed = ParseInt(value, settings.Scene.CameraCount);
+		else if (option == "-rooms") parsed = ParseInt(value, settings.Scene.Rooms);
+		else if (option == "-depth") parsed = ParseInt(value, settings.Scene.HierarchyDepth);
+		else if (option == "-lods")
+		{
+			int lods = 0;
+			parsed = ParseInt(value, lods);
+			settings.Scene.UseLods = lods != 0;
+		}
+		else if (option == "-seed")
+		{
+			parsed = ParseInt(value, seed);
+			settings.Scene.Seed = (uint32_t)seed;
+		}
+		else
+		{
+			sceneKnob = false;
+			if (option == "-benchmark") parsed = ParseInt(value, settings.Frames);
+			else if (option == "-views")
+			{
+				parsed = ParseInt(value, settings.Views) && settings.Views >= 0 && settings.Views <= CULL_MAX_VIEWS;
+				settings.Scene.CameraCount = settings.Views > settings.Scene.CameraCount ? settings.Views : settings.Scene.CameraCount;
+			}
+			else if (option == "-shadows") parsed = ParseInt(value, settings.ShadowCascades) && settings.ShadowCascades >= 0 && settings.ShadowCascades <= SHADOW_MAX_CASCADES;
+			else if (option == "-pvs") parsed = ParseFloatList(value, settings.PvsCellSizes);
+			else if (option == "-statecache")
+			{
+				int filter = 0;
+				parsed = ParseInt(value, filter);
+				settings.FilterStateCalls = filter != 0;
+			}
+			else if (option == "-instancing")
+			{
+				int instancing = 0;
+				parsed = ParseInt(value, instancing);
+				settings.Instancing = instancing != 0;
+			}
+			else if (option == "-validate")
+			{
+				int validate = 0;
+				parsed = ParseInt(value, validate);
+				settings.ValidateVisibility = validate != 0;
+			}
+			else if (option == "-turn") parsed = ParseFloat(value, settings.CameraTurnRate);
+			else if (option == "-schedule")
+			{
+				int schedule = 0;
+				parsed = ParseInt(value, schedule);
+				settings.PrintSchedule = schedule != 0;
+			}
+			else if (option == "-warmup") parsed = ParseInt(value, settings.WarmupFrames);
+			else if (option == "-rewind") parsed = ParseInt(value, settings.RewindFrames);
+			else if (option == "-out") settings.OutputPath = value;
+			else if (option == "-suite") parsed = ParseNameList(value, settings.Suites);
+			else if (option == "-scenario")
+			{
+				const char* commandLine = FindScenario(value);
+				if (commandLine == nullptr)
+				{
+					error = "unknown scenario " + value;
+					return false;
+				}
+				if (!Parse(commandLine, settings, error))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				error = "unknown option " + option;
+				return false;
+			}
+		}
+
+		if (!parsed)
+		{
+			error = "bad value '" + value + "' for " + option;
+			return false;
+		}
+		settings.UseStressScene |= sceneKnob;
+	}
+
+	if (settings.Frames < 0 || settings.WarmupFrames < 0 || settings.RewindFrames < 0)
+	{
+		error = "frame counts can't be negative";
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ BENCHMARK -----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+Benchmark::Benchmark() : running(false), frame(0), warmupFrames(0), frames(0)
+{
+}
+
+/// <summary>
+/// Starts a run, throwing away anything from an earlier one
+/// </summary>
+void Benchmark::Begin(const BenchmarkSettings& settings)
+{
+	series.clear();
+	seriesLookup.clear();
+	updateSeries.clear();
+	drawSeries.clear();
+	info.clear();
+	checks.clear();
+
+	running = settings.Frames > 0;
+	frame = 0;
+	warmupFrames = settings.WarmupFrames;
+	frames = settings.Frames;
+
+	AddInfo("frames", frames);
+	AddInfo("warmupFrames", warmupFrames);
+}
+
+/// <summary>
+/// Records what every stage of both graphs took this frame, once warmup is over
+/// </summary>
+/// <returns>False when the run is over (or was never started)</returns>
+bool Benchmark::EndFrame(TaskGraph& updateGraph, TaskGraph& drawGraph)
+{
+	if (!running)
+	{
+		return false;
+	}
+
+	if (frame >= warmupFrames)
+	{
+		RecordGraph("Update/", updateGraph, updateSeries);
+		RecordGraph("Draw/", drawGraph, drawSeries);
+		AddSample("Update", updateGraph.GetLastMilliseconds());
+		AddSample("Draw", drawGraph.GetLastMilliseconds());
+		AddSample("Frame", updateGraph.GetLastMilliseconds() + drawGraph.GetLastMilliseconds());
+	}
+
+	frame++;
+	running = frame < warmupFrames + frames;
+	return running;
+}
+
+void Benchmark::AddSample(const std::string& name, float milliseconds)
+{
+	auto found = seriesLookup.find(name);
+	if (found == seriesLookup.end())
+	{
+		found = seriesLookup.emplace(name, (int)series.size()).first;
+		series.push_back(Series{ name, {} });
+		series.back().Samples.reserve(frames);
+	}
+	series[found->second].Samples.push_back(milliseconds);
+}
+
+/// <summary>
+/// Anything worth keeping next to the timings, like the scene settings
+/// </summary>
+void Benchmark::AddInfo(const std::string& key, double value)
+{
+	info.push_back({ key, value });
+}
+
+/// <summary>
+/// Something the run should always get right, like a result matching a reference.
+/// Failures are printed as they come in as well.
+/// </summary>
+void Benchmark::AddCheck(const std::string& name, bool passed)
+{
+	checks.push_back({ name, passed });
+	if (!passed)
+	{
+		std::printf("Benchmark: check %s failed\n", name.c_str());
+	}
+}
+
+bool Benchmark::GetChecksPassed()
+{
+	for (const std::pair<std::string, bool>& check : checks)
+	{
+		if (!check.second)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Writes every series as mean, p50, p90, p99 and max in milliseconds, then the checks
+/// </summary>
+/// <returns>False if the file couldn't be written</returns>
+bool Benchmark::WriteJson(const std::filesystem::path& path)
+{
+	FILE* file = nullptr;
+#ifdef _WIN32
+	_wfopen_s(&file, path.c_str(), L"w");
+#else
+	file = std::fopen(path.c_str(), "w");
+#endif
+	if (!file)
+	{
+		return false;
+	}
+
+	std::fprintf(file, "{\n\t\"info\": {");
+	for (size_t i = 0; i < info.size(); i++)
+	{
+		std::fprintf(file, "%s\n\t\t\"%s\": %.17g", i ? "," : "", EscapeJson(info[i].first).c_str(), info[i].second);
+	}
+	std::fprintf(file, "\n\t},\n\t\"stages\": [");
+
+	std::vector<float> sorted;
+	for (size_t i = 0; i < series.size(); i++)
+	{
+		sorted = series[i].Samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0;
+		for (float sample : sorted)
+		{
+			total += sample;
+		}
+		double mean = sorted.empty() ? 0.0 : total / sorted.size();
+
+		std::fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"samples\": %d, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+			i ? "," : "",
+			EscapeJson(series[i].Name).c_str(),
+			(int)sorted.size(),
+			mean,
+			Percentile(sorted, 50),
+			Percentile(sorted, 90),
+			Percentile(sorted, 99),
+			sorted.empty() ? 0.0f : sorted.back());
+	}
+	std::fprintf(file, "\n\t],\n\t\"checks\": [");
+
+	for (size_t i = 0; i < checks.size(); i++)
+	{
+		std::fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"passed\": %s }", i ? "," : "", EscapeJson(checks[i].first).c_str(), checks[i].second ? "true" : "false");
+	}
+	std::fprintf(file, "\n\t]\n}\n");
+
+	bool written = !std::ferror(file);
+	std::fclose(file);
+	return written;
+}
+
+float Benchmark::GetPercentile(const std::string& name, float percentile)
+{
+	auto found = seriesLookup.find(name);
+	if (found == seriesLookup.end())
+	{
+		return 0;
+	}
+
+	std::vector<float> sorted = series[found->second].Samples;
+	std::sort(sorted.begin(), sorted.end());
+	return Percentile(sorted, percentile);
+}
+
+/// <summary>
+/// Adds every stage's time as "[prefix][stage name]". The series are looked up by name
+/// once, so after the first frame recording doesn't build any strings.
+/// </summary>
+void Benchmark::RecordGraph(const char* prefix, TaskGraph& graph, std::vector<int>& seriesOfStage)
+{
+	if ((int)seriesOfStage.size() != graph.GetStageCount())
+	{
+		seriesOfStage.clear();
+		for (int i = 0; i < graph.GetStageCount(); i++)
+		{
+			std::string name = prefix + graph.GetStage(i).Name;
+			AddSample(name, graph.GetStage(i).LastMilliseconds);
+			seriesOfStage.push_back(seriesLookup[name]);
+		}
+		return;
+	}
+
+	for (int i = 0; i < graph.GetStageCount(); i++)
+	{
+		series[seriesOfStage[i]].Samples.push_back(graph.GetStage(i).LastMilliseconds);
+	}
+}
+
+/// <summary>
+/// Smallest sample that at least percentile% of the samples are less than or equal to
+/// </summary>
+float Benchmark::Percentile(std::vector<float>& sorted, float percentile)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+
+	int rank = (int)std::ceil(percentile / 100.0f * sorted.size());
+	return sorted[std::clamp(rank - 1, 0, (int)sorted.size() - 1)];
+}
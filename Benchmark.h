@@ -0,0 +1,130 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "StressScene.h"
+#include "TaskGraph.h"
+
+#define BENCHMARK_FIXED_DELTA_TIME (1.0f / 60.0f) //Every benchmark frame simulates the same step
+
+// --------------------------------------------------------
+// What the game was asked to do from the command line
+//
+//   -stress                 load a generated scene instead of Main
+//   -entities N -meshes N -materials N -lights N
+//   -moving PERCENT -spacing X -seed N -occluders N
+//   -lods 0|1 -cameras N -rooms N -depth N
+//                           stress scene knobs, any of them implies -stress
+//   -views N                cull N cameras in one pass, adding cameras to
+//                           the stress scene to make N if it has fewer
+//   -pvs SIZE,SIZE,...      bake the potentially visible set at each cell
+//                           size in turn, keeping the last
+//   -shadows CASCADES       cull shadow casters for every spot and
+//                           directional light, 0 leaves it off
+//   -statecache 0|1         drop binds that change nothing, on by default
+//   -instancing 0|1         draw runs sharing a mesh and material
+//                           instanced, on by default
+//   -validate 0|1           check the visibility cache against a full cull
+//                           every frame, off by default
+//   -turn RADIANS           turn the active camera this much a second in a
+//                           headless run, so what it sees keeps changing
+//   -schedule 0|1           print both frame graphs' levels at startup,
+//                           off by default
+//   -benchmark FRAMES       run headless for FRAMES frames, then quit,
+//                           with an error if any check failed
+//   -warmup FRAMES          frames run before timing starts
+//   -rewind FRAMES          then rewind FRAMES frames and step through them
+//                           again, checking they hash the same, 0 skips it
+//   -out PATH               where the results go
+//   -suite NAME,NAME,...    run these system suites instead of the game,
+//                           "all" for every one, see BenchmarkSuite.h
+//   -scenario NAME          a fixed seed headless run of one feature,
+//                           checked at the end. Switches after it can
+//                           still change it. One of: occlusion,
+//                           visibilitycache, indoor, pvs, shadows
+// --------------------------------------------------------
+struct BenchmarkSettings
+{
+	bool UseStressScene = false;
+	StressSceneSettings Scene;
+
+	int Views = 0; //0 culls the active camera on its own, otherwise how many cameras to cull together
+	std::vector<float> PvsCellSizes; //Empty bakes at the default size, if the scene has occluders
+	int ShadowCascades = 0; //Per directional light, 0 doesn't cull shadow casters at all
+	bool FilterStateCalls = true;
+	bool Instancing = true;
+	bool ValidateVisibility = false;
+	float CameraTurnRate = 0.0f; //Radians a second, headless runs only
+	bool PrintSchedule = false;
+	int Frames = 0; //0 runs the game normally
+	int WarmupFrames = 30;
+	int RewindFrames = 30; //Clamped to what the snapshot history holds
+	std::string OutputPath = "Benchmark.json";
+	std::vector<std::string> Suites; //Empty runs the game
+
+	static bool Parse(const std::string& commandLine, BenchmarkSettings& settings, std::string& error);
+};
+
+// --------------------------------------------------------
+// Per stage timings gathered over a run
+//
+// Every sample is kept (a few floats per stage per frame),
+// so the percentiles written out are exact rather than
+// estimated from buckets. Stages are reported in the order
+// they were first seen.
+//
+// Checks are pass or fail results written next to the
+// timings. If any of them failed the whole run did, and
+// the program exits with an error.
+// --------------------------------------------------------
+class Benchmark
+{
+public:
+	Benchmark();
+
+	void Begin(const BenchmarkSettings& settings);
+	bool IsRunning() { return running; }
+	bool IsTiming() { return running && frame >= warmupFrames; } //The frame in progress is past warmup
+
+	//Call once per frame after both graphs ran, false once the last frame is in
+	bool EndFrame(TaskGraph& updateGraph, TaskGraph& drawGraph);
+
+	void AddSample(const std::string& name, float milliseconds);
+	void AddInfo(const std::string& key, double value);
+	void AddCheck(const std::string& name, bool passed);
+	bool WriteJson(const std::filesystem::path& path);
+
+	//True until a check fails
+	bool GetChecksPassed();
+
+	//Nearest rank percentile of one series, 0 if it has no samples
+	float GetPercentile(const std::string& name, float percentile);
+
+private:
+	struct Series
+	{
+		std::string Name;
+		std::vector<float> Samples;
+	};
+
+	std::vector<Series> series;
+	std::unordered_map<std::string, int> seriesLookup;
+	std::vector<std::pair<std::string, double>> info;
+	std::vector<std::pair<std::string, bool>> checks;
+
+	//Series index of each graph stage, filled in on the first recorded frame
+	std::vector<int> updateSeries;
+	std::vector<int> drawSeries;
+
+	bool running;
+	int frame;
+	int warmupFrames;
+	int frames;
+
+	void RecordGraph(const char* prefix, TaskGraph& graph, std::vector<int>& seriesOfStage);
+	static float Percentile(std::vector<float>& sorted, float percentile);
+};
@@ -0,0 +1,3327 @@
+#include "BenchmarkSuite.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "Camera.h"
+#include "ChangeJournal.h"
+#include "Components.h"
+#include "DynamicAABBTree.h"
+#include "ECS.h"
+#include "FrustumCuller.h"
+#include "Handle.h"
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "LooseOctree.h"
+#include "Memory.h"
+#include "OcclusionCuller.h"
+#include "PortalSystem.h"
+#include "PotentiallyVisibleSet.h"
+#include "PvsBaker.h"
+#include "RenderQueue.h"
+#include "RenderStateCache.h"
+#include "SceneFile.h"
+#include "ShadowCasterCuller.h"
+#include "SimulationState.h"
+#include "SnapshotHistory.h"
+#include "SpatialHashGrid.h"
+#include "StressScene.h"
+#include "Transform.h"
+#include "TransformHierarchy.h"
+#include "VisibilityCache.h"
+
+using namespace DirectX;
+
+namespace
+{
+	//Same xorshift as the stress scene, so suites see the same numbers everywhere
+	struct SuiteRandom
+	{
+		uint32_t state;
+
+		uint32_t Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		float Range(float min, float max)
+		{
+			return min + (max - min) * (float)(Next() >> 8) / (float)(1 << 24);
+		}
+
+		uint32_t Below(uint32_t count)
+		{
+			return (uint32_t)(((uint64_t)Next() * count) >> 32);
+		}
+	};
+
+	//Calls function repeats times, each call's milliseconds going in as a sample
+	template<typename Function>
+	void Time(Benchmark& benchmark, const std::string& name, int repeats, Function function)
+	{
+		for (int i = 0; i < repeats; i++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			function();
+			auto end = std::chrono::high_resolution_clock::now();
+			benchmark.AddSample(name, std::chrono::duration<float, std::milli>(end - start).count());
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ TRANSFORMS ----------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	bool NearlyEqual(const XMFLOAT4X4& a, FXMMATRIX b, float tolerance = 1e-3f)
+	{
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, b);
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				if (std::fabs(a.m[row][column] - expected.m[row][column]) > tolerance)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	//The local matrix built from scratch out of the transform's parts
+	XMMATRIX ReferenceMatrix(Transform& transform)
+	{
+		XMFLOAT3 position = transform.GetPosition();
+		XMFLOAT3 rotation = transform.GetRotation();
+		XMFLOAT3 scale = transform.GetScale();
+		return XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) * XMMatrixTranslation(position.x, position.y, position.z);
+	}
+
+	//Asks for every cached output, which should leave only the hierarchy bit for the hierarchy to take
+	void RebuildCaches(Transform& transform)
+	{
+		transform.GetLocalMatrix();
+		transform.GetLocalInverseTransposeMatrix();
+		transform.GetForward();
+		transform.ConsumeHierarchyDirty();
+	}
+
+	void RunTransformSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const unsigned int moved = TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY;
+		float values[3] = { 0.3f, -0.2f, 1.5f };
+
+		//Every mutator, with the bits it has to set
+		struct Mutator
+		{
+			const char* Name;
+			unsigned int Dirty;
+			std::function<void(Transform&)> Apply;
+		};
+		const Mutator mutators[] =
+		{
+			{ "SetPosition", moved, [](Transform& t) { t.SetPosition(1, 2, 3); } },
+			{ "SetPositionFloat3", moved, [](Transform& t) { t.SetPosition(XMFLOAT3(-2, 0.5f, 4)); } },
+			{ "SetPositionArray", moved, [&](Transform& t) { t.SetPosition(values); } },
+			{ "SetRotation", TRANSFORM_DIRTY_ALL, [](Transform& t) { t.SetRotation(0.5f, 0.2f, 0.1f); } },
+			{ "SetRotationFloat3", TRANSFORM_DIRTY_ALL, [](Transform& t) { t.SetRotation(XMFLOAT3(0.1f, 0.6f, -0.3f)); } },
+			{ "SetRotationArray", TRANSFORM_DIRTY_ALL, [&](Transform& t) { t.SetRotation(values); } },
+			{ "SetScale", moved, [](Transform& t) { t.SetScale(2, 3, 4); } },
+			{ "SetScaleFloat3", moved, [](Transform& t) { t.SetScale(XMFLOAT3(1, 2, 0.5f)); } },
+			{ "SetScaleArray", moved, [&](Transform& t) { t.SetScale(values); } },
+			{ "MoveAbsolute", moved, [](Transform& t) { t.MoveAbsolute(1, 1, 1); } },
+			{ "MoveAbsoluteFloat3", moved, [](Transform& t) { t.MoveAbsolute(XMFLOAT3(1, -1, 2)); } },
+			{ "MoveRelative", moved, [](Transform& t) { t.MoveRelative(0, 0, 1); } },
+			{ "Rotate", TRANSFORM_DIRTY_ALL, [](Transform& t) { t.Rotate(0.1f, 0.2f, 0.3f); } },
+			{ "Scale", moved, [](Transform& t) { t.Scale(2, 0.5f, 2); } },
+		};
+
+		//Each one on top of everything before it, so they're seen from all sorts of starting points
+		Transform transform;
+		bool dirtyBits = true;
+		bool matrices = true;
+		for (const Mutator& mutator : mutators)
+		{
+			RebuildCaches(transform);
+			dirtyBits = dirtyBits && transform.GetDirtyFlags() == 0;
+
+			mutator.Apply(transform);
+			bool setRight = transform.GetDirtyFlags() == mutator.Dirty;
+
+			XMMATRIX reference = ReferenceMatrix(transform);
+			bool matched = NearlyEqual(transform.GetWorldMatrix(), reference)
+				&& NearlyEqual(transform.GetInverseTransposeMatrix(), XMMatrixTranspose(XMMatrixInverse(nullptr, reference)));
+
+			XMFLOAT3 forward = transform.GetForward();
+			XMFLOAT3 expectedForward;
+			XMStoreFloat3(&expectedForward, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0, 0, 1, 0), XMMatrixRotationRollPitchYaw(transform.GetRotation().x, transform.GetRotation().y, transform.GetRotation().z))));
+			matched = matched && std::fabs(forward.x - expectedForward.x) < 1e-3f && std::fabs(forward.y - expectedForward.y) < 1e-3f && std::fabs(forward.z - expectedForward.z) < 1e-3f;
+
+			//Asking again after the rebuild has to come from the cache
+			bool cleared = (transform.GetDirtyFlags() & ~TRANSFORM_DIRTY_HIERARCHY) == 0;
+
+			if (!setRight || !cleared || !matched)
+			{
+				std::printf("Suite transform: %s %s\n", mutator.Name, !setRight || !cleared ? "left the wrong dirty bits" : "built the wrong matrices");
+			}
+			dirtyBits = dirtyBits && setRight && cleared;
+			matrices = matrices && matched;
+		}
+		benchmark.AddCheck("transform/DirtyBits", dirtyBits);
+		benchmark.AddCheck("transform/InverseTranspose", matrices);
+
+		//Parented, the world matrix and its inverse transpose both compose down the chain
+		Transform parent;
+		Transform child;
+		parent.SetScale(2, 1, 1);
+		parent.SetRotation(0.3f, 0.4f, 0);
+		parent.SetPosition(1, 2, 3);
+		child.SetScale(1, 3, 1);
+		child.SetRotation(0, 0, 0.7f);
+		child.SetPosition(4, 0, 0);
+		TransformHierarchy hierarchy;
+		hierarchy.AddNode(&child, hierarchy.AddNode(&parent));
+		hierarchy.UpdateWorldMatrices();
+		XMMATRIX world = ReferenceMatrix(child) * ReferenceMatrix(parent);
+		benchmark.AddCheck("transform/HierarchyInverseTranspose", NearlyEqual(child.GetWorldMatrix(), world)
+			&& NearlyEqual(child.GetInverseTransposeMatrix(), XMMatrixTranspose(XMMatrixInverse(nullptr, world))));
+
+		//The inverse transpose from the parts against a general 4x4 inverse, over a scene's worth of transforms
+		const int transformCount = 100000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<Transform> transforms(transformCount);
+		for (Transform& t : transforms)
+		{
+			t.SetPosition(random.Range(-100, 100), random.Range(-100, 100), random.Range(-100, 100));
+			t.SetRotation(random.Range(0, XM_2PI), random.Range(0, XM_2PI), random.Range(0, XM_2PI));
+			t.SetScale(random.Range(0.5f, 2), random.Range(0.5f, 2), random.Range(0.5f, 2));
+		}
+
+		XMFLOAT4X4 sink;
+		Time(benchmark, "transform/InverseTransposeFromParts", 10, [&]()
+			{
+				for (Transform& t : transforms)
+				{
+					t.Rotate(0, 0, 0);
+					sink = t.GetLocalInverseTransposeMatrix();
+				}
+			});
+		Time(benchmark, "transform/InverseTransposeGeneral", 10, [&]()
+			{
+				for (Transform& t : transforms)
+				{
+					XMFLOAT4X4 local = t.GetLocalMatrix();
+					XMStoreFloat4x4(&sink, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&local))));
+				}
+			});
+		Time(benchmark, "transform/InverseTransposeCached", 10, [&]()
+			{
+				for (Transform& t : transforms)
+				{
+					sink = t.GetLocalInverseTransposeMatrix();
+				}
+			});
+		benchmark.AddInfo("transform/sink", sink._11); //Keeps the timed loops from being optimized away
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ HIERARCHY -----------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunHierarchySuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		//The same stress scene at every depth, from all roots down to a few hundred long chains
+		const int depths[] = { 1, 4, 16, 64, 256 };
+		StressSceneSettings sceneSettings = settings.Scene;
+		sceneSettings.EntityCount = 100000;
+		sceneSettings.Rooms = 0;
+
+		bool matched = true;
+		for (int depth : depths)
+		{
+			sceneSettings.HierarchyDepth = depth;
+			SceneBuilder builder;
+			std::string error;
+			if (!BuildStressScene(sceneSettings, builder, error))
+			{
+				std::printf("Suite hierarchy: %s\n", error.c_str());
+				matched = false;
+				continue;
+			}
+			const SceneEntity* entities = builder.GetEntities();
+			int count = builder.GetEntityCount();
+			int moving = GetStressMovingCount(sceneSettings);
+			std::string prefix = "hierarchy/depth" + std::to_string(depth) + "/";
+
+			//Transforms can't move once the hierarchy points at them
+			std::vector<Transform> transforms(count);
+			std::vector<int> nodes(count);
+			TransformHierarchy hierarchy;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < count; i++)
+			{
+				transforms[i].SetPosition(entities[i].Position);
+				transforms[i].SetRotation(entities[i].Rotation);
+				transforms[i].SetScale(entities[i].Scale);
+				nodes[i] = hierarchy.AddNode(&transforms[i], entities[i].Parent == SCENE_NO_INDEX ? -1 : nodes[entities[i].Parent]);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			benchmark.AddSample(prefix + "Build", std::chrono::duration<float, std::milli>(end - start).count());
+
+			//Everything rebuilt, as on the frame a scene loads
+			Time(benchmark, prefix + "Full", 10, [&]()
+				{
+					for (int i = 0; i < count; i += depth)
+					{
+						hierarchy.MarkDirty(nodes[i]);
+					}
+					hierarchy.UpdateWorldMatrices();
+				});
+
+			//Only the stress scene's moving entities, and whatever hangs off them
+			float time = 0;
+			Time(benchmark, prefix + "Moving", 10, [&]()
+				{
+					time += BENCHMARK_FIXED_DELTA_TIME;
+					for (int i = 0; i < moving; i++)
+					{
+						XMFLOAT3 origin = entities[i].Position;
+						transforms[i].SetPosition(origin.x + std::cos(time + i), origin.y, origin.z + std::sin(time + i));
+					}
+					hierarchy.UpdateWorldMatrices();
+				});
+			benchmark.AddInfo(prefix + "updatedWhileMoving", hierarchy.GetLastUpdateCount());
+
+			//Every node against its own chain multiplied out the slow way
+			std::vector<XMFLOAT4X4> reference(count);
+			for (int i = 0; i < count && matched; i++)
+			{
+				XMMATRIX world = ReferenceMatrix(transforms[i]);
+				if (entities[i].Parent != SCENE_NO_INDEX)
+				{
+					world = world * XMLoadFloat4x4(&reference[entities[i].Parent]);
+				}
+				XMStoreFloat4x4(&reference[i], world);
+				matched = NearlyEqual(hierarchy.GetWorldMatrix(nodes[i]), world, 1e-2f);
+				if (!matched)
+				{
+					std::printf("Suite hierarchy: depth %d node %d has the wrong world matrix\n", depth, i);
+				}
+			}
+		}
+		benchmark.AddCheck("hierarchy/WorldMatrices", matched);
+		benchmark.AddInfo("hierarchy/nodes", sceneSettings.EntityCount);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ JOBS ----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Enough arithmetic per element that the threads aren't just fighting over memory
+	void JobWork(std::vector<float>& data, int start, int end)
+	{
+		for (int i = start; i < end; i++)
+		{
+			float x = (float)i;
+			for (int k = 0; k < 16; k++)
+			{
+				x = std::sqrt(x + k);
+			}
+			data[i] = x;
+		}
+	}
+
+	void RunJobsSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		//Every thread count from one up, so the scaling curve is in the results
+		std::vector<float> data(1 << 21);
+		float oneThread = 0;
+		for (unsigned int threads = 1; threads <= maxThreads; threads++)
+		{
+			JobSystem jobs(threads - 1);
+			std::string name = "jobs/threads" + std::to_string(threads) + "/ParallelFor";
+			Time(benchmark, name, 10, [&]()
+				{
+					JobCounter counter;
+					jobs.ParallelFor((int)data.size(), [&data](int start, int end) { JobWork(data, start, end); }, &counter, 1024);
+					jobs.Wait(&counter);
+				});
+			float median = benchmark.GetPercentile(name, 50);
+			oneThread = threads == 1 ? median : oneThread;
+			benchmark.AddInfo("jobs/threads" + std::to_string(threads) + "/speedup", median > 0 ? oneThread / median : 0);
+		}
+		benchmark.AddInfo("jobs/maxThreads", maxThreads);
+
+		//Stress runs on at least four threads even on a smaller machine, so stealing really happens,
+		//and checks against sums worked out up front
+		JobSystem jobs(std::max(maxThreads, 4u) - 1);
+
+		//Far more tiny jobs than the rings and deques hold, so they wrap and overflow
+		const int tinyJobs = 200000;
+		std::atomic<int64_t> tinySum = 0;
+		Time(benchmark, "jobs/TinyJobs", 5, [&]()
+			{
+				tinySum = 0;
+				JobCounter counter;
+				for (int i = 0; i < tinyJobs; i++)
+				{
+					jobs.Run([&tinySum, i]() { tinySum.fetch_add(i, std::memory_order_relaxed); }, &counter);
+				}
+				jobs.Wait(&counter);
+			});
+		benchmark.AddCheck("jobs/TinyJobs", tinySum == (int64_t)tinyJobs * (tinyJobs - 1) / 2);
+
+		//Jobs that submit and wait on their own jobs, which is how the task graph uses it
+		const int outerJobs = 20000;
+		std::atomic<int64_t> nestedSum = 0;
+		Time(benchmark, "jobs/NestedWaits", 5, [&]()
+			{
+				nestedSum = 0;
+				JobCounter counter;
+				for (int i = 0; i < outerJobs; i++)
+				{
+					jobs.Run([&jobs, &nestedSum, i]()
+						{
+							JobCounter inner;
+							for (int k = 0; k < 4; k++)
+							{
+								jobs.Run([&nestedSum, i, k]() { nestedSum.fetch_add(i * 4 + k, std::memory_order_relaxed); }, &inner);
+							}
+							jobs.Wait(&inner);
+						}, &counter);
+				}
+				jobs.Wait(&counter);
+			});
+		int64_t nestedCount = (int64_t)outerJobs * 4;
+		benchmark.AddCheck("jobs/NestedWaits", nestedSum == nestedCount * (nestedCount - 1) / 2);
+
+		//Ranges have to cover every index exactly once, whatever the count and grain
+		bool covered = true;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<std::atomic<int>> hits(100000);
+		for (int round = 0; round < 200 && covered; round++)
+		{
+			int count = 1 + (int)random.Below((uint32_t)hits.size());
+			int grain = 1 + (int)random.Below(512);
+			for (int i = 0; i < count; i++)
+			{
+				hits[i].store(0, std::memory_order_relaxed);
+			}
+			JobCounter counter;
+			jobs.ParallelFor(count, [&hits](int start, int end)
+				{
+					for (int i = start; i < end; i++)
+					{
+						hits[i].fetch_add(1, std::memory_order_relaxed);
+					}
+				}, &counter, grain);
+			jobs.Wait(&counter);
+			for (int i = 0; i < count && covered; i++)
+			{
+				covered = hits[i].load(std::memory_order_relaxed) == 1;
+			}
+		}
+		benchmark.AddCheck("jobs/ParallelForCoverage", covered);
+
+		//Another system made and dropped on this thread mustn't stop this one seeing it as thread 0.
+		//A job this thread submits gets queued, so it can't have run here before Run returned.
+		std::thread::id mainThread = std::this_thread::get_id();
+		auto queuedFromHere = [&]()
+			{
+				std::atomic<bool> returned = false;
+				std::atomic<bool> ranInline = false;
+				JobCounter counter;
+				jobs.Run([&]() { ranInline = std::this_thread::get_id() == mainThread && !returned; }, &counter);
+				returned = true;
+				jobs.Wait(&counter);
+				return !ranInline;
+			};
+		bool ownerKept;
+		{
+			JobSystem other(1);
+			ownerKept = queuedFromHere();
+		}
+		ownerKept = ownerKept && queuedFromHere();
+		benchmark.AddCheck("jobs/SecondSystemOnThread", ownerKept);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ ECS -----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//How entities were stored before the ECS, every component behind its own shared_ptr
+	struct SharedEntity
+	{
+		std::shared_ptr<Transform> SharedTransform;
+		std::shared_ptr<Motion> SharedMotion;
+		int HierarchyNode;
+	};
+
+	//Game's Motion stage, one entity at a time
+	inline void MoveEntity(Transform& transform, const Motion& motion, float time)
+	{
+		float angle = time * motion.Speed + motion.Phase;
+		transform.SetPosition(
+			motion.Origin.x + std::cos(angle) * motion.Radius,
+			motion.Origin.y + std::sin(angle * 2.0f) * motion.Radius * 0.5f,
+			motion.Origin.z + std::sin(angle) * motion.Radius);
+	}
+
+	void RunEcsSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int entityCount = 1000000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<Motion> motions(entityCount);
+		for (int i = 0; i < entityCount; i++)
+		{
+			motions[i].Origin = XMFLOAT3(random.Range(-500, 500), random.Range(-500, 500), random.Range(-500, 500));
+			motions[i].Radius = 0.5f + (i % 7) * 0.25f;
+			motions[i].Speed = 0.5f + (i % 5) * 0.25f;
+			motions[i].Phase = i * 2.39996f;
+		}
+
+		//Both layouts do the same frames, then have to agree on where everything ended up
+		const int frames = 10;
+		double ecsSum = 0;
+		double sharedSum = 0;
+		{
+			World world;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < entityCount; i++)
+			{
+				world.CreateEntity(Transform(), motions[i], HierarchyNode{ -1 });
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			benchmark.AddSample("ecs/Create", std::chrono::duration<float, std::milli>(end - start).count());
+
+			Query<Transform, Motion> query(&world);
+			float time = 0;
+			Time(benchmark, "ecs/Motion", frames, [&]()
+				{
+					time += BENCHMARK_FIXED_DELTA_TIME;
+					query.ForEachChunk([time](int count, Entity*, Transform* transforms, Motion* motions)
+						{
+							for (int i = 0; i < count; i++)
+							{
+								MoveEntity(transforms[i], motions[i], time);
+							}
+						});
+				});
+
+			JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+			Time(benchmark, "ecs/MotionParallel", frames, [&]()
+				{
+					query.ParallelForEachChunk(jobs, [time](int count, Entity*, Transform* transforms, Motion* motions)
+						{
+							for (int i = 0; i < count; i++)
+							{
+								MoveEntity(transforms[i], motions[i], time);
+							}
+						});
+				});
+
+			Time(benchmark, "ecs/ReadPositions", frames, [&]()
+				{
+					ecsSum = 0;
+					query.ForEachChunk([&ecsSum](int count, Entity*, Transform* transforms, Motion*)
+						{
+							for (int i = 0; i < count; i++)
+							{
+								XMFLOAT3 position = transforms[i].GetPosition();
+								ecsSum += position.x + position.y + position.z;
+							}
+						});
+				});
+		}
+		{
+			std::vector<std::shared_ptr<SharedEntity>> entities;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < entityCount; i++)
+			{
+				std::shared_ptr<SharedEntity> entity = std::make_shared<SharedEntity>();
+				entity->SharedTransform = std::make_shared<Transform>();
+				entity->SharedMotion = std::make_shared<Motion>(motions[i]);
+				entity->HierarchyNode = -1;
+				entities.push_back(entity);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			benchmark.AddSample("ecs/SharedCreate", std::chrono::duration<float, std::milli>(end - start).count());
+
+			float time = 0;
+			Time(benchmark, "ecs/SharedMotion", frames, [&]()
+				{
+					time += BENCHMARK_FIXED_DELTA_TIME;
+					for (const std::shared_ptr<SharedEntity>& entity : entities)
+					{
+						MoveEntity(*entity->SharedTransform, *entity->SharedMotion, time);
+					}
+				});
+
+			Time(benchmark, "ecs/SharedReadPositions", frames, [&]()
+				{
+					sharedSum = 0;
+					for (const std::shared_ptr<SharedEntity>& entity : entities)
+					{
+						XMFLOAT3 position = entity->SharedTransform->GetPosition();
+						sharedSum += position.x + position.y + position.z;
+					}
+				});
+		}
+		benchmark.AddCheck("ecs/MatchesSharedLayout", std::fabs(ecsSum - sharedSum) <= 1e-6 * std::max(std::fabs(sharedSum), 1.0));
+		benchmark.AddInfo("ecs/entities", entityCount);
+
+		//Game's StructuralChanges stage destroying a parent with a subtree under it and a root. Rows
+		//move as entities go, so whatever survives has to end up bound to its new row.
+		World world;
+		TransformHierarchy hierarchy;
+		CommandBuffer commands;
+		const int parents[] = { -1, 0, 1, 1, 2, -1 };
+		Entity tree[6];
+		for (int i = 0; i < 6; i++)
+		{
+			Transform transform;
+			transform.SetPosition((float)i, 1, 0);
+			transform.SetRotation(0, 0.2f * i, 0);
+			tree[i] = world.CreateEntity(transform, HierarchyNode{ -1 });
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			int parentNode = parents[i] < 0 ? -1 : world.GetComponent<HierarchyNode>(tree[parents[i]])->Node;
+			world.GetComponent<HierarchyNode>(tree[i])->Node = hierarchy.AddNode(world.GetComponent<Transform>(tree[i]), parentNode);
+		}
+		commands.DestroyEntity(tree[1]);
+		commands.DestroyEntity(tree[5]);
+		commands.ForEachDestroy([&](Entity entity)
+			{
+				HierarchyNode* node = world.IsAlive(entity) ? world.GetComponent<HierarchyNode>(entity) : nullptr;
+				if (node != nullptr && node->Node >= 0)
+				{
+					hierarchy.DetachNode(node->Node);
+					node->Node = -1;
+				}
+			});
+		commands.Playback(world);
+		Query<Transform, HierarchyNode> bound(&world);
+		bound.ForEach([&](Entity, Transform& transform, HierarchyNode& node)
+			{
+				hierarchy.SetTransform(node.Node, &transform);
+			});
+		hierarchy.UpdateWorldMatrices();
+
+		auto nodeOf = [&](int i) { return world.GetComponent<HierarchyNode>(tree[i])->Node; };
+		auto localOf = [&](int i) { return ReferenceMatrix(*world.GetComponent<Transform>(tree[i])); };
+		bool detached = hierarchy.GetNodeCount() == 4 && !world.IsAlive(tree[1]) && !world.IsAlive(tree[5]);
+		for (int i : { 0, 2, 3, 4 })
+		{
+			detached = detached && hierarchy.GetTransform(nodeOf(i)) == world.GetComponent<Transform>(tree[i]);
+		}
+		detached = detached && hierarchy.GetParent(nodeOf(2)) == nodeOf(0) && hierarchy.GetParent(nodeOf(3)) == nodeOf(0) && hierarchy.GetParent(nodeOf(4)) == nodeOf(2)
+			&& NearlyEqual(hierarchy.GetWorldMatrix(nodeOf(4)), localOf(4) * localOf(2) * localOf(0))
+			&& NearlyEqual(hierarchy.GetWorldMatrix(nodeOf(3)), localOf(3) * localOf(0));
+		benchmark.AddCheck("ecs/DestroyDetachesHierarchyNode", detached);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SPATIAL -------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//"100k", "1M", for sample names
+	std::string CountName(int count)
+	{
+		return count >= 1000000 ? std::to_string(count / 1000000) + "M" : std::to_string(count / 1000) + "k";
+	}
+
+	//Half the side of a cube holding count things spacing apart, the same as the stress scene's
+	float CubeHalfSize(int count, float spacing)
+	{
+		return 0.5f * spacing * std::cbrt((float)std::max(count, 1));
+	}
+
+	//Stress scene sized boxes scattered through the cube
+	std::vector<AABB> RandomBoxes(SuiteRandom& random, int count, float halfSize)
+	{
+		std::vector<AABB> boxes(count);
+		for (AABB& box : boxes)
+		{
+			float extent = random.Range(0.25f, 0.75f);
+			box.Center = XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+			box.Extents = XMFLOAT3(extent, extent, extent);
+		}
+		return boxes;
+	}
+
+	//A frame of movement for the first moving boxes, a small step each like the Motion stage makes
+	void MoveBoxes(SuiteRandom& random, std::vector<AABB>& boxes, int moving)
+	{
+		for (int i = 0; i < moving; i++)
+		{
+			boxes[i].Center.x += random.Range(-0.5f, 0.5f);
+			boxes[i].Center.y += random.Range(-0.5f, 0.5f);
+			boxes[i].Center.z += random.Range(-0.5f, 0.5f);
+		}
+	}
+
+	//An axis aligned box as six planes, so frustum queries can be checked against plain box maths
+	Frustum BoxFrustum(const AABB& box)
+	{
+		Frustum frustum;
+		frustum.Planes[0] = XMFLOAT4(1, 0, 0, -(box.Center.x - box.Extents.x));
+		frustum.Planes[1] = XMFLOAT4(-1, 0, 0, box.Center.x + box.Extents.x);
+		frustum.Planes[2] = XMFLOAT4(0, 1, 0, -(box.Center.y - box.Extents.y));
+		frustum.Planes[3] = XMFLOAT4(0, -1, 0, box.Center.y + box.Extents.y);
+		frustum.Planes[4] = XMFLOAT4(0, 0, 1, -(box.Center.z - box.Extents.z));
+		frustum.Planes[5] = XMFLOAT4(0, 0, -1, box.Center.z + box.Extents.z);
+		return frustum;
+	}
+
+	std::vector<AABB> RandomQueries(SuiteRandom& random, int count, float halfSize, float size)
+	{
+		std::vector<AABB> queries(count);
+		for (AABB& query : queries)
+		{
+			query.Center = XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+			query.Extents = XMFLOAT3(size, size, size);
+		}
+		return queries;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SCENE ---------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunSceneSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		//The stress scene as asked for on the command line, at a million entities
+		StressSceneSettings sceneSettings = settings.Scene;
+		sceneSettings.EntityCount = 1000000;
+		std::string prefix = "scene/" + CountName(sceneSettings.EntityCount) + "/";
+
+		SceneBuilder builder;
+		std::string error;
+		bool built = false;
+		Time(benchmark, prefix + "Generate", 1, [&]() { built = BuildStressScene(sceneSettings, builder, error); });
+		if (!built)
+		{
+			std::printf("Suite scene: %s\n", error.c_str());
+			benchmark.AddCheck("scene/RoundTrip", false);
+			return;
+		}
+
+		std::filesystem::path path = std::filesystem::temp_directory_path() / "BenchmarkSuite.sceneb";
+		bool written = false;
+		Time(benchmark, prefix + "Write", 1, [&]() { written = builder.Write(path); });
+
+		//Mapping and validating is the whole of opening, nothing gets parsed or copied
+		SceneFile scene;
+		bool opened = written;
+		Time(benchmark, prefix + "Open", 5, [&]() { opened = opened && scene.Open(path); });
+
+		//Then LoadSceneFile's work per entity, less anything that needs a device
+		int count = opened ? scene.GetEntityCount() : 0;
+		const SceneEntity* entities = opened ? scene.GetEntities() : nullptr;
+		{
+			World world;
+			TransformHierarchy hierarchy;
+			std::vector<int> nodes(count);
+			Time(benchmark, prefix + "CreateEntities", 1, [&]()
+				{
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = world.CreateEntity(Transform(), Renderable{}, HierarchyNode{ -1 });
+						Transform* transform = world.GetComponent<Transform>(entity);
+						nodes[i] = hierarchy.AddNode(transform);
+						world.GetComponent<HierarchyNode>(entity)->Node = nodes[i];
+						transform->SetPosition(entities[i].Position);
+						transform->SetRotation(entities[i].Rotation);
+						transform->SetScale(entities[i].Scale);
+						if (entities[i].Parent != SCENE_NO_INDEX)
+						{
+							hierarchy.SetParent(nodes[i], nodes[entities[i].Parent]);
+						}
+					}
+				});
+			Time(benchmark, prefix + "FirstUpdate", 1, [&]() { hierarchy.UpdateWorldMatrices(); });
+		}
+
+		//What comes back out of the file has to be exactly what went in
+		bool matched = opened && count == builder.GetEntityCount()
+			&& std::memcmp(entities, builder.GetEntities(), sizeof(SceneEntity) * count) == 0;
+		benchmark.AddCheck("scene/RoundTrip", matched);
+		benchmark.AddInfo(prefix + "fileBytes", written ? (double)std::filesystem::file_size(path) : 0);
+
+		scene.Close();
+		std::error_code removeError;
+		std::filesystem::remove(path, removeError);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ HANDLES -------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Stand ins for what a draw reads off Mesh and Material, which need a device to make
+	struct SuiteShader
+	{
+		int Id;
+	};
+
+	struct SuiteMesh
+	{
+		int Id;
+		int IndexCount;
+	};
+
+	//How materials were held before handles, with getters handing out shared_ptr copies
+	struct SharedMaterial
+	{
+		std::shared_ptr<SuiteShader> VertexShader;
+		std::shared_ptr<SuiteShader> PixelShader;
+		XMFLOAT4 ColorTint;
+
+		std::shared_ptr<SuiteShader> GetVS() { return VertexShader; }
+		std::shared_ptr<SuiteShader> GetPS() { return PixelShader; }
+	};
+
+	struct PooledMaterial
+	{
+		SuiteShader* VertexShader;
+		SuiteShader* PixelShader;
+		XMFLOAT4 ColorTint;
+	};
+
+	struct SharedDraw
+	{
+		std::shared_ptr<SuiteMesh> Mesh;
+		std::shared_ptr<SharedMaterial> Material;
+
+		std::shared_ptr<SuiteMesh> GetMesh() { return Mesh; }
+		std::shared_ptr<SharedMaterial> GetMaterial() { return Material; }
+	};
+
+	struct PooledDraw
+	{
+		Handle<SuiteMesh> Mesh;
+		Handle<PooledMaterial> Material;
+	};
+
+	void RunHandlesSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int drawCount = 100000;
+		const int frames = 20;
+		int meshCount = std::max(settings.Scene.MeshVariety, 1);
+		int materialCount = std::max(settings.Scene.MaterialVariety, 1);
+
+		std::vector<SuiteShader> shaders = { { 0 }, { 1 }, { 2 } };
+		std::vector<std::shared_ptr<SuiteShader>> sharedShaders;
+		for (const SuiteShader& shader : shaders)
+		{
+			sharedShaders.push_back(std::make_shared<SuiteShader>(shader));
+		}
+
+		//The same meshes and materials both ways
+		std::vector<std::shared_ptr<SuiteMesh>> sharedMeshes;
+		std::vector<std::shared_ptr<SharedMaterial>> sharedMaterials;
+		HandlePool<SuiteMesh> meshPool;
+		HandlePool<PooledMaterial> materialPool;
+		std::vector<Handle<SuiteMesh>> meshHandles;
+		std::vector<Handle<PooledMaterial>> materialHandles;
+		for (int i = 0; i < meshCount; i++)
+		{
+			SuiteMesh mesh = { i, 36 * (i + 1) };
+			sharedMeshes.push_back(std::make_shared<SuiteMesh>(mesh));
+			meshHandles.push_back(meshPool.Create(mesh));
+		}
+		for (int i = 0; i < materialCount; i++)
+		{
+			XMFLOAT4 tint((float)i, 1, 1, 1);
+			sharedMaterials.push_back(std::make_shared<SharedMaterial>(SharedMaterial{ sharedShaders[0], sharedShaders[1 + i % 2], tint }));
+			materialHandles.push_back(materialPool.Create(PooledMaterial{ &shaders[0], &shaders[1 + i % 2], tint }));
+		}
+
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<SharedDraw> sharedDraws(drawCount);
+		std::vector<PooledDraw> pooledDraws(drawCount);
+		for (int i = 0; i < drawCount; i++)
+		{
+			uint32_t mesh = random.Below(meshCount);
+			uint32_t material = random.Below(materialCount);
+			sharedDraws[i] = { sharedMeshes[mesh], sharedMaterials[material] };
+			pooledDraws[i] = { meshHandles[mesh], materialHandles[material] };
+		}
+
+		//What GameEntity::Draw used to read per draw, every getter a shared_ptr copy
+		int64_t sharedSum = 0;
+		Time(benchmark, "handles/SharedPtrDraws", frames, [&]()
+			{
+				sharedSum = 0;
+				for (SharedDraw& draw : sharedDraws)
+				{
+					std::shared_ptr<SharedMaterial> material = draw.GetMaterial();
+					std::shared_ptr<SuiteShader> vs = material->GetVS();
+					std::shared_ptr<SuiteShader> ps = material->GetPS();
+					std::shared_ptr<SuiteMesh> mesh = draw.GetMesh();
+					sharedSum += vs->Id + ps->Id * 3 + (int64_t)material->ColorTint.x * 7 + mesh->IndexCount;
+				}
+			});
+
+		//And what it reads now, two pool lookups and plain pointers
+		int64_t pooledSum = 0;
+		Time(benchmark, "handles/HandleDraws", frames, [&]()
+			{
+				pooledSum = 0;
+				for (const PooledDraw& draw : pooledDraws)
+				{
+					PooledMaterial* material = materialPool.Get(draw.Material);
+					SuiteMesh* mesh = meshPool.Get(draw.Mesh);
+					pooledSum += material->VertexShader->Id + material->PixelShader->Id * 3 + (int64_t)material->ColorTint.x * 7 + mesh->IndexCount;
+				}
+			});
+		benchmark.AddCheck("handles/SameDraws", sharedSum == pooledSum);
+
+		//A destroyed slot's handle stays dead even after something else reuses the slot
+		Handle<PooledMaterial> destroyed = materialHandles[0];
+		materialPool.Destroy(destroyed);
+		Handle<PooledMaterial> reused = materialPool.Create(PooledMaterial{ &shaders[0], &shaders[1], XMFLOAT4(-1, 0, 0, 0) });
+		bool stale = materialPool.Get(destroyed) == nullptr && reused.Index == destroyed.Index && materialPool.Get(reused)->ColorTint.x == -1;
+		for (int i = 1; i < materialCount; i++)
+		{
+			stale = stale && materialPool.Get(materialHandles[i])->ColorTint.x == (float)i;
+		}
+		benchmark.AddCheck("handles/StaleHandles", stale);
+		benchmark.AddInfo("handles/draws", drawCount);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ OCTREE --------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunOctreeSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int counts[] = { 100000, 1000000 };
+		const int frames = 10;
+		const int queryCount = 100;
+		float spacing = std::max(settings.Scene.Spacing, 0.1f);
+		float percent = std::clamp(settings.Scene.MovingPercent, 0.0f, 100.0f);
+
+		bool matched = true;
+		for (int count : counts)
+		{
+			std::string prefix = "octree/" + CountName(count) + "/";
+			SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+			float halfSize = CubeHalfSize(count, spacing);
+			std::vector<AABB> boxes = RandomBoxes(random, count, halfSize);
+			int moving = (int)(count * percent / 100.0f);
+
+			//Room around the cube for everything that wanders out of it
+			LooseOctree octree(XMFLOAT3(0, 0, 0), halfSize + 16.0f);
+			Time(benchmark, prefix + "Insert", 1, [&]()
+				{
+					for (int i = 0; i < count; i++)
+					{
+						octree.Insert(i, boxes[i]);
+					}
+				});
+
+			Time(benchmark, prefix + "Move", frames, [&]()
+				{
+					MoveBoxes(random, boxes, moving);
+					for (int i = 0; i < moving; i++)
+					{
+						octree.Move(i, boxes[i]);
+					}
+				});
+
+			//Half boxes, half frustums, each about eight entities across
+			std::vector<AABB> queries = RandomQueries(random, queryCount, halfSize, 4.0f * spacing);
+			std::vector<std::vector<int>> found(queryCount);
+			Time(benchmark, prefix + "Query", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						if (q % 2 == 0)
+						{
+							octree.QueryAABB(queries[q], found[q]);
+						}
+						else
+						{
+							octree.QueryFrustum(BoxFrustum(queries[q]), found[q]);
+						}
+					}
+				});
+
+			std::vector<std::vector<int>> expected(queryCount);
+			Time(benchmark, prefix + "BruteForceQuery", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						Frustum frustum = BoxFrustum(queries[q]);
+						for (int i = 0; i < count; i++)
+						{
+							if (q % 2 == 0 ? AABBIntersectsAABB(boxes[i], queries[q]) : FrustumIntersectsAABB(frustum, boxes[i]))
+							{
+								expected[q].push_back(i);
+							}
+						}
+					}
+				});
+
+			int results = 0;
+			for (int q = 0; q < queryCount; q++)
+			{
+				std::sort(found[q].begin(), found[q].end());
+				matched = matched && found[q] == expected[q];
+				results += (int)expected[q].size();
+			}
+			benchmark.AddInfo(prefix + "moving", moving);
+			benchmark.AddInfo(prefix + "nodes", octree.GetNodeCount());
+			benchmark.AddInfo(prefix + "resultsPerQuery", (double)results / queryCount);
+		}
+		benchmark.AddCheck("octree/MatchesBruteForce", matched);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ BVH -----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunBvhSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int counts[] = { 100000, 1000000 };
+		const int frames = 10;
+		const int queryCount = 100;
+		float spacing = std::max(settings.Scene.Spacing, 0.1f);
+		float percent = std::clamp(settings.Scene.MovingPercent, 0.0f, 100.0f);
+
+		bool matched = true;
+		for (int count : counts)
+		{
+			std::string prefix = "bvh/" + CountName(count) + "/";
+			SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+			float halfSize = CubeHalfSize(count, spacing);
+			std::vector<AABB> boxes = RandomBoxes(random, count, halfSize);
+			int moving = (int)(count * percent / 100.0f);
+
+			DynamicAABBTree tree;
+			std::vector<int> proxies(count);
+			Time(benchmark, prefix + "Build", 1, [&]()
+				{
+					for (int i = 0; i < count; i++)
+					{
+						proxies[i] = tree.CreateProxy(boxes[i], i);
+					}
+				});
+			benchmark.AddInfo(prefix + "builtHeight", tree.GetHeight());
+			benchmark.AddInfo(prefix + "builtAreaRatio", tree.GetAreaRatio());
+
+			//Moves the -moving share every frame, then spends the same small rotation budget the game would
+			int changed = 0;
+			Time(benchmark, prefix + "Refit", frames, [&]()
+				{
+					MoveBoxes(random, boxes, moving);
+					for (int i = 0; i < moving; i++)
+					{
+						changed += tree.MoveProxy(proxies[i], boxes[i]) ? 1 : 0;
+					}
+					tree.Optimize(256);
+				});
+			benchmark.AddInfo(prefix + "moving", moving);
+			benchmark.AddInfo(prefix + "changedPerFrame", (double)changed / frames);
+			benchmark.AddInfo(prefix + "refitHeight", tree.GetHeight());
+			benchmark.AddInfo(prefix + "refitAreaRatio", tree.GetAreaRatio());
+
+			std::vector<AABB> queries = RandomQueries(random, queryCount, halfSize, 4.0f * spacing);
+			std::vector<std::vector<int>> found(queryCount);
+			Time(benchmark, prefix + "Query", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						if (q % 2 == 0)
+						{
+							tree.QueryAABB(queries[q], found[q]);
+						}
+						else
+						{
+							tree.QueryFrustum(BoxFrustum(queries[q]), found[q]);
+						}
+					}
+				});
+
+			std::vector<std::vector<int>> expected(queryCount);
+			Time(benchmark, prefix + "BruteForceQuery", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						Frustum frustum = BoxFrustum(queries[q]);
+						for (int i = 0; i < count; i++)
+						{
+							if (q % 2 == 0 ? AABBIntersectsAABB(boxes[i], queries[q]) : FrustumIntersectsAABB(frustum, boxes[i]))
+							{
+								expected[q].push_back(i);
+							}
+						}
+					}
+				});
+
+			//Leaves hold fattened boxes, so the tree can find a few more than the exact test, but never one outside the fat box
+			for (int q = 0; q < queryCount && matched; q++)
+			{
+				std::sort(found[q].begin(), found[q].end());
+				matched = std::adjacent_find(found[q].begin(), found[q].end()) == found[q].end()
+					&& std::includes(found[q].begin(), found[q].end(), expected[q].begin(), expected[q].end());
+				Frustum frustum = BoxFrustum(queries[q]);
+				for (int i : found[q])
+				{
+					AABB fat = tree.GetFatBounds(proxies[i]);
+					matched = matched && (q % 2 == 0 ? AABBIntersectsAABB(fat, queries[q]) : FrustumIntersectsAABB(frustum, fat));
+				}
+			}
+		}
+		benchmark.AddCheck("bvh/MatchesBruteForce", matched);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ STATIC --------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunStaticSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int entityCount = 1000000;
+		const int frames = 20;
+		float spacing = std::max(settings.Scene.Spacing, 0.1f);
+		float halfSize = CubeHalfSize(entityCount, spacing);
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<AABB> bounds = RandomBoxes(random, entityCount, halfSize);
+		AABB localBounds = { XMFLOAT3(0, 0, 0), XMFLOAT3(0.5f, 0.5f, 0.5f) };
+
+		//Entity index and node id line up, as they do for a freshly loaded scene
+		std::vector<Transform> transforms(entityCount);
+		TransformHierarchy hierarchy;
+		LooseOctree octree(XMFLOAT3(0, 0, 0), halfSize + 16.0f);
+		ChangeJournal journal;
+		journal.Get(CHANGE_CHANNEL_TRANSFORM).Resize(entityCount);
+		for (int i = 0; i < entityCount; i++)
+		{
+			transforms[i].SetPosition(bounds[i].Center);
+			hierarchy.AddNode(&transforms[i]);
+		}
+
+		//Game's TransformPropagation, Bounds and SpatialIndex stages, driven by the journal like the real ones
+		int journaled = 0;
+		auto frame = [&]()
+			{
+				hierarchy.UpdateWorldMatrices();
+				for (int node : hierarchy.GetUpdatedNodes())
+				{
+					journal.Mark(CHANGE_CHANNEL_TRANSFORM, (uint32_t)node);
+				}
+
+				DirtyBitset& moved = journal.Get(CHANGE_CHANNEL_TRANSFORM);
+				journaled = moved.GetMarkedCount();
+				moved.ForEach([&](uint32_t index)
+					{
+						bounds[index] = TransformAABB(localBounds, transforms[index].GetWorldMatrix());
+						octree.Move((int)index, bounds[index]);
+					});
+				journal.Clear();
+			};
+
+		//Loading touches everything once
+		Time(benchmark, "static/FirstFrame", 1, frame);
+		int firstJournaled = journaled;
+
+		//After that a scene where nothing moves should cost next to nothing
+		bool idle = true;
+		Time(benchmark, "static/Frame", frames, [&]()
+			{
+				frame();
+				idle = idle && journaled == 0 && hierarchy.GetLastUpdateCount() == 0;
+			});
+		benchmark.AddCheck("static/NothingJournaled", idle && firstJournaled == entityCount);
+
+		//Transforms report their own changes, so the hierarchy doesn't look at any of them either
+		Time(benchmark, "static/PropagationOnly", frames, [&]() { hierarchy.UpdateWorldMatrices(); });
+
+		//Against one percent moving, and against redoing everything as if nothing were journaled
+		int moving = entityCount / 100;
+		float time = 0;
+		Time(benchmark, "static/OnePercentMoving", frames, [&]()
+			{
+				time += BENCHMARK_FIXED_DELTA_TIME;
+				for (int i = 0; i < moving; i++)
+				{
+					XMFLOAT3 position = transforms[i].GetPosition();
+					transforms[i].SetPosition(position.x + std::sin(time) * 0.1f, position.y, position.z);
+				}
+				frame();
+			});
+		benchmark.AddCheck("static/JournalsOnlyMoved", journaled == moving);
+
+		Time(benchmark, "static/EverythingEveryFrame", 5, [&]()
+			{
+				for (int i = 0; i < entityCount; i++)
+				{
+					hierarchy.MarkDirty(i);
+				}
+				frame();
+			});
+		benchmark.AddInfo("static/entities", entityCount);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ GRID ----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunGridSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		//The same million points packed tighter and looser, so a query finds anything from hundreds of points to none
+		const int pointCount = 1000000;
+		const float spacings[] = { 0.5f, 1.0f, 2.0f, 4.0f };
+		const float radius = 2.0f;
+		const int queryCount = 50;
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+		bool matched = true;
+		for (float spacing : spacings)
+		{
+			char prefix[64];
+			std::snprintf(prefix, sizeof(prefix), "grid/spacing%g/", spacing);
+			SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+			float halfSize = CubeHalfSize(pointCount, spacing);
+			std::vector<XMFLOAT3> points(pointCount);
+			for (XMFLOAT3& point : points)
+			{
+				point = XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+			}
+
+			//Cells the size of the query radius, so a query only ever looks at its own cell and the ones around it
+			SpatialHashGrid grid(radius);
+			Time(benchmark, std::string(prefix) + "Build", 5, [&]() { grid.Build(points.data(), pointCount); });
+			Time(benchmark, std::string(prefix) + "BuildParallel", 5, [&]() { grid.Build(points.data(), pointCount, &jobs); });
+
+			std::vector<XMFLOAT3> centers(queryCount);
+			for (XMFLOAT3& center : centers)
+			{
+				center = XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+			}
+
+			std::vector<std::vector<int>> found(queryCount);
+			Time(benchmark, std::string(prefix) + "Query", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						grid.QueryRadius(centers[q], radius, found[q]);
+					}
+				});
+
+			std::vector<std::vector<int>> expected(queryCount);
+			Time(benchmark, std::string(prefix) + "BruteForceQuery", 1, [&]()
+				{
+					for (int q = 0; q < queryCount; q++)
+					{
+						for (int i = 0; i < pointCount; i++)
+						{
+							float x = points[i].x - centers[q].x;
+							float y = points[i].y - centers[q].y;
+							float z = points[i].z - centers[q].z;
+							if (x * x + y * y + z * z <= radius * radius)
+							{
+								expected[q].push_back(i);
+							}
+						}
+					}
+				});
+
+			int results = 0;
+			for (int q = 0; q < queryCount; q++)
+			{
+				std::sort(found[q].begin(), found[q].end());
+				matched = matched && found[q] == expected[q];
+				results += (int)expected[q].size();
+			}
+			benchmark.AddInfo(std::string(prefix) + "resultsPerQuery", (double)results / queryCount);
+		}
+		benchmark.AddCheck("grid/MatchesBruteForce", matched);
+		benchmark.AddInfo("grid/points", pointCount);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SORT ----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	void RunSortSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int keyCount = 1000000;
+		const int repeats = 10;
+		uint32_t meshCount = (uint32_t)std::max(settings.Scene.MeshVariety, 1);
+		uint32_t materialCount = (uint32_t)std::max(settings.Scene.MaterialVariety, 1);
+
+		//Opaque draws over the stress scene's variety, with a sprinkling of translucent ones
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<std::pair<uint64_t, uint32_t>> items(keyCount);
+		for (int i = 0; i < keyCount; i++)
+		{
+			uint32_t material = random.Below(materialCount);
+			items[i].first = RenderQueue::MakeKey(0, random.Below(20) == 0, material % 4, material, random.Below(meshCount), random.Range(0, 1));
+			items[i].second = (uint32_t)i;
+		}
+
+		std::vector<std::pair<uint64_t, uint32_t>> expected = items;
+		Time(benchmark, "sort/1M/StdStableSort", repeats, [&]()
+			{
+				expected = items;
+				std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			});
+
+		//Only the sort itself is timed, refilling the queue each time is not
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		RenderQueue queue;
+		bool matched = true;
+		for (int parallel = 0; parallel < 2; parallel++)
+		{
+			for (int repeat = 0; repeat < repeats; repeat++)
+			{
+				queue.Resize(keyCount);
+				for (int i = 0; i < keyCount; i++)
+				{
+					queue.Set(i, items[i].first, items[i].second);
+				}
+				auto start = std::chrono::high_resolution_clock::now();
+				queue.Sort(parallel ? &jobs : nullptr);
+				auto end = std::chrono::high_resolution_clock::now();
+				benchmark.AddSample(parallel ? "sort/1M/RadixParallel" : "sort/1M/Radix", std::chrono::duration<float, std::milli>(end - start).count());
+			}
+
+			//Radix sorts are stable, so even equal keys have to come out in the same order
+			for (int i = 0; i < keyCount && matched; i++)
+			{
+				matched = queue.GetKeys()[i] == expected[i].first && queue.GetValues()[i] == expected[i].second;
+			}
+		}
+		benchmark.AddCheck("sort/MatchesStableSort", matched);
+
+		const RenderQueueStats& stats = queue.GetStats();
+		benchmark.AddInfo("sort/1M/passes", stats.Passes);
+		benchmark.AddInfo("sort/1M/stateChangesBefore", stats.StateChangesBefore);
+		benchmark.AddInfo("sort/1M/stateChangesAfter", stats.StateChangesAfter);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ INSTANCING ----------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Every batch follows on from the one before, instanced ones hold one mesh and material and
+	//are between the limits, and no instanced batch could have taken in the next draw
+	bool ValidBatches(InstanceBatcher& batcher, const InstanceDraw* draws, int count, int minInstances, int maxInstances)
+	{
+		const InstanceBatch* batches = batcher.GetBatches();
+		int next = 0;
+		int instances = 0;
+		int drawCalls = 0;
+		for (int b = 0; b < batcher.GetBatchCount(); b++)
+		{
+			const InstanceBatch& batch = batches[b];
+			if (batch.First != next || batch.Count <= 0)
+			{
+				return false;
+			}
+			next += batch.Count;
+
+			if (!batch.Instanced)
+			{
+				//Drawn one at a time, and never two of those in a row
+				if (b > 0 && !batches[b - 1].Instanced)
+				{
+					return false;
+				}
+				drawCalls += batch.Count;
+				continue;
+			}
+
+			const InstanceDraw& first = draws[batch.First];
+			if (batch.FirstInstance != instances || batch.Count < minInstances || batch.Count > maxInstances)
+			{
+				return false;
+			}
+			for (int i = batch.First; i < batch.First + batch.Count; i++)
+			{
+				if (!draws[i].Instancable || draws[i].Mesh != first.Mesh || draws[i].Material != first.Material)
+				{
+					return false;
+				}
+			}
+
+			//Stopping short of a full batch means the run ended there
+			int after = batch.First + batch.Count;
+			if (batch.Count < maxInstances && after < count && draws[after].Instancable && draws[after].Mesh == first.Mesh && draws[after].Material == first.Material)
+			{
+				return false;
+			}
+			instances += batch.Count;
+			drawCalls++;
+		}
+
+		const InstanceBatchStats& stats = batcher.GetStats();
+		return next == count && instances == stats.InstancedDraws && drawCalls == stats.DrawCalls;
+	}
+
+	//Batches as (instanced, count) pairs, to compare against hand worked expectations
+	bool BatchesAre(InstanceBatcher& batcher, const std::vector<std::pair<bool, int>>& expected)
+	{
+		if (batcher.GetBatchCount() != (int)expected.size())
+		{
+			return false;
+		}
+		for (int b = 0; b < batcher.GetBatchCount(); b++)
+		{
+			if (batcher.GetBatches()[b].Instanced != expected[b].first || batcher.GetBatches()[b].Count != expected[b].second)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void RunInstancingSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		InstanceBatcher batcher;
+
+		//Three of A, one B, two C, two that can't be instanced, four D, then one more A
+		std::vector<InstanceDraw> runs =
+		{
+			{ 0, 0, true }, { 0, 0, true }, { 0, 0, true },
+			{ 1, 0, true },
+			{ 1, 1, true }, { 1, 1, true },
+			{ 2, 2, false }, { 2, 2, false },
+			{ 3, 3, true }, { 3, 3, true }, { 3, 3, true }, { 3, 3, true },
+			{ 0, 0, true },
+		};
+		batcher.Build(runs.data(), (int)runs.size());
+		bool split = BatchesAre(batcher, { { true, 3 }, { false, 1 }, { true, 2 }, { false, 2 }, { true, 4 }, { false, 1 } })
+			&& ValidBatches(batcher, runs.data(), (int)runs.size(), INSTANCE_MIN_BATCH, INSTANCE_MAX_BATCH);
+
+		//A run longer than the maximum is cut at it, and a leftover too short to instance joins the next one at a time batch
+		const int maxInstances = 8;
+		std::vector<InstanceDraw> longRun(maxInstances * 2 + 1, InstanceDraw{ 5, 5, true });
+		longRun.push_back({ 6, 6, false });
+		batcher.Build(longRun.data(), maxInstances, INSTANCE_MIN_BATCH, maxInstances);
+		bool boundary = BatchesAre(batcher, { { true, maxInstances } });
+		batcher.Build(longRun.data(), (int)longRun.size(), INSTANCE_MIN_BATCH, maxInstances);
+		boundary = boundary && BatchesAre(batcher, { { true, maxInstances }, { true, maxInstances }, { false, 2 } })
+			&& ValidBatches(batcher, longRun.data(), (int)longRun.size(), INSTANCE_MIN_BATCH, maxInstances);
+		batcher.Build(longRun.data(), maxInstances + 2, INSTANCE_MIN_BATCH, maxInstances);
+		boundary = boundary && BatchesAre(batcher, { { true, maxInstances }, { true, 2 } });
+
+		benchmark.AddCheck("instancing/RunSplitting", split);
+		benchmark.AddCheck("instancing/MaxBatchBoundary", boundary);
+
+		//A frame's worth of draws through the render queue, every run checked against its keys
+		const int drawCount = 100000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<InstanceDraw> source(drawCount);
+		RenderQueue queue;
+		for (int i = 0; i < drawCount; i++)
+		{
+			uint32_t material = random.Below(32);
+			source[i] = { random.Below(20), material, material % 8 != 0 };
+			queue.Add(RenderQueue::MakeKey(0, false, material % 4, material, source[i].Mesh, random.Range(0.0f, 1.0f)), i);
+		}
+		queue.Sort();
+
+		std::vector<InstanceDraw> draws(drawCount);
+		for (int i = 0; i < drawCount; i++)
+		{
+			draws[i] = source[queue.GetValues()[i]];
+		}
+
+		Time(benchmark, "instancing/Build", 20, [&]() { batcher.Build(draws.data(), drawCount); });
+		benchmark.AddCheck("instancing/RunKeys", ValidBatches(batcher, draws.data(), drawCount, INSTANCE_MIN_BATCH, INSTANCE_MAX_BATCH));
+		benchmark.AddInfo("instancing/draws", batcher.GetStats().Draws);
+		benchmark.AddInfo("instancing/drawCalls", batcher.GetStats().DrawCalls);
+		benchmark.AddInfo("instancing/instancedBatches", batcher.GetStats().InstancedBatches);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ STATE CACHE ---------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Stands in for a device context, keeping what every slot ends up holding and counting the calls
+	class RecordingContext : public IRenderContext
+	{
+	public:
+		std::map<uint64_t, std::array<uintptr_t, 3>> Slots; //Keyed by call, stage and slot
+		int Calls = 0;
+
+		void SetInputLayout(ID3D11InputLayout* layout) override { Record(0, 0, 0, layout); }
+		void SetVertexShader(ID3D11VertexShader* shader) override { Record(1, 0, 0, shader); }
+		void SetPixelShader(ID3D11PixelShader* shader) override { Record(2, 0, 0, shader); }
+		void SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer) override { Record(3, stage, slot, buffer); }
+		void SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv) override { Record(4, stage, slot, srv); }
+		void SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler) override { Record(5, stage, slot, sampler); }
+		void SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) override { Record(6, 0, slot, buffer, stride, offset); }
+		void SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset) override { Record(7, 0, 0, buffer, format, offset); }
+		void SetRasterizerState(ID3D11RasterizerState* state) override { Record(8, 0, 0, state); }
+		void SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef) override { Record(9, 0, 0, state, stencilRef); }
+
+	private:
+		void Record(uint64_t call, int stage, uint32_t slot, const void* value, uint32_t first = 0, uint32_t second = 0)
+		{
+			Slots[(call << 40) | ((uint64_t)stage << 32) | slot] = { (uintptr_t)value, first, second };
+			Calls++;
+		}
+	};
+
+	//Never dereferenced, only compared, so any distinct non null values will do
+	template<typename T>
+	T* FakeResource(uint32_t id)
+	{
+		return reinterpret_cast<T*>((uintptr_t)(id + 1) * 16);
+	}
+
+	//One draw's binds, as Mesh::Draw and a material's shaders make them
+	template<typename Context>
+	void BindDraw(Context& context, uint32_t shader, uint32_t material, uint32_t mesh)
+	{
+		context.SetInputLayout(FakeResource<ID3D11InputLayout>(shader));
+		context.SetVertexShader(FakeResource<ID3D11VertexShader>(shader));
+		context.SetPixelShader(FakeResource<ID3D11PixelShader>(shader));
+		context.SetConstantBuffer(RENDER_STAGE_VERTEX, 0, FakeResource<ID3D11Buffer>(shader * 2));
+		context.SetConstantBuffer(RENDER_STAGE_PIXEL, 0, FakeResource<ID3D11Buffer>(shader * 2 + 1));
+		for (uint32_t texture = 0; texture < 3; texture++)
+		{
+			context.SetShaderResource(RENDER_STAGE_PIXEL, texture, FakeResource<ID3D11ShaderResourceView>(material * 3 + texture));
+		}
+		context.SetSampler(RENDER_STAGE_PIXEL, 0, FakeResource<ID3D11SamplerState>(material % 2));
+		context.SetVertexBuffer(0, FakeResource<ID3D11Buffer>(1000 + mesh), 32, 0);
+		context.SetIndexBuffer(FakeResource<ID3D11Buffer>(2000 + mesh), 42, 0);
+	}
+
+	void RunStateCacheSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		//Two identical draws, then one with only a new mesh: 11 binds each, the second all dropped,
+		//the third sending just its vertex and index buffer
+		RecordingContext counted;
+		RenderStateCache cache;
+		cache.SetContext(&counted);
+		cache.BeginFrame();
+		BindDraw(cache, 1, 1, 1);
+		BindDraw(cache, 1, 1, 1);
+		BindDraw(cache, 1, 1, 2);
+		bool counts = cache.GetStats().Issued == 13 && cache.GetStats().Elided == 20 && counted.Calls == 13;
+
+		//Slots past what's tracked always go through
+		cache.SetShaderResource(RENDER_STAGE_PIXEL, STATE_CACHE_SRV_SLOTS, nullptr);
+		cache.SetShaderResource(RENDER_STAGE_PIXEL, STATE_CACHE_SRV_SLOTS, nullptr);
+		counts = counts && counted.Calls == 15;
+
+		//After an invalidate everything is sent again, and a new frame starts the counts over
+		cache.Invalidate();
+		BindDraw(cache, 1, 1, 2);
+		cache.BeginFrame();
+		counts = counts && counted.Calls == 26 && cache.GetLastFrameStats().Issued == 26 && cache.GetStats().Issued == 0;
+
+		//Disabled, repeats are sent and still counted
+		cache.SetEnabled(false);
+		BindDraw(cache, 1, 1, 2);
+		BindDraw(cache, 1, 1, 2);
+		counts = counts && counted.Calls == 48 && cache.GetStats().Issued == 22 && cache.GetStats().Elided == 0;
+		benchmark.AddCheck("statecache/BindCounts", counts);
+
+		//A sorted frame's worth of draws sent through the cache and straight to a second context. Whatever
+		//the cache drops, both have to end up holding the same thing after every draw.
+		RecordingContext direct;
+		RecordingContext filtered;
+		cache.SetContext(&filtered);
+		cache.SetEnabled(true);
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		const int drawCount = 20000;
+		bool matched = true;
+		for (int frame = 0; frame < 3; frame++)
+		{
+			cache.BeginFrame();
+
+			//The UI binds behind the cache's back, which is why frames start invalidated
+			direct.SetPixelShader(FakeResource<ID3D11PixelShader>(999));
+			filtered.SetPixelShader(FakeResource<ID3D11PixelShader>(999));
+			cache.Invalidate();
+
+			uint32_t shader = 0;
+			uint32_t material = 0;
+			uint32_t mesh = 0;
+			for (int draw = 0; draw < drawCount && matched; draw++)
+			{
+				shader = random.Below(50) == 0 ? random.Below(8) : shader;
+				material = random.Below(10) == 0 ? random.Below(64) : material;
+				mesh = random.Below(3) == 0 ? random.Below(200) : mesh;
+				BindDraw(cache, shader, material, mesh);
+				BindDraw(direct, shader, material, mesh);
+				matched = filtered.Slots == direct.Slots;
+			}
+		}
+		benchmark.AddCheck("statecache/MatchesDirect", matched);
+		benchmark.AddInfo("statecache/issuedPerFrame", cache.GetStats().Issued);
+		benchmark.AddInfo("statecache/elidedPerFrame", cache.GetStats().Elided);
+
+		//What a bind costs the CPU before it reaches the driver, against the context on its own
+		RecordingContext sink;
+		cache.SetContext(&sink);
+		Time(benchmark, "statecache/Cached", 10, [&]()
+			{
+				cache.BeginFrame();
+				for (int draw = 0; draw < drawCount; draw++)
+				{
+					BindDraw(cache, draw / 500, draw / 50, draw / 3);
+				}
+			});
+		Time(benchmark, "statecache/Direct", 10, [&]()
+			{
+				for (int draw = 0; draw < drawCount; draw++)
+				{
+					BindDraw(sink, draw / 500, draw / 50, draw / 3);
+				}
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ MEMORY --------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	struct PooledParticle
+	{
+		DirectX::XMFLOAT3 Position;
+		float Age;
+	};
+
+	//What a frame's transient work asks of the allocators: scratch arrays and a frame vector off the thread's
+	//frame allocator, pooled objects made and freed, and a vector bumped out of a caller owned linear allocator
+	void RunMemoryFrame(LinearAllocator& scratch, ObjectPool<PooledParticle>& particles, std::vector<PooledParticle*>& live, int count)
+	{
+		FrameMemory::BeginFrame();
+		scratch.Reset();
+
+		float* weights = FrameMemory::GetThreadAllocator().AllocateArray<float>(count);
+		FrameVector<int> visible;
+		std::vector<int, LinearStlAllocator<int>> sorted{ LinearStlAllocator<int>(&scratch) };
+		for (int i = 0; i < count; i++)
+		{
+			weights[i] = (float)i;
+			visible.push_back(i);
+			sorted.push_back(count - i);
+		}
+
+		for (int i = 0; i < count / 4; i++)
+		{
+			live.push_back(particles.Create(PooledParticle{ { (float)i, 0, 0 }, 0 }));
+		}
+		for (PooledParticle* particle : live)
+		{
+			particles.Destroy(particle);
+		}
+		live.clear();
+	}
+
+	void RunMemorySuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int count = std::max(settings.Scene.EntityCount, 1000);
+		LinearAllocator scratch(4096);
+		ObjectPool<PooledParticle> particles(64);
+		std::vector<PooledParticle*> live;
+		live.reserve(count / 4);
+
+		//The first frame overflows the small starting sizes and gives the pool its pages, the
+		//second is where the allocators have grown to fit, after which nothing should reach new
+		RunMemoryFrame(scratch, particles, live, count);
+		RunMemoryFrame(scratch, particles, live, count);
+
+		const int steadyFrames = 10;
+		uint64_t before = AllocationCounter::GetCount();
+		for (int frame = 0; frame < steadyFrames; frame++)
+		{
+			RunMemoryFrame(scratch, particles, live, count);
+		}
+		uint64_t steadyAllocations = AllocationCounter::GetCount() - before;
+
+		//Makes sure the counter is actually watching, or the check above would pass for nothing
+		std::unique_ptr<int> probe = std::make_unique<int>(1);
+		bool counting = AllocationCounter::GetCount() > before + steadyAllocations;
+
+#if MEMORY_TRACK_ALLOCATIONS
+		benchmark.AddCheck("memory/CounterCounts", counting);
+		benchmark.AddCheck("memory/ZeroSteadyStateAllocations", steadyAllocations == 0);
+		if (steadyAllocations != 0)
+		{
+			std::printf("Suite memory: %llu allocations over %d steady frames\n", (unsigned long long)steadyAllocations, steadyFrames);
+		}
+#else
+		(void)counting;
+#endif
+		benchmark.AddInfo("memory/steadyAllocations", (float)steadyAllocations);
+
+		//The same frame through the allocators, against plain heap containers doing the same work
+		Time(benchmark, "memory/FrameAllocators", 20, [&]()
+			{
+				RunMemoryFrame(scratch, particles, live, count);
+			});
+		Time(benchmark, "memory/Heap", 20, [&]()
+			{
+				std::unique_ptr<float[]> weights(new float[count]);
+				std::vector<int> visible;
+				std::vector<int> sorted;
+				std::vector<std::unique_ptr<PooledParticle>> owned;
+				for (int i = 0; i < count; i++)
+				{
+					weights[i] = (float)i;
+					visible.push_back(i);
+					sorted.push_back(count - i);
+				}
+				for (int i = 0; i < count / 4; i++)
+				{
+					owned.push_back(std::make_unique<PooledParticle>(PooledParticle{ { (float)i, 0, 0 }, 0 }));
+				}
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SNAPSHOTS -----------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Materials for snapshots without any shaders behind them
+	class SuiteMaterialState : public IMaterialStateSource
+	{
+	public:
+		std::vector<MaterialState> Materials;
+
+		int GetMaterialCount() override { return (int)Materials.size(); }
+		MaterialState GetMaterialState(int index) override { return Materials[index]; }
+		void SetMaterialState(int index, const MaterialState& state) override { Materials[index] = state; }
+	};
+
+	//Everything a snapshot covers, set up the way Game owns it
+	struct SnapshotScene
+	{
+		World Entities;
+		HandlePool<Camera> Cameras;
+		HandlePool<Light> Lights;
+		SuiteMaterialState Materials;
+		Handle<Camera> ActiveCamera;
+		float MotionTime = 0;
+	};
+
+	//Moves a share of the entities and nudges one of everything else, like a frame of simulation would
+	void MutateSnapshotScene(SnapshotScene& scene, Query<Transform>& transforms, SuiteRandom& random, uint32_t moveOneIn)
+	{
+		transforms.ForEach([&](Entity, Transform& transform)
+			{
+				if (random.Below(moveOneIn) == 0)
+				{
+					transform.MoveAbsolute(random.Range(-1, 1), random.Range(-1, 1), random.Range(-1, 1));
+					transform.Rotate(0, random.Range(-0.1f, 0.1f), 0);
+				}
+			});
+		scene.Cameras.GetData()[random.Below(scene.Cameras.GetCount())].GetTransform()->MoveAbsolute(0, 0, 1);
+		scene.Lights.GetData()[random.Below(scene.Lights.GetCount())].Intensity += 0.5f;
+		scene.Materials.Materials[random.Below((uint32_t)scene.Materials.Materials.size())].Roughness += 0.125f;
+		scene.MotionTime += BENCHMARK_FIXED_DELTA_TIME;
+	}
+
+	void RunSnapshotSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int entityCount = std::max(settings.Scene.EntityCount, 1000);
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		SnapshotScene scene;
+		std::vector<Entity> entities;
+		for (int i = 0; i < entityCount; i++)
+		{
+			Transform transform;
+			transform.SetPosition(random.Range(-100, 100), random.Range(-100, 100), random.Range(-100, 100));
+			entities.push_back(scene.Entities.CreateEntity(transform));
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			scene.Cameras.Create(XMFLOAT3(0, 0, -20.0f * (i + 1)), 10.0f, 2.0f, XM_PIDIV4, 16.0f / 9.0f);
+			Light light = {};
+			light.Type = i % 3;
+			light.Intensity = 1.0f;
+			scene.Lights.Create(light);
+		}
+		for (int i = 0; i < 8; i++)
+		{
+			scene.Materials.Materials.push_back({ XMFLOAT4(1, 1, 1, 1), XMFLOAT2(1, 1), XMFLOAT2(0, 0), i / 8.0f });
+		}
+		scene.ActiveCamera = scene.Cameras.GetHandle(0);
+
+		SimulationState state(&scene.Entities, &scene.Cameras, &scene.Lights, &scene.Materials, &scene.ActiveCamera, &scene.MotionTime);
+		Query<Transform> transforms(&scene.Entities);
+
+		//Capture, change everything, restore, and the state has to hash back to what was captured
+		std::vector<unsigned char> original;
+		std::vector<unsigned char> changed;
+		std::vector<unsigned char> check;
+		state.Capture(0, original);
+		MutateSnapshotScene(scene, transforms, random, 2);
+		scene.ActiveCamera = scene.Cameras.GetHandle(2);
+		state.Capture(0, changed);
+		bool restored = state.Restore(original);
+		state.Capture(0, check);
+		benchmark.AddCheck("snapshot/MutationChangesHash", SimulationState::Hash(changed) != SimulationState::Hash(original));
+		benchmark.AddCheck("snapshot/RestoreMatchesHash", restored && SimulationState::Hash(check) == SimulationState::Hash(original) && check == original);
+
+		//Once the structure changes the rows no longer line up, survivors are found by id instead
+		scene.Entities.GetComponent<Transform>(entities[10])->MoveAbsolute(5, 5, 5);
+		scene.Entities.DestroyEntity(entities[3]);
+		restored = state.Restore(original);
+		const EntityState* saved = reinterpret_cast<const EntityState*>(original.data() + sizeof(SnapshotHeader));
+		XMFLOAT3 position = scene.Entities.GetComponent<Transform>(entities[10])->GetPosition();
+		bool byId = saved[10].Id == entities[10] && position.x == saved[10].Position.x && position.y == saved[10].Position.y && position.z == saved[10].Position.z;
+		benchmark.AddCheck("snapshot/RestoreAfterDestroy", restored && byId);
+
+		//Anything that isn't exactly a snapshot of this version is turned away before it touches the state
+		std::vector<unsigned char> truncated(original.begin(), original.end() - 4);
+		std::vector<unsigned char> wrongVersion = original;
+		wrongVersion[4]++;
+		benchmark.AddCheck("snapshot/RejectsMalformed", !state.Restore(truncated) && !state.Restore(wrongVersion) && !state.Restore({}));
+
+		//Deltas on their own, both ways between two real snapshots
+		std::vector<unsigned char> delta;
+		std::vector<unsigned char> rebuilt;
+		SnapshotHistory::EncodeDelta(changed, original, delta);
+		SnapshotHistory::ApplyDelta(delta, original, rebuilt);
+		bool deltas = rebuilt == changed;
+		SnapshotHistory::EncodeDelta(original, changed, delta);
+		SnapshotHistory::ApplyDelta(delta, changed, rebuilt);
+		benchmark.AddCheck("snapshot/DeltaRoundTrip", deltas && rebuilt == original);
+
+		//A run of frames through the ring: every frame still held comes back byte for byte, older ones are gone
+		const int capacity = 16;
+		const int frames = 40;
+		SnapshotHistory history(capacity);
+		std::vector<std::vector<unsigned char>> captured(frames);
+		std::vector<unsigned char> snapshot;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			MutateSnapshotScene(scene, transforms, random, 20);
+			state.Capture((uint32_t)frame, captured[frame]);
+			history.Push((uint32_t)frame, captured[frame]);
+		}
+		bool historyMatched = history.GetCount() == capacity && history.GetNewestFrame() == frames - 1 && history.GetOldestFrame() == frames - capacity;
+		for (int frame = 0; frame < frames && historyMatched; frame++)
+		{
+			bool held = history.Get((uint32_t)frame, snapshot);
+			historyMatched = frame < frames - capacity ? !held : held && SimulationState::Hash(snapshot) == SimulationState::Hash(captured[frame]) && snapshot == captured[frame];
+		}
+		benchmark.AddCheck("snapshot/HistoryRoundTrip", historyMatched);
+
+		//Going back through the history has to put the whole simulation back as it was then
+		bool rewound = history.Get(frames - capacity, snapshot) && state.Restore(snapshot);
+		state.Capture(frames - capacity, check);
+		benchmark.AddCheck("snapshot/HistoryRestoreMatchesHash", rewound && SimulationState::Hash(check) == SimulationState::Hash(captured[frames - capacity]));
+		benchmark.AddInfo("snapshot/snapshotBytes", (float)original.size());
+		benchmark.AddInfo("snapshot/historyBytes", (float)history.GetMemoryUsed());
+
+		Time(benchmark, "snapshot/Capture", 20, [&]()
+			{
+				state.Capture(0, snapshot);
+			});
+		Time(benchmark, "snapshot/Restore", 20, [&]()
+			{
+				state.Restore(snapshot);
+			});
+		uint32_t nextFrame = frames;
+		Time(benchmark, "snapshot/Push", 20, [&]()
+			{
+				MutateSnapshotScene(scene, transforms, random, 20);
+				state.Capture(nextFrame, snapshot);
+				history.Push(nextFrame++, snapshot);
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ OCCLUSION -----------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Unit cube, every face wound clockwise seen from outside like the models are
+	void BuildCube(std::vector<XMFLOAT3>& positions, std::vector<unsigned int>& indices)
+	{
+		for (int corner = 0; corner < 8; corner++)
+		{
+			positions.push_back(XMFLOAT3((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f));
+		}
+		const unsigned int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 } };
+		for (const unsigned int* face : faces)
+		{
+			unsigned int quad[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	//Where a box lands on the occlusion buffer, worked out the way OcclusionCuller::IsVisible does it
+	struct ScreenRect
+	{
+		float MinX, MinY, MaxX, MaxY;
+		float Nearest;
+		bool NearPlane;
+		bool OffScreen;
+	};
+
+	ScreenRect ProjectBox(const AABB& box, FXMMATRIX viewProjection)
+	{
+		const float far = std::numeric_limits<float>::max();
+		ScreenRect rect = { far, far, -far, -far, far, false, false };
+		for (int corner = 0; corner < 8; corner++)
+		{
+			XMVECTOR point = XMVectorSet(
+				box.Center.x + ((corner & 1) ? box.Extents.x : -box.Extents.x),
+				box.Center.y + ((corner & 2) ? box.Extents.y : -box.Extents.y),
+				box.Center.z + ((corner & 4) ? box.Extents.z : -box.Extents.z),
+				1.0f);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(point, viewProjection));
+			if (clip.w < OCCLUSION_NEAR_W)
+			{
+				rect.NearPlane = true;
+				return rect;
+			}
+			float x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+			float y = (0.5f - clip.y / clip.w * 0.5f) * OCCLUSION_HEIGHT;
+			rect.MinX = std::min(rect.MinX, x);
+			rect.MaxX = std::max(rect.MaxX, x);
+			rect.MinY = std::min(rect.MinY, y);
+			rect.MaxY = std::max(rect.MaxY, y);
+			rect.Nearest = std::min(rect.Nearest, clip.w);
+		}
+		rect.OffScreen = rect.MaxX < 0 || rect.MaxY < 0 || rect.MinX >= OCCLUSION_WIDTH || rect.MinY >= OCCLUSION_HEIGHT;
+		return rect;
+	}
+
+	//The exact answer: every occluder triangle drawn into a full depth buffer, depth interpolated per pixel
+	void RasterizeReference(std::vector<float>& depth, const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& indices, FXMMATRIX worldViewProjection)
+	{
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			float x[3], y[3], w[3];
+			bool usable = true;
+			for (int v = 0; v < 3; v++)
+			{
+				XMFLOAT4 clip;
+				XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(positions[indices[i + v]].x, positions[indices[i + v]].y, positions[indices[i + v]].z, 1.0f), worldViewProjection));
+				usable = usable && clip.w >= OCCLUSION_NEAR_W;
+				x[v] = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+				y[v] = (0.5f - clip.y / clip.w * 0.5f) * OCCLUSION_HEIGHT;
+				w[v] = clip.w;
+			}
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (!usable || area == 0)
+			{
+				continue;
+			}
+
+			//Both facings and pixels on an edge count, so the reference only ever hides more
+			int minX = std::max((int)std::floor(std::min({ x[0], x[1], x[2] })), 0);
+			int maxX = std::min((int)std::ceil(std::max({ x[0], x[1], x[2] })), OCCLUSION_WIDTH - 1);
+			int minY = std::max((int)std::floor(std::min({ y[0], y[1], y[2] })), 0);
+			int maxY = std::min((int)std::ceil(std::max({ y[0], y[1], y[2] })), OCCLUSION_HEIGHT - 1);
+			for (int py = minY; py <= maxY; py++)
+			{
+				for (int px = minX; px <= maxX; px++)
+				{
+					float cx = px + 0.5f;
+					float cy = py + 0.5f;
+					float edge[3];
+					for (int e = 0; e < 3; e++)
+					{
+						int j = (e + 1) % 3;
+						edge[e] = ((x[j] - x[e]) * (cy - y[e]) - (y[j] - y[e]) * (cx - x[e])) / area;
+					}
+					if (edge[0] < 0 || edge[1] < 0 || edge[2] < 0)
+					{
+						continue;
+					}
+
+					//Edge e is the weight of the vertex across from it, and 1/w is what's linear on screen
+					float inverseW = edge[1] / w[0] + edge[2] / w[1] + edge[0] / w[2];
+					float& pixel = depth[py * OCCLUSION_WIDTH + px];
+					pixel = std::min(pixel, 1.0f / inverseW);
+				}
+			}
+		}
+	}
+
+	void RunOcclusionSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<XMFLOAT3> cubePositions;
+		std::vector<unsigned int> cubeIndices;
+		BuildCube(cubePositions, cubeIndices);
+
+		//A row of walls across the view, some overlapping, with boxes scattered in front, between and behind
+		std::vector<XMFLOAT4X4> walls(12);
+		for (XMFLOAT4X4& wall : walls)
+		{
+			XMMATRIX world = XMMatrixScaling(random.Range(6, 14), random.Range(4, 10), 0.5f)
+				* XMMatrixRotationY(random.Range(-0.3f, 0.3f))
+				* XMMatrixTranslation(random.Range(-22, 22), random.Range(-6, 6), random.Range(20, 40));
+			XMStoreFloat4x4(&wall, world);
+		}
+		const int boxCount = 20000;
+		std::vector<AABB> boxes(boxCount);
+		for (AABB& box : boxes)
+		{
+			float z = random.Range(5, 150);
+			box.Center = XMFLOAT3(random.Range(-z, z) * 0.8f, random.Range(-z, z) * 0.45f, z);
+			box.Extents = XMFLOAT3(random.Range(0.2f, 3), random.Range(0.2f, 3), random.Range(0.2f, 3));
+		}
+
+		XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, (float)OCCLUSION_WIDTH / OCCLUSION_HEIGHT, 0.1f, 1000.0f);
+		XMMATRIX viewProjectionMatrix = view * projection;
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, viewProjectionMatrix);
+
+		std::vector<float> referenceDepth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, std::numeric_limits<float>::max());
+		for (const XMFLOAT4X4& wall : walls)
+		{
+			RasterizeReference(referenceDepth, cubePositions, cubeIndices, XMLoadFloat4x4(&wall) * viewProjectionMatrix);
+		}
+
+		OcclusionCuller culler;
+		culler.Begin(viewProjection);
+		for (const XMFLOAT4X4& wall : walls)
+		{
+			culler.AddOccluder(cubePositions.data(), cubeIndices.data(), (int)cubeIndices.size(), wall);
+		}
+		culler.Rasterize();
+
+		//The culler may keep boxes the reference would hide, never the other way round
+		int onScreen = 0;
+		int culled = 0;
+		int referenceCulled = 0;
+		int wronglyHidden = 0;
+		for (const AABB& box : boxes)
+		{
+			ScreenRect rect = ProjectBox(box, viewProjectionMatrix);
+			if (rect.NearPlane || rect.OffScreen)
+			{
+				continue;
+			}
+			onScreen++;
+
+			bool referenceVisible = false;
+			int minX = std::max((int)std::floor(rect.MinX), 0);
+			int maxX = std::min((int)std::floor(rect.MaxX), OCCLUSION_WIDTH - 1);
+			int minY = std::max((int)std::floor(rect.MinY), 0);
+			int maxY = std::min((int)std::floor(rect.MaxY), OCCLUSION_HEIGHT - 1);
+			for (int py = minY; py <= maxY && !referenceVisible; py++)
+			{
+				for (int px = minX; px <= maxX && !referenceVisible; px++)
+				{
+					referenceVisible = referenceDepth[py * OCCLUSION_WIDTH + px] >= rect.Nearest;
+				}
+			}
+
+			bool visible = culler.IsVisible(box);
+			culled += visible ? 0 : 1;
+			referenceCulled += referenceVisible ? 0 : 1;
+			wronglyHidden += !visible && referenceVisible ? 1 : 0;
+		}
+		benchmark.AddCheck("occlusion/NeverHidesVisible", wronglyHidden == 0);
+		benchmark.AddCheck("occlusion/CullsBehindWalls", culled > 0);
+		if (wronglyHidden)
+		{
+			std::printf("Suite occlusion: %d boxes hidden that the reference sees\n", wronglyHidden);
+		}
+		benchmark.AddInfo("occlusion/onScreen", onScreen);
+		benchmark.AddInfo("occlusion/cullRate", onScreen ? (double)culled / onScreen : 0.0);
+		benchmark.AddInfo("occlusion/referenceCullRate", onScreen ? (double)referenceCulled / onScreen : 0.0);
+		benchmark.AddInfo("occlusion/triangles", culler.GetTriangleCount());
+
+		//Every coarse cell has to be exactly the farthest of its tiles, or the early out could hide something
+		bool coarse = true;
+		for (int band = 0; band < OCCLUSION_BANDS; band++)
+		{
+			for (int coarseX = 0; coarseX < OCCLUSION_COARSE_X; coarseX++)
+			{
+				float farthest = 0;
+				for (int tileY = band * OCCLUSION_BAND_ROWS; tileY < (band + 1) * OCCLUSION_BAND_ROWS; tileY++)
+				{
+					for (int tileX = coarseX * OCCLUSION_COARSE_WIDTH; tileX < (coarseX + 1) * OCCLUSION_COARSE_WIDTH; tileX++)
+					{
+						farthest = std::max(farthest, culler.GetTileDepth(tileX, tileY));
+					}
+				}
+				coarse = coarse && culler.GetCoarseDepth(coarseX, band) == farthest;
+			}
+		}
+		benchmark.AddCheck("occlusion/CoarseIsFarthestTile", coarse);
+
+		//Rasterizing in band jobs has to land on the same depths as doing it in order
+		std::vector<float> serialDepths;
+		for (int tileY = 0; tileY < OCCLUSION_TILES_Y; tileY++)
+		{
+			for (int tileX = 0; tileX < OCCLUSION_TILES_X; tileX++)
+			{
+				serialDepths.push_back(culler.GetTileDepth(tileX, tileY));
+			}
+		}
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		auto drawWalls = [&](JobSystem* jobSystem)
+		{
+			culler.Begin(viewProjection);
+			for (const XMFLOAT4X4& wall : walls)
+			{
+				culler.AddOccluder(cubePositions.data(), cubeIndices.data(), (int)cubeIndices.size(), wall);
+			}
+			culler.Rasterize(jobSystem);
+		};
+		drawWalls(&jobs);
+		bool parallel = true;
+		for (int tileY = 0; tileY < OCCLUSION_TILES_Y; tileY++)
+		{
+			for (int tileX = 0; tileX < OCCLUSION_TILES_X; tileX++)
+			{
+				parallel = parallel && culler.GetTileDepth(tileX, tileY) == serialDepths[tileY * OCCLUSION_TILES_X + tileX];
+			}
+		}
+		benchmark.AddCheck("occlusion/ParallelMatchesSerial", parallel);
+
+		int visibleCount = 0;
+		auto testBoxes = [&]()
+		{
+			visibleCount = 0;
+			for (const AABB& box : boxes)
+			{
+				visibleCount += culler.IsVisible(box) ? 1 : 0;
+			}
+		};
+		Time(benchmark, "occlusion/Rasterize", 20, [&]() { drawWalls(nullptr); });
+		Time(benchmark, "occlusion/RasterizeParallel", 20, [&]() { drawWalls(&jobs); });
+		Time(benchmark, "occlusion/Test", 20, testBoxes);
+		Time(benchmark, "occlusion/Frame", 20, [&]()
+			{
+				drawWalls(&jobs);
+				testBoxes();
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ FRUSTUM -------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//A camera's frustum, yaw and pitch in radians like Transform's rotation
+	Frustum CameraFrustum(const XMFLOAT3& eye, float yaw, float pitch, float farPlane)
+	{
+		XMVECTOR direction = XMVectorSet(std::sin(yaw) * std::cos(pitch), -std::sin(pitch), std::cos(yaw) * std::cos(pitch), 0);
+		XMMATRIX view = XMMatrixLookToLH(XMVectorSet(eye.x, eye.y, eye.z, 1), direction, XMVectorSet(0, 1, 0, 0));
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, view * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, farPlane));
+		return FrustumFromMatrix(viewProjection);
+	}
+
+	//Frames of a camera circling the middle of the cube while it turns, so every plane moves a little each time
+	std::vector<Frustum> CameraPath(int frames, float halfSize, float turnPerFrame)
+	{
+		std::vector<Frustum> path;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			float angle = frame * turnPerFrame;
+			XMFLOAT3 eye(std::sin(angle) * halfSize * 0.5f, halfSize * 0.1f, -std::cos(angle) * halfSize * 0.5f);
+			path.push_back(CameraFrustum(eye, angle * 1.5f, 0.1f, halfSize * 1.5f));
+		}
+		return path;
+	}
+
+	//The slots FrustumIntersectsAABB keeps, in slot order, which is what every cull is held to
+	void ScalarCull(const Frustum& frustum, const std::vector<AABB>& boxes, const std::vector<bool>& present, std::vector<uint32_t>& visible)
+	{
+		visible.clear();
+		for (uint32_t slot = 0; slot < (uint32_t)boxes.size(); slot++)
+		{
+			if (present[slot] && FrustumIntersectsAABB(frustum, boxes[slot]))
+			{
+				visible.push_back(slot);
+			}
+		}
+	}
+
+	bool SameSlots(const uint32_t* found, int count, const std::vector<uint32_t>& expected)
+	{
+		return count == (int)expected.size() && std::equal(expected.begin(), expected.end(), found);
+	}
+
+	void RunFrustumSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int boxCount = 1000000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		float halfSize = CubeHalfSize(boxCount, settings.Scene.Spacing);
+		std::vector<AABB> boxes = RandomBoxes(random, boxCount, halfSize);
+
+		//Every so often a slot is left empty, like a destroyed entity's
+		std::vector<bool> present(boxCount, true);
+		FrustumCuller serial;
+		FrustumCuller parallel;
+		serial.Resize(boxCount);
+		parallel.Resize(boxCount);
+		for (int slot = 0; slot < boxCount; slot++)
+		{
+			serial.SetBounds(slot, boxes[slot]);
+			parallel.SetBounds(slot, boxes[slot]);
+		}
+		for (int slot = 0; slot < boxCount; slot += 97)
+		{
+			present[slot] = false;
+			serial.ClearBounds(slot);
+			parallel.ClearBounds(slot);
+		}
+
+		//Down the path, with a few boxes moving now and then, both cullers have to keep the scalar list exactly.
+		//Repeating a frame has to hand the same list back without doing the work again.
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		std::vector<Frustum> path = CameraPath(30, halfSize, 0.02f);
+		std::vector<uint32_t> expected;
+		bool serialMatched = true;
+		bool parallelMatched = true;
+		bool reused = true;
+		bool moved = true;
+		int earlyOuts = 0;
+		for (int frame = 0; frame < (int)path.size(); frame++)
+		{
+			ScalarCull(path[frame], boxes, present, expected);
+			serial.Cull(path[frame]);
+			parallel.Cull(path[frame], &jobs);
+			serialMatched = serialMatched && !serial.WasReused() && SameSlots(serial.GetVisible(), serial.GetVisibleCount(), expected);
+			parallelMatched = parallelMatched && SameSlots(parallel.GetVisible(), parallel.GetVisibleCount(), expected);
+			earlyOuts += serial.GetLastEarlyOuts();
+
+			serial.Cull(path[frame]);
+			reused = reused && serial.WasReused() && SameSlots(serial.GetVisible(), serial.GetVisibleCount(), expected);
+
+			//Moved boxes under the same frustum have to be culled again rather than reused
+			if (frame % 5 == 4)
+			{
+				for (int i = 0; i < 1000; i++)
+				{
+					uint32_t slot = random.Below(boxCount);
+					boxes[slot].Center.x += random.Range(-2, 2);
+					present[slot] = true;
+					serial.SetBounds(slot, boxes[slot]);
+					parallel.SetBounds(slot, boxes[slot]);
+				}
+				ScalarCull(path[frame], boxes, present, expected);
+				serial.Cull(path[frame]);
+				moved = moved && !serial.WasReused() && SameSlots(serial.GetVisible(), serial.GetVisibleCount(), expected);
+			}
+		}
+		benchmark.AddCheck("frustum/SerialMatchesScalar", serialMatched);
+		benchmark.AddCheck("frustum/ParallelMatchesScalar", parallelMatched);
+		benchmark.AddCheck("frustum/ReuseMatchesScalar", reused);
+		benchmark.AddCheck("frustum/MovedBoundsCulledAgain", moved);
+		benchmark.AddInfo("frustum/visible", (double)expected.size());
+		benchmark.AddInfo("frustum/earlyOutRate", (double)earlyOuts / ((double)path.size() * serial.GetSlotCount() / CULL_BLOCK_SIZE));
+
+		//Timed down a fresh stretch of the same path, so every call has a new frustum and the remembered planes are warm
+		std::vector<Frustum> timed = CameraPath(60, halfSize, 0.02f);
+		int next = 0;
+		std::string name = CountName(boxCount);
+		Time(benchmark, "frustum/Scalar" + name, 10, [&]()
+			{
+				ScalarCull(timed[next++ % timed.size()], boxes, present, expected);
+			});
+		Time(benchmark, "frustum/Serial" + name, 20, [&]()
+			{
+				serial.Cull(timed[next++ % timed.size()]);
+			});
+		Time(benchmark, "frustum/Parallel" + name, 20, [&]()
+			{
+				parallel.Cull(timed[next++ % timed.size()], &jobs);
+			});
+		serial.Cull(timed[next % timed.size()]);
+		Time(benchmark, "frustum/Reused" + name, 20, [&]()
+			{
+				serial.Cull(timed[next % timed.size()]);
+			});
+	}
+
+	void RunViewsSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int boxCount = 250000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		float halfSize = CubeHalfSize(boxCount, settings.Scene.Spacing);
+		std::vector<AABB> boxes = RandomBoxes(random, boxCount, halfSize);
+		FrustumCuller culler;
+		culler.Resize(boxCount);
+		for (int slot = 0; slot < boxCount; slot++)
+		{
+			culler.SetBounds(slot, boxes[slot]);
+		}
+
+		//Eight cameras spread around the cube, like split screen players or a light's views. Two sets a
+		//little apart, swapped between repeats so a single view is never handed back its last list.
+		Frustum frusta[2][CULL_MAX_VIEWS];
+		for (int set = 0; set < 2; set++)
+		{
+			for (int view = 0; view < CULL_MAX_VIEWS; view++)
+			{
+				float angle = view * XM_2PI / CULL_MAX_VIEWS + set * 0.01f;
+				XMFLOAT3 eye(std::sin(angle) * halfSize * 0.6f, (view % 3 - 1) * halfSize * 0.2f, -std::cos(angle) * halfSize * 0.6f);
+				frusta[set][view] = CameraFrustum(eye, angle + XM_PI * 0.75f, 0.05f * (view % 4), halfSize * 1.5f);
+			}
+		}
+
+		//What each view sees culled on its own, the answer CullViews has to give for all of them at once
+		std::vector<uint32_t> single[CULL_MAX_VIEWS];
+		for (int view = 0; view < CULL_MAX_VIEWS; view++)
+		{
+			culler.Cull(frusta[0][view]);
+			single[view].assign(culler.GetVisible(), culler.GetVisible() + culler.GetVisibleCount());
+		}
+
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		bool matched = true;
+		bool masks = true;
+		for (int viewCount = 1; viewCount <= CULL_MAX_VIEWS; viewCount++)
+		{
+			for (int pass = 0; pass < 2; pass++)
+			{
+				culler.CullViews(frusta[0], viewCount, pass == 0 ? nullptr : &jobs);
+				for (int view = 0; view < viewCount; view++)
+				{
+					matched = matched && SameSlots(culler.GetViewVisible(view), culler.GetViewVisibleCount(view), single[view]);
+				}
+
+				//A slot's bits have to say exactly which lists it made it into
+				std::vector<int> fromMasks(viewCount, 0);
+				for (int slot = 0; slot < culler.GetSlotCount(); slot++)
+				{
+					uint8_t mask = culler.GetViewMasks()[slot];
+					masks = masks && (mask >> viewCount) == 0;
+					for (int view = 0; view < viewCount; view++)
+					{
+						fromMasks[view] += (mask >> view) & 1;
+					}
+				}
+				for (int view = 0; view < viewCount; view++)
+				{
+					masks = masks && fromMasks[view] == culler.GetViewVisibleCount(view);
+				}
+			}
+		}
+		benchmark.AddCheck("views/MatchesSingleViewCull", matched);
+		benchmark.AddCheck("views/MasksMatchLists", masks);
+
+		//All the views in one pass over the bounds against a pass per view
+		std::string name = CountName(boxCount);
+		for (int viewCount = 1; viewCount <= CULL_MAX_VIEWS; viewCount++)
+		{
+			int repeat = 0;
+			Time(benchmark, "views/Together" + name + "x" + std::to_string(viewCount), 10, [&]()
+				{
+					culler.CullViews(frusta[repeat++ % 2], viewCount, &jobs);
+				});
+			Time(benchmark, "views/Separate" + name + "x" + std::to_string(viewCount), 10, [&]()
+				{
+					const Frustum* set = frusta[repeat++ % 2];
+					for (int view = 0; view < viewCount; view++)
+					{
+						culler.Cull(set[view], &jobs);
+					}
+				});
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ LOD -----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//A box's projected radius in pixels, the sum LodSelector makes
+	float ProjectedPixels(const AABB& box, const XMFLOAT3& eye, float pixelScale)
+	{
+		float radius = std::sqrt(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y + box.Extents.z * box.Extents.z);
+		float dx = box.Center.x - eye.x;
+		float dy = box.Center.y - eye.y;
+		float dz = box.Center.z - eye.z;
+		return radius * pixelScale / std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	void RunLodSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		LodSettings lods;
+		const float viewportHeight = 1080.0f;
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+		float pixelScale = projection._22 * viewportHeight * 0.5f;
+		XMFLOAT3 eye(0, 0, 0);
+		float thresholds[LOD_MAX_LEVELS] = { lods.LevelPixels[0], lods.LevelPixels[1], lods.LevelPixels[2], lods.CullPixels };
+
+		//One box pulled away a small step at a time until it's culled, then brought back. Going out, a level
+		//may only drop once the box is below threshold * (1 - Hysteresis), coming back it only returns once the
+		//box is at threshold * (1 + Hysteresis) again, and in between the level holds.
+		FrustumCuller single;
+		single.Resize(1);
+		LodSelector selector;
+		selector.SetView(eye, projection, viewportHeight);
+		uint32_t slot = 0;
+		AABB box = { XMFLOAT3(0, 0, 1), XMFLOAT3(1, 1, 1) };
+		std::vector<float> distances;
+		for (float distance = 2.0f; distance < 2000.0f; distance *= 1.003f)
+		{
+			distances.push_back(distance);
+		}
+		std::vector<float> outward;
+		std::vector<float> inward;
+		bool held = true;
+		bool listed = true;
+		int level = 0;
+		float lastPixels = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (size_t step = 0; step < distances.size(); step++)
+			{
+				box.Center.z = pass == 0 ? distances[step] : distances[distances.size() - 1 - step];
+				single.SetBounds(slot, box);
+				int selectedCount = selector.Select(single, &slot, 1, lods);
+				float pixels = ProjectedPixels(box, eye, pixelScale);
+				int newLevel = selector.GetLevel(slot);
+				if (newLevel != level)
+				{
+					//Only ever one level at a time with steps this small, and only across the band's edge
+					int threshold = std::min(level, newLevel);
+					float edge = thresholds[threshold] * (newLevel > level ? 1.0f - lods.Hysteresis : 1.0f + lods.Hysteresis);
+					bool crossed = newLevel > level ? lastPixels >= edge && pixels < edge : lastPixels < edge && pixels >= edge;
+					held = held && std::abs(newLevel - level) == 1 && crossed;
+					(newLevel > level ? outward : inward).push_back(pixels);
+				}
+				listed = listed && (selectedCount == 1) == (newLevel != LOD_CULLED);
+				level = newLevel;
+				lastPixels = pixels;
+			}
+		}
+		held = held && outward.size() == LOD_MAX_LEVELS && inward.size() == LOD_MAX_LEVELS && level == 0;
+		benchmark.AddCheck("lod/HysteresisBothWays", held);
+		benchmark.AddCheck("lod/CulledLeavesSelected", listed);
+		for (int threshold = 0; threshold < (int)outward.size() && threshold < (int)inward.size(); threshold++)
+		{
+			benchmark.AddInfo("lod/switchOutPixels" + std::to_string(threshold), outward[threshold]);
+			benchmark.AddInfo("lod/switchInPixels" + std::to_string(threshold), inward[LOD_MAX_LEVELS - 1 - threshold]);
+		}
+
+		//A field of boxes from first picks: every slot starts at level 0, so each lands on the finest level its
+		//band allows. The list keeps input order minus the culled, and the histogram covers every input slot.
+		const int slotCount = 250000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<AABB> boxes(slotCount);
+		FrustumCuller culler;
+		culler.Resize(slotCount);
+		for (int i = 0; i < slotCount; i++)
+		{
+			float extent = random.Range(0.05f, 2.0f);
+			boxes[i].Center = XMFLOAT3(random.Range(-500, 500), random.Range(-50, 50), random.Range(1, 1500));
+			boxes[i].Extents = XMFLOAT3(extent, extent, extent);
+			culler.SetBounds(i, boxes[i]);
+		}
+		std::vector<uint32_t> input;
+		for (uint32_t i = 0; i < (uint32_t)slotCount; i++)
+		{
+			if (i % 7 != 3)
+			{
+				input.push_back(i);
+			}
+		}
+
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		LodSelector serial;
+		LodSelector parallel;
+		serial.SetView(eye, projection, viewportHeight);
+		parallel.SetView(eye, projection, viewportHeight);
+		int selectedCount = serial.Select(culler, input.data(), (int)input.size(), lods);
+		parallel.Select(culler, input.data(), (int)input.size(), lods, &jobs);
+
+		std::vector<uint32_t> expected;
+		int levelCounts[LOD_MAX_LEVELS + 1] = {};
+		bool levels = true;
+		for (uint32_t i : input)
+		{
+			float pixels = ProjectedPixels(boxes[i], eye, pixelScale);
+			int finest = 0;
+			for (int k = 0; k < LOD_MAX_LEVELS; k++)
+			{
+				finest += pixels < thresholds[k] * (1.0f - lods.Hysteresis) ? 1 : 0;
+			}
+			levels = levels && serial.GetLevel(i) == finest && parallel.GetLevel(i) == finest;
+			levelCounts[serial.GetLevel(i)]++;
+			if (serial.GetLevel(i) != LOD_CULLED)
+			{
+				expected.push_back(i);
+			}
+		}
+		int histogramTotal = 0;
+		for (int k = 0; k <= LOD_MAX_LEVELS; k++)
+		{
+			histogramTotal += serial.GetHistogram()[k];
+			levels = levels && serial.GetHistogram()[k] == levelCounts[k] && parallel.GetHistogram()[k] == levelCounts[k];
+		}
+		benchmark.AddCheck("lod/LevelsFromPixels", levels);
+		benchmark.AddCheck("lod/SmallSlotsDropped", SameSlots(serial.GetSelected(), selectedCount, expected)
+			&& SameSlots(parallel.GetSelected(), parallel.GetSelectedCount(), expected));
+		benchmark.AddCheck("lod/HistogramSumsToInput", histogramTotal == (int)input.size() && serial.GetHistogram()[LOD_CULLED] == (int)input.size() - selectedCount);
+		for (int k = 0; k <= LOD_MAX_LEVELS; k++)
+		{
+			benchmark.AddInfo("lod/level" + std::to_string(k), serial.GetHistogram()[k]);
+		}
+
+		std::string name = CountName((int)input.size());
+		Time(benchmark, "lod/Select" + name, 20, [&]()
+			{
+				serial.Select(culler, input.data(), (int)input.size(), lods);
+			});
+		Time(benchmark, "lod/SelectParallel" + name, 20, [&]()
+			{
+				parallel.Select(culler, input.data(), (int)input.size(), lods, &jobs);
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SHADOWS -------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//Whether a ray from origin along direction ever gets inside every plane, by clipping its range plane by plane
+	bool RayHitsPlanes(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT4* planes, int planeCount)
+	{
+		float enter = 0;
+		float leave = std::numeric_limits<float>::max();
+		for (int p = 0; p < planeCount; p++)
+		{
+			const XMFLOAT4& plane = planes[p];
+			float start = plane.x * origin.x + plane.y * origin.y + plane.z * origin.z + plane.w;
+			float rate = plane.x * direction.x + plane.y * direction.y + plane.z * direction.z;
+			if (rate == 0)
+			{
+				if (start < 0)
+				{
+					return false;
+				}
+				continue;
+			}
+			float crossing = -start / rate;
+			if (rate > 0)
+			{
+				enter = std::max(enter, crossing);
+			}
+			else
+			{
+				leave = std::min(leave, crossing);
+			}
+		}
+		return enter <= leave;
+	}
+
+	bool BoxInsidePlanes(const AABB& box, const XMFLOAT4* planes, int planeCount)
+	{
+		for (int p = 0; p < planeCount; p++)
+		{
+			const XMFLOAT4& plane = planes[p];
+			float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+			float radius = box.Extents.x * std::abs(plane.x) + box.Extents.y * std::abs(plane.y) + box.Extents.z * std::abs(plane.z);
+			if (distance + radius < 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Whether some point of the box, lit by the light, throws its shadow into the camera's region. Shadows run
+	//away from a spot light's position, and along a directional light's direction. Checked from 27 points
+	//spread over the box, so it can miss a caster but never makes one up.
+	bool CastsInto(const AABB& box, const ShadowView& view, const Light& light, const XMFLOAT4* lit, int litPlanes, const XMFLOAT4* seen, int seenPlanes)
+	{
+		for (int sample = 0; sample < 27; sample++)
+		{
+			XMFLOAT3 point(
+				box.Center.x + (sample % 3 - 1) * box.Extents.x,
+				box.Center.y + (sample / 3 % 3 - 1) * box.Extents.y,
+				box.Center.z + (sample / 9 - 1) * box.Extents.z);
+			XMFLOAT3 away = view.Cascade == SHADOW_NO_CASCADE
+				? XMFLOAT3(point.x - light.Position.x, point.y - light.Position.y, point.z - light.Position.z)
+				: light.Direction;
+			if (BoxInsidePlanes(AABB{ point, XMFLOAT3(0, 0, 0) }, lit, litPlanes) && RayHitsPlanes(point, away, seen, seenPlanes))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RunShadowsSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		//A camera above the ground looking down the field, a sun, two spots and a point light that has no views
+		XMFLOAT3 eye(0, 8, -30);
+		XMFLOAT3 forward(0, -0.15f, 1);
+		XMMATRIX viewMatrix = XMMatrixLookToLH(XMVectorSet(eye.x, eye.y, eye.z, 1), XMVector3Normalize(XMLoadFloat3(&forward)), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 400.0f);
+		XMFLOAT4X4 view;
+		XMFLOAT4X4 projection;
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&view, viewMatrix);
+		XMStoreFloat4x4(&projection, projectionMatrix);
+		XMStoreFloat4x4(&viewProjection, viewMatrix * projectionMatrix);
+		Frustum camera = FrustumFromMatrix(viewProjection);
+		XMFLOAT3 cameraForward;
+		XMStoreFloat3(&cameraForward, XMVector3Normalize(XMLoadFloat3(&forward)));
+
+		Light lights[4] = {};
+		lights[0].Type = LIGHT_TYPE_DIRECTIONAL;
+		lights[0].Direction = XMFLOAT3(0.4f, -1.0f, 0.3f);
+		lights[1].Type = LIGHT_TYPE_SPOT;
+		lights[1].Position = XMFLOAT3(-60, 20, 40);
+		lights[1].Direction = XMFLOAT3(1, -0.3f, 0.2f);
+		lights[1].Range = 90;
+		lights[1].SpotOuterAngle = 0.5f;
+		lights[2].Type = LIGHT_TYPE_SPOT;
+		lights[2].Position = XMFLOAT3(5, 15, -50);
+		lights[2].Direction = XMFLOAT3(0, -0.4f, 1);
+		lights[2].Range = 70;
+		lights[2].SpotOuterAngle = 0.35f;
+		lights[3].Type = LIGHT_TYPE_POINT;
+		lights[3].Position = XMFLOAT3(0, 5, 0);
+		lights[3].Range = 20;
+
+		//Boxes on and above the ground, all around the camera including behind it
+		const int boxCount = 20000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<AABB> boxes(boxCount);
+		FrustumCuller culler;
+		culler.Resize(boxCount);
+		for (int i = 0; i < boxCount; i++)
+		{
+			boxes[i].Extents = XMFLOAT3(random.Range(0.3f, 3), random.Range(0.3f, 3), random.Range(0.3f, 3));
+			boxes[i].Center = XMFLOAT3(random.Range(-150, 150), boxes[i].Extents.y + random.Range(0, 30), random.Range(-120, 250));
+			culler.SetBounds(i, boxes[i]);
+		}
+
+		ShadowCasterSettings shadows;
+		ShadowCasterCuller shadowCuller;
+		shadowCuller.Update(view, projection, lights, 4, shadows, culler);
+
+		//Every view's list against two references. The view's own planes tested one box at a time have to give
+		//exactly the list. And a box found by rays to shadow what the camera sees has to be on it.
+		bool planesMatched = true;
+		bool noneMissed = true;
+		std::vector<int> bruteForce(4, 0);
+		std::vector<uint32_t> expected;
+		for (int v = 0; v < shadowCuller.GetViewCount(); v++)
+		{
+			const ShadowView& shadowView = shadowCuller.GetView(v);
+			const Light& light = lights[shadowView.Light];
+			const uint32_t* casters = shadowCuller.GetCasters(v);
+
+			//Where the shadow has to land: the camera frustum for a spot, the cascade's slice of it for the sun
+			XMFLOAT4 seen[6];
+			std::copy(camera.Planes, camera.Planes + 4, seen);
+			if (shadowView.Cascade == SHADOW_NO_CASCADE)
+			{
+				seen[4] = camera.Planes[4];
+				seen[5] = camera.Planes[5];
+			}
+			else
+			{
+				float eyeDepth = cameraForward.x * eye.x + cameraForward.y * eye.y + cameraForward.z * eye.z;
+				seen[4] = XMFLOAT4(cameraForward.x, cameraForward.y, cameraForward.z, -eyeDepth - shadowView.SplitNear);
+				seen[5] = XMFLOAT4(-cameraForward.x, -cameraForward.y, -cameraForward.z, eyeDepth + shadowView.SplitFar);
+			}
+
+			//What the light reaches: the spot's own frustum, or the slice's box in light space, open towards the sun
+			XMFLOAT4 lit[6];
+			int litPlanes = shadowView.Cascade == SHADOW_NO_CASCADE ? 6 : 5;
+			if (shadowView.Cascade == SHADOW_NO_CASCADE)
+			{
+				Frustum spot = FrustumFromMatrix(shadowView.ViewProjection);
+				std::copy(spot.Planes, spot.Planes + 6, lit);
+			}
+			else
+			{
+				std::copy(shadowView.Planes, shadowView.Planes + 5, lit);
+			}
+
+			expected.clear();
+			int inVolume = 0;
+			int caster = 0;
+			for (uint32_t slot = 0; slot < (uint32_t)boxCount; slot++)
+			{
+				inVolume += BoxInsidePlanes(boxes[slot], shadowView.Planes, shadowView.VolumePlaneCount) ? 1 : 0;
+				if (BoxInsidePlanes(boxes[slot], shadowView.Planes, shadowView.VolumePlaneCount + shadowView.ReachPlaneCount))
+				{
+					expected.push_back(slot);
+				}
+				if (CastsInto(boxes[slot], shadowView, light, lit, litPlanes, seen, 6))
+				{
+					bruteForce[shadowView.Light]++;
+					while (caster < shadowView.Casters && casters[caster] < slot)
+					{
+						caster++;
+					}
+					noneMissed = noneMissed && caster < shadowView.Casters && casters[caster] == slot;
+				}
+			}
+			planesMatched = planesMatched && SameSlots(casters, shadowView.Casters, expected) && inVolume == shadowView.InVolume;
+		}
+		benchmark.AddCheck("shadows/CastersMatchPlanes", planesMatched);
+		benchmark.AddCheck("shadows/NoCasterMissed", noneMissed);
+
+		//Spots get one view each, the sun one per cascade, the point light none
+		const std::vector<ShadowLightStats>& stats = shadowCuller.GetLightStats();
+		bool views = stats.size() == 4 && stats[0].Views == shadows.CascadeCount && stats[1].Views == 1 && stats[2].Views == 1 && stats[3].Views == 0;
+		int rejected = 0;
+		for (int i = 0; i < (int)stats.size(); i++)
+		{
+			rejected += stats[i].InVolume - stats[i].Casters;
+			benchmark.AddInfo("shadows/light" + std::to_string(i) + "Views", stats[i].Views);
+			benchmark.AddInfo("shadows/light" + std::to_string(i) + "InVolume", stats[i].InVolume);
+			benchmark.AddInfo("shadows/light" + std::to_string(i) + "Casters", stats[i].Casters);
+			benchmark.AddInfo("shadows/light" + std::to_string(i) + "BruteForce", bruteForce[i]);
+		}
+		benchmark.AddCheck("shadows/ViewsPerLight", views);
+
+		//The reach planes have to actually drop something here, and with them off every box in the volume casts
+		shadows.RejectUnseen = false;
+		shadowCuller.Update(view, projection, lights, 4, shadows, culler);
+		benchmark.AddCheck("shadows/RejectsUnseen", rejected > 0 && shadowCuller.GetCasterTotal() == shadowCuller.GetInVolumeTotal());
+		shadows.RejectUnseen = true;
+
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		Time(benchmark, "shadows/Update", 20, [&]()
+			{
+				shadowCuller.Update(view, projection, lights, 4, shadows, culler, &jobs);
+			});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ PVS -----------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	struct SuiteTriangle
+	{
+		XMFLOAT3 Corners[3];
+		uint32_t Owner;
+	};
+
+	//Whether the segment crosses the triangle strictly between its ends, with the same margins the baker uses
+	bool SegmentHitsTriangle(const XMFLOAT3& from, const XMFLOAT3& to, const SuiteTriangle& triangle)
+	{
+		XMVECTOR origin = XMLoadFloat3(&from);
+		XMVECTOR direction = XMVectorSubtract(XMLoadFloat3(&to), origin);
+		XMVECTOR vertex = XMLoadFloat3(&triangle.Corners[0]);
+		XMVECTOR edge1 = XMVectorSubtract(XMLoadFloat3(&triangle.Corners[1]), vertex);
+		XMVECTOR edge2 = XMVectorSubtract(XMLoadFloat3(&triangle.Corners[2]), vertex);
+		XMVECTOR p = XMVector3Cross(direction, edge2);
+		float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+		if (std::abs(determinant) < 1e-12f)
+		{
+			return false;
+		}
+		XMVECTOR s = XMVectorSubtract(origin, vertex);
+		float u = XMVectorGetX(XMVector3Dot(s, p)) / determinant;
+		XMVECTOR q = XMVector3Cross(s, edge1);
+		float v = XMVectorGetX(XMVector3Dot(direction, q)) / determinant;
+		float t = XMVectorGetX(XMVector3Dot(edge2, q)) / determinant;
+		return u >= 0 && v >= 0 && u + v <= 1 && t > 1e-4f && t < 1 - 1e-4f;
+	}
+
+	void RunPvsSuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		std::vector<XMFLOAT3> cubePositions;
+		std::vector<unsigned int> cubeIndices;
+		BuildCube(cubePositions, cubeIndices);
+
+		//A wall across the middle with a doorway, a second one off to the side, and small things scattered on
+		//both sides. The walls are objects as well as occluders, the rest only objects.
+		std::vector<XMFLOAT4X4> walls(3);
+		XMStoreFloat4x4(&walls[0], XMMatrixScaling(26, 6, 0.5f) * XMMatrixTranslation(-17, 3, 0));
+		XMStoreFloat4x4(&walls[1], XMMatrixScaling(26, 6, 0.5f) * XMMatrixTranslation(17, 3, 0));
+		XMStoreFloat4x4(&walls[2], XMMatrixScaling(0.5f, 6, 25) * XMMatrixTranslation(12, 3, 17.5f));
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		std::vector<AABB> objects;
+		std::vector<SuiteTriangle> triangles;
+		PvsBaker baker;
+		for (uint32_t wall = 0; wall < (uint32_t)walls.size(); wall++)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&walls[wall]);
+			for (size_t i = 0; i < cubeIndices.size(); i += 3)
+			{
+				SuiteTriangle triangle;
+				for (int k = 0; k < 3; k++)
+				{
+					XMStoreFloat3(&triangle.Corners[k], XMVector3TransformCoord(XMLoadFloat3(&cubePositions[cubeIndices[i + k]]), world));
+				}
+				triangle.Owner = wall;
+				triangles.push_back(triangle);
+			}
+			AABB bounds;
+			bounds.Center = XMFLOAT3(walls[wall]._41, walls[wall]._42, walls[wall]._43);
+			bounds.Extents = XMFLOAT3(walls[wall]._11 * 0.5f, walls[wall]._22 * 0.5f, walls[wall]._33 * 0.5f);
+			objects.push_back(bounds);
+			baker.AddOccluder(cubePositions.data(), cubeIndices.data(), (int)cubeIndices.size(), walls[wall], wall);
+		}
+		for (int i = 0; i < 40; i++)
+		{
+			float extent = random.Range(0.3f, 1.0f);
+			objects.push_back({ XMFLOAT3(random.Range(-28, 28), random.Range(0.5f, 5), random.Range(-28, 28)), XMFLOAT3(extent, extent, extent) });
+		}
+		for (uint32_t object = 0; object < (uint32_t)objects.size(); object++)
+		{
+			baker.AddObject(object, objects[object]);
+		}
+
+		//Bake time, size and how much is kept as the cells get bigger
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		std::string error;
+		const float cellSizes[] = { 2.0f, 4.0f, 8.0f, 16.0f };
+		for (float cellSize : cellSizes)
+		{
+			PvsBakeSettings bake;
+			bake.CellSize = cellSize;
+			PotentiallyVisibleSet sized;
+			if (!baker.Bake(bake, sized, &jobs, error))
+			{
+				std::printf("Suite pvs: %s\n", error.c_str());
+				continue;
+			}
+			const PvsBakeStats& stats = baker.GetStats();
+			std::string size = std::to_string((int)cellSize);
+			benchmark.AddSample("pvs/Bake" + size, (float)(stats.Seconds * 1000.0));
+			benchmark.AddInfo("pvs/cells" + size, stats.Cells);
+			benchmark.AddInfo("pvs/rays" + size, (double)stats.Rays);
+			benchmark.AddInfo("pvs/bytes" + size, (double)stats.Bytes);
+			benchmark.AddInfo("pvs/uniqueSets" + size, stats.UniqueSets);
+			benchmark.AddInfo("pvs/averageVisible" + size, stats.AverageVisible);
+		}
+
+		//Every object a ray from one of a cell's own sample points reaches unblocked, checked against every
+		//triangle rather than through the BVH, has to be in the cell's set
+		PvsBakeSettings bake;
+		PotentiallyVisibleSet pvs;
+		bool baked = baker.Bake(bake, pvs, nullptr, error);
+		int missed = 0;
+		int extra = 0;
+		std::vector<XMFLOAT3> samples;
+		for (int cell = 0; baked && cell < pvs.GetCellCount(); cell++)
+		{
+			AABB cellBounds = pvs.GetCellBounds(cell);
+			PvsBaker::GetSamplePoints(cell, cellBounds, bake, samples);
+			for (uint32_t object = 0; object < (uint32_t)objects.size(); object++)
+			{
+				const AABB& box = objects[object];
+				bool visible = AABBIntersectsAABB(cellBounds, box);
+				for (int target = 0; target < PVS_TARGET_POINTS && !visible; target++)
+				{
+					XMFLOAT3 point = box.Center;
+					if (target > 0)
+					{
+						point.x += ((target - 1) & 1 ? 0.9f : -0.9f) * box.Extents.x;
+						point.y += ((target - 1) & 2 ? 0.9f : -0.9f) * box.Extents.y;
+						point.z += ((target - 1) & 4 ? 0.9f : -0.9f) * box.Extents.z;
+					}
+					for (const XMFLOAT3& sample : samples)
+					{
+						bool blocked = false;
+						for (size_t i = 0; i < triangles.size() && !blocked; i++)
+						{
+							blocked = triangles[i].Owner != object && SegmentHitsTriangle(sample, point, triangles[i]);
+						}
+						if (!blocked)
+						{
+							visible = true;
+							break;
+						}
+					}
+				}
+				missed += visible && !pvs.IsVisible(cell, object) ? 1 : 0;
+				extra += !visible && pvs.IsVisible(cell, object) ? 1 : 0;
+			}
+		}
+		benchmark.AddCheck("pvs/RayVisibleInSet", baked && missed == 0);
+		benchmark.AddInfo("pvs/extraOverBruteForce", extra);
+		if (missed)
+		{
+			std::printf("Suite pvs: %d objects seen by rays but left out of their cell's set\n", missed);
+		}
+
+		//The wall has to be hiding something somewhere, or the scene isn't testing anything
+		int hidden = 0;
+		for (int cell = 0; baked && cell < pvs.GetCellCount(); cell++)
+		{
+			hidden += (int)objects.size() - pvs.GetSetSize(cell);
+		}
+		benchmark.AddCheck("pvs/WallsHide", hidden > 0);
+
+		//Workers only change which cells are baked together, never what comes out
+		PotentiallyVisibleSet parallel;
+		std::filesystem::path path = std::filesystem::temp_directory_path() / "suite_pvs.bin";
+		std::filesystem::path parallelPath = std::filesystem::temp_directory_path() / "suite_pvs_parallel.bin";
+		bool same = baker.Bake(bake, parallel, &jobs, error) && pvs.Save(path) && parallel.Save(parallelPath)
+			&& std::filesystem::file_size(path) == std::filesystem::file_size(parallelPath);
+		if (same)
+		{
+			std::ifstream first(path, std::ios::binary);
+			std::ifstream second(parallelPath, std::ios::binary);
+			same = std::equal(std::istreambuf_iterator<char>(first), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(second));
+		}
+		benchmark.AddCheck("pvs/SameWithJobs", same);
+
+		//Loaded back it has to answer every cell and object the same, filters included
+		PotentiallyVisibleSet loaded;
+		bool roundTrip = loaded.Load(path) && loaded.GetSourceHash() == pvs.GetSourceHash() && loaded.GetSourceHash() == baker.GetSourceHash(bake)
+			&& loaded.GetCellCount() == pvs.GetCellCount() && loaded.GetSetCount() == pvs.GetSetCount();
+		std::vector<uint32_t> all(objects.size() + 5);
+		std::iota(all.begin(), all.end(), 0u);
+		std::vector<uint32_t> kept;
+		for (int cell = 0; roundTrip && cell < pvs.GetCellCount(); cell++)
+		{
+			for (uint32_t object = 0; object < (uint32_t)all.size(); object++)
+			{
+				roundTrip = roundTrip && loaded.IsVisible(cell, object) == pvs.IsVisible(cell, object);
+			}
+			pvs.Filter(cell, all.data(), (int)all.size());
+			kept.assign(pvs.GetVisible(), pvs.GetVisible() + pvs.GetVisibleCount());
+			loaded.Filter(cell, all.data(), (int)all.size());
+			roundTrip = roundTrip && SameSlots(loaded.GetVisible(), loaded.GetVisibleCount(), kept);
+		}
+		benchmark.AddCheck("pvs/SaveLoadRoundTrip", roundTrip);
+
+		//A cut short file is turned away
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+		PotentiallyVisibleSet truncated;
+		benchmark.AddCheck("pvs/RejectsTruncated", !truncated.Load(path));
+		std::filesystem::remove(path);
+		std::filesystem::remove(parallelPath);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ PORTALS -------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//A square view, so a point's screen x is just its sideways offset over its distance
+	XMFLOAT4X4 PortalView(const XMFLOAT3& eye, float yaw)
+	{
+		XMMATRIX view = XMMatrixLookToLH(XMVectorSet(eye.x, eye.y, eye.z, 1), XMVectorSet(std::sin(yaw), 0, std::cos(yaw), 0), XMVectorSet(0, 1, 0, 0));
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.1f, 500.0f));
+		return viewProjection;
+	}
+
+	//A doorway from y 1 to 3 in the wall at x = along when onX, or z = along otherwise
+	int AddDoor(PortalSystem& portals, int cellA, int cellB, bool onX, float along, float from, float to)
+	{
+		XMFLOAT3 corners[4];
+		for (int i = 0; i < 4; i++)
+		{
+			float across = i == 1 || i == 2 ? to : from;
+			float y = i < 2 ? 1.0f : 3.0f;
+			corners[i] = onX ? XMFLOAT3(along, y, across) : XMFLOAT3(across, y, along);
+		}
+		return portals.AddPortal(cellA, cellB, corners, 4);
+	}
+
+	struct PortalCase
+	{
+		const char* Name;
+		XMFLOAT3 Eye;
+		float Yaw;
+		int CameraCell;
+		std::vector<int> Cells; //Sorted
+		int PortalsTested; //-1 for any
+	};
+
+	void RunPortalsSuite(Benchmark& benchmark, const BenchmarkSettings&)
+	{
+		//A row of four 10x4x10 rooms running up z, the doorway out of each one further to the side than the
+		//last, and off at x = 40 a ring of four rooms around a corner, each opening into the next
+		PortalSystem portals;
+		for (int room = 0; room < 4; room++)
+		{
+			portals.AddCell({ XMFLOAT3(0, 2, room * 10.0f), XMFLOAT3(5, 2, 5) });
+		}
+		AddDoor(portals, 0, 1, false, 5, -1, 1);
+		AddDoor(portals, 1, 2, false, 15, 3, 4.5f);
+		AddDoor(portals, 2, 3, false, 25, -4.5f, -3);
+		int ring = portals.AddCell({ XMFLOAT3(35, 2, -5), XMFLOAT3(5, 2, 5) });
+		portals.AddCell({ XMFLOAT3(45, 2, -5), XMFLOAT3(5, 2, 5) });
+		portals.AddCell({ XMFLOAT3(45, 2, 5), XMFLOAT3(5, 2, 5) });
+		portals.AddCell({ XMFLOAT3(35, 2, 5), XMFLOAT3(5, 2, 5) });
+		AddDoor(portals, ring, ring + 1, true, 40, -9, -1);
+		AddDoor(portals, ring + 1, ring + 2, false, 0, 41, 49);
+		AddDoor(portals, ring + 2, ring + 3, true, 40, 1, 9);
+		AddDoor(portals, ring + 3, ring, false, 0, 31, 39);
+
+		const PortalCase cases[] =
+		{
+			//Through the first doorway, which is too narrow to see the second one off to the side
+			{ "ThroughDoor", XMFLOAT3(0, 2, -4), 0.0f, 0, { 0, 1 }, -1 },
+			{ "LookingAway", XMFLOAT3(0, 2, -4), XM_PI, 0, { 0 }, -1 },
+			//The doorway back to the first room is a step behind the eye, the next one ahead but to the side
+			{ "DoorBehind", XMFLOAT3(0, 2, 6), 0.0f, 1, { 1, 2 }, -1 },
+			//Standing in the doorway's plane it's wholly behind the near plane, but still seen through
+			{ "InDoorway", XMFLOAT3(0, 2, 5 - PORTAL_PLANE_EPSILON * 0.5f), XM_PI, 0, { 0, 1 }, -1 },
+			//Round the ring both ways, three doorways each way and never back into the first room
+			{ "RingCorner", XMFLOAT3(37, 2, -3), XM_PIDIV4, ring, { ring, ring + 1, ring + 2, ring + 3 }, 6 },
+			{ "RingAway", XMFLOAT3(37, 2, -3), XM_PIDIV4 - XM_PI, ring, { ring }, -1 },
+			//Round through the back room into the side one, the eye is already past the last doorway's plane
+			{ "RingBehindPlane", XMFLOAT3(35, 2, -5), 0.0f, ring, { ring, ring + 2, ring + 3 }, -1 },
+			{ "Outside", XMFLOAT3(100, 2, 100), 0.0f, PORTAL_NO_CELL, { 0, 1, 2, 3, ring, ring + 1, ring + 2, ring + 3 }, -1 },
+		};
+		for (const PortalCase& test : cases)
+		{
+			portals.Update(PortalView(test.Eye, test.Yaw), test.Eye);
+			const PortalStats& stats = portals.GetStats();
+			std::vector<int> cells(portals.GetVisibleCells(), portals.GetVisibleCells() + portals.GetVisibleCellCount());
+			std::sort(cells.begin(), cells.end());
+			bool matched = cells == test.Cells && stats.CameraCell == test.CameraCell && !stats.Truncated
+				&& stats.VisibleCells == (int)test.Cells.size() && (test.PortalsTested < 0 || stats.PortalsTested == test.PortalsTested);
+			for (int cell = 0; cell < portals.GetCellCount(); cell++)
+			{
+				matched = matched && portals.IsCellVisible(cell) == std::binary_search(test.Cells.begin(), test.Cells.end(), cell);
+			}
+			benchmark.AddCheck(std::string("portals/") + test.Name, matched);
+			if (!matched)
+			{
+				std::string found;
+				for (int cell : cells)
+				{
+					found += " " + std::to_string(cell);
+				}
+				std::printf("Suite portals: %s saw cells%s from cell %d\n", test.Name, found.c_str(), stats.CameraCell);
+			}
+		}
+
+		//Through the first doorway: the first room's entity, one straight through the doorway, one in the
+		//next room but off to the side of it, one in a room not seen at all and one straddling the doorway
+		const AABB entities[] =
+		{
+			{ XMFLOAT3(0, 2, 0), XMFLOAT3(0.3f, 0.3f, 0.3f) },
+			{ XMFLOAT3(0, 2, 12), XMFLOAT3(0.3f, 0.3f, 0.3f) },
+			{ XMFLOAT3(4, 2, 9), XMFLOAT3(0.3f, 0.3f, 0.3f) },
+			{ XMFLOAT3(0, 2, 20), XMFLOAT3(0.3f, 0.3f, 0.3f) },
+			{ XMFLOAT3(0, 2, 5), XMFLOAT3(0.5f, 0.5f, 0.5f) },
+		};
+		const int entityCount = (int)(sizeof(entities) / sizeof(entities[0]));
+		FrustumCuller culler;
+		culler.Resize(entityCount);
+		portals.ResizeEntities(entityCount);
+		std::vector<uint32_t> slots;
+		for (uint32_t slot = 0; slot < (uint32_t)entityCount; slot++)
+		{
+			culler.SetBounds(slot, entities[slot]);
+			portals.AssignEntity(slot, entities[slot]);
+			slots.push_back(slot);
+		}
+		portals.Update(PortalView(cases[0].Eye, cases[0].Yaw), cases[0].Eye);
+		portals.Filter(culler, slots.data(), entityCount);
+		const PortalStats& stats = portals.GetStats();
+		benchmark.AddCheck("portals/FilterKeepsSeen", SameSlots(portals.GetVisible(), portals.GetVisibleCount(), { 0, 1, 4 })
+			&& portals.GetEntityCell(4) == PORTAL_NO_CELL && stats.HiddenByCell == 1 && stats.HiddenByRect == 1);
+
+		//A long corridor of rooms with the doorways in line, so the walk goes all the way down it
+		PortalSystem corridor;
+		const int corridorLength = 256;
+		for (int room = 0; room < corridorLength; room++)
+		{
+			corridor.AddCell({ XMFLOAT3(0, 2, room * 10.0f), XMFLOAT3(5, 2, 5) });
+			if (room > 0)
+			{
+				AddDoor(corridor, room - 1, room, false, room * 10.0f - 5, -1, 1);
+			}
+		}
+		XMFLOAT3 eye(0, 2, -4);
+		XMFLOAT4X4 viewProjection = PortalView(eye, 0);
+		int visibleCells = 0;
+		Time(benchmark, "portals/UpdateCorridor256", 10, [&]()
+			{
+				for (int i = 0; i < 100; i++)
+				{
+					visibleCells = corridor.Update(viewProjection, eye);
+				}
+			});
+		benchmark.AddInfo("portals/corridorVisibleCells", visibleCells);
+		benchmark.AddInfo("portals/corridorDeepestPath", corridor.GetStats().DeepestPath);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ VISIBILITY CACHE ----------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	//A stretch of the camera path, the same turn and step forward every frame
+	struct CameraLeg
+	{
+		int Frames;
+		float Turn;
+		float Step;
+	};
+
+	//Slow stretches the cache can coast through, broken up by a fast spin and a fast run that are past its margins
+	const CameraLeg cameraLegs[] =
+	{
+		{ 60, 0.002f, 0.05f },
+		{ 15, 0.08f, 0.0f },
+		{ 40, 0.001f, 0.02f },
+		{ 15, 0.0f, 3.0f },
+		{ 40, 0.003f, 0.1f },
+	};
+
+	//Every frame of the legs in turn, starting back from the middle of the cube
+	void CameraLegPath(float halfSize, std::vector<Frustum>& frusta, std::vector<XMFLOAT3>& eyes)
+	{
+		XMFLOAT3 eye(0, halfSize * 0.1f, -halfSize * 0.5f);
+		float yaw = 0;
+		for (const CameraLeg& leg : cameraLegs)
+		{
+			for (int frame = 0; frame < leg.Frames; frame++)
+			{
+				yaw += leg.Turn;
+				eye.x += std::sin(yaw) * leg.Step;
+				eye.z += std::cos(yaw) * leg.Step;
+				frusta.push_back(CameraFrustum(eye, yaw, 0.1f, halfSize * 1.5f));
+				eyes.push_back(eye);
+			}
+		}
+	}
+
+	void RunVisibilitySuite(Benchmark& benchmark, const BenchmarkSettings& settings)
+	{
+		const int boxCount = 200000;
+		SuiteRandom random{ settings.Scene.Seed ? settings.Scene.Seed : 1u };
+		float halfSize = CubeHalfSize(boxCount, settings.Scene.Spacing);
+		std::vector<AABB> boxes = RandomBoxes(random, boxCount, halfSize);
+		std::vector<bool> present(boxCount, true);
+		FrustumCuller culler;
+		culler.Resize(boxCount);
+		for (int slot = 0; slot < boxCount; slot++)
+		{
+			culler.SetBounds(slot, boxes[slot]);
+		}
+
+		std::vector<Frustum> frusta;
+		std::vector<XMFLOAT3> eyes;
+		CameraLegPath(halfSize, frusta, eyes);
+
+		//Every frame some boxes take a small step, now and then one jumps across the cube, and one slot at a time is
+		//emptied and later filled again. All of them are marked moved, and every frame has to match the scalar cull,
+		//the fallback frames while the camera is moving too fast included.
+		JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		VisibilityCache cache;
+		cache.SetValidation(true);
+		std::vector<uint32_t> expected;
+		bool matched = true;
+		bool movingMatched = true;
+		int cachedFrames = 0;
+		int refreshFrames = 0;
+		int movingFrames = 0;
+		int skipped = 0;
+		int sinceRefresh = 0;
+		int longestWithoutRefresh = 0;
+		uint32_t emptied = boxCount;
+		for (int frame = 0; frame < (int)frusta.size(); frame++)
+		{
+			for (int i = 0; i < 64; i++)
+			{
+				uint32_t slot = random.Below(boxCount);
+				AABB& box = boxes[slot];
+				box.Center.x += random.Range(-0.5f, 0.5f);
+				box.Center.y += random.Range(-0.5f, 0.5f);
+				box.Center.z += random.Range(-0.5f, 0.5f);
+				if (i == 0 && frame % 10 == 0)
+				{
+					box.Center = XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+				}
+				if (present[slot])
+				{
+					culler.SetBounds(slot, box);
+					cache.MarkMoved(slot);
+				}
+			}
+			if (frame % 20 == 0)
+			{
+				if (emptied < (uint32_t)boxCount)
+				{
+					present[emptied] = true;
+					culler.SetBounds(emptied, boxes[emptied]);
+					cache.MarkMoved(emptied);
+				}
+				emptied = random.Below(boxCount);
+				present[emptied] = false;
+				culler.ClearBounds(emptied);
+				cache.MarkMoved(emptied);
+			}
+
+			cache.Update(culler, frusta[frame], eyes[frame], &jobs);
+			const VisibilityCacheStats& stats = cache.GetStats();
+			ScalarCull(frusta[frame], boxes, present, expected);
+			bool same = stats.Mismatches == 0 && SameSlots(cache.GetVisible(), cache.GetVisibleCount(), expected);
+			matched = matched && same;
+			if (stats.CameraMoving)
+			{
+				movingMatched = movingMatched && same;
+				movingFrames++;
+			}
+			else if (stats.FullRefresh)
+			{
+				refreshFrames++;
+			}
+			else
+			{
+				cachedFrames++;
+				skipped += stats.Skipped;
+			}
+			sinceRefresh = stats.FullRefresh ? 0 : sinceRefresh + 1;
+			longestWithoutRefresh = std::max(longestWithoutRefresh, sinceRefresh);
+			if (!same)
+			{
+				std::printf("Suite visibility: frame %d has %d visible, the scalar cull %d, %d mismatches counted\n",
+					frame, cache.GetVisibleCount(), (int)expected.size(), stats.Mismatches);
+			}
+		}
+		benchmark.AddCheck("visibility/MatchesFullCull", matched);
+		benchmark.AddCheck("visibility/CameraMovingMatches", movingFrames > 0 && movingMatched);
+		benchmark.AddCheck("visibility/CachedFramesSkip", cachedFrames > 0 && skipped > 0);
+		benchmark.AddCheck("visibility/RefreshInterval", longestWithoutRefresh < VISIBILITY_CACHE_REFRESH_FRAMES);
+		benchmark.AddInfo("visibility/cachedFrames", cachedFrames);
+		benchmark.AddInfo("visibility/refreshFrames", refreshFrames);
+		benchmark.AddInfo("visibility/movingFrames", movingFrames);
+		benchmark.AddInfo("visibility/averageSkipped", cachedFrames ? (double)skipped / cachedFrames : 0.0);
+
+		//The same path with nothing moving and validation off, against a plain cull every frame
+		VisibilityCache timed;
+		for (int frame = 0; frame < (int)frusta.size(); frame++)
+		{
+			Time(benchmark, "visibility/Cached200k", 1, [&]()
+				{
+					timed.Update(culler, frusta[frame], eyes[frame], &jobs);
+				});
+			Time(benchmark, "visibility/Cull200k", 1, [&]()
+				{
+					culler.Cull(frusta[frame], &jobs);
+				});
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	// ------ SUITES --------------------------------------------------------------
+	///////////////////////////////////////////////////////////////////////////////
+
+	struct Suite
+	{
+		const char* Name;
+		void (*Run)(Benchmark& benchmark, const BenchmarkSettings& settings);
+	};
+
+	const Suite suites[] =
+	{
+		{ "transform", RunTransformSuite },
+		{ "hierarchy", RunHierarchySuite },
+		{ "jobs", RunJobsSuite },
+		{ "ecs", RunEcsSuite },
+		{ "scene", RunSceneSuite },
+		{ "handles", RunHandlesSuite },
+		{ "octree", RunOctreeSuite },
+		{ "bvh", RunBvhSuite },
+		{ "grid", RunGridSuite },
+		{ "static", RunStaticSuite },
+		{ "sort", RunSortSuite },
+		{ "instancing", RunInstancingSuite },
+		{ "statecache", RunStateCacheSuite },
+		{ "memory", RunMemorySuite },
+		{ "snapshot", RunSnapshotSuite },
+		{ "occlusion", RunOcclusionSuite },
+		{ "frustum", RunFrustumSuite },
+		{ "views", RunViewsSuite },
+		{ "lod", RunLodSuite },
+		{ "shadows", RunShadowsSuite },
+		{ "pvs", RunPvsSuite },
+		{ "portals", RunPortalsSuite },
+		{ "visibility", RunVisibilitySuite },
+	};
+}
+
+/// <summary>
+/// Runs every suite named in the settings, in the order they're listed here, or all of them for "all"
+/// </summary>
+/// <returns>False if a name isn't a suite, before anything has run</returns>
+bool RunBenchmarkSuites(const BenchmarkSettings& settings, Benchmark& benchmark, std::string& error)
+{
+	bool all = std::find(settings.Suites.begin(), settings.Suites.end(), "all") != settings.Suites.end();
+	for (const std::string& name : settings.Suites)
+	{
+		bool known = name == "all";
+		for (const Suite& suite : suites)
+		{
+			known |= name == suite.Name;
+		}
+		if (!known)
+		{
+			error = "unknown suite " + name;
+			return false;
+		}
+	}
+
+	for (const Suite& suite : suites)
+	{
+		if (!all && std::find(settings.Suites.begin(), settings.Suites.end(), suite.Name) == settings.Suites.end())
+		{
+			continue;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		suite.Run(benchmark, settings);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::printf("Suite %s: %.1fms\n", suite.Name, std::chrono::duration<float, std::milli>(end - start).count());
+	}
+	return true;
+}
+
+#ifdef BENCHMARK_SUITE_MAIN
+
+// --------------------------------------------------------
+// Takes the same switches as the game, -suite to pick the
+// suites and -out for where the results go
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	std::string commandLine;
+	for (int i = 1; i < argc; i++)
+	{
+		commandLine += std::string(argv[i]) + " ";
+	}
+
+	BenchmarkSettings settings;
+	std::string error;
+	Benchmark benchmark;
+	if (!BenchmarkSettings::Parse(commandLine, settings, error) || !RunBenchmarkSuites(settings, benchmark, error))
+	{
+		std::printf("Command line: %s\n", error.c_str());
+		return 2;
+	}
+
+	if (!benchmark.WriteJson(settings.OutputPath))
+	{
+		std::printf("Suites: couldn't write %s\n", settings.OutputPath.c_str());
+		return 2;
+	}
+	return benchmark.GetChecksPassed() ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "Benchmark.h"
+
+// --------------------------------------------------------
+// Benchmarks and checks of single systems, run on their
+// own without a window or a device
+//
+// Every suite makes its own data from a fixed seed, times
+// the work it's there to measure into the Benchmark as
+// samples named "[suite]/[what]" and checks its results
+// against a plain reference done the slow way. Anything it
+// counts goes in the info, keyed the same way. Results are
+// written to the same file, in the same form, as a frame
+// benchmark.
+//
+// None of the systems tested need Windows, so the suites
+// build on their own with BENCHMARK_SUITE_MAIN defined,
+// given DirectXMath's headers.
+// --------------------------------------------------------
+bool RunBenchmarkSuites(const BenchmarkSettings& settings, Benchmark& benchmark, std::string& error);
@@ -0,0 +1,118 @@
+#include "Bounds.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+/// <summary>
+/// Transforms a box and returns the AABB around the result (Arvo's method),
+/// so it works for any rotation and scale without touching all 8 corners
+/// </summary>
+AABB TransformAABB(const AABB& box, const DirectX::XMFLOAT4X4& matrix)
+{
+	const XMFLOAT4X4& m = matrix;
+	AABB result;
+
+	//New center is just the old center through the matrix
+	result.Center.x = box.Center.x * m._11 + box.Center.y * m._21 + box.Center.z * m._31 + m._41;
+	result.Center.y = box.Center.x * m._12 + box.Center.y * m._22 + box.Center.z * m._32 + m._42;
+	result.Center.z = box.Center.x * m._13 + box.Center.y * m._23 + box.Center.z * m._33 + m._43;
+
+	//New extents are the old ones through the absolute value of the 3x3 part
+	result.Extents.x = box.Extents.x * fabsf(m._11) + box.Extents.y * fabsf(m._21) + box.Extents.z * fabsf(m._31);
+	result.Extents.y = box.Extents.x * fabsf(m._12) + box.Extents.y * fabsf(m._22) + box.Extents.z * fabsf(m._32);
+	result.Extents.z = box.Extents.x * fabsf(m._13) + box.Extents.y * fabsf(m._23) + box.Extents.z * fabsf(m._33);
+
+	return result;
+}
+
+BoundingSphere SphereFromAABB(const AABB& box)
+{
+	BoundingSphere sphere;
+	sphere.Center = box.Center;
+	sphere.Radius = sqrtf(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y + box.Extents.z * box.Extents.z);
+	return sphere;
+}
+
+/// <summary>
+/// Pulls the clip planes straight out of a view * projection matrix (Gribb/Hartmann).
+/// With row vectors each plane is a sum of columns, and D3D clips z to [0, w].
+/// </summary>
+Frustum FrustumFromMatrix(const DirectX::XMFLOAT4X4& viewProjection)
+{
+	const XMFLOAT4X4& m = viewProjection;
+	Frustum frustum;
+
+	frustum.Planes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41); //Left
+	frustum.Planes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41); //Right
+	frustum.Planes[2] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42); //Bottom
+	frustum.Planes[3] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42); //Top
+	frustum.Planes[4] = XMFLOAT4(m._13, m._23, m._33, m._43); //Near
+	frustum.Planes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43); //Far
+
+	//Normalize so plane distances are real distances
+	for (XMFLOAT4& plane : frustum.Planes)
+	{
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane.x /= length;
+		plane.y /= length;
+		plane.z /= length;
+		plane.w /= length;
+	}
+
+	return frustum;
+}
+
+bool AABBIntersectsAABB(const AABB& a, const AABB& b)
+{
+	return fabsf(a.Center.x - b.Center.x) <= a.Extents.x + b.Extents.x
+		&& fabsf(a.Center.y - b.Center.y) <= a.Extents.y + b.Extents.y
+		&& fabsf(a.Center.z - b.Center.z) <= a.Extents.z + b.Extents.z;
+}
+
+bool AABBContainsAABB(const AABB& outer, const AABB& inner)
+{
+	return fabsf(outer.Center.x - inner.Center.x) + inner.Extents.x <= outer.Extents.x
+		&& fabsf(outer.Center.y - inner.Center.y) + inner.Extents.y <= outer.Extents.y
+		&& fabsf(outer.Center.z - inner.Center.z) + inner.Extents.z <= outer.Extents.z;
+}
+
+bool AABBIntersectsSphere(const AABB& box, const DirectX::XMFLOAT3& center, float radius)
+{
+	//Distance from the sphere to the closest point on the box
+	float dx = fmaxf(fabsf(center.x - box.Center.x) - box.Extents.x, 0.0f);
+	float dy = fmaxf(fabsf(center.y - box.Center.y) - box.Extents.y, 0.0f);
+	float dz = fmaxf(fabsf(center.z - box.Center.z) - box.Extents.z, 0.0f);
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+/// <summary>
+/// Conservative test, boxes near the frustum's corners can still pass
+/// </summary>
+bool FrustumIntersectsAABB(const Frustum& frustum, const AABB& box)
+{
+	for (const XMFLOAT4& plane : frustum.Planes)
+	{
+		float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+		float radius = box.Extents.x * fabsf(plane.x) + box.Extents.y * fabsf(plane.y) + box.Extents.z * fabsf(plane.z);
+		if (distance + radius < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FrustumContainsAABB(const Frustum& frustum, const AABB& box)
+{
+	for (const XMFLOAT4& plane : frustum.Planes)
+	{
+		float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+		float radius = box.Extents.x * fabsf(plane.x) + box.Extents.y * fabsf(plane.y) + box.Extents.z * fabsf(plane.z);
+		if (distance - radius < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
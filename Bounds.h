@@ -0,0 +1,42 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Axis aligned box stored as center + half size
+// --------------------------------------------------------
+struct AABB
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 Extents; // Half the size on each axis
+};
+
+// --------------------------------------------------------
+// Sphere that fully contains an AABB
+// --------------------------------------------------------
+struct BoundingSphere
+{
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+};
+
+// --------------------------------------------------------
+// Six planes (left, right, bottom, top, near, far) stored
+// as (normal, distance), with normals pointing inwards
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+//Helpers
+AABB TransformAABB(const AABB& box, const DirectX::XMFLOAT4X4& matrix);
+BoundingSphere SphereFromAABB(const AABB& box);
+Frustum FrustumFromMatrix(const DirectX::XMFLOAT4X4& viewProjection);
+
+//Overlap tests
+bool AABBIntersectsAABB(const AABB& a, const AABB& b);
+bool AABBContainsAABB(const AABB& outer, const AABB& inner);
+bool AABBIntersectsSphere(const AABB& box, const DirectX::XMFLOAT3& center, float radius);
+bool FrustumIntersectsAABB(const Frustum& frustum, const AABB& box);
+bool FrustumContainsAABB(const Frustum& frustum, const AABB& box);
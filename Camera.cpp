@@ -9,9 +9,7 @@ Camera::Camera(DirectX::XMFLOAT3 pos, float moveSpeed, float lookSpeed, float fo
 	mouseLookSpeed = lookSpeed;
 	fieldOfView = fov;
 
-	transform = std::make_shared<Transform>();
-
-	transform->SetPosition(pos);
+	transform.SetPosition(pos);
 
 	UpdateViewMatrix();
 
@@ -27,25 +25,25 @@ void Camera::Update(float deltaTime)
 	//W
 	if (Input::KeyDown('W'))
 	{
-		transform->MoveRelative(0, 0, movementSpeed * deltaTime);
+		transform.MoveRelative(0, 0, movementSpeed * deltaTime);
 	}
 
 	//A
 	if (Input::KeyDown('A'))
 	{
-		transform->MoveRelative(-movementSpeed * deltaTime, 0, 0);
+		transform.MoveRelative(-movementSpeed * deltaTime, 0, 0);
 	}
 
 	//S
 	if (Input::KeyDown('S'))
 	{
-		transform->MoveRelative(0, 0, -movementSpeed * deltaTime);
+		transform.MoveRelative(0, 0, -movementSpeed * deltaTime);
 	}
 
 	//D
 	if (Input::KeyDown('D'))
 	{
-		transform->MoveRelative(movementSpeed * deltaTime, 0, 0);
+		transform.MoveRelative(movementSpeed * deltaTime, 0, 0);
 	}
 
 	//Mouse Movement
@@ -56,9 +54,9 @@ void Camera::Update(float deltaTime)
 
 		printf("efojwejf");
 
-		transform->Rotate(cursorMovementY * deltaTime, cursorMovementX * deltaTime, 0);
+		transform.Rotate(cursorMovementY * deltaTime, cursorMovementX * deltaTime, 0);
 
-		transform->SetRotation(Clamp(transform->GetRotation().x, -DirectX::XM_PIDIV2, DirectX::XM_PIDIV2), transform->GetRotation().y, transform->GetRotation().z);
+		transform.SetRotation(Clamp(transform.GetRotation().x, -DirectX::XM_PIDIV2, DirectX::XM_PIDIV2), transform.GetRotation().y, transform.GetRotation().z);
 	}
 
 
@@ -67,8 +65,8 @@ void Camera::Update(float deltaTime)
 
 void Camera::UpdateViewMatrix()
 {
-	XMFLOAT3 pos = transform->GetPosition();
-	XMFLOAT3 forward = transform->GetForward();
+	XMFLOAT3 pos = transform.GetPosition();
+	XMFLOAT3 forward = transform.GetForward();
 	XMFLOAT3 worldUp = XMFLOAT3(0, 1, 0);
 
 	XMMATRIX viewM = XMMatrixLookToLH(
@@ -84,7 +82,7 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 	//Call the DXMath function to make the perspective proj
 	XMMATRIX proj = XMMatrixPerspectiveFovLH
 	(
-		XM_PIDIV4, //FOV anle in radians
+		fieldOfView, //FOV angle in radians
 		aspectRatio,
 		.01f,
 		1000.0f
@@ -104,9 +102,17 @@ DirectX::XMFLOAT4X4 Camera::GetProjection()
 	return projMatrix;
 }
 
-std::shared_ptr<Transform> Camera::GetTransform()
+//View then projection, what the frustum planes come out of
+DirectX::XMFLOAT4X4 Camera::GetViewProjection()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projMatrix)));
+	return viewProjection;
+}
+
+Transform* Camera::GetTransform()
 {
-	return transform;
+	return &transform;
 }
 
 float Camera::Clamp(float input, float min, float max)
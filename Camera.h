@@ -20,14 +20,15 @@ public:
 	//Getters
 	DirectX::XMFLOAT4X4 GetView();
 	DirectX::XMFLOAT4X4 GetProjection();
-	std::shared_ptr <Transform> GetTransform();
+	DirectX::XMFLOAT4X4 GetViewProjection();
+	Transform* GetTransform();
 
 private:
 	//camera matricies
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
 
-	std::shared_ptr<Transform> transform;
+	Transform transform;
 
 
 	float fieldOfView;
@@ -0,0 +1,90 @@
+#include "ChangeJournal.h"
+
+#include <algorithm>
+
+DirtyBitset::DirtyBitset() : wordCount(0), capacity(0), touchedCount(0)
+{
+}
+
+void DirtyBitset::Resize(uint32_t newCapacity)
+{
+	uint32_t newWordCount = (newCapacity + 63) / 64;
+	if (newWordCount > wordCount)
+	{
+		//Grow by at least half again so entity ids trickling in don't copy every time
+		newWordCount = std::max(newWordCount, wordCount + wordCount / 2);
+
+		std::unique_ptr<std::atomic<uint64_t>[]> newWords(new std::atomic<uint64_t>[newWordCount]);
+		std::unique_ptr<uint32_t[]> newTouched(new uint32_t[newWordCount]);
+		for (uint32_t i = 0; i < newWordCount; i++)
+		{
+			newWords[i].store(i < wordCount ? words[i].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+		}
+		std::copy(touchedWords.get(), touchedWords.get() + touchedCount.load(), newTouched.get());
+
+		words = std::move(newWords);
+		touchedWords = std::move(newTouched);
+		wordCount = newWordCount;
+	}
+	capacity = std::max(capacity, newCapacity);
+}
+
+void DirtyBitset::Mark(uint32_t index)
+{
+	if (index >= capacity)
+	{
+		return;
+	}
+
+	uint32_t word = index / 64;
+	uint64_t bit = 1ull << (index % 64);
+	uint64_t previous = words[word].fetch_or(bit, std::memory_order_relaxed);
+	if (previous == 0)
+	{
+		//Only the thread that set the first bit of this word records it
+		touchedWords[touchedCount.fetch_add(1, std::memory_order_acq_rel)] = word;
+	}
+}
+
+bool DirtyBitset::IsMarked(uint32_t index)
+{
+	return index < capacity && (words[index / 64].load(std::memory_order_relaxed) & (1ull << (index % 64))) != 0;
+}
+
+void DirtyBitset::Clear()
+{
+	uint32_t count = touchedCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		words[touchedWords[i]].store(0, std::memory_order_relaxed);
+	}
+	touchedCount.store(0, std::memory_order_release);
+}
+
+void DirtyBitset::Sort()
+{
+	//Words get touched in whatever order threads got to them
+	uint32_t count = touchedCount.load(std::memory_order_acquire);
+	std::sort(touchedWords.get(), touchedWords.get() + count);
+}
+
+int DirtyBitset::Gather(uint32_t* indices)
+{
+	int written = 0;
+	ForEach([indices, &written](uint32_t index)
+		{
+			indices[written++] = index;
+		});
+	return written;
+}
+
+int DirtyBitset::GetMarkedCount()
+{
+	int marked = 0;
+	uint32_t count = touchedCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		marked += std::popcount(words[touchedWords[i]].load(std::memory_order_relaxed));
+	}
+	return marked;
+}
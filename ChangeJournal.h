@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+
+//What changed, each channel has its own id space
+#define CHANGE_CHANNEL_TRANSFORM 0 //Entity index, world matrix changed
+#define CHANGE_CHANNEL_MATERIAL 1 //Material pool index, parameters, textures or shaders changed
+#define CHANGE_CHANNEL_LIGHT 2 //Light pool index
+#define CHANGE_CHANNEL_COUNT 3
+
+// --------------------------------------------------------
+// One bit per id, plus a list of the 64 bit words that have
+// any bits set. Marking is thread safe. Reading and clearing
+// only walk the touched words, so a frame where nothing
+// changed costs next to nothing however many ids there are.
+// --------------------------------------------------------
+class DirtyBitset
+{
+public:
+	DirtyBitset();
+
+	void Resize(uint32_t capacity); //Keeps existing marks, not thread safe
+	void Mark(uint32_t index); //Ids past the capacity are ignored
+	bool IsMarked(uint32_t index);
+	void Clear();
+
+	//Puts the touched words in order. The producer calls it once it's done marking, so
+	//readers sharing the bitset never write to it.
+	void Sort();
+
+	//Writes every marked id, in ascending order once sorted. indices needs room for GetMarkedCount
+	int Gather(uint32_t* indices);
+
+	template<typename Function>
+	void ForEach(Function function)
+	{
+		uint32_t count = touchedCount.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t word = touchedWords[i];
+			uint64_t bits = words[word].load(std::memory_order_relaxed);
+			while (bits != 0)
+			{
+				function(word * 64 + (uint32_t)std::countr_zero(bits));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	//Getters
+	bool IsEmpty() { return touchedCount.load(std::memory_order_acquire) == 0; }
+	int GetMarkedCount();
+	uint32_t GetCapacity() { return capacity; }
+
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	uint32_t wordCount;
+	uint32_t capacity;
+
+	//Each word goes on here once, when its first bit is set
+	std::unique_ptr<uint32_t[]> touchedWords;
+	std::atomic<uint32_t> touchedCount;
+};
+
+// --------------------------------------------------------
+// Everything that changed this frame, one DirtyBitset per
+// channel. Producers mark as they change things, systems
+// later in the frame only visit what was marked, and the
+// whole journal is cleared once every frame.
+// --------------------------------------------------------
+class ChangeJournal
+{
+public:
+	void Mark(int channel, uint32_t index) { channels[channel].Mark(index); }
+	DirtyBitset& Get(int channel) { return channels[channel]; }
+
+	void Clear()
+	{
+		for (DirtyBitset& channel : channels)
+		{
+			channel.Clear();
+		}
+	}
+
+private:
+	DirtyBitset channels[CHANGE_CHANNEL_COUNT];
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Handle.h"
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// Plain data components stored in the ECS World. Transform
+// and AABB are used as components directly.
+// --------------------------------------------------------
+
+//What to draw with. Meshes and materials live in Game's pools.
+struct Renderable
+{
+	Handle<Mesh> MeshHandle;
+	Handle<Material> MaterialHandle;
+};
+
+//Node id inside the scene's TransformHierarchy
+struct HierarchyNode
+{
+	int Node;
+};
+
+//Tag for entities whose mesh is drawn into the occlusion buffer, from SCENE_ENTITY_OCCLUDER
+struct Occluder
+{
+};
+
+//Bobs an entity around where it started, see Game's Motion stage
+struct Motion
+{
+	DirectX::XMFLOAT3 Origin;
+	float Radius;
+	float Speed; //Radians per second
+	float Phase;
+};
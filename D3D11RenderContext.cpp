@@ -0,0 +1,74 @@
+#include "D3D11RenderContext.h"
+
+void D3D11RenderContext::SetInputLayout(ID3D11InputLayout* layout)
+{
+	deviceContext->IASetInputLayout(layout);
+}
+
+void D3D11RenderContext::SetVertexShader(ID3D11VertexShader* shader)
+{
+	deviceContext->VSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::SetPixelShader(ID3D11PixelShader* shader)
+{
+	deviceContext->PSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer)
+{
+	if (stage == RENDER_STAGE_VERTEX)
+	{
+		deviceContext->VSSetConstantBuffers(slot, 1, &buffer);
+	}
+	else
+	{
+		deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+	}
+}
+
+void D3D11RenderContext::SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv)
+{
+	if (stage == RENDER_STAGE_VERTEX)
+	{
+		deviceContext->VSSetShaderResources(slot, 1, &srv);
+	}
+	else
+	{
+		deviceContext->PSSetShaderResources(slot, 1, &srv);
+	}
+}
+
+void D3D11RenderContext::SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler)
+{
+	if (stage == RENDER_STAGE_VERTEX)
+	{
+		deviceContext->VSSetSamplers(slot, 1, &sampler);
+	}
+	else
+	{
+		deviceContext->PSSetSamplers(slot, 1, &sampler);
+	}
+}
+
+void D3D11RenderContext::SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+	UINT strides = stride;
+	UINT offsets = offset;
+	deviceContext->IASetVertexBuffers(slot, 1, &buffer, &strides, &offsets);
+}
+
+void D3D11RenderContext::SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset)
+{
+	deviceContext->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset);
+}
+
+void D3D11RenderContext::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	deviceContext->RSSetState(state);
+}
+
+void D3D11RenderContext::SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef)
+{
+	deviceContext->OMSetDepthStencilState(state, stencilRef);
+}
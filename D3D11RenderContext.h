@@ -0,0 +1,29 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "RenderStateCache.h"
+
+// --------------------------------------------------------
+// The cache's calls made on a real device context
+// --------------------------------------------------------
+class D3D11RenderContext : public IRenderContext
+{
+public:
+	void SetDeviceContext(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext) { this->deviceContext = deviceContext; }
+
+	void SetInputLayout(ID3D11InputLayout* layout) override;
+	void SetVertexShader(ID3D11VertexShader* shader) override;
+	void SetPixelShader(ID3D11PixelShader* shader) override;
+	void SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer) override;
+	void SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv) override;
+	void SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler) override;
+	void SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset) override;
+	void SetRasterizerState(ID3D11RasterizerState* state) override;
+	void SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
+};
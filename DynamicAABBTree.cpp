@@ -0,0 +1,576 @@
+#include "DynamicAABBTree.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	AABB Union(const AABB& a, const AABB& b)
+	{
+		XMFLOAT3 minimum(
+			fminf(a.Center.x - a.Extents.x, b.Center.x - b.Extents.x),
+			fminf(a.Center.y - a.Extents.y, b.Center.y - b.Extents.y),
+			fminf(a.Center.z - a.Extents.z, b.Center.z - b.Extents.z));
+		XMFLOAT3 maximum(
+			fmaxf(a.Center.x + a.Extents.x, b.Center.x + b.Extents.x),
+			fmaxf(a.Center.y + a.Extents.y, b.Center.y + b.Extents.y),
+			fmaxf(a.Center.z + a.Extents.z, b.Center.z + b.Extents.z));
+
+		AABB result;
+		result.Center = XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+		result.Extents = XMFLOAT3((maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f);
+		return result;
+	}
+
+	float SurfaceArea(const AABB& box)
+	{
+		const XMFLOAT3& e = box.Extents;
+		return 8.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+}
+
+DynamicAABBTree::DynamicAABBTree(float margin) : margin(margin), root(-1), proxyCount(0), optimizeCursor(0)
+{
+}
+
+int DynamicAABBTree::CreateProxy(const AABB& bounds, int userData)
+{
+	int proxy = AllocateNode();
+	nodes[proxy].Box = Fatten(bounds);
+	nodes[proxy].UserData = userData;
+	nodes[proxy].Height = 0;
+
+	InsertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+/// <summary>
+/// Nothing happens while the bounds stay inside the fat box. Otherwise the leaf is
+/// refit in place if it only moved a little, or reinserted if it jumped.
+/// </summary>
+bool DynamicAABBTree::MoveProxy(int proxy, const AABB& bounds)
+{
+	AABB& fatBox = nodes[proxy].Box;
+
+	//Still inside, and the fat box hasn't become much bigger than the object (it shrank)
+	bool contained = AABBContainsAABB(fatBox, bounds);
+	bool oversized =
+		fatBox.Extents.x > bounds.Extents.x + margin * 4 ||
+		fatBox.Extents.y > bounds.Extents.y + margin * 4 ||
+		fatBox.Extents.z > bounds.Extents.z + margin * 4;
+	if (contained && !oversized)
+	{
+		return false;
+	}
+
+	AABB newFatBox = Fatten(bounds);
+	if (AABBIntersectsAABB(fatBox, newFatBox))
+	{
+		fatBox = newFatBox;
+		RefitAncestors(nodes[proxy].Parent);
+	}
+	else
+	{
+		RemoveLeaf(proxy);
+		nodes[proxy].Box = newFatBox;
+		InsertLeaf(proxy);
+	}
+	return true;
+}
+
+void DynamicAABBTree::Optimize(int nodeBudget)
+{
+	int count = (int)nodes.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	for (int visited = 0; visited < count && nodeBudget > 0; visited++)
+	{
+		int node = optimizeCursor;
+		optimizeCursor = (optimizeCursor + 1) % count;
+
+		//Skip leaves and free nodes
+		if (nodes[node].Height < 1)
+		{
+			continue;
+		}
+
+		nodeBudget--;
+		if (Rotate(node))
+		{
+			UpdateHeightsFrom(nodes[node].Parent);
+		}
+	}
+}
+
+void DynamicAABBTree::QueryAABB(const AABB& box, std::vector<int>& results)
+{
+	if (root < 0)
+	{
+		return;
+	}
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+
+		if (!AABBIntersectsAABB(nodes[node].Box, box))
+		{
+			continue;
+		}
+
+		if (IsLeaf(node))
+		{
+			results.push_back(nodes[node].UserData);
+		}
+		else
+		{
+			stack.push_back(nodes[node].Child1);
+			stack.push_back(nodes[node].Child2);
+		}
+	}
+}
+
+/// <summary>
+/// Subtrees fully inside the frustum are taken without testing their leaves
+/// </summary>
+void DynamicAABBTree::QueryFrustum(const Frustum& frustum, std::vector<int>& results)
+{
+	if (root < 0)
+	{
+		return;
+	}
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+
+		if (!FrustumIntersectsAABB(frustum, nodes[node].Box))
+		{
+			continue;
+		}
+
+		if (IsLeaf(node))
+		{
+			results.push_back(nodes[node].UserData);
+			continue;
+		}
+
+		if (FrustumContainsAABB(frustum, nodes[node].Box))
+		{
+			//Everything below is in, so just gather the leaves
+			size_t base = stack.size();
+			stack.push_back(node);
+			while (stack.size() > base)
+			{
+				int inner = stack.back();
+				stack.pop_back();
+				if (IsLeaf(inner))
+				{
+					results.push_back(nodes[inner].UserData);
+				}
+				else
+				{
+					stack.push_back(nodes[inner].Child1);
+					stack.push_back(nodes[inner].Child2);
+				}
+			}
+			continue;
+		}
+
+		stack.push_back(nodes[node].Child1);
+		stack.push_back(nodes[node].Child2);
+	}
+}
+
+int DynamicAABBTree::RayCast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, float* hitDistance)
+{
+	if (root < 0)
+	{
+		return -1;
+	}
+
+	XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	//Slab test, returns the entry distance or -1 if the box is missed
+	auto enterDistance = [&](const AABB& box, float limit)
+	{
+		float tMin = 0;
+		float tMax = limit;
+		const float* o = &origin.x;
+		const float* inv = &inverse.x;
+		const float* c = &box.Center.x;
+		const float* e = &box.Extents.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t1 = (c[axis] - e[axis] - o[axis]) * inv[axis];
+			float t2 = (c[axis] + e[axis] - o[axis]) * inv[axis];
+			tMin = fmaxf(tMin, fminf(t1, t2));
+			tMax = fminf(tMax, fmaxf(t1, t2));
+		}
+		return tMin <= tMax ? tMin : -1.0f;
+	};
+
+	float closest = maxDistance;
+	int hit = -1;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+
+		float distance = enterDistance(nodes[node].Box, closest);
+		if (distance < 0)
+		{
+			continue;
+		}
+
+		if (IsLeaf(node))
+		{
+			closest = distance;
+			hit = nodes[node].UserData;
+		}
+		else
+		{
+			stack.push_back(nodes[node].Child1);
+			stack.push_back(nodes[node].Child2);
+		}
+	}
+
+	if (hit >= 0 && hitDistance)
+	{
+		*hitDistance = closest;
+	}
+	return hit;
+}
+
+int DynamicAABBTree::GetUserData(int proxy)
+{
+	return nodes[proxy].UserData;
+}
+
+AABB DynamicAABBTree::GetFatBounds(int proxy)
+{
+	return nodes[proxy].Box;
+}
+
+int DynamicAABBTree::GetProxyCount()
+{
+	return proxyCount;
+}
+
+int DynamicAABBTree::GetHeight()
+{
+	return root < 0 ? 0 : nodes[root].Height;
+}
+
+float DynamicAABBTree::GetAreaRatio()
+{
+	if (root < 0)
+	{
+		return 0;
+	}
+
+	float rootArea = SurfaceArea(nodes[root].Box);
+	if (rootArea <= 0)
+	{
+		return 0;
+	}
+
+	float totalArea = 0;
+	for (const TreeNode& node : nodes)
+	{
+		if (node.Height > 0)
+		{
+			totalArea += SurfaceArea(node.Box);
+		}
+	}
+	return totalArea / rootArea;
+}
+
+int DynamicAABBTree::AllocateNode()
+{
+	int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.push_back({});
+	}
+
+	nodes[node].Parent = -1;
+	nodes[node].Child1 = -1;
+	nodes[node].Child2 = -1;
+	nodes[node].Height = 0;
+	nodes[node].UserData = -1;
+	return node;
+}
+
+void DynamicAABBTree::FreeNode(int node)
+{
+	nodes[node].Height = -1;
+	freeNodes.push_back(node);
+}
+
+bool DynamicAABBTree::IsLeaf(int node)
+{
+	return nodes[node].Child1 < 0;
+}
+
+AABB DynamicAABBTree::Fatten(const AABB& bounds)
+{
+	AABB fat = bounds;
+	fat.Extents.x += margin;
+	fat.Extents.y += margin;
+	fat.Extents.z += margin;
+	return fat;
+}
+
+/// <summary>
+/// Walks down picking the sibling with the lowest surface area cost (Box2D's heuristic),
+/// then splices in a new parent above it
+/// </summary>
+void DynamicAABBTree::InsertLeaf(int leaf)
+{
+	if (root < 0)
+	{
+		root = leaf;
+		nodes[leaf].Parent = -1;
+		return;
+	}
+
+	AABB leafBox = nodes[leaf].Box;
+	int index = root;
+	while (!IsLeaf(index))
+	{
+		const TreeNode& node = nodes[index];
+		float area = SurfaceArea(node.Box);
+		float combinedArea = SurfaceArea(Union(node.Box, leafBox));
+
+		//Cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+
+		//Minimum cost of pushing the leaf further down
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int child)
+		{
+			float unionArea = SurfaceArea(Union(leafBox, nodes[child].Box));
+			return IsLeaf(child) ? unionArea + inheritanceCost : unionArea - SurfaceArea(nodes[child].Box) + inheritanceCost;
+		};
+		float cost1 = descendCost(node.Child1);
+		float cost2 = descendCost(node.Child2);
+
+		if (cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+		index = cost1 < cost2 ? node.Child1 : node.Child2;
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].Parent;
+	int newParent = AllocateNode();
+	nodes[newParent].Parent = oldParent;
+	nodes[newParent].Box = Union(leafBox, nodes[sibling].Box);
+	nodes[newParent].Height = nodes[sibling].Height + 1;
+	nodes[newParent].Child1 = sibling;
+	nodes[newParent].Child2 = leaf;
+	nodes[sibling].Parent = newParent;
+	nodes[leaf].Parent = newParent;
+
+	if (oldParent < 0)
+	{
+		root = newParent;
+	}
+	else if (nodes[oldParent].Child1 == sibling)
+	{
+		nodes[oldParent].Child1 = newParent;
+	}
+	else
+	{
+		nodes[oldParent].Child2 = newParent;
+	}
+
+	RefitAncestors(oldParent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].Parent;
+	int grandParent = nodes[parent].Parent;
+	int sibling = nodes[parent].Child1 == leaf ? nodes[parent].Child2 : nodes[parent].Child1;
+
+	//The sibling takes the parent's place
+	nodes[sibling].Parent = grandParent;
+	if (grandParent < 0)
+	{
+		root = sibling;
+	}
+	else
+	{
+		if (nodes[grandParent].Child1 == parent)
+		{
+			nodes[grandParent].Child1 = sibling;
+		}
+		else
+		{
+			nodes[grandParent].Child2 = sibling;
+		}
+	}
+	FreeNode(parent);
+	nodes[leaf].Parent = -1;
+
+	RefitAncestors(grandParent);
+}
+
+/// <summary>
+/// Rebuilds boxes and heights from a node up to the root, rotating along the way
+/// </summary>
+void DynamicAABBTree::RefitAncestors(int node)
+{
+	while (node >= 0)
+	{
+		TreeNode& current = nodes[node];
+		const TreeNode& child1 = nodes[current.Child1];
+		const TreeNode& child2 = nodes[current.Child2];
+		current.Box = Union(child1.Box, child2.Box);
+		current.Height = 1 + (child1.Height > child2.Height ? child1.Height : child2.Height);
+
+		Rotate(node);
+		node = nodes[node].Parent;
+	}
+}
+
+/// <summary>
+/// Tries swapping one child with a grandchild on the other side and keeps the swap
+/// that shrinks the changed child's surface area the most. The node's own box never
+/// changes, since it still holds the same leaves.
+/// </summary>
+/// <returns>True if a rotation was applied</returns>
+bool DynamicAABBTree::Rotate(int node)
+{
+	int b = nodes[node].Child1;
+	int c = nodes[node].Child2;
+
+	float bestGain = 0;
+	int bestDirect = -1; //Child of node that moves down
+	int bestGrand = -1; //Grandchild that moves up
+	int bestOther = -1; //Child whose children change
+
+	auto consider = [&](int direct, int other)
+	{
+		if (IsLeaf(other))
+		{
+			return;
+		}
+
+		float baseline = SurfaceArea(nodes[other].Box);
+		int grand1 = nodes[other].Child1;
+		int grand2 = nodes[other].Child2;
+
+		//Swapping direct with grand1 leaves other holding direct and grand2, and the reverse
+		float gain1 = baseline - SurfaceArea(Union(nodes[direct].Box, nodes[grand2].Box));
+		float gain2 = baseline - SurfaceArea(Union(nodes[direct].Box, nodes[grand1].Box));
+		if (gain1 > bestGain)
+		{
+			bestGain = gain1;
+			bestDirect = direct;
+			bestGrand = grand1;
+			bestOther = other;
+		}
+		if (gain2 > bestGain)
+		{
+			bestGain = gain2;
+			bestDirect = direct;
+			bestGrand = grand2;
+			bestOther = other;
+		}
+	};
+	consider(b, c);
+	consider(c, b);
+
+	if (bestDirect < 0)
+	{
+		return false;
+	}
+
+	//Grandchild comes up to where the direct child was
+	if (nodes[node].Child1 == bestDirect)
+	{
+		nodes[node].Child1 = bestGrand;
+	}
+	else
+	{
+		nodes[node].Child2 = bestGrand;
+	}
+	nodes[bestGrand].Parent = node;
+
+	//Direct child goes down to where the grandchild was
+	TreeNode& other = nodes[bestOther];
+	if (other.Child1 == bestGrand)
+	{
+		other.Child1 = bestDirect;
+	}
+	else
+	{
+		other.Child2 = bestDirect;
+	}
+	nodes[bestDirect].Parent = bestOther;
+
+	other.Box = Union(nodes[other.Child1].Box, nodes[other.Child2].Box);
+	int height1 = nodes[other.Child1].Height;
+	int height2 = nodes[other.Child2].Height;
+	other.Height = 1 + (height1 > height2 ? height1 : height2);
+
+	height1 = nodes[nodes[node].Child1].Height;
+	height2 = nodes[nodes[node].Child2].Height;
+	nodes[node].Height = 1 + (height1 > height2 ? height1 : height2);
+	return true;
+}
+
+void DynamicAABBTree::UpdateHeightsFrom(int node)
+{
+	while (node >= 0)
+	{
+		int height1 = nodes[nodes[node].Child1].Height;
+		int height2 = nodes[nodes[node].Child2].Height;
+		int height = 1 + (height1 > height2 ? height1 : height2);
+		if (height == nodes[node].Height)
+		{
+			return;
+		}
+
+		nodes[node].Height = height;
+		node = nodes[node].Parent;
+	}
+}
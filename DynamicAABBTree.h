@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+
+#define AABB_TREE_DEFAULT_MARGIN 0.1f
+
+// --------------------------------------------------------
+// Dynamic bounding volume hierarchy (binary AABB tree)
+//
+// Leaves store a fattened copy of each proxy's bounds, so
+// small movements don't touch the tree at all. A proxy that
+// escapes its fat box is refit in place when the new box is
+// close by (boxes are rebuilt walking up from the leaf), or
+// reinserted when it jumped somewhere else. Tree rotations
+// clean up after refits, both on the way up and in
+// Optimize, which can be given a small budget every frame.
+//
+// Proxy ids are node indices and stay valid until the proxy
+// is destroyed. Each proxy carries a user int (an entity
+// index, for example) and queries return those.
+// --------------------------------------------------------
+class DynamicAABBTree
+{
+public:
+	DynamicAABBTree(float margin = AABB_TREE_DEFAULT_MARGIN);
+
+	int CreateProxy(const AABB& bounds, int userData);
+	void DestroyProxy(int proxy);
+	bool MoveProxy(int proxy, const AABB& bounds); //True when the tree had to change
+
+	//Tries a rotation at up to nodeBudget internal nodes, picking up where the last call stopped
+	void Optimize(int nodeBudget);
+
+	//Queries append the user data of every hit
+	void QueryAABB(const AABB& box, std::vector<int>& results);
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& results);
+
+	//Closest fat box along the ray, returns -1 on a miss
+	int RayCast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, float* hitDistance = nullptr);
+
+	//Getters
+	int GetUserData(int proxy);
+	AABB GetFatBounds(int proxy);
+	int GetProxyCount();
+	int GetHeight();
+	float GetAreaRatio(); //Total internal node area over root area, lower is better
+
+private:
+	struct TreeNode
+	{
+		AABB Box;
+		int Parent;
+		int Child1;
+		int Child2;
+		int Height; //Leaves are 0, free nodes are -1
+		int UserData;
+	};
+
+	float margin;
+	int root;
+	int proxyCount;
+	int optimizeCursor;
+
+	std::vector<TreeNode> nodes;
+	std::vector<int> freeNodes;
+
+	//Reused between queries so they don't allocate
+	std::vector<int> stack;
+
+	int AllocateNode();
+	void FreeNode(int node);
+	bool IsLeaf(int node);
+	AABB Fatten(const AABB& bounds);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void RefitAncestors(int node);
+	bool Rotate(int node);
+	void UpdateHeightsFrom(int node);
+};
@@ -0,0 +1,411 @@
+#include "ECS.h"
+
+#include <new>
+#include <stdexcept>
+
+namespace
+{
+	std::vector<ComponentInfo>& GetComponentInfos()
+	{
+		static std::vector<ComponentInfo> infos;
+		return infos;
+	}
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ COMPONENT REGISTRY --------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+const ComponentInfo& ComponentRegistry::GetInfo(int id)
+{
+	return GetComponentInfos()[id];
+}
+
+int ComponentRegistry::Register(size_t size, size_t alignment)
+{
+	std::vector<ComponentInfo>& infos = GetComponentInfos();
+	if (infos.size() >= ECS_MAX_COMPONENTS)
+	{
+		throw std::length_error("Too many component types, the ECS supports 64");
+	}
+
+	infos.push_back({ size, alignment });
+	return (int)infos.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ ARCHETYPE -----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+Archetype::Archetype(uint64_t mask, PoolAllocator* chunkPool) : mask(mask), chunkPool(chunkPool)
+{
+	size_t rowSize = sizeof(Entity);
+	for (int id = 0; id < ECS_MAX_COMPONENTS; id++)
+	{
+		columnOffsets[id] = 0;
+		if (mask & (1ull << id))
+		{
+			componentIds.push_back(id);
+			rowSize += ComponentRegistry::GetInfo(id).Size;
+		}
+	}
+
+	//Start from the ideal row count, then back off until the aligned columns fit
+	for (chunkCapacity = (int)(ECS_CHUNK_SIZE / rowSize); chunkCapacity > 1; chunkCapacity--)
+	{
+		size_t offset = AlignUp(sizeof(Entity) * chunkCapacity, 16);
+		for (int id : componentIds)
+		{
+			const ComponentInfo& info = ComponentRegistry::GetInfo(id);
+			offset = AlignUp(offset, info.Alignment > 16 ? info.Alignment : 16);
+			offset += info.Size * chunkCapacity;
+		}
+		if (offset <= ECS_CHUNK_SIZE)
+		{
+			break;
+		}
+	}
+
+	//Columns start on 16 byte boundaries so they can be loaded with SIMD
+	size_t offset = AlignUp(sizeof(Entity) * chunkCapacity, 16);
+	for (int id : componentIds)
+	{
+		const ComponentInfo& info = ComponentRegistry::GetInfo(id);
+		offset = AlignUp(offset, info.Alignment > 16 ? info.Alignment : 16);
+		columnOffsets[id] = offset;
+		offset += info.Size * chunkCapacity;
+	}
+}
+
+Archetype::~Archetype()
+{
+	for (ArchetypeChunk& chunk : chunks)
+	{
+		chunkPool->Free(chunk.Data);
+	}
+}
+
+void Archetype::AddRow(Entity entity, int& chunk, int& row)
+{
+	if (chunks.empty() || chunks.back().Count == chunkCapacity)
+	{
+		ArchetypeChunk newChunk;
+		newChunk.Data = static_cast<unsigned char*>(chunkPool->Allocate());
+		newChunk.Count = 0;
+		chunks.push_back(newChunk);
+	}
+
+	chunk = (int)chunks.size() - 1;
+	row = chunks.back().Count++;
+	GetEntities(chunk)[row] = entity;
+}
+
+/// <summary>
+/// Fills the hole with the very last row so chunks stay packed
+/// </summary>
+/// <returns>The entity that got moved into the hole, or an invalid entity if none did</returns>
+Entity Archetype::RemoveRow(int chunk, int row)
+{
+	int lastChunk = (int)chunks.size() - 1;
+	int lastRow = chunks[lastChunk].Count - 1;
+
+	Entity moved;
+	if (chunk != lastChunk || row != lastRow)
+	{
+		moved = GetEntities(lastChunk)[lastRow];
+		GetEntities(chunk)[row] = moved;
+		for (int id : componentIds)
+		{
+			size_t size = ComponentRegistry::GetInfo(id).Size;
+			std::memcpy(GetComponent(chunk, row, id), GetComponent(lastChunk, lastRow, id), size);
+		}
+	}
+
+	chunks[lastChunk].Count--;
+	if (chunks[lastChunk].Count == 0)
+	{
+		chunkPool->Free(chunks[lastChunk].Data);
+		chunks.pop_back();
+	}
+
+	return moved;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ WORLD ---------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+World::World() : entityCount(0), chunkPool(ECS_CHUNK_SIZE, 64, 16), structuralVersion(0)
+{
+}
+
+World::~World()
+{
+	for (Archetype* archetype : archetypes)
+	{
+		delete archetype;
+	}
+}
+
+/// <summary>
+/// Creates an entity with the given components, all of them left uninitialized
+/// </summary>
+Entity World::CreateEntity(uint64_t mask)
+{
+	Entity entity;
+	if (!freeIndices.empty())
+	{
+		entity.Index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		entity.Index = (uint32_t)records.size();
+		records.push_back({ nullptr, 0, 0, 0 });
+	}
+
+	EntityRecord& record = records[entity.Index];
+	entity.Generation = record.Generation;
+	record.Owner = GetArchetype(mask);
+	record.Owner->AddRow(entity, record.Chunk, record.Row);
+
+	entityCount++;
+	structuralVersion++;
+	return entity;
+}
+
+void World::DestroyEntity(Entity entity)
+{
+	if (!IsAlive(entity))
+	{
+		return;
+	}
+
+	EntityRecord& record = records[entity.Index];
+	RemoveRow(record.Owner, record.Chunk, record.Row);
+
+	//New generation so any copies of this id go stale
+	record.Owner = nullptr;
+	record.Generation++;
+	freeIndices.push_back(entity.Index);
+
+	entityCount--;
+	structuralVersion++;
+}
+
+bool World::IsAlive(Entity entity)
+{
+	return entity.Index < records.size()
+		&& records[entity.Index].Generation == entity.Generation
+		&& records[entity.Index].Owner != nullptr;
+}
+
+Entity World::GetEntity(uint32_t index)
+{
+	Entity entity;
+	if (index < records.size() && records[index].Owner != nullptr)
+	{
+		entity.Index = index;
+		entity.Generation = records[index].Generation;
+	}
+	return entity;
+}
+
+/// <summary>
+/// Returns null if the entity is dead or doesn't have the component
+/// </summary>
+void* World::GetComponent(Entity entity, int componentId)
+{
+	if (!IsAlive(entity))
+	{
+		return nullptr;
+	}
+
+	EntityRecord& record = records[entity.Index];
+	if (!(record.Owner->GetMask() & (1ull << componentId)))
+	{
+		return nullptr;
+	}
+
+	return record.Owner->GetComponent(record.Chunk, record.Row, componentId);
+}
+
+void World::AddComponent(Entity entity, int componentId, const void* data)
+{
+	if (!IsAlive(entity))
+	{
+		return;
+	}
+
+	EntityRecord& record = records[entity.Index];
+	uint64_t mask = record.Owner->GetMask() | (1ull << componentId);
+	if (mask != record.Owner->GetMask())
+	{
+		MoveEntity(entity, GetArchetype(mask));
+	}
+
+	std::memcpy(GetComponent(entity, componentId), data, ComponentRegistry::GetInfo(componentId).Size);
+}
+
+void World::RemoveComponent(Entity entity, int componentId)
+{
+	if (!IsAlive(entity))
+	{
+		return;
+	}
+
+	EntityRecord& record = records[entity.Index];
+	uint64_t mask = record.Owner->GetMask() & ~(1ull << componentId);
+	if (mask != record.Owner->GetMask())
+	{
+		MoveEntity(entity, GetArchetype(mask));
+	}
+}
+
+Archetype* World::GetArchetype(uint64_t mask)
+{
+	auto found = archetypeLookup.find(mask);
+	if (found != archetypeLookup.end())
+	{
+		return found->second;
+	}
+
+	Archetype* archetype = new Archetype(mask, &chunkPool);
+	archetypeLookup.insert({ mask, archetype });
+	archetypes.push_back(archetype);
+
+	//Queries read these lists without checking for new archetypes, so they're kept complete here
+	for (auto& entry : matchingArchetypes)
+	{
+		if ((mask & entry.first) == entry.first)
+		{
+			entry.second.push_back(archetype);
+		}
+	}
+	return archetype;
+}
+
+/// <summary>
+/// The archetypes a query over the mask runs over, made on first use
+/// </summary>
+/// <returns>A list that stays put for as long as the world does, mapped values in the map never move</returns>
+const std::vector<Archetype*>& World::GetMatchingArchetypes(uint64_t mask)
+{
+	auto found = matchingArchetypes.find(mask);
+	if (found != matchingArchetypes.end())
+	{
+		return found->second;
+	}
+
+	std::vector<Archetype*>& matches = matchingArchetypes[mask];
+	for (Archetype* archetype : archetypes)
+	{
+		if ((archetype->GetMask() & mask) == mask)
+		{
+			matches.push_back(archetype);
+		}
+	}
+	return matches;
+}
+
+/// <summary>
+/// Copies every shared component into a new row of the destination archetype
+/// </summary>
+void World::MoveEntity(Entity entity, Archetype* destination)
+{
+	EntityRecord& record = records[entity.Index];
+	Archetype* source = record.Owner;
+
+	int chunk, row;
+	destination->AddRow(entity, chunk, row);
+	for (int id : source->GetComponentIds())
+	{
+		if (destination->GetMask() & (1ull << id))
+		{
+			std::memcpy(destination->GetComponent(chunk, row, id), source->GetComponent(record.Chunk, record.Row, id), ComponentRegistry::GetInfo(id).Size);
+		}
+	}
+
+	RemoveRow(source, record.Chunk, record.Row);
+
+	record.Owner = destination;
+	record.Chunk = chunk;
+	record.Row = row;
+	structuralVersion++;
+}
+
+void World::RemoveRow(Archetype* archetype, int chunk, int row)
+{
+	Entity moved = archetype->RemoveRow(chunk, row);
+	if (moved.Index != ECS_INVALID_INDEX)
+	{
+		records[moved.Index].Chunk = chunk;
+		records[moved.Index].Row = row;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ COMMAND BUFFER ------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::DestroyEntity(Entity entity)
+{
+	Command command = {};
+	command.Type = CommandType::Destroy;
+	command.Target = entity;
+	commands.push_back(command);
+}
+
+void CommandBuffer::Playback(World& world)
+{
+	for (const Command& command : commands)
+	{
+		switch (command.Type)
+		{
+		case CommandType::Create:
+		{
+			Entity entity = world.CreateEntity(command.Mask);
+			size_t offset = command.DataOffset;
+			for (int i = 0; i < command.ComponentCount; i++)
+			{
+				int header[2];
+				std::memcpy(header, &data[offset], sizeof(header));
+				offset += sizeof(header);
+				std::memcpy(world.GetComponent(entity, header[0]), &data[offset], header[1]);
+				offset += header[1];
+			}
+			break;
+		}
+		case CommandType::Destroy:
+			world.DestroyEntity(command.Target);
+			break;
+		case CommandType::Add:
+		{
+			int header[2];
+			std::memcpy(header, &data[command.DataOffset], sizeof(header));
+			world.AddComponent(command.Target, header[0], &data[command.DataOffset + sizeof(header)]);
+			break;
+		}
+		case CommandType::Remove:
+			world.RemoveComponent(command.Target, command.ComponentId);
+			break;
+		}
+	}
+
+	commands.clear();
+	data.clear();
+}
+
+void CommandBuffer::PushComponent(int componentId, const void* component, size_t size)
+{
+	int header[2] = { componentId, (int)size };
+	size_t offset = data.size();
+	data.resize(offset + sizeof(header) + size);
+	std::memcpy(&data[offset], header, sizeof(header));
+	std::memcpy(&data[offset + sizeof(header)], component, size);
+}
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Memory.h"
+
+#define ECS_CHUNK_SIZE 16384 //Bytes per chunk, every column of a chunk lives in here
+#define ECS_MAX_COMPONENTS 64 //Component sets are stored as 64 bit masks
+#define ECS_INVALID_INDEX 0xFFFFFFFFu
+
+// --------------------------------------------------------
+// An entity is just an index and a generation. The
+// generation changes every time an index is reused, so
+// stale ids can be detected.
+// --------------------------------------------------------
+struct Entity
+{
+	uint32_t Index = ECS_INVALID_INDEX;
+	uint32_t Generation = 0;
+
+	bool operator==(const Entity& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+struct ComponentInfo
+{
+	size_t Size;
+	size_t Alignment;
+};
+
+// --------------------------------------------------------
+// Hands out a small integer id per component type.
+// Components get moved around with memcpy, so they have
+// to be trivially copyable.
+// --------------------------------------------------------
+class ComponentRegistry
+{
+public:
+	template<typename T>
+	static int GetId()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Components are moved with memcpy, so they must be trivially copyable");
+		static const int id = Register(sizeof(T), alignof(T));
+		return id;
+	}
+
+	template<typename... Ts>
+	static uint64_t GetMask()
+	{
+		return (0ull | ... | (1ull << GetId<Ts>()));
+	}
+
+	static const ComponentInfo& GetInfo(int id);
+
+private:
+	static int Register(size_t size, size_t alignment);
+};
+
+// --------------------------------------------------------
+// A fixed size block holding the same rows of every column
+// --------------------------------------------------------
+struct ArchetypeChunk
+{
+	unsigned char* Data;
+	int Count;
+};
+
+// --------------------------------------------------------
+// Every entity with exactly the same set of components.
+// Each component is a contiguous column inside each chunk.
+// Only the last chunk is ever partly full.
+// --------------------------------------------------------
+class Archetype
+{
+public:
+	Archetype(uint64_t mask, PoolAllocator* chunkPool);
+	~Archetype();
+	Archetype(const Archetype&) = delete;
+	Archetype& operator=(const Archetype&) = delete;
+
+	uint64_t GetMask() { return mask; }
+	int GetChunkCapacity() { return chunkCapacity; }
+	int GetChunkCount() { return (int)chunks.size(); }
+	int GetChunkSize(int chunk) { return chunks[chunk].Count; }
+	const std::vector<int>& GetComponentIds() { return componentIds; }
+
+	Entity* GetEntities(int chunk) { return reinterpret_cast<Entity*>(chunks[chunk].Data); }
+	void* GetColumn(int chunk, int componentId) { return chunks[chunk].Data + columnOffsets[componentId]; }
+	void* GetComponent(int chunk, int row, int componentId) { return chunks[chunk].Data + columnOffsets[componentId] + row * ComponentRegistry::GetInfo(componentId).Size; }
+
+	//Row management, World keeps its records in sync with these
+	void AddRow(Entity entity, int& chunk, int& row);
+	Entity RemoveRow(int chunk, int row);
+
+private:
+	uint64_t mask;
+	PoolAllocator* chunkPool;
+	int chunkCapacity;
+	std::vector<int> componentIds;
+	size_t columnOffsets[ECS_MAX_COMPONENTS];
+	std::vector<ArchetypeChunk> chunks;
+};
+
+// --------------------------------------------------------
+// Owns every entity and archetype
+//
+// Structural changes (create, destroy, add or remove a
+// component) move rows around, so don't make them while a
+// query is running. Record them in a CommandBuffer instead.
+// --------------------------------------------------------
+class World
+{
+public:
+	World();
+	~World();
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	template<typename... Ts>
+	Entity CreateEntity(const Ts&... components)
+	{
+		Entity entity = CreateEntity(ComponentRegistry::GetMask<Ts...>());
+		(std::memcpy(GetComponent(entity, ComponentRegistry::GetId<Ts>()), &components, sizeof(Ts)), ...);
+		return entity;
+	}
+
+	template<typename T>
+	T* GetComponent(Entity entity)
+	{
+		return static_cast<T*>(GetComponent(entity, ComponentRegistry::GetId<T>()));
+	}
+
+	template<typename T>
+	bool HasComponent(Entity entity)
+	{
+		return GetComponent(entity, ComponentRegistry::GetId<T>()) != nullptr;
+	}
+
+	template<typename T>
+	void AddComponent(Entity entity, const T& component)
+	{
+		AddComponent(entity, ComponentRegistry::GetId<T>(), &component);
+	}
+
+	template<typename T>
+	void RemoveComponent(Entity entity)
+	{
+		RemoveComponent(entity, ComponentRegistry::GetId<T>());
+	}
+
+	//Type erased versions of the above
+	Entity CreateEntity(uint64_t mask);
+	void DestroyEntity(Entity entity);
+	bool IsAlive(Entity entity);
+	Entity GetEntity(uint32_t index); //The live entity using this index, or an invalid one
+	void* GetComponent(Entity entity, int componentId);
+	void AddComponent(Entity entity, int componentId, const void* data);
+	void RemoveComponent(Entity entity, int componentId);
+
+	int GetEntityCount() { return entityCount; }
+	uint32_t GetEntityCapacity() { return (uint32_t)records.size(); } //One past the highest index ever used
+	unsigned int GetStructuralVersion() { return structuralVersion; }
+	const std::vector<Archetype*>& GetArchetypes() { return archetypes; }
+
+	//Every archetype with all of the mask's components. The list is made the first time the mask is
+	//asked for and added to as archetypes are, so call this while nothing is iterating.
+	const std::vector<Archetype*>& GetMatchingArchetypes(uint64_t mask);
+
+private:
+	struct EntityRecord
+	{
+		Archetype* Owner;
+		int Chunk;
+		int Row;
+		uint32_t Generation;
+	};
+
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	std::unordered_map<uint64_t, Archetype*> archetypeLookup;
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<uint64_t, std::vector<Archetype*>> matchingArchetypes; //Keyed by query mask
+	int entityCount;
+
+	//Every archetype's chunks come from here, so freed chunks get reused
+	PoolAllocator chunkPool;
+
+	//Bumped on every change that can move a row
+	unsigned int structuralVersion;
+
+	Archetype* GetArchetype(uint64_t mask);
+	void MoveEntity(Entity entity, Archetype* destination);
+	void RemoveRow(Archetype* archetype, int chunk, int row);
+};
+
+// --------------------------------------------------------
+// Typed view over every archetype that has all of Ts.
+// The world keeps the list of matching archetypes up to
+// date as it makes new ones, so running a query only ever
+// reads, and any number of them can run at once. Create
+// queries while nothing is running, like any structural
+// change.
+// --------------------------------------------------------
+template<typename... Ts>
+class Query
+{
+public:
+	Query(World* world) : matches(&world->GetMatchingArchetypes(ComponentRegistry::GetMask<Ts...>())) {}
+
+	// --------------------------------------------------------
+	// function(int count, Entity* entities, Ts*... columns)
+	// Columns are plain arrays, so loops over them vectorize.
+	// --------------------------------------------------------
+	template<typename Function>
+	void ForEachChunk(Function function)
+	{
+		for (Archetype* archetype : *matches)
+		{
+			for (int chunk = 0; chunk < archetype->GetChunkCount(); chunk++)
+			{
+				RunChunk(archetype, chunk, function);
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// function(Entity entity, Ts&... components)
+	// --------------------------------------------------------
+	template<typename Function>
+	void ForEach(Function function)
+	{
+		ForEachChunk([&function](int count, Entity* entities, Ts*... columns)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					function(entities[i], columns[i]...);
+				}
+			});
+	}
+
+	// --------------------------------------------------------
+	// Same as ForEachChunk, with chunks spread across workers.
+	// Every archetype's chunks go out under one counter, so
+	// the archetypes run alongside each other too.
+	// --------------------------------------------------------
+	template<typename Function>
+	void ParallelForEachChunk(JobSystem& jobSystem, Function function)
+	{
+		JobCounter counter;
+		for (Archetype* archetype : *matches)
+		{
+			jobSystem.ParallelFor(archetype->GetChunkCount(), [archetype, &function](int start, int end)
+				{
+					for (int chunk = start; chunk < end; chunk++)
+					{
+						RunChunk(archetype, chunk, function);
+					}
+				}, &counter);
+		}
+		jobSystem.Wait(&counter);
+	}
+
+	int Count()
+	{
+		int count = 0;
+		for (Archetype* archetype : *matches)
+		{
+			for (int chunk = 0; chunk < archetype->GetChunkCount(); chunk++)
+			{
+				count += archetype->GetChunkSize(chunk);
+			}
+		}
+		return count;
+	}
+
+private:
+	//Owned by the world, which only adds to it during structural changes
+	const std::vector<Archetype*>* matches;
+
+	template<typename Function>
+	static void RunChunk(Archetype* archetype, int chunk, Function& function)
+	{
+		function(
+			archetype->GetChunkSize(chunk),
+			archetype->GetEntities(chunk),
+			static_cast<Ts*>(archetype->GetColumn(chunk, ComponentRegistry::GetId<Ts>()))...);
+	}
+};
+
+// --------------------------------------------------------
+// Records structural changes so they can be applied later,
+// at a point where nothing is iterating. Use one buffer per
+// thread when recording from jobs.
+// --------------------------------------------------------
+class CommandBuffer
+{
+public:
+	template<typename... Ts>
+	void CreateEntity(const Ts&... components)
+	{
+		Command command = {};
+		command.Type = CommandType::Create;
+		command.Mask = ComponentRegistry::GetMask<Ts...>();
+		command.DataOffset = data.size();
+		command.ComponentCount = (int)sizeof...(Ts);
+		(PushComponent(ComponentRegistry::GetId<Ts>(), &components, sizeof(Ts)), ...);
+		commands.push_back(command);
+	}
+
+	void DestroyEntity(Entity entity);
+
+	template<typename T>
+	void AddComponent(Entity entity, const T& component)
+	{
+		Command command = {};
+		command.Type = CommandType::Add;
+		command.Target = entity;
+		command.DataOffset = data.size();
+		command.ComponentCount = 1;
+		PushComponent(ComponentRegistry::GetId<T>(), &component, sizeof(T));
+		commands.push_back(command);
+	}
+
+	template<typename T>
+	void RemoveComponent(Entity entity)
+	{
+		Command command = {};
+		command.Type = CommandType::Remove;
+		command.Target = entity;
+		command.ComponentId = ComponentRegistry::GetId<T>();
+		commands.push_back(command);
+	}
+
+	//Calls function(entity) for every queued destroy. Done before Playback, everything
+	//being destroyed is still where it was.
+	template<typename Function>
+	void ForEachDestroy(Function function)
+	{
+		for (const Command& command : commands)
+		{
+			if (command.Type == CommandType::Destroy)
+			{
+				function(command.Target);
+			}
+		}
+	}
+
+	//Applies everything in order, then empties the buffer
+	void Playback(World& world);
+	bool IsEmpty() { return commands.empty(); }
+
+private:
+	enum class CommandType { Create, Destroy, Add, Remove };
+
+	struct Command
+	{
+		CommandType Type;
+		Entity Target;
+		uint64_t Mask;
+		int ComponentId;
+		int ComponentCount;
+		size_t DataOffset;
+	};
+
+	std::vector<Command> commands;
+
+	//Component payloads stored as [int id][int size][bytes...] back to back
+	std::vector<unsigned char> data;
+
+	void PushComponent(int componentId, const void* component, size_t size);
+};
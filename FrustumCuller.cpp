@@ -0,0 +1,608 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+using namespace Simd;
+
+namespace
+{
+	//One frustum plane broadcast across every lane, with the absolute normal ready for the box radius
+	struct CullPlane
+	{
+		Float8 X, Y, Z, W;
+		Float8 AbsX, AbsY, AbsZ;
+	};
+
+	//How far each box reaches past the plane onto its inside, negative when it's wholly outside
+	inline Float8 PlaneReach(const CullPlane& plane, Float8 cx, Float8 cy, Float8 cz, Float8 ex, Float8 ey, Float8 ez)
+	{
+		Float8 distance = Add(Add(Mul(plane.X, cx), Mul(plane.Y, cy)), Add(Mul(plane.Z, cz), plane.W));
+		Float8 radius = Add(Add(Mul(plane.AbsX, ex), Mul(plane.AbsY, ey)), Mul(plane.AbsZ, ez));
+		return Add(distance, radius);
+	}
+
+	//Lanes whose box is at least partly on the inside of the plane
+	inline Float8 InsidePlane(const CullPlane& plane, Float8 cx, Float8 cy, Float8 cz, Float8 ex, Float8 ey, Float8 ez)
+	{
+		return AtLeastZero(PlaneReach(plane, cx, cy, cz, ex, ey, ez));
+	}
+
+	void LoadPlanes(const DirectX::XMFLOAT4* source, int count, CullPlane* planes)
+	{
+		for (int p = 0; p < count; p++)
+		{
+			const DirectX::XMFLOAT4& plane = source[p];
+			planes[p].X = Splat(plane.x);
+			planes[p].Y = Splat(plane.y);
+			planes[p].Z = Splat(plane.z);
+			planes[p].W = Splat(plane.w);
+			planes[p].AbsX = Splat(plane.x < 0 ? -plane.x : plane.x);
+			planes[p].AbsY = Splat(plane.y < 0 ? -plane.y : plane.y);
+			planes[p].AbsZ = Splat(plane.z < 0 ? -plane.z : plane.z);
+		}
+	}
+
+	void LoadPlanes(const Frustum& frustum, CullPlane* planes)
+	{
+		LoadPlanes(frustum.Planes, 6, planes);
+	}
+
+	//CullMargins broadcast across every lane
+	struct MarginLanes
+	{
+		Float8 EyeX, EyeY, EyeZ;
+		Float8 NormalDrift, OffsetDrift;
+	};
+
+	MarginLanes LoadMargins(const CullMargins& margins)
+	{
+		return { Splat(margins.Eye.x), Splat(margins.Eye.y), Splat(margins.Eye.z), Splat(margins.NormalDrift), Splat(margins.OffsetDrift) };
+	}
+
+	//A box is visible when it reaches onto the inside of every plane, like in CullBlocks. Moving a
+	//plane changes that reach by at most NormalDrift * (distance from Eye to the center + extent length)
+	//+ OffsetDrift, so boxes whose smallest reach is further than that from zero keep their answer and
+	//everything else is on the boundary. Empty slots are NaN all the way through, so they come out as neither.
+	inline void ClassifyLanes(const CullPlane* planes, const MarginLanes& margins, Float8 cx, Float8 cy, Float8 cz, Float8 ex, Float8 ey, Float8 ez, unsigned int& visibleMask, unsigned int& boundaryMask)
+	{
+		Float8 inside = AllSet();
+		Float8 nearest = Splat(std::numeric_limits<float>::infinity());
+		for (int p = 0; p < 6; p++)
+		{
+			Float8 reach = PlaneReach(planes[p], cx, cy, cz, ex, ey, ez);
+			inside = And(inside, AtLeastZero(reach));
+			nearest = Min(nearest, reach);
+		}
+
+		Float8 dx = Sub(cx, margins.EyeX);
+		Float8 dy = Sub(cy, margins.EyeY);
+		Float8 dz = Sub(cz, margins.EyeZ);
+		Float8 distance = Sqrt(Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz)));
+		Float8 size = Sqrt(Add(Add(Mul(ex, ex), Mul(ey, ey)), Mul(ez, ez)));
+		Float8 margin = Add(Mul(margins.NormalDrift, Add(distance, size)), margins.OffsetDrift);
+
+		visibleMask = Mask(inside);
+		boundaryMask = Mask(AtLeastZero(Sub(margin, Abs(nearest))));
+	}
+}
+
+FrustumCuller::FrustumCuller() :
+	capacity(0),
+	visibleCount(0),
+	viewVisibleCount{},
+	lastFrustum{},
+	boundsChanged(true),
+	lastReused(false),
+	lastEarlyOuts(0)
+{
+}
+
+void FrustumCuller::Resize(int newCapacity)
+{
+	int padded = (newCapacity + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE * CULL_BLOCK_SIZE;
+	float empty = std::numeric_limits<float>::quiet_NaN();
+
+	centerX.resize(padded, empty);
+	centerY.resize(padded, empty);
+	centerZ.resize(padded, empty);
+	extentX.resize(padded, 0.0f);
+	extentY.resize(padded, 0.0f);
+	extentZ.resize(padded, 0.0f);
+	rejectPlane.resize(padded / CULL_BLOCK_SIZE, CULL_NO_PLANE);
+	visible.resize(padded);
+
+	//Shrinking can leave old boxes in the padding of the last block
+	for (int slot = newCapacity; slot < padded; slot++)
+	{
+		centerX[slot] = empty;
+		centerY[slot] = empty;
+		centerZ[slot] = empty;
+	}
+
+	capacity = newCapacity;
+	boundsChanged = true;
+}
+
+void FrustumCuller::SetBounds(uint32_t slot, const AABB& box)
+{
+	centerX[slot] = box.Center.x;
+	centerY[slot] = box.Center.y;
+	centerZ[slot] = box.Center.z;
+	extentX[slot] = box.Extents.x;
+	extentY[slot] = box.Extents.y;
+	extentZ[slot] = box.Extents.z;
+	boundsChanged = true;
+}
+
+void FrustumCuller::ClearBounds(uint32_t slot)
+{
+	float empty = std::numeric_limits<float>::quiet_NaN();
+	centerX[slot] = empty;
+	centerY[slot] = empty;
+	centerZ[slot] = empty;
+	boundsChanged = true;
+}
+
+void FrustumCuller::ClearAll()
+{
+	float empty = std::numeric_limits<float>::quiet_NaN();
+	std::fill(centerX.begin(), centerX.end(), empty);
+	std::fill(centerY.begin(), centerY.end(), empty);
+	std::fill(centerZ.begin(), centerZ.end(), empty);
+	std::fill(rejectPlane.begin(), rejectPlane.end(), (uint8_t)CULL_NO_PLANE);
+	std::fill(viewRejectPlane.begin(), viewRejectPlane.end(), (uint8_t)CULL_NO_PLANE);
+	visibleCount = 0;
+	boundsChanged = true;
+}
+
+/// <summary>
+/// Tests every slot against the frustum. Big arrays are split into runs of CULL_JOB_BLOCKS
+/// blocks across the workers, each writing its own part of the list, then the gaps are closed.
+/// </summary>
+/// <returns>How many slots are visible</returns>
+int FrustumCuller::Cull(const Frustum& frustum, JobSystem* jobSystem)
+{
+	lastReused = !boundsChanged && std::memcmp(&frustum, &lastFrustum, sizeof(Frustum)) == 0;
+	if (lastReused)
+	{
+		lastEarlyOuts = 0;
+		return visibleCount;
+	}
+
+	int blockCount = (int)rejectPlane.size();
+	if (!jobSystem || blockCount < CULL_PARALLEL_MIN_BLOCKS)
+	{
+		visibleCount = CullBlocks(frustum, 0, blockCount, visible.data(), lastEarlyOuts);
+	}
+	else
+	{
+		int jobCount = (blockCount + CULL_JOB_BLOCKS - 1) / CULL_JOB_BLOCKS;
+		jobCounts.resize(jobCount);
+		jobEarlyOuts.resize(jobCount);
+
+		JobCounter counter;
+		jobSystem->ParallelFor(jobCount, [this, &frustum, blockCount](int start, int end)
+			{
+				for (int job = start; job < end; job++)
+				{
+					int firstBlock = job * CULL_JOB_BLOCKS;
+					int endBlock = std::min(firstBlock + CULL_JOB_BLOCKS, blockCount);
+					jobCounts[job] = CullBlocks(frustum, firstBlock, endBlock, visible.data() + firstBlock * CULL_BLOCK_SIZE, jobEarlyOuts[job]);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+
+		visibleCount = 0;
+		lastEarlyOuts = 0;
+		for (int job = 0; job < jobCount; job++)
+		{
+			const uint32_t* run = visible.data() + job * CULL_JOB_BLOCKS * CULL_BLOCK_SIZE;
+			if (run != visible.data() + visibleCount)
+			{
+				std::memmove(visible.data() + visibleCount, run, jobCounts[job] * sizeof(uint32_t));
+			}
+			visibleCount += jobCounts[job];
+			lastEarlyOuts += jobEarlyOuts[job];
+		}
+	}
+
+	lastFrustum = frustum;
+	boundsChanged = false;
+	return visibleCount;
+}
+
+/// <summary>
+/// Tests every slot against all the views, split across the workers like Cull. Each job writes its own
+/// run of every view's list, then the gaps are closed one view at a time.
+/// </summary>
+void FrustumCuller::CullViews(const Frustum* frusta, int viewCount, JobSystem* jobSystem)
+{
+	int blockCount = (int)rejectPlane.size();
+	viewMasks.resize(centerX.size());
+	viewRejectPlane.resize(rejectPlane.size() * CULL_MAX_VIEWS, CULL_NO_PLANE);
+	for (int view = 0; view < viewCount; view++)
+	{
+		viewVisible[view].resize(centerX.size());
+	}
+
+	int jobCount = (blockCount + CULL_JOB_BLOCKS - 1) / CULL_JOB_BLOCKS;
+	jobViewCounts.assign(jobCount * CULL_MAX_VIEWS, 0);
+	if (!jobSystem || blockCount < CULL_PARALLEL_MIN_BLOCKS)
+	{
+		for (int job = 0; job < jobCount; job++)
+		{
+			int firstBlock = job * CULL_JOB_BLOCKS;
+			CullViewBlocks(frusta, viewCount, firstBlock, std::min(firstBlock + CULL_JOB_BLOCKS, blockCount), jobViewCounts.data() + job * CULL_MAX_VIEWS);
+		}
+	}
+	else
+	{
+		JobCounter counter;
+		jobSystem->ParallelFor(jobCount, [this, frusta, viewCount, blockCount](int start, int end)
+			{
+				for (int job = start; job < end; job++)
+				{
+					int firstBlock = job * CULL_JOB_BLOCKS;
+					CullViewBlocks(frusta, viewCount, firstBlock, std::min(firstBlock + CULL_JOB_BLOCKS, blockCount), jobViewCounts.data() + job * CULL_MAX_VIEWS);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+	}
+
+	for (int view = 0; view < CULL_MAX_VIEWS; view++)
+	{
+		viewVisibleCount[view] = 0;
+		if (view >= viewCount)
+		{
+			continue;
+		}
+
+		uint32_t* list = viewVisible[view].data();
+		for (int job = 0; job < jobCount; job++)
+		{
+			int count = jobViewCounts[job * CULL_MAX_VIEWS + view];
+			const uint32_t* run = list + job * CULL_JOB_BLOCKS * CULL_BLOCK_SIZE;
+			if (run != list + viewVisibleCount[view])
+			{
+				std::memmove(list + viewVisibleCount[view], run, count * sizeof(uint32_t));
+			}
+			viewVisibleCount[view] += count;
+		}
+	}
+}
+
+/// <summary>
+/// The multi view kernel. A block's bounds are loaded once and stay in registers for every view.
+/// Each view remembers the plane that last threw the block out, the same as CullBlocks does.
+/// </summary>
+void FrustumCuller::CullViewBlocks(const Frustum* frusta, int viewCount, int firstBlock, int endBlock, int* counts)
+{
+	CullPlane planes[CULL_MAX_VIEWS][6];
+	for (int view = 0; view < viewCount; view++)
+	{
+		LoadPlanes(frusta[view], planes[view]);
+	}
+
+	uint32_t* outputs[CULL_MAX_VIEWS];
+	for (int view = 0; view < viewCount; view++)
+	{
+		outputs[view] = viewVisible[view].data() + firstBlock * CULL_BLOCK_SIZE;
+	}
+
+	for (int block = firstBlock; block < endBlock; block++)
+	{
+		int first = block * CULL_BLOCK_SIZE;
+		Float8 cx = Load(centerX.data() + first);
+		Float8 cy = Load(centerY.data() + first);
+		Float8 cz = Load(centerZ.data() + first);
+		Float8 ex = Load(extentX.data() + first);
+		Float8 ey = Load(extentY.data() + first);
+		Float8 ez = Load(extentZ.data() + first);
+
+		uint8_t laneMasks[CULL_BLOCK_SIZE] = {};
+		for (int view = 0; view < viewCount; view++)
+		{
+			uint8_t& remembered = viewRejectPlane[block * CULL_MAX_VIEWS + view];
+			Float8 inside = AllSet();
+			if (remembered != CULL_NO_PLANE)
+			{
+				inside = InsidePlane(planes[view][remembered], cx, cy, cz, ex, ey, ez);
+			}
+
+			unsigned int mask = Mask(inside);
+			for (int p = 0; p < 6 && mask; p++)
+			{
+				if (p == remembered)
+				{
+					continue;
+				}
+
+				inside = And(inside, InsidePlane(planes[view][p], cx, cy, cz, ex, ey, ez));
+				mask = Mask(inside);
+				if (!mask)
+				{
+					remembered = (uint8_t)p;
+				}
+			}
+
+			while (mask)
+			{
+				int lane = std::countr_zero(mask);
+				laneMasks[lane] |= (uint8_t)(1u << view);
+				outputs[view][counts[view]++] = (uint32_t)(first + lane);
+				mask &= mask - 1;
+			}
+		}
+		std::memcpy(viewMasks.data() + first, laneMasks, CULL_BLOCK_SIZE);
+	}
+}
+
+/// <summary>
+/// The kernel: one block of 8 boxes per iteration, planes tested until every lane is out
+/// </summary>
+/// <returns>How many slots were written to output</returns>
+int FrustumCuller::CullBlocks(const Frustum& frustum, int firstBlock, int endBlock, uint32_t* output, int& earlyOuts)
+{
+	CullPlane planes[6];
+	LoadPlanes(frustum, planes);
+
+	int count = 0;
+	earlyOuts = 0;
+	for (int block = firstBlock; block < endBlock; block++)
+	{
+		int first = block * CULL_BLOCK_SIZE;
+		Float8 cx = Load(centerX.data() + first);
+		Float8 cy = Load(centerY.data() + first);
+		Float8 cz = Load(centerZ.data() + first);
+		Float8 ex = Load(extentX.data() + first);
+		Float8 ey = Load(extentY.data() + first);
+		Float8 ez = Load(extentZ.data() + first);
+
+		//Whatever plane threw this block out last time usually still does
+		uint8_t& remembered = rejectPlane[block];
+		Float8 inside = AllSet();
+		if (remembered != CULL_NO_PLANE)
+		{
+			inside = InsidePlane(planes[remembered], cx, cy, cz, ex, ey, ez);
+			if (Mask(inside) == 0)
+			{
+				earlyOuts++;
+				continue;
+			}
+		}
+
+		unsigned int mask = Mask(inside);
+		for (int p = 0; p < 6 && mask; p++)
+		{
+			if (p == remembered)
+			{
+				continue;
+			}
+
+			inside = And(inside, InsidePlane(planes[p], cx, cy, cz, ex, ey, ez));
+			mask = Mask(inside);
+			if (!mask)
+			{
+				remembered = (uint8_t)p;
+			}
+		}
+
+		//Compact the surviving lanes into the list
+		while (mask)
+		{
+			output[count++] = (uint32_t)(first + std::countr_zero(mask));
+			mask &= mask - 1;
+		}
+	}
+	return count;
+}
+
+/// <summary>
+/// Classifies every slot, split across the workers the same way Cull is. Each job writes its own range of states.
+/// </summary>
+void FrustumCuller::Classify(const Frustum& frustum, const CullMargins& margins, uint8_t* states, JobSystem* jobSystem)
+{
+	int blockCount = (int)rejectPlane.size();
+	if (!jobSystem || blockCount < CULL_PARALLEL_MIN_BLOCKS)
+	{
+		ClassifyBlocks(frustum, margins, 0, blockCount, states);
+		return;
+	}
+
+	int jobCount = (blockCount + CULL_JOB_BLOCKS - 1) / CULL_JOB_BLOCKS;
+	JobCounter counter;
+	jobSystem->ParallelFor(jobCount, [this, &frustum, &margins, states, blockCount](int start, int end)
+		{
+			for (int job = start; job < end; job++)
+			{
+				int firstBlock = job * CULL_JOB_BLOCKS;
+				ClassifyBlocks(frustum, margins, firstBlock, std::min(firstBlock + CULL_JOB_BLOCKS, blockCount), states + firstBlock * CULL_BLOCK_SIZE);
+			}
+		}, &counter);
+	jobSystem->Wait(&counter);
+}
+
+/// <summary>
+/// Classify for a scattered list of slots. Eight at a time are gathered into one block, and every
+/// lane does exactly the same arithmetic wherever it came from, so the answers match Classify's.
+/// </summary>
+void FrustumCuller::ClassifySlots(const Frustum& frustum, const CullMargins& margins, const uint32_t* slots, int count, uint8_t* states)
+{
+	CullPlane planes[6];
+	LoadPlanes(frustum, planes);
+	MarginLanes marginLanes = LoadMargins(margins);
+
+	float lanes[6][CULL_BLOCK_SIZE];
+	for (int first = 0; first < count; first += CULL_BLOCK_SIZE)
+	{
+		int laneCount = std::min(count - first, CULL_BLOCK_SIZE);
+		GatherBounds(slots + first, laneCount, lanes);
+
+		unsigned int visibleMask;
+		unsigned int boundaryMask;
+		ClassifyLanes(planes, marginLanes, Load(lanes[0]), Load(lanes[1]), Load(lanes[2]), Load(lanes[3]), Load(lanes[4]), Load(lanes[5]), visibleMask, boundaryMask);
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			uint8_t& state = states[slots[first + lane]];
+			state = (uint8_t)((state & ~(CULL_STATE_VISIBLE | CULL_STATE_BOUNDARY)) | ((visibleMask >> lane) & 1) * CULL_STATE_VISIBLE | ((boundaryMask >> lane) & 1) * CULL_STATE_BOUNDARY);
+		}
+	}
+}
+
+/// <summary>
+/// The plain frustum test for a scattered list of slots, gathered like ClassifySlots.
+/// Only the visible bit of each state changes.
+/// </summary>
+void FrustumCuller::TestSlots(const Frustum& frustum, const uint32_t* slots, int count, uint8_t* states)
+{
+	CullPlane planes[6];
+	LoadPlanes(frustum, planes);
+
+	float lanes[6][CULL_BLOCK_SIZE];
+	for (int first = 0; first < count; first += CULL_BLOCK_SIZE)
+	{
+		int laneCount = std::min(count - first, CULL_BLOCK_SIZE);
+		GatherBounds(slots + first, laneCount, lanes);
+
+		Float8 cx = Load(lanes[0]);
+		Float8 cy = Load(lanes[1]);
+		Float8 cz = Load(lanes[2]);
+		Float8 ex = Load(lanes[3]);
+		Float8 ey = Load(lanes[4]);
+		Float8 ez = Load(lanes[5]);
+		Float8 inside = AllSet();
+		for (int p = 0; p < 6; p++)
+		{
+			inside = And(inside, InsidePlane(planes[p], cx, cy, cz, ex, ey, ez));
+		}
+
+		unsigned int mask = Mask(inside);
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			uint8_t& state = states[slots[first + lane]];
+			state = (mask >> lane) & 1 ? (uint8_t)(state | CULL_STATE_VISIBLE) : (uint8_t)(state & ~CULL_STATE_VISIBLE);
+		}
+	}
+}
+
+/// <summary>
+/// The classify kernel over whole blocks, output starts at firstBlock
+/// </summary>
+void FrustumCuller::ClassifyBlocks(const Frustum& frustum, const CullMargins& margins, int firstBlock, int endBlock, uint8_t* states)
+{
+	CullPlane planes[6];
+	LoadPlanes(frustum, planes);
+	MarginLanes marginLanes = LoadMargins(margins);
+
+	for (int block = firstBlock; block < endBlock; block++)
+	{
+		int first = block * CULL_BLOCK_SIZE;
+		unsigned int visibleMask;
+		unsigned int boundaryMask;
+		ClassifyLanes(planes, marginLanes,
+			Load(centerX.data() + first), Load(centerY.data() + first), Load(centerZ.data() + first),
+			Load(extentX.data() + first), Load(extentY.data() + first), Load(extentZ.data() + first),
+			visibleMask, boundaryMask);
+
+		uint8_t* output = states + (first - firstBlock * CULL_BLOCK_SIZE);
+		for (int lane = 0; lane < CULL_BLOCK_SIZE; lane++)
+		{
+			output[lane] = (uint8_t)(((visibleMask >> lane) & 1) * CULL_STATE_VISIBLE | ((boundaryMask >> lane) & 1) * CULL_STATE_BOUNDARY);
+		}
+	}
+}
+
+/// <summary>
+/// Like CullViews, but the volumes can have any number of planes and the result is only the masks
+/// </summary>
+void FrustumCuller::CullVolumes(const CullVolume* volumes, int volumeCount, uint8_t* masks, JobSystem* jobSystem)
+{
+	int blockCount = (int)rejectPlane.size();
+	int jobCount = (blockCount + CULL_JOB_BLOCKS - 1) / CULL_JOB_BLOCKS;
+	if (!jobSystem || blockCount < CULL_PARALLEL_MIN_BLOCKS)
+	{
+		CullVolumeBlocks(volumes, volumeCount, 0, blockCount, masks);
+		return;
+	}
+
+	JobCounter counter;
+	jobSystem->ParallelFor(jobCount, [this, volumes, volumeCount, blockCount, masks](int start, int end)
+		{
+			CullVolumeBlocks(volumes, volumeCount, start * CULL_JOB_BLOCKS, std::min(end * CULL_JOB_BLOCKS, blockCount), masks);
+		}, &counter);
+	jobSystem->Wait(&counter);
+}
+
+/// <summary>
+/// The volume kernel over whole blocks, masks are indexed by slot. A volume stops being tested
+/// against a block as soon as every box in it is outside one of its planes.
+/// </summary>
+void FrustumCuller::CullVolumeBlocks(const CullVolume* volumes, int volumeCount, int firstBlock, int endBlock, uint8_t* masks)
+{
+	CullPlane planes[CULL_MAX_VIEWS][CULL_MAX_VOLUME_PLANES];
+	for (int volume = 0; volume < volumeCount; volume++)
+	{
+		LoadPlanes(volumes[volume].Planes, std::min(volumes[volume].PlaneCount, CULL_MAX_VOLUME_PLANES), planes[volume]);
+	}
+
+	for (int block = firstBlock; block < endBlock; block++)
+	{
+		int first = block * CULL_BLOCK_SIZE;
+		Float8 cx = Load(centerX.data() + first);
+		Float8 cy = Load(centerY.data() + first);
+		Float8 cz = Load(centerZ.data() + first);
+		Float8 ex = Load(extentX.data() + first);
+		Float8 ey = Load(extentY.data() + first);
+		Float8 ez = Load(extentZ.data() + first);
+
+		uint8_t laneMasks[CULL_BLOCK_SIZE] = {};
+		for (int volume = 0; volume < volumeCount; volume++)
+		{
+			int planeCount = std::min(volumes[volume].PlaneCount, CULL_MAX_VOLUME_PLANES);
+			Float8 inside = AllSet();
+			unsigned int mask = Mask(inside);
+			for (int p = 0; p < planeCount && mask; p++)
+			{
+				inside = And(inside, InsidePlane(planes[volume][p], cx, cy, cz, ex, ey, ez));
+				mask = Mask(inside);
+			}
+
+			while (mask)
+			{
+				int lane = std::countr_zero(mask);
+				laneMasks[lane] |= (uint8_t)(1 << volume);
+				mask &= mask - 1;
+			}
+		}
+		std::memcpy(masks + first, laneMasks, CULL_BLOCK_SIZE);
+	}
+}
+
+/// <summary>
+/// Copies up to one block's worth of scattered slots into lanes, padding the rest with empty boxes
+/// </summary>
+void FrustumCuller::GatherBounds(const uint32_t* slots, int count, float lanes[6][CULL_BLOCK_SIZE])
+{
+	float empty = std::numeric_limits<float>::quiet_NaN();
+	for (int lane = 0; lane < CULL_BLOCK_SIZE; lane++)
+	{
+		if (lane < count)
+		{
+			uint32_t slot = slots[lane];
+			lanes[0][lane] = centerX[slot];
+			lanes[1][lane] = centerY[slot];
+			lanes[2][lane] = centerZ[slot];
+			lanes[3][lane] = extentX[slot];
+			lanes[4][lane] = extentY[slot];
+			lanes[5][lane] = extentZ[slot];
+		}
+		else
+		{
+			lanes[0][lane] = lanes[1][lane] = lanes[2][lane] = empty;
+			lanes[3][lane] = lanes[4][lane] = lanes[5][lane] = 0.0f;
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+#include "Simd.h"
+
+#define CULL_BLOCK_SIZE SIMD_WIDTH //Objects tested together, one per SIMD lane
+#define CULL_NO_PLANE 0xFF
+#define CULL_JOB_BLOCKS 512 //Blocks per parallel job, each job writes its own run of the output
+#define CULL_PARALLEL_MIN_BLOCKS 2048 //Below this one thread is quicker than waking the workers
+
+#define CULL_MAX_VIEWS 8 //Frusta CullViews tests together, one bit each in a byte
+#define CULL_MAX_VOLUME_PLANES 20 //Planes a CullVolume can have
+
+#define CULL_STATE_VISIBLE 0x1 //Touches the frustum
+#define CULL_STATE_BOUNDARY 0x2 //Close enough to a plane that a frustum within the margins could say otherwise
+
+//How far a later frustum may drift from the one a slot was classified against, see Classify
+struct CullMargins
+{
+	DirectX::XMFLOAT3 Eye; //Point the drift is measured around, the camera position works best
+	float NormalDrift; //Largest change in any plane normal, roughly the turn in radians
+	float OffsetDrift; //Largest change in any plane's distance from Eye, roughly the distance moved
+};
+
+//Any convex volume as inward facing planes, like a Frustum's but as many as it needs
+struct CullVolume
+{
+	const DirectX::XMFLOAT4* Planes;
+	int PlaneCount;
+};
+
+// --------------------------------------------------------
+// Frustum culling over flat arrays of world space boxes
+//
+// Boxes live in structure of arrays form (all the center
+// x's together, all the center y's...) so eight of them
+// load straight into SIMD registers and get tested against
+// a plane at once. Slots are whatever ids the caller likes,
+// usually entity indices, and empty slots hold NaN so they
+// fail every plane without a branch.
+//
+// Two kinds of coherency keep repeat frames cheap:
+//  - Every block of 8 remembers the plane that last threw
+//    the whole block out and tries it first, which is right
+//    almost every time while the camera moves smoothly
+//  - If neither the frustum nor any box changed since the
+//    last Cull, the old visible list is handed back as is
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	//Slots past the old capacity start out empty
+	void Resize(int capacity);
+	void SetBounds(uint32_t slot, const AABB& box);
+	void ClearBounds(uint32_t slot);
+	void ClearAll();
+
+	//Fills the visible list with the slots that touch the frustum, in slot order
+	int Cull(const Frustum& frustum, JobSystem* jobSystem = nullptr);
+
+	//Tests every slot against up to CULL_MAX_VIEWS frusta while its bounds are loaded once. Fills a
+	//mask per slot with a bit for every view that sees it, and a visible list per view, in slot order.
+	void CullViews(const Frustum* frusta, int viewCount, JobSystem* jobSystem = nullptr);
+
+	//Tests every slot against up to CULL_MAX_VIEWS convex volumes, writing a byte per slot (GetSlotCount of them)
+	//with a bit for every volume it touches. Leaves the other culls' results alone, so it can run after them.
+	void CullVolumes(const CullVolume* volumes, int volumeCount, uint8_t* masks, JobSystem* jobSystem = nullptr);
+
+	//Writes CULL_STATE_* bits for all GetSlotCount slots. Slots without the boundary bit are
+	//guaranteed to get the same answer from any frustum whose planes stay within the margins.
+	void Classify(const Frustum& frustum, const CullMargins& margins, uint8_t* states, JobSystem* jobSystem = nullptr);
+
+	//The same for a list of slots, updating states[slot] for each. Bits other than CULL_STATE_* are left alone.
+	void ClassifySlots(const Frustum& frustum, const CullMargins& margins, const uint32_t* slots, int count, uint8_t* states);
+	void TestSlots(const Frustum& frustum, const uint32_t* slots, int count, uint8_t* states); //Only updates CULL_STATE_VISIBLE
+
+	//Copies up to a block's worth of boxes into lanes: center x, y, z then extent x, y, z. Missing lanes are empty.
+	void GatherBounds(const uint32_t* slots, int count, float lanes[6][CULL_BLOCK_SIZE]);
+
+	//Getters
+	const uint32_t* GetVisible() { return visible.data(); }
+	int GetVisibleCount() { return visibleCount; }
+	int GetCapacity() { return capacity; }
+	int GetSlotCount() { return (int)centerX.size(); } //Capacity padded to whole blocks
+	bool WasReused() { return lastReused; } //True if the last Cull skipped all work
+	int GetLastEarlyOuts() { return lastEarlyOuts; } //Blocks the remembered plane threw out on its own
+	const uint8_t* GetViewMasks() { return viewMasks.data(); }
+	const uint32_t* GetViewVisible(int view) { return viewVisible[view].data(); }
+	int GetViewVisibleCount(int view) { return viewVisibleCount[view]; }
+
+private:
+	int capacity;
+
+	//Padded to a whole number of blocks
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<uint8_t> rejectPlane; //Per block
+
+	//One slot per box so parallel jobs never share space, compacted afterwards
+	std::vector<uint32_t> visible;
+	int visibleCount;
+	std::vector<int> jobCounts;
+	std::vector<int> jobEarlyOuts;
+
+	//CullViews output
+	std::vector<uint8_t> viewMasks;
+	std::vector<uint8_t> viewRejectPlane; //Per block and view, like rejectPlane
+	std::vector<uint32_t> viewVisible[CULL_MAX_VIEWS];
+	int viewVisibleCount[CULL_MAX_VIEWS];
+	std::vector<int> jobViewCounts;
+
+	Frustum lastFrustum;
+	bool boundsChanged;
+	bool lastReused;
+	int lastEarlyOuts;
+
+	int CullBlocks(const Frustum& frustum, int firstBlock, int endBlock, uint32_t* output, int& earlyOuts);
+	void CullViewBlocks(const Frustum* frusta, int viewCount, int firstBlock, int endBlock, int* counts);
+	void CullVolumeBlocks(const CullVolume* volumes, int volumeCount, int firstBlock, int endBlock, uint8_t* masks);
+	void ClassifyBlocks(const Frustum& frustum, const CullMargins& margins, int firstBlock, int endBlock, uint8_t* states);
+};
@@ -9,6 +9,11 @@
 #include "ImGui/imgui_impl_win32.h"
 
 #include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -21,7 +26,7 @@ using namespace DirectX;
 // Called once per program, after the window and graphics API
 // are initialized but before the game loop begins
 // --------------------------------------------------------
-void Game::Initialize()
+void Game::Initialize(const BenchmarkSettings& settings)
 {
 	// Initialize ImGui itself & platform/renderer backends
 	IMGUI_CHECKVERSION();
@@ -35,6 +40,10 @@ void Game::Initialize()
 	//ImGui::StyleColorsLight();
 	//ImGui::StyleColorsClassic();
 
+	//Shaders bind through the state cache from here on, repeats of what's bound are dropped
+	ISimpleShader::StateCache = &Graphics::StateCache;
+	Graphics::StateCache.SetEnabled(settings.FilterStateCalls);
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
@@ -57,83 +66,10 @@ void Game::Initialize()
 	//3. Only pass in time if they shader wants time
 
 
-	//Base Shaders
-	vs = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str());
-	ps =  std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str());
-
-	//Uv shader
-	std::shared_ptr uvPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"DebugUVPixelShader.cso").c_str());
-	
-	//Normal Shader
-	std::shared_ptr normalPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"DebugNormalPixelShader.cso").c_str());
-
-	//Custom Shader
-	std::shared_ptr customPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"CustomPixelShader.cso").c_str());
-
-	//Multi Texture Shader
-	std::shared_ptr multiTexturePixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"MultiTexturePixelShader.cso").c_str());
-
 	//Sky Box Shaders
 	std::shared_ptr skyVertexShader = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyVertexShader.cso").c_str());
 	std::shared_ptr skyPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyPixelShader.cso").c_str());
 
-	DirectX::XMFLOAT4 colorTint(1.0f, 1.0f, 1.0f, 1.0f);
-	DirectX::XMFLOAT4 colorTint2(1.0f, 1.0f, 1.0f, 1.0f);
-	DirectX::XMFLOAT4 colorTint3(.2f, .2f, .2f, 1.0f);
-	DirectX::XMFLOAT4 colorTint4(1.0f, 0.0f, 1.0f, 1.0f);
-
-	//Create Lights
-	directionalLight = {};
-	pointLight = {};
-	spotLight = {};
-
-	//SetLight Properties
-	directionalLight.Type = 0;
-	directionalLight.Direction = XMFLOAT3(1, 0, 0);
-	directionalLight.Color = XMFLOAT3(1, 0, 0);
-	directionalLight.Intensity = 1;
-
-	pointLight.Type = 1;
-	pointLight.Position = XMFLOAT3(5, 2, 0);
-	pointLight.Range = 20.0f;
-	pointLight.Color = XMFLOAT3(0, 1, 0);
-	pointLight.Intensity = 1;
-
-	spotLight.Type = 2;
-	spotLight.Position = XMFLOAT3(10, -1, 0);
-	spotLight.Direction = XMFLOAT3(0, -1, 0);
-	spotLight.Range = 20.0f;
-	spotLight.Color = XMFLOAT3(1, 0, 1);
-	spotLight.Intensity = 1;
-	spotLight.SpotInnerAngle = 15.0f;
-	spotLight.SpotOuterAngle = 30.0f;
-
-	//AddLight to List
-	lights.push_back(directionalLight);
-	lights.push_back(pointLight);
-	lights.push_back(spotLight);
-
-	//Shell method for loading all meshes
-	MeshLoaderShell();
-
-	//Create Textures
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brickTexture;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> oakTexture;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brokenWallTexture;
-
-	//Create Texture With Normal Map
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleStoneTexture;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleStoneNormalTexture;
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/BrickTexture.png", nullptr, brickTexture.GetAddressOf(), (size_t)1000);
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/OakTexture.png", nullptr, oakTexture.GetAddressOf(), (size_t)1000);
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/BrokenWallTexture.png", nullptr, brokenWallTexture.GetAddressOf(), (size_t)1000);
-
-	//Load Texture With Normal Map
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/CobblestoneTexture.png", nullptr, cobbleStoneTexture.GetAddressOf(), (size_t)1000);
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/NormalMaps/cobblestone_normals.png", nullptr, cobbleStoneNormalTexture.GetAddressOf(), (size_t)1000);
-
 	//Load SkyBox Textures
 	std::vector<std::wstring> textureFiles = {
 	L"Assets/Skyboxes/right.png", L"Assets/Skyboxes/left.png",
@@ -145,8 +81,6 @@ void Game::Initialize()
 	std::shared_ptr skyboxMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/cube.obj").c_str());
 
 	//Create sampler state
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerStateComPtr;
-
 	D3D11_SAMPLER_DESC sampleStateDesc = {};
 	sampleStateDesc.Filter = D3D11_FILTER_ANISOTROPIC;
 	sampleStateDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -155,77 +89,75 @@ void Game::Initialize()
 	sampleStateDesc.MaxAnisotropy = 16;
 	sampleStateDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	Graphics::Device->CreateSamplerState(&sampleStateDesc, samplerStateComPtr.GetAddressOf());
+	Graphics::Device->CreateSamplerState(&sampleStateDesc, basicSampler.GetAddressOf());
 
 	//Create skybox
-	skyBox = std::make_shared<Sky>(skyboxMesh, samplerStateComPtr, textureFiles, skyPixelShader, skyVertexShader);
-
-	//Create Materials
-	CreateMaterial(vs, ps, colorTint, 0);
-	CreateMaterial(vs, ps, colorTint2, 0);
-	CreateMaterial(vs, ps, colorTint, 0);
-	CreateMaterial(vs, multiTexturePixelShader, colorTint, 0);
-
-	//Create Normal Map Material
-	CreateMaterial(vs, ps, colorTint, 0);
-
-	//Map Textures and Samplers to materials
-	materials[0]->AddTextureSRV("SurfaceTexture", oakTexture);
-	materials[0]->AddSampler("BasicSampler", samplerStateComPtr);
-
-	materials[1]->AddTextureSRV("SurfaceTexture", oakTexture);
-	materials[1]->AddSampler("BasicSampler", samplerStateComPtr);
-
-	materials[2]->AddTextureSRV("SurfaceTexture", brickTexture);
-	materials[2]->AddSampler("BasicSampler", samplerStateComPtr);
-
-	materials[3]->AddTextureSRV("SurfaceTexture", brickTexture);
-	materials[3]->AddTextureSRV("SecondaryTexture", brokenWallTexture);
-	materials[3]->AddSampler("BasicSampler", samplerStateComPtr);
-
-	//Load Normal Mapped Textures To Material
-	materials[4]->AddTextureSRV("SurfaceTexture", cobbleStoneTexture);
-	materials[4]->AddTextureSRV("NormalMapTexture", cobbleStoneNormalTexture);
-	materials[4]->AddSampler("BasicSampler", samplerStateComPtr);
-
-	// For materials that don't require a normal map:
-	materials[0]->AddTextureSRV("NormalMapTexture", nullptr);
-	materials[1]->AddTextureSRV("NormalMapTexture", nullptr);
-	materials[2]->AddTextureSRV("NormalMapTexture", nullptr);
-	materials[3]->AddTextureSRV("NormalMapTexture", nullptr);
-
+	skyBox = std::make_shared<Sky>(skyboxMesh, basicSampler, textureFiles, skyPixelShader, skyVertexShader);
 
-	//Create Game Entities
-	CreateGameEntity(*temp_Meshes[0], *materials[0]);
-	CreateGameEntity(*temp_Meshes[1], *materials[1]);
-	CreateGameEntity(*temp_Meshes[2], *materials[2]);
-	CreateGameEntity(*temp_Meshes[3], *materials[3]);
-	CreateGameEntity(*temp_Meshes[4], *materials[4]);
-
-	CreateCamera(XMFLOAT3(0, 0, -20), 10.0f, 2.0f, XM_PIDIV4, Window::AspectRatio());
-	CreateCamera(XMFLOAT3(0, 0, -1), 10.0f, 1.0f, XM_PIDIV4/2, Window::AspectRatio());
+	//Meshes, materials, entities, lights and cameras all come from the scene file
+	bool loaded = settings.UseStressScene ? LoadStressScene(settings.Scene) : LoadScene("Main");
+	if (!loaded)
+	{
+		//Still leave something to look through
+		CreateCamera(XMFLOAT3(0, 0, -20), 10.0f, 2.0f, XM_PIDIV4, Window::AspectRatio());
+	}
 
 	activeCamera = cameraList[0];
 
-	//Move Game Entities
+	//Initialize Window Color and color tint
+	ChangeColor(color, 0, 0, 0, 0.0f);
 
-	//Move the TopHat
-	gameEntities[1]->GetTransform()->SetPosition(XMFLOAT3(5, 0, 0));
+	//Initialize ambient light color
+	ambientLightColor = XMFLOAT3(0.1f, 0.1f, 0.25f);
 
-	//Move The Helix
-	gameEntities[2]->GetTransform()->SetPosition(XMFLOAT3(10, 0, 0));
+	BuildFrameGraphs();
+	if (settings.PrintSchedule)
+	{
+		printf("%s", updateGraph.DumpSchedule().c_str());
+		printf("%s", drawGraph.DumpSchedule().c_str());
+	}
 
-	//Move the Cylinder
-	gameEntities[3]->GetTransform()->SetPosition(XMFLOAT3(0, -5, 0));
+	//Without occluders nothing would ever be hidden, so only bake when asked to then
+	pvsPendingSizes = settings.PvsCellSizes;
+	pvsBakesRequested = settings.PvsCellSizes.size();
+	pvsBakeRequested = !pvsPendingSizes.empty() || occluderQuery.Count() > 0;
 
-	//Move the cube
-	gameEntities[4]->GetTransform()->SetPosition(XMFLOAT3(-5, 0, -10));
+	instancingEnabled = settings.Instancing;
+	validateVisibility = settings.ValidateVisibility;
+	cameraTurnRate = settings.CameraTurnRate;
 
-	//Initialize Window Color and color tint
-	ChangeColor(color, 0, 0, 0, 0.0f);
+	if (settings.ShadowCascades > 0)
+	{
+		shadowCastersEnabled = true;
+		shadowCasterSettings.CascadeCount = settings.ShadowCascades;
+	}
 
-	//Initialize ambient light color
-	ambientLightColor = XMFLOAT3(0.1f, 0.1f, 0.25f);
+	if (settings.Views > 0)
+	{
+		cullAllCameras = true;
+		cullViewLimit = settings.Views;
+	}
+
+	headless = settings.Frames > 0;
+	if (headless)
+	{
+		benchmarkOutput = settings.OutputPath;
+		rewindCheckFrames = settings.RewindFrames;
+		benchmark.Begin(settings);
+		benchmark.AddInfo("stressScene", settings.UseStressScene);
+		benchmark.AddInfo("entities", (double)renderQuery.Count());
+		benchmark.AddInfo("meshes", meshPool.GetCount());
+		benchmark.AddInfo("materials", materialPool.GetCount());
+		benchmark.AddInfo("lights", lightPool.GetCount());
+		benchmark.AddInfo("moving", motionQuery.Count());
+		benchmark.AddInfo("occluders", occluderQuery.Count());
+		benchmark.AddInfo("cells", portalSystem.GetCellCount());
+		benchmark.AddInfo("pvsBakes", (double)pvsPendingSizes.size());
+		benchmark.AddInfo("filterStateCalls", Graphics::StateCache.GetEnabled());
+		benchmark.AddInfo("instancing", instancingEnabled);
+		benchmark.AddInfo("views", cullAllCameras ? (cullViewLimit < (int)cameraList.size() ? cullViewLimit : (int)cameraList.size()) : 0);
+		benchmark.AddInfo("workerThreads", jobSystem.GetThreadCount());
+	}
 }
 
 
@@ -248,13 +180,13 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::OnResize()
 {
-	if (activeCamera == nullptr)
+	if (activeCamera.IsNull())
 	{
 		return;
 	}
-	for (const auto& obj : cameraList)
+	for (Camera& camera : cameraPool)
 	{
-		obj->UpdateProjectionMatrix(Window::AspectRatio());
+		camera.UpdateProjectionMatrix(Window::AspectRatio());
 	}
 }
 
@@ -264,22 +196,24 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	UpdateImGui(deltaTime);
-
-	BuildUI();
-
-	// Example input checking: Quit if the escape key is pressed
-	if (Input::KeyDown(VK_ESCAPE))
-		Window::Quit();
-
-	 //Move them on the X
-	/*for (int i = 0; i < 5; i++)
+	//Benchmarks step the same amount every frame so runs can be compared
+	frameDeltaTime = headless ? BENCHMARK_FIXED_DELTA_TIME : deltaTime;
+	frameTotalTime = headless ? simulationFrame * BENCHMARK_FIXED_DELTA_TIME : totalTime;
+
+	//Nothing is running yet, so last frame's scratch memory can be recycled
+	FrameMemory::BeginFrame();
+	uint64_t allocations = AllocationCounter::GetCount();
+	lastFrameAllocations = allocations - frameStartAllocations;
+	frameStartAllocations = allocations;
+
+	//Last frame's draw has seen every change by now
+	for (int channel = 0; channel < CHANGE_CHANNEL_COUNT; channel++)
 	{
-		gameEntities[i]->GetTransform()->SetPosition(sinf(totalTime), 0, 0);
-		CopyInfoToStruct(i);
-	}*/
+		lastChangeCounts[channel] = changeJournal.Get(channel).GetMarkedCount();
+	}
+	changeJournal.Clear();
 
-	activeCamera->Update(deltaTime);
+	updateGraph.Execute();
 }
 
 
@@ -288,49 +222,476 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	// Frame START
-	// - These things should happen ONCE PER FRAME
-	// - At the beginning of Game::Draw() before drawing *anything*
+	drawGraph.Execute();
+
+	//Warmup is there for buffers to grow, after it a frame should get by on the memory it has
+	if (benchmark.IsTiming())
 	{
-		// Clear the back buffer (erase what's on screen) and depth buffer
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	color);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		steadyAllocationsTotal += AllocationCounter::GetCount() - frameStartAllocations;
 	}
 
-	//triangle->Draw();
-	for (const auto& obj : gameEntities) 
+	if (benchmark.IsRunning() && !benchmark.EndFrame(updateGraph, drawGraph))
 	{
-		obj->Draw(activeCamera, totalTime);
+		//Averaged over every frame, warmup included
+		benchmark.AddInfo("occlusionTestedTotal", (double)occlusionTestedTotal);
+		benchmark.AddInfo("occlusionCulledTotal", (double)occlusionCulledTotal);
+		benchmark.AddInfo("occlusionCullRate", occlusionTestedTotal ? (double)occlusionCulledTotal / occlusionTestedTotal : 0.0);
+		if (occluderQuery.Count() > 0)
+		{
+			benchmark.AddCheck("OcclusionCulled", occlusionCulledTotal > 0);
+		}
+		double visibilityAverage = visibilityFrames ? (double)visibilityFrames : 1.0;
+		benchmark.AddInfo("visibilityRefreshes", (double)visibilityRefreshTotal);
+		benchmark.AddInfo("visibilityRetestedAverage", visibilityRetestedTotal / visibilityAverage);
+		benchmark.AddInfo("visibilitySkippedAverage", visibilitySkippedTotal / visibilityAverage);
+		if (validateVisibility)
+		{
+			benchmark.AddInfo("visibilityMismatchesTotal", (double)visibilityMismatchTotal);
+			benchmark.AddCheck("VisibilityCacheMatchesFullCull", visibilityFrames > 0 && visibilityMismatchTotal == 0);
+		}
+		benchmark.AddInfo("portalTestedTotal", (double)portalTestedTotal);
+		benchmark.AddInfo("portalCulledTotal", (double)portalCulledTotal);
+		benchmark.AddInfo("portalCullRate", portalTestedTotal ? (double)portalCulledTotal / portalTestedTotal : 0.0);
+		if (portalSystem.GetCellCount() > 0)
+		{
+			benchmark.AddCheck("PortalsCulled", portalCulledTotal > 0);
+		}
+		for (size_t i = 0; i < pvsBakes.size(); i++)
+		{
+			const PvsBakeStats& bake = pvsBakes[i];
+			std::string prefix = "pvsBake" + std::to_string(i);
+			benchmark.AddInfo(prefix + "CellSize", bake.CellSize);
+			benchmark.AddInfo(prefix + "Cells", bake.Cells);
+			benchmark.AddInfo(prefix + "Rays", (double)bake.Rays);
+			benchmark.AddInfo(prefix + "Seconds", bake.Seconds);
+			benchmark.AddInfo(prefix + "Bytes", (double)bake.Bytes);
+			benchmark.AddInfo(prefix + "UniqueSets", bake.UniqueSets);
+			benchmark.AddInfo(prefix + "AverageVisible", bake.AverageVisible);
+		}
+		//Per frame, what the frustum let through against what the camera's cell sees and what's in both
+		double frames = pvsFrames ? (double)pvsFrames : 1.0;
+		benchmark.AddInfo("pvsFrustumAverage", pvsFrustumTotal / frames);
+		benchmark.AddInfo("pvsSetAverage", pvsSetTotal / frames);
+		benchmark.AddInfo("pvsKeptAverage", pvsKeptTotal / frames);
+		benchmark.AddInfo("pvsCullRate", pvsFrustumTotal ? 1.0 - (double)pvsKeptTotal / pvsFrustumTotal : 0.0);
+		if (pvsBakesRequested > 0)
+		{
+			//What the lookup costs at runtime next to the frustum cull it trims
+			benchmark.AddInfo("pvsStageP50", benchmark.GetPercentile("Update/Pvs", 50));
+			benchmark.AddInfo("cullingStageP50", benchmark.GetPercentile("Update/Culling", 50));
+			benchmark.AddCheck("PvsBakedEverySize", pvsBakes.size() == pvsBakesRequested);
+		}
+		benchmark.AddInfo("stateChangesUnsortedTotal", (double)stateChangesBeforeTotal);
+		benchmark.AddInfo("stateChangesTotal", (double)stateChangesAfterTotal);
+		benchmark.AddInfo("stateChangesAvoidedTotal", (double)(stateChangesBeforeTotal - stateChangesAfterTotal));
+		benchmark.AddInfo("stateCallsIssuedAverage", stateCallFrames ? (double)stateCallsIssuedTotal / stateCallFrames : 0.0);
+		benchmark.AddInfo("stateCallsElidedAverage", stateCallFrames ? (double)stateCallsElidedTotal / stateCallFrames : 0.0);
+		benchmark.AddInfo("queuedDrawsAverage", instanceFrames ? (double)queuedDrawsTotal / instanceFrames : 0.0);
+		benchmark.AddInfo("drawCallsAverage", instanceFrames ? (double)drawCallsTotal / instanceFrames : 0.0);
+		benchmark.AddInfo("shadowInVolumeAverage", shadowFrames ? (double)shadowInVolumeTotal / shadowFrames : 0.0);
+		benchmark.AddInfo("shadowCasterAverage", shadowFrames ? (double)shadowCasterTotal / shadowFrames : 0.0);
+		for (size_t i = 0; i < shadowCasterCuller.GetLightStats().size(); i++)
+		{
+			//Last frame's, per light
+			const ShadowLightStats& light = shadowCasterCuller.GetLightStats()[i];
+			if (light.Views > 0)
+			{
+				benchmark.AddInfo("shadowLight" + std::to_string(i) + "Casters", light.Casters);
+				benchmark.AddInfo("shadowLight" + std::to_string(i) + "InVolume", light.InVolume);
+			}
+		}
+
+#if MEMORY_TRACK_ALLOCATIONS
+		benchmark.AddInfo("steadyStateAllocations", (double)steadyAllocationsTotal);
+		benchmark.AddCheck("ZeroSteadyStateAllocations", steadyAllocationsTotal == 0);
+#endif
 
-		//Set the ambient light color of each object.
-		obj->GetMaterial()->GetPS()->SetFloat3("ambientLightColor", ambientLightColor);
+		//Last, since it winds the simulation back and steps it again
+		if (rewindCheckFrames > 0)
+		{
+			benchmark.AddInfo("rewindFrames", rewindCheckFrames);
+			benchmark.AddCheck("RewindReplay", CheckRewind(rewindCheckFrames));
+		}
 
-		//Sets the lights for the object
-		obj->GetMaterial()->PrepareLight(lights);
+		std::filesystem::path path = FixPath(benchmarkOutput);
+		if (benchmark.WriteJson(path))
+		{
+			printf("Benchmark: frame p50 %.3fms, p99 %.3fms, written to %s\n", benchmark.GetPercentile("Frame", 50), benchmark.GetPercentile("Frame", 99), path.string().c_str());
+		}
+		else
+		{
+			printf("Benchmark: couldn't write %s\n", path.string().c_str());
+		}
+		Window::Quit();
 	}
-	skyBox->Draw(activeCamera.get());
+}
+
+/// <summary>
+/// Declares every per frame system and what data it touches, then
+/// compiles both graphs into their schedules once
+/// </summary>
+void Game::BuildFrameGraphs()
+{
+	//Apply last frame's structural changes before anything iterates the world
+	updateGraph.AddStage("StructuralChanges", {}, { "Entities", "Transforms" }, [this]()
+		{
+			//The hierarchy points at transforms inside chunk rows, so entities on their way out leave
+			//it while those rows are still theirs. Their children stay, moved up a level.
+			commandBuffer.ForEachDestroy([this](Entity entity)
+				{
+					HierarchyNode* node = world.IsAlive(entity) ? world.GetComponent<HierarchyNode>(entity) : nullptr;
+					if (node != nullptr && node->Node >= 0)
+					{
+						sceneGraph.DetachNode(node->Node);
+						node->Node = -1;
+					}
+				});
+			commandBuffer.Playback(world);
+			RebindHierarchy();
+
+			structureChanged = world.GetStructuralVersion() != frameStructuralVersion;
+			frameStructuralVersion = world.GetStructuralVersion();
+
+			changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).Resize(world.GetEntityCapacity());
+			changeJournal.Get(CHANGE_CHANNEL_MATERIAL).Resize(materialPool.GetCount());
+			changeJournal.Get(CHANGE_CHANNEL_LIGHT).Resize(lightPool.GetCount());
+		}, true);
+
+	//ImGui and the window have to stay on the main thread. The inspector itself is built at the
+	//end of the frame, once everything it shows is done.
+	updateGraph.AddStage("Input", {}, { "UI" }, [this]()
+		{
+			//Nobody is looking at a headless run
+			if (headless)
+			{
+				return;
+			}
+
+			UpdateImGui(frameDeltaTime);
+
+			// Example input checking: Quit if the escape key is pressed
+			if (Input::KeyDown(VK_ESCAPE))
+				Window::Quit();
+		}, true);
+
+	//Moves whatever has a Motion component, which so far is only stress scene entities
+	updateGraph.AddStage("Motion", {}, { "Transforms" }, [this]()
+		{
+			motionTime += frameDeltaTime;
+			motionQuery.ParallelForEachChunk(jobSystem, [this](int count, Entity* entities, Transform* transforms, Motion* motions)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						const Motion& motion = motions[i];
+						float angle = motionTime * motion.Speed + motion.Phase;
+						transforms[i].SetPosition(
+							motion.Origin.x + cosf(angle) * motion.Radius,
+							motion.Origin.y + sinf(angle * 2.0f) * motion.Radius * 0.5f,
+							motion.Origin.z + sinf(angle) * motion.Radius);
+					}
+				});
+		});
+
+	updateGraph.AddStage("Camera", { "ActiveCamera" }, { "CameraMatrices" }, [this]()
+		{
+			Camera* camera = cameraPool.Get(activeCamera);
+			if (headless && cameraTurnRate != 0.0f)
+			{
+				camera->GetTransform()->Rotate(0, cameraTurnRate * frameDeltaTime, 0);
+			}
+			camera->Update(frameDeltaTime);
+		});
+
+	//Push any transform changes down to children. Every world matrix that got rebuilt is
+	//journaled here, so entities need a hierarchy node for later systems to see them move.
+	updateGraph.AddStage("TransformPropagation", { "Transforms" }, { "WorldMatrices", "TransformChanges" }, [this]()
+		{
+			sceneGraph.UpdateWorldMatrices();
+			for (int node : sceneGraph.GetUpdatedNodes())
+			{
+				if (node < (int)entityOfNode.size())
+				{
+					changeJournal.Mark(CHANGE_CHANNEL_TRANSFORM, entityOfNode[node]);
+				}
+			}
+
+			//Sorted here, while nothing else can be reading it
+			changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).Sort();
+		});
+
+	//Setters flag the material itself, this turns the flags into journal entries
+	updateGraph.AddStage("MaterialChanges", { "Materials" }, { "MaterialChanges" }, [this]()
+		{
+			Material* materialData = materialPool.GetData();
+			for (int i = 0; i < materialPool.GetCount(); i++)
+			{
+				if (materialData[i].ConsumeDirty())
+				{
+					changeJournal.Mark(CHANGE_CHANNEL_MATERIAL, i);
+				}
+			}
+		});
+
+	//Only entities that moved need new bounds. Entities only touch their own data, so spread them across the workers.
+	updateGraph.AddStage("Bounds", { "WorldMatrices", "TransformChanges" }, { "Bounds" }, [this]()
+		{
+			if (structureChanged)
+			{
+				renderQuery.ParallelForEachChunk(jobSystem, [this](int count, Entity* entities, Transform* transforms, Renderable* renderables, AABB* bounds)
+					{
+						for (int i = 0; i < count; i++)
+						{
+							GameEntity::Update(transforms[i], meshPool.Get(renderables[i].MeshHandle), bounds[i]);
+						}
+					});
+				return;
+			}
+
+			DirtyBitset& moved = changeJournal.Get(CHANGE_CHANNEL_TRANSFORM);
+			if (moved.IsEmpty())
+			{
+				return;
+			}
+
+			uint32_t* indices = FrameMemory::GetThreadAllocator().AllocateArray<uint32_t>(moved.GetMarkedCount());
+			int count = moved.Gather(indices);
+
+			JobCounter counter;
+			jobSystem.ParallelFor(count, [this, indices](int start, int end)
+				{
+					for (int i = start; i < end; i++)
+					{
+						UpdateEntityBounds(indices[i]);
+					}
+				}, &counter, 64);
+			jobSystem.Wait(&counter);
+		});
+
+	//Keep the octree in step with the new bounds
+	updateGraph.AddStage("SpatialIndex", { "Bounds", "Entities", "TransformChanges" }, { "SpatialIndex" }, [this]()
+		{
+			UpdateSceneIndex();
+		});
+
+	//Everything outside the active camera's frustum is dropped before submission
+	updateGraph.AddStage("Culling", { "Bounds", "Entities", "TransformChanges", "CameraMatrices" }, { "Visibility" }, [this]()
+		{
+			UpdateCulling();
+		});
+
+	//Indoors, only what's in cells seen through the portals
+	updateGraph.AddStage("Portals", { "Bounds", "Entities", "TransformChanges", "CameraMatrices" }, { "Visibility" }, [this]()
+		{
+			UpdatePortals();
+		});
+
+	//Then the baked set of the camera's cell. Runs a pending bake first, it needs this frame's bounds.
+	updateGraph.AddStage("Pvs", { "Bounds", "Entities", "TransformChanges", "CameraMatrices", "WorldMatrices" }, { "Visibility" }, [this]()
+		{
+			UpdatePvs();
+		});
+
+	//Levels for what's left, dropping anything only a pixel or two across
+	updateGraph.AddStage("Lod", { "Bounds", "CameraMatrices" }, { "Visibility" }, [this]()
+		{
+			UpdateLod();
+		});
+
+	//Then whatever sits behind the occluders
+	updateGraph.AddStage("Occlusion", { "Bounds", "Entities", "CameraMatrices", "WorldMatrices" }, { "Visibility" }, [this]()
+		{
+			UpdateOcclusion();
+		});
+
+	//What's left to draw, in the order it'll be drawn
+	updateGraph.AddStage("RenderQueue", { "Bounds", "Entities", "CameraMatrices", "Materials", "MaterialChanges", "Visibility" }, { "RenderQueue" }, [this]()
+		{
+			UpdateRenderQueue();
+		});
+
+	//The queue cut into instanced runs, with each instance's matrices
+	updateGraph.AddStage("Instancing", { "Entities", "Materials", "WorldMatrices", "RenderQueue" }, { "Instances" }, [this]()
+		{
+			UpdateInstancing();
+		});
+
+	//Every light's casters, from the bounds the culling pass keeps
+	updateGraph.AddStage("ShadowCasters", { "Bounds", "Entities", "CameraMatrices", "Visibility" }, { "ShadowCasters" }, [this]()
+		{
+			UpdateShadowCasters();
+		});
+
+	//A few tree rotations a frame keep the BVH from degrading as things move
+	updateGraph.AddStage("TreeOptimize", {}, { "SpatialIndex" }, [this]()
+		{
+			sceneTree.Optimize(64);
+		});
+
+	//Rebuilt from scratch when anything moved, the counting sort is cheaper than tracking moves
+	updateGraph.AddStage("PointGrid", { "WorldMatrices", "Entities", "TransformChanges" }, { "PointGrid" }, [this]()
+		{
+			if (!structureChanged && changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).IsEmpty())
+			{
+				return;
+			}
+
+			LinearAllocator& frameMemory = FrameMemory::GetThreadAllocator();
+			int count = renderQuery.Count();
+			XMFLOAT3* gridPositions = frameMemory.AllocateArray<XMFLOAT3>(count);
+			gridEntities.resize(count);
+
+			int next = 0;
+			renderQuery.ForEach([this, gridPositions, &next](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+				{
+					//World space position, so children land in the right cell
+					XMFLOAT4X4 world = transform.GetWorldMatrix();
+					gridPositions[next] = XMFLOAT3(world._41, world._42, world._43);
+					gridEntities[next] = entity;
+					next++;
+				});
+			pointGrid.Build(gridPositions, count, &jobSystem);
+		});
+
+	//Last simulation stage in the frame, so a restored snapshot picks up right where this one ends. Only
+	//the first five are captured, the rest are read so every stage writing them has finished first.
+	updateGraph.AddStage("Snapshot", { "Transforms", "ActiveCamera", "CameraMatrices", "Materials", "Lights",
+		"WorldMatrices", "Bounds", "SpatialIndex", "Visibility", "RenderQueue", "Instances", "ShadowCasters", "PointGrid" }, { "History" }, [this]()
+		{
+			if (recordHistory)
+			{
+				simulationState.Capture(simulationFrame, snapshotBuffer);
+				snapshotHistory.Push(simulationFrame, snapshotBuffer);
+			}
+			simulationFrame++;
+		});
+
+	//Shows what every stage made of this frame. Anything edited in it, a restore included, is
+	//picked up by next frame's stages.
+	updateGraph.AddStage("Inspector", { "SpatialIndex", "PointGrid", "Visibility", "RenderQueue", "Instances", "ShadowCasters", "History" },
+		{ "UI", "ActiveCamera", "Transforms", "Materials", "Lights", "LightChanges" }, [this]()
+		{
+			if (headless)
+			{
+				return;
+			}
+
+			BuildUI();
+		}, true);
+
+	// Frame START
+	// - These things should happen ONCE PER FRAME
+	// - At the beginning of Game::Draw() before drawing *anything*
+	drawGraph.AddStage("Clear", {}, { "BackBuffer" }, [this]()
+		{
+			//Starts the state cache's counts over, and forgets what the UI bound last frame
+			Graphics::StateCache.BeginFrame();
+
+			// Clear the back buffer (erase what's on screen) and depth buffer
+			Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	color);
+			Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		}, true);
+
+	drawGraph.AddStage("Submit", { "CameraMatrices", "WorldMatrices", "Materials", "Lights", "MaterialChanges", "LightChanges", "RenderQueue", "Instances" }, { "BackBuffer" }, [this]()
+		{
+			Camera* camera = cameraPool.Get(activeCamera);
+
+			//Shaders keep their own copy of the light data between draws, so it only
+			//needs sending when the lights change or a material is new or edited
+			auto prepareLights = [this](uint32_t index)
+			{
+				Material& material = materialPool.GetData()[index];
+				material.GetPS()->SetFloat3("ambientLightColor", ambientLightColor);
+				material.PrepareLight(lightPool.GetData(), lightPool.GetCount());
+			};
+			if (!changeJournal.Get(CHANGE_CHANNEL_LIGHT).IsEmpty())
+			{
+				for (int i = 0; i < materialPool.GetCount(); i++)
+				{
+					prepareLights(i);
+				}
+			}
+			else
+			{
+				changeJournal.Get(CHANGE_CHANNEL_MATERIAL).ForEach(prepareLights);
+			}
+
+			UploadInstances();
+
+			//The sky leaves its own states bound, so the defaults go back here, once, before the scene draws
+			Graphics::StateCache.SetRasterizerState(nullptr);
+			Graphics::StateCache.SetDepthStencilState(nullptr, 0);
 
-	ImGui::Render(); // Turns this frames UI into renderable triangles
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
+			const uint32_t* draws = renderQueue.GetValues();
+			const InstanceBatch* batches = instanceBatcher.GetBatches();
+			for (int b = 0; b < instanceBatcher.GetBatchCount(); b++)
+			{
+				const InstanceBatch& batch = batches[b];
+				if (batch.Instanced)
+				{
+					//Everything in the run shares these, so the first draw stands in for the rest
+					uint32_t index = draws[batch.First];
+					Renderable* renderable = world.GetComponent<Renderable>(world.GetEntity(index));
+					Handle<Mesh> mesh = GetLodMesh(renderable->MeshHandle, lodSelector.GetLevel(index));
+					GameEntity::DrawInstanced(meshPool.Get(mesh), materialPool.Get(renderable->MaterialHandle), camera, frameTotalTime,
+						instanceBuffer.Get(), batch.Count, batch.FirstInstance);
+					continue;
+				}
+
+				for (int i = batch.First; i < batch.First + batch.Count; i++)
+				{
+					uint32_t index = draws[i];
+					Entity entity = world.GetEntity(index);
+					Transform* transform = world.GetComponent<Transform>(entity);
+					Renderable* renderable = world.GetComponent<Renderable>(entity);
+					Handle<Mesh> mesh = GetLodMesh(renderable->MeshHandle, lodSelector.GetLevel(index));
+					GameEntity::Draw(*transform, meshPool.Get(mesh), materialPool.Get(renderable->MaterialHandle), camera, frameTotalTime);
+				}
+			}
+			skyBox->Draw(camera);
 
+			const RenderStateStats& stateStats = Graphics::StateCache.GetStats();
+			stateCallFrames++;
+			stateCallsIssuedTotal += stateStats.Issued;
+			stateCallsElidedTotal += stateStats.Elided;
+		}, true);
+
+	drawGraph.AddStage("UI", { "UI" }, { "BackBuffer" }, [this]()
+		{
+			if (headless)
+			{
+				return;
+			}
 
+			ImGui::Render(); // Turns this frames UI into renderable triangles
+			ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
+		}, true);
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
-	{
-		// Present at the end of the frame
-		bool vsync = Graphics::VsyncState();
-		Graphics::SwapChain->Present(
-			vsync ? 1 : 0,
-			vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+	drawGraph.AddStage("Present", { "BackBuffer" }, { "BackBuffer" }, [this]()
+		{
+			//Benchmarks only time CPU work, so don't wait on the GPU or the display
+			if (headless)
+			{
+				return;
+			}
 
-		// Re-bind back buffer and depth buffer after presenting
-		Graphics::Context->OMSetRenderTargets(
-			1,
-			Graphics::BackBufferRTV.GetAddressOf(),
-			Graphics::DepthBufferDSV.Get());
-	}
+			// Present at the end of the frame
+			bool vsync = Graphics::VsyncState();
+			Graphics::SwapChain->Present(
+				vsync ? 1 : 0,
+				vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+
+			// Re-bind back buffer and depth buffer after presenting
+			Graphics::Context->OMSetRenderTargets(
+				1,
+				Graphics::BackBufferRTV.GetAddressOf(),
+				Graphics::DepthBufferDSV.Get());
+		}, true);
+
+	updateGraph.Compile();
+	drawGraph.Compile();
 }
 
 void::Game::UpdateImGui(float deltaTime) 
@@ -361,6 +722,11 @@ void::Game::BuildUI()
 
 		ImGui::Text("Window Resolution: %dx%d", Window::Width(), Window::Height());
 
+		ImGui::Text("Heap allocations last frame: %llu", (unsigned long long)lastFrameAllocations);
+
+		ImGui::Text("Changed last frame: %d transforms, %d materials, %d lights",
+			lastChangeCounts[CHANGE_CHANNEL_TRANSFORM], lastChangeCounts[CHANGE_CHANNEL_MATERIAL], lastChangeCounts[CHANGE_CHANNEL_LIGHT]);
+
 		ImGui::ColorEdit4("Background Color", color);
 
 		ImGui::ColorEdit4("ColorTint", &objectColorTint.x);
@@ -374,10 +740,10 @@ void::Game::BuildUI()
 	if (ImGui::CollapsingHeader("Meshes"))
 	{
 		int counter = 1;
-		for (const auto& obj : gameEntities)
+		for (auto& obj : gameEntities)
 		{
-			ImGui::Text(("Entity " + std::to_string(counter) + " Vert Count: %d").c_str(), obj->GetMesh()->GetVertexCount());
-			ImGui::Text(("Entity " + std::to_string(counter) + " Index Count: %d").c_str(), obj->GetMesh()->GetIndexCount());
+			ImGui::Text("Entity %d Vert Count: %d", counter, meshPool.Get(obj.GetMesh())->GetVertexCount());
+			ImGui::Text("Entity %d Index Count: %d", counter, meshPool.Get(obj.GetMesh())->GetIndexCount());
 
 			ImGui::Text(" ");
 			
@@ -389,22 +755,28 @@ void::Game::BuildUI()
 	{
 		//CONVERT THIS TO NAMES
 		int counter = 1;
-		for (const auto& t : gameEntities)
+		for (auto& t : gameEntities)
 		{
-			Transform* trans = t->GetTransform().get();
+			Transform* trans = t.GetTransform();
 			//Local Variables
 			XMFLOAT3 pos = trans->GetPosition();
 			XMFLOAT3 rotation = trans->GetRotation();
 			XMFLOAT3 scale = trans->GetScale();
-			if (ImGui::CollapsingHeader(("Entity " + std::to_string(counter)).c_str()))
+			char label[32];
+			snprintf(label, sizeof(label), "Entity %d", counter);
+			if (ImGui::CollapsingHeader(label))
 			{
-				ImGui::SliderFloat3("Position", &pos.x, -20.0f, 20.0f);
-				ImGui::SliderFloat3("Rotation", &rotation.x, -5.0f, 5.0f);
-				ImGui::SliderFloat3("Scale", &scale.x, 0.0f, 5.0f);
-
-				trans->SetPosition(pos);
-				trans->SetRotation(rotation);
-				trans->SetScale(scale);
+				//Only write back real edits, every set marks the transform as changed
+				bool changed = ImGui::SliderFloat3("Position", &pos.x, -20.0f, 20.0f);
+				changed |= ImGui::SliderFloat3("Rotation", &rotation.x, -5.0f, 5.0f);
+				changed |= ImGui::SliderFloat3("Scale", &scale.x, 0.0f, 5.0f);
+
+				if (changed)
+				{
+					trans->SetPosition(pos);
+					trans->SetRotation(rotation);
+					trans->SetScale(scale);
+				}
 			}
 			counter++;
 		}
@@ -412,9 +784,11 @@ void::Game::BuildUI()
 
 	if (ImGui::CollapsingHeader("Camera"))
 	{
-		for (int i = 0; i < 2; i++)
+		for (int i = 0; i < (int)cameraList.size(); i++)
 		{
-			if (ImGui::Button(("Camera " + std::to_string(i + 1)).c_str()))
+			char label[32];
+			snprintf(label, sizeof(label), "Camera %d", i + 1);
+			if (ImGui::Button(label))
 			{
 				activeCamera = cameraList[i];
 			}
@@ -426,20 +800,25 @@ void::Game::BuildUI()
 		int counter = 1;
 		for (auto& t : gameEntities)
 		{
-			Material* mat = t->GetMaterial().get();
+			Material* mat = materialPool.Get(t.GetMaterial());
 
 			XMFLOAT4 colorTint = mat->GetColorTint();
 			XMFLOAT2 uvScale = mat->GetUVScale();
 			XMFLOAT2 uvOffset = mat->GetUVOffset();
-			if(ImGui::CollapsingHeader(("Material " + std::to_string(counter)).c_str()))
+			char label[32];
+			snprintf(label, sizeof(label), "Material %d", counter);
+			if(ImGui::CollapsingHeader(label))
 			{
-				ImGui::ColorEdit4("Color Tint: ", &colorTint.x);
-				ImGui::SliderFloat2("UV Scale: ", &uvScale.x, .1f, 10);
-				ImGui::SliderFloat2("UV Offset: ", &uvOffset.x, 0.0f, 10);
-
-				mat->SetColorTint(colorTint);
-				mat->SetUVScale(uvScale.x, uvScale.y);
-				mat->SetUVOffset(uvOffset.x, uvOffset.y);
+				bool changed = ImGui::ColorEdit4("Color Tint: ", &colorTint.x);
+				changed |= ImGui::SliderFloat2("UV Scale: ", &uvScale.x, .1f, 10);
+				changed |= ImGui::SliderFloat2("UV Offset: ", &uvOffset.x, 0.0f, 10);
+
+				if (changed)
+				{
+					mat->SetColorTint(colorTint);
+					mat->SetUVScale(uvScale.x, uvScale.y);
+					mat->SetUVOffset(uvOffset.x, uvOffset.y);
+				}
 			}
 			counter++;
 		}
@@ -448,22 +827,213 @@ void::Game::BuildUI()
 	if (ImGui::CollapsingHeader("Light Info"))
 	{
 		int counter = 1;
-		for (auto& light : lights)
+		for (Light& light : lightPool)
 		{
 			XMFLOAT3 lightColor = light.Color;
 
-			if (ImGui::CollapsingHeader(("Light " + std::to_string(counter)).c_str()))
+			char label[32];
+			snprintf(label, sizeof(label), "Light %d", counter);
+			if (ImGui::CollapsingHeader(label) && ImGui::ColorEdit3("Color Tint: ", &lightColor.x))
 			{
-				ImGui::ColorEdit3("Color Tint: ", &lightColor.x);
-				
+				light.Color = lightColor;
+				changeJournal.Mark(CHANGE_CHANNEL_LIGHT, counter - 1);
 			}
-			light.Color = lightColor;
 			counter++;
 		}
 	}
 
 
 
+	if (ImGui::CollapsingHeader("Spatial Index"))
+	{
+		indexQueryResults.clear();
+		sceneIndex.QueryFrustum(FrustumFromMatrix(cameraPool.Get(activeCamera)->GetViewProjection()), indexQueryResults);
+
+		ImGui::Text("Items: %d", sceneIndex.GetItemCount());
+		ImGui::Text("Nodes: %d", sceneIndex.GetNodeCount());
+		ImGui::Text("In view: %d", (int)indexQueryResults.size());
+		ImGui::Text("BVH: %d proxies, height %d, area ratio %.2f", sceneTree.GetProxyCount(), sceneTree.GetHeight(), sceneTree.GetAreaRatio());
+		ImGui::Text("Hash grid: %d points in %d buckets", pointGrid.GetPointCount(), pointGrid.GetTableSize());
+	}
+
+	//Nothing has been culled yet on the very first frame
+	if (activeVisibility && ImGui::CollapsingHeader("Culling"))
+	{
+		ImGui::Text("Visible: %d of %d", cameraVisibleCount, renderQuery.Count());
+		ImGui::Checkbox("Cull every camera in one pass", &cullAllCameras);
+		if (cullAllCameras)
+		{
+			for (int view = 0; view < culledViewCount; view++)
+			{
+				ImGui::Text("View %d: %d visible", view, frustumCuller.GetViewVisibleCount(view));
+			}
+		}
+		else
+		{
+			const VisibilityCacheStats& stats = activeVisibility->GetStats();
+			ImGui::Text("Last update: %s", stats.CameraMoving ? "camera moving, plain cull" : (stats.FullRefresh ? "full refresh" : "reused the cache"));
+			ImGui::Text("Retested %d, skipped %d, %d on the boundary, %d moved", stats.Retested, stats.Skipped, stats.Boundary, stats.Moved);
+			ImGui::Checkbox("Validate against a full cull", &validateVisibility);
+			if (validateVisibility)
+			{
+				ImGui::Text("Mismatches: %d", stats.Mismatches);
+			}
+		}
+	}
+
+	if (activeVisibility && portalSystem.GetCellCount() > 0 && ImGui::CollapsingHeader("Portals"))
+	{
+		const PortalStats& stats = portalSystem.GetStats();
+		ImGui::Checkbox("Enabled##Portals", &portalsEnabled);
+		ImGui::Checkbox("Overlay", &portalOverlay);
+		if (stats.CameraCell == PORTAL_NO_CELL)
+		{
+			ImGui::Text("Camera outside every cell, all %d visible", portalSystem.GetCellCount());
+		}
+		else
+		{
+			ImGui::Text("Camera in cell %d, %d of %d cells visible", stats.CameraCell, stats.VisibleCells, portalSystem.GetCellCount());
+		}
+		ImGui::Text("Portals: %d tested, %d passed, deepest path %d%s", stats.PortalsTested, stats.PortalsPassed, stats.DeepestPath, stats.Truncated ? ", gave up" : "");
+		ImGui::Text("Hidden: %d in unseen cells, %d outside the portals, of %d", stats.HiddenByCell, stats.HiddenByRect, stats.EntitiesTested);
+	}
+	if (activeVisibility && portalOverlay && portalsEnabled && portalSystem.GetCellCount() > 0)
+	{
+		DrawPortalOverlay();
+	}
+
+	if (activeVisibility && ImGui::CollapsingHeader("PVS"))
+	{
+		ImGui::Checkbox("Enabled##Pvs", &pvsEnabled);
+		ImGui::SliderFloat("Cell size", &pvsSettings.CellSize, 1.0f, 64.0f);
+		ImGui::SliderInt("Samples per cell", &pvsSettings.SamplesPerCell, 1, 64);
+		if (ImGui::Button("Bake"))
+		{
+			pvsBakeRequested = true;
+		}
+		for (const PvsBakeStats& bake : pvsBakes)
+		{
+			ImGui::Text("Size %.1f: %d cells, %.2fs, %d sets, %.1f KB, %.0f visible per cell",
+				bake.CellSize, bake.Cells, bake.Seconds, bake.UniqueSets, bake.Bytes / 1024.0f, bake.AverageVisible);
+		}
+
+		if (pvs.IsEmpty())
+		{
+			ImGui::Text("Not baked");
+		}
+		else if (pvsCameraCell == PVS_NO_CELL)
+		{
+			ImGui::Text("Camera outside the baked cells, everything passes");
+		}
+		else
+		{
+			ImGui::Text("Camera in cell %d of %d, which sees %d", pvsCameraCell, pvs.GetCellCount(), pvs.GetSetSize(pvsCameraCell));
+		}
+		if (pvsFrames > 0)
+		{
+			ImGui::Text("Per frame: frustum %.0f, kept %.0f", (double)pvsFrustumTotal / pvsFrames, (double)pvsKeptTotal / pvsFrames);
+		}
+	}
+
+	if (activeVisibility && ImGui::CollapsingHeader("LOD"))
+	{
+		ImGui::Checkbox("Enabled##Lod", &lodEnabled);
+		ImGui::SliderFloat3("Level pixels", lodSettings.LevelPixels, 1.0f, 256.0f);
+		ImGui::SliderFloat("Cull pixels", &lodSettings.CullPixels, 0.0f, 8.0f);
+		ImGui::SliderFloat("Hysteresis", &lodSettings.Hysteresis, 0.0f, 0.5f);
+
+		const int* histogram = lodSelector.GetHistogram();
+		for (int level = 0; level < LOD_MAX_LEVELS; level++)
+		{
+			ImGui::Text("Level %d: %d", level, histogram[level]);
+		}
+		ImGui::Text("Too small to draw: %d", histogram[LOD_CULLED]);
+	}
+
+	if (activeVisibility && ImGui::CollapsingHeader("Occlusion"))
+	{
+		ImGui::Checkbox("Enabled##Occlusion", &occlusionEnabled);
+		ImGui::Text("Occluders drawn: %d of %d, %d triangles", occlusionCuller.GetOccluderCount(), occluderQuery.Count(), occlusionCuller.GetTriangleCount());
+		ImGui::Text("Hidden: %d of %d tested", lastOccludedCount, lodSelector.GetSelectedCount());
+		ImGui::Text("Drawn: %d", (int)drawList.size());
+	}
+
+	if (activeVisibility && ImGui::CollapsingHeader("Render Queue"))
+	{
+		const RenderQueueStats& stats = renderQueue.GetStats();
+		ImGui::Checkbox("Sort", &sortDraws);
+		ImGui::Text("Draws: %d, %d radix passes", stats.Items, stats.Passes);
+		ImGui::Text("State changes: %d, %d unsorted", stats.StateChangesAfter, stats.StateChangesBefore);
+		ImGui::Text("Avoided since start: %llu", (unsigned long long)(stateChangesBeforeTotal - stateChangesAfterTotal));
+
+		//Update runs before Draw starts the counts over, so these are still last frame's
+		bool filterStateCalls = Graphics::StateCache.GetEnabled();
+		if (ImGui::Checkbox("Drop repeated binds", &filterStateCalls))
+		{
+			Graphics::StateCache.SetEnabled(filterStateCalls);
+		}
+		const RenderStateStats& stateStats = Graphics::StateCache.GetStats();
+		ImGui::Text("Bind calls: %d issued, %d dropped", stateStats.Issued, stateStats.Elided);
+
+		const InstanceBatchStats& instanceStats = instanceBatcher.GetStats();
+		ImGui::Checkbox("Instancing", &instancingEnabled);
+		ImGui::Text("Draw calls: %d for %d draws", instanceStats.DrawCalls, instanceStats.Draws);
+		ImGui::Text("Instanced: %d draws in %d batches", instanceStats.InstancedDraws, instanceStats.InstancedBatches);
+	}
+
+	if (activeVisibility && ImGui::CollapsingHeader("Shadow Casters"))
+	{
+		ImGui::Checkbox("Enabled##Shadows", &shadowCastersEnabled);
+		ImGui::SliderInt("Cascades", &shadowCasterSettings.CascadeCount, 1, SHADOW_MAX_CASCADES);
+		ImGui::SliderFloat("Shadow distance", &shadowCasterSettings.ShadowDistance, 10.0f, 500.0f);
+		ImGui::SliderFloat("Split blend", &shadowCasterSettings.SplitBlend, 0.0f, 1.0f);
+		ImGui::Checkbox("Reject casters out of view", &shadowCasterSettings.RejectUnseen);
+
+		const std::vector<ShadowLightStats>& lights = shadowCasterCuller.GetLightStats();
+		for (int i = 0; shadowCastersEnabled && i < (int)lights.size(); i++)
+		{
+			const ShadowLightStats& light = lights[i];
+			if (light.Views > 0)
+			{
+				ImGui::Text("Light %d (%s): %d casters of %d in its %d volume%s", i, light.Type == LIGHT_TYPE_SPOT ? "spot" : "directional",
+					light.Casters, light.InVolume, light.Views, light.Views == 1 ? "" : "s");
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("History"))
+	{
+		ImGui::Checkbox("Record", &recordHistory);
+		ImGui::Text("Frames %u to %u, %d stored in %.1f KB", snapshotHistory.GetOldestFrame(), snapshotHistory.GetNewestFrame(),
+			snapshotHistory.GetCount(), snapshotHistory.GetMemoryUsed() / 1024.0f);
+
+		ImGui::SliderInt("Frames Back", &rewindFrames, 0, snapshotHistory.GetCount() > 0 ? snapshotHistory.GetCount() - 1 : 0);
+		if (ImGui::Button("Restore") && snapshotHistory.GetCount() > 0)
+		{
+			lastRestore = RestoreSnapshot(snapshotHistory.GetNewestFrame() - rewindFrames);
+		}
+		ImGui::Text("Last restore %s",
+			lastRestore == RestoreResult::Matched ? "matched its hash" :
+			lastRestore == RestoreResult::Mismatched ? "did NOT match its hash" :
+			lastRestore == RestoreResult::NotCompared ? "wasn't compared, entities changed since" :
+			lastRestore == RestoreResult::Failed ? "failed, the frame is gone" : "hasn't happened yet");
+	}
+
+	if (ImGui::CollapsingHeader("Task Graph"))
+	{
+		TaskGraph* graphs[2] = { &updateGraph, &drawGraph };
+		const char* graphNames[2] = { "Update", "Draw" };
+		for (int g = 0; g < 2; g++)
+		{
+			ImGui::Text("%s: %.3f ms", graphNames[g], graphs[g]->GetLastMilliseconds());
+			for (int i = 0; i < graphs[g]->GetStageCount(); i++)
+			{
+				const TaskStage& stage = graphs[g]->GetStage(i);
+				ImGui::Text("  [%d] %s %.3f ms", stage.Level, stage.Name.c_str(), stage.LastMilliseconds);
+			}
+		}
+	}
+
 	if (demoWindowState)
 	{
 		ImGui::ShowDemoWindow(&demoWindowState);
@@ -487,45 +1057,907 @@ void Game::CreateGeometry()
 
 }
 
-void Game::MeshLoaderShell()
+/// <summary>
+/// Converts Assets/Scenes/[name].scene if its binary copy is missing or older, then loads the binary
+/// </summary>
+/// <returns>False if the scene couldn't be converted or opened, nothing is created then</returns>
+bool Game::LoadScene(const std::string& name)
 {
-	//Load Sphere
-	temp_Meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Models/sphere.obj").c_str()));
+	std::filesystem::path textPath = FixPath("../../Assets/Scenes/" + name + ".scene");
+	std::filesystem::path binaryPath = FixPath(name + ".sceneb");
+	pvsPath = FixPath(name + ".pvs");
 
-	//Load Top Hat
-	temp_Meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Models/TopHat.obj").c_str()));
+	std::error_code fileError;
+	bool haveText = std::filesystem::exists(textPath, fileError);
+	bool haveBinary = std::filesystem::exists(binaryPath, fileError);
 
-	//Load Helix
-	temp_Meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Models/helix.obj").c_str()));
-
-	//Load Cylinder
-	temp_Meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Models/cylinder.obj").c_str()));
-
-	//Load Cube
-	temp_Meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Models/cube.obj").c_str()));
+	//A binary written by an older build has the wrong version and won't open, so it counts as missing
+	SceneFile existing;
+	haveBinary = haveBinary && existing.Open(binaryPath);
+	existing.Close();
 
+	if (haveText && (!haveBinary || std::filesystem::last_write_time(textPath, fileError) > std::filesystem::last_write_time(binaryPath, fileError)))
+	{
+		std::string error;
+		if (!SceneFile::ConvertText(textPath, binaryPath, error))
+		{
+			printf("Scene %s: %s\n", name.c_str(), error.c_str());
+			return false;
+		}
+	}
 
+	return LoadSceneFile(binaryPath);
 }
 
 /// <summary>
-/// Creates Material and Adds It To Materials List
+/// Maps a binary scene and creates everything in it. The tables are read straight out of the mapping.
 /// </summary>
-/// <param name="_vs"></param>
-/// <param name="_ps"></param>
-/// <param name="_colorTint"></param>
-void Game::CreateMaterial(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT4 _colorTint, float _roughness)
+/// <returns>False if the file couldn't be opened, nothing is created then</returns>
+bool Game::LoadSceneFile(const std::filesystem::path& binaryPath)
 {
-	materials.push_back(std::make_shared<Material>(_vs, _ps, _colorTint, _roughness));
-}
+	SceneFile scene;
+	if (!scene.Open(binaryPath))
+	{
+		printf("Scene: couldn't open %s\n", binaryPath.string().c_str());
+		return false;
+	}
 
-/// <summary>
-/// Creates an object, and adds it to the game entities list
-/// </summary>
+	//Assets, in table order so scene indices line up
+	for (int i = 0; i < scene.GetMeshCount(); i++)
+	{
+		sceneMeshes.push_back(meshPool.Create(FixPath("../../" + std::string(scene.GetString(scene.GetMeshes()[i].Path))).c_str()));
+	}
+
+	//LOD chains, always pointing back at a mesh that's already loaded
+	for (int i = 0; i < scene.GetMeshCount(); i++)
+	{
+		uint32_t lod = scene.GetMeshes()[i].Lod;
+		if (lod != SCENE_NO_INDEX)
+		{
+			Handle<Mesh> mesh = sceneMeshes[i];
+			if (meshLods.size() <= mesh.Index)
+			{
+				meshLods.resize(mesh.Index + 1);
+			}
+			meshLods[mesh.Index] = sceneMeshes[lod];
+		}
+	}
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textures(scene.GetTextureCount());
+	for (int i = 0; i < scene.GetTextureCount(); i++)
+	{
+		std::wstring path = NarrowToWide(FixPath("../../" + std::string(scene.GetString(scene.GetTextures()[i].Path))));
+		CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), path.c_str(), nullptr, textures[i].GetAddressOf(), (size_t)1000);
+	}
+
+	std::vector<std::shared_ptr<SimpleVertexShader>> vertexShaders(scene.GetShaderCount());
+	std::vector<std::shared_ptr<SimpleVertexShader>> instancedVertexShaders(scene.GetShaderCount());
+	std::vector<std::shared_ptr<SimplePixelShader>> pixelShaders(scene.GetShaderCount());
+	for (int i = 0; i < scene.GetShaderCount(); i++)
+	{
+		const SceneShader& shader = scene.GetShaders()[i];
+		std::wstring path = FixPath(NarrowToWide(scene.GetString(shader.Path)));
+		if (shader.Stage == SCENE_SHADER_VERTEX)
+		{
+			vertexShaders[i] = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, path.c_str());
+
+			//A vertex shader gets drawn instanced when an Instanced version of it sits next to it
+			std::filesystem::path instancedPath(path);
+			instancedPath.replace_filename(L"Instanced" + instancedPath.filename().wstring());
+			if (std::filesystem::exists(instancedPath))
+			{
+				instancedVertexShaders[i] = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, instancedPath.c_str());
+			}
+		}
+		else
+		{
+			pixelShaders[i] = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, path.c_str());
+		}
+	}
+
+	int firstMaterial = (int)materials.size();
+	for (int i = 0; i < scene.GetMaterialCount(); i++)
+	{
+		const SceneMaterial& source = scene.GetMaterials()[i];
+		CreateMaterial(vertexShaders[source.VertexShader], pixelShaders[source.PixelShader], source.ColorTint, source.Roughness);
+
+		Material* material = materialPool.Get(materials.back());
+		material->SetUVScale(source.UVScale.x, source.UVScale.y);
+		material->SetUVOffset(source.UVOffset.x, source.UVOffset.y);
+		material->SetInstancedVS(instancedVertexShaders[source.VertexShader]);
+		material->AddSampler("BasicSampler", basicSampler);
+		for (uint32_t b = 0; b < source.BindingCount; b++)
+		{
+			const SceneTextureBinding& binding = scene.GetTextureBindings()[source.FirstBinding + b];
+			material->AddTextureSRV(scene.GetString(binding.Name), binding.Texture == SCENE_NO_INDEX ? nullptr : textures[binding.Texture]);
+		}
+	}
+
+	//Parents always come first, so their nodes already exist by the time a child needs them
+	int firstEntity = (int)gameEntities.size();
+	const SceneEntity* entities = scene.GetEntities();
+	gameEntities.reserve(firstEntity + scene.GetEntityCount());
+	for (int i = 0; i < scene.GetEntityCount(); i++)
+	{
+		CreateGameEntity(sceneMeshes[entities[i].Mesh], materials[firstMaterial + entities[i].Material]);
+
+		Transform* transform = gameEntities.back().GetTransform();
+		transform->SetPosition(entities[i].Position);
+		transform->SetRotation(entities[i].Rotation);
+		transform->SetScale(entities[i].Scale);
+
+		if (entities[i].Parent != SCENE_NO_INDEX)
+		{
+			sceneGraph.SetParent(gameEntities.back().GetHierarchyNode(), gameEntities[firstEntity + entities[i].Parent].GetHierarchyNode());
+		}
+
+		if (entities[i].Flags & SCENE_ENTITY_OCCLUDER)
+		{
+			world.AddComponent(gameEntities.back().GetEntity(), Occluder{});
+		}
+	}
+
+	for (int i = 0; i < scene.GetLightCount(); i++)
+	{
+		lightPool.Create(scene.GetLights()[i]);
+	}
+
+	for (int i = 0; i < scene.GetCameraCount(); i++)
+	{
+		const SceneCamera& camera = scene.GetCameras()[i];
+		CreateCamera(camera.Position, camera.MoveSpeed, camera.LookSpeed, camera.FieldOfView, Window::AspectRatio());
+	}
+
+	//Cells and portals, numbered on from any already loaded
+	static_assert(SCENE_PORTAL_MAX_VERTICES <= PORTAL_MAX_VERTICES, "Scene portals have to fit the portal system");
+	int firstCell = portalSystem.GetCellCount();
+	for (int i = 0; i < scene.GetCellCount(); i++)
+	{
+		const SceneCell& cell = scene.GetCells()[i];
+		AABB bounds;
+		bounds.Center = XMFLOAT3((cell.Min.x + cell.Max.x) * 0.5f, (cell.Min.y + cell.Max.y) * 0.5f, (cell.Min.z + cell.Max.z) * 0.5f);
+		bounds.Extents = XMFLOAT3((cell.Max.x - cell.Min.x) * 0.5f, (cell.Max.y - cell.Min.y) * 0.5f, (cell.Max.z - cell.Min.z) * 0.5f);
+		portalSystem.AddCell(bounds);
+	}
+	for (int i = 0; i < scene.GetPortalCount(); i++)
+	{
+		const ScenePortal& portal = scene.GetPortals()[i];
+		portalSystem.AddPortal(firstCell + portal.Cells[0], firstCell + portal.Cells[1], portal.Vertices, portal.VertexCount);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Generates a scene from the settings, writes it out as Stress.sceneb and loads it like any other.
+/// The first GetStressMovingCount entities then get a Motion component of their own.
+/// </summary>
+/// <returns>False if the settings were rejected or the scene couldn't be written or loaded</returns>
+bool Game::LoadStressScene(const StressSceneSettings& settings)
+{
+	SceneBuilder builder;
+	std::string error;
+	if (!BuildStressScene(settings, builder, error))
+	{
+		printf("Stress scene: %s\n", error.c_str());
+		return false;
+	}
+
+	std::filesystem::path binaryPath = FixPath("Stress.sceneb");
+	pvsPath = FixPath("Stress.pvs");
+	int firstEntity = (int)gameEntities.size();
+	if (!builder.Write(binaryPath) || !LoadSceneFile(binaryPath))
+	{
+		printf("Stress scene: couldn't write %s\n", binaryPath.string().c_str());
+		return false;
+	}
+
+	//Each of these moves the entity to another archetype, the scene graph catches up on the first Update
+	int moving = GetStressMovingCount(settings);
+	for (int i = 0; i < moving; i++)
+	{
+		Entity entity = gameEntities[firstEntity + i].GetEntity();
+		Motion motion;
+		motion.Origin = world.GetComponent<Transform>(entity)->GetPosition();
+		motion.Radius = 0.5f + (i % 7) * 0.25f;
+		motion.Speed = 0.5f + (i % 5) * 0.25f;
+		motion.Phase = i * 2.39996f; //Golden angle, so neighbours never move in step
+		world.AddComponent(entity, motion);
+	}
+	return true;
+}
+
+/// <summary>
+/// Creates Material and Adds It To Materials List
+/// </summary>
+/// <param name="_vs"></param>
+/// <param name="_ps"></param>
+/// <param name="_colorTint"></param>
+void Game::CreateMaterial(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT4 _colorTint, float _roughness)
+{
+	materials.push_back(materialPool.Create(_vs, _ps, _colorTint, _roughness));
+}
+
+/// <summary>
+/// Creates an object in the world, and adds a handle to it to the game entities list
+/// </summary>
 /// <param name="mesh"></param>
 /// <param name="mat"></param>
-void Game::CreateGameEntity(Mesh mesh, Material mat)
+void Game::CreateGameEntity(Handle<Mesh> mesh, Handle<Material> mat)
+{
+	Entity entity = world.CreateEntity(Transform(), Renderable{ mesh, mat }, meshPool.Get(mesh)->GetLocalBounds(), HierarchyNode{ -1 });
+	int node = sceneGraph.AddNode(world.GetComponent<Transform>(entity));
+	world.GetComponent<HierarchyNode>(entity)->Node = node;
+	if (node >= (int)entityOfNode.size())
+	{
+		entityOfNode.resize(node + 1);
+	}
+	entityOfNode[node] = entity.Index;
+	gameEntities.push_back(GameEntity(&world, entity));
+	boundStructuralVersion = world.GetStructuralVersion();
+}
+
+/// <summary>
+/// Refreshes one entity's matrices and world bounds from its entity index
+/// </summary>
+void Game::UpdateEntityBounds(uint32_t index)
 {
-	gameEntities.push_back(std::make_shared<GameEntity>(mesh, mat));
+	Entity entity = world.GetEntity(index);
+	Transform* transform = world.GetComponent<Transform>(entity);
+	Renderable* renderable = world.GetComponent<Renderable>(entity);
+	AABB* bounds = world.GetComponent<AABB>(entity);
+	if (transform && renderable && bounds)
+	{
+		GameEntity::Update(*transform, meshPool.Get(renderable->MeshHandle), *bounds);
+	}
+}
+
+/// <summary>
+/// Files one entity's bounds in the octree and the BVH, adding it to either if it's new
+/// </summary>
+void Game::IndexEntity(uint32_t index, const AABB& bounds)
+{
+	sceneIndex.Move((int)index, bounds);
+
+	//Entities still inside their fat leaf cost one containment test here
+	if (index >= treeProxyOfEntity.size())
+	{
+		treeProxyOfEntity.resize(index + 1, -1);
+	}
+	int& proxy = treeProxyOfEntity[index];
+	if (proxy < 0)
+	{
+		proxy = sceneTree.CreateProxy(bounds, (int)index);
+	}
+	else
+	{
+		sceneTree.MoveProxy(proxy, bounds);
+	}
+}
+
+/// <summary>
+/// Moves entities that changed this frame in the octree and the BVH. After structural
+/// changes every entity is refiled and entities that were destroyed are dropped.
+/// </summary>
+void Game::UpdateSceneIndex()
+{
+	if (indexedStructuralVersion == world.GetStructuralVersion())
+	{
+		changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).ForEach([this](uint32_t index)
+			{
+				Entity entity = world.GetEntity(index);
+				AABB* bounds = world.GetComponent<AABB>(entity);
+				if (bounds && world.HasComponent<Renderable>(entity))
+				{
+					IndexEntity(index, *bounds);
+				}
+			});
+		return;
+	}
+
+	renderQuery.ForEach([this](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+		{
+			IndexEntity(entity.Index, bounds);
+		});
+
+	indexedAlive.assign(sceneIndex.GetItemCapacity(), 0);
+	renderQuery.ForEach([this](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+		{
+			indexedAlive[entity.Index] = 1;
+		});
+	for (int item = 0; item < (int)indexedAlive.size(); item++)
+	{
+		if (!indexedAlive[item])
+		{
+			sceneIndex.Remove(item);
+
+			if (item < (int)treeProxyOfEntity.size() && treeProxyOfEntity[item] >= 0)
+			{
+				sceneTree.DestroyProxy(treeProxyOfEntity[item]);
+				treeProxyOfEntity[item] = -1;
+			}
+		}
+	}
+	indexedStructuralVersion = world.GetStructuralVersion();
+}
+
+/// <summary>
+/// Brings the culler's copy of the world bounds up to date and culls against the active camera.
+/// After structural changes every slot is refilled, otherwise only entities that moved are copied.
+/// </summary>
+void Game::UpdateCulling()
+{
+	visibilityCaches.resize(cameraList.size());
+	if (structureChanged)
+	{
+		frustumCuller.Resize(world.GetEntityCapacity());
+		frustumCuller.ClearAll();
+		renderQuery.ForEach([this](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+			{
+				frustumCuller.SetBounds(entity.Index, bounds);
+			});
+
+		for (VisibilityCache& cache : visibilityCaches)
+		{
+			cache.Invalidate();
+		}
+	}
+	else
+	{
+		changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).ForEach([this](uint32_t index)
+			{
+				Entity entity = world.GetEntity(index);
+				AABB* bounds = world.GetComponent<AABB>(entity);
+				if (bounds && world.HasComponent<Renderable>(entity))
+				{
+					frustumCuller.SetBounds(index, *bounds);
+					for (VisibilityCache& cache : visibilityCaches)
+					{
+						cache.MarkMoved(index);
+					}
+				}
+			});
+	}
+
+	//Only the active camera updates, the others keep collecting moves until they're switched back to
+	for (size_t i = 0; i < cameraList.size(); i++)
+	{
+		if (cameraList[i] == activeCamera)
+		{
+			activeVisibility = &visibilityCaches[i];
+		}
+	}
+
+	Camera* camera = cameraPool.Get(activeCamera);
+	if (cullAllCameras)
+	{
+		Frustum frusta[CULL_MAX_VIEWS];
+		frusta[0] = FrustumFromMatrix(camera->GetViewProjection());
+		culledViewCount = 1;
+		for (size_t i = 0; i < cameraList.size() && culledViewCount < cullViewLimit; i++)
+		{
+			if (!(cameraList[i] == activeCamera))
+			{
+				frusta[culledViewCount++] = FrustumFromMatrix(cameraPool.Get(cameraList[i])->GetViewProjection());
+			}
+		}
+		frustumCuller.CullViews(frusta, culledViewCount, &jobSystem);
+		cameraVisible = frustumCuller.GetViewVisible(0);
+		cameraVisibleCount = frustumCuller.GetViewVisibleCount(0);
+
+		//The caches didn't see this frame's moves
+		for (VisibilityCache& cache : visibilityCaches)
+		{
+			cache.Invalidate();
+		}
+		return;
+	}
+
+	activeVisibility->SetValidation(validateVisibility);
+	activeVisibility->Update(frustumCuller, FrustumFromMatrix(camera->GetViewProjection()), camera->GetTransform()->GetPosition(), &jobSystem);
+	cameraVisible = activeVisibility->GetVisible();
+	cameraVisibleCount = activeVisibility->GetVisibleCount();
+
+	const VisibilityCacheStats& stats = activeVisibility->GetStats();
+	visibilityFrames++;
+	visibilityRefreshTotal += stats.FullRefresh ? 1 : 0;
+	visibilityRetestedTotal += stats.Retested;
+	visibilitySkippedTotal += stats.Skipped;
+	visibilityMismatchTotal += stats.Mismatches;
+}
+
+/// <summary>
+/// Keeps every entity's cell up to date, walks the portals from the active camera and filters
+/// the frustum's list down to what they let through. Cells are found again for whatever moved.
+/// </summary>
+void Game::UpdatePortals()
+{
+	if (portalSystem.GetCellCount() == 0)
+	{
+		return;
+	}
+
+	if (structureChanged)
+	{
+		portalSystem.ResizeEntities(world.GetEntityCapacity());
+		renderQuery.ForEach([this](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+			{
+				portalSystem.AssignEntity(entity.Index, bounds);
+			});
+	}
+	else
+	{
+		changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).ForEach([this](uint32_t index)
+			{
+				Entity entity = world.GetEntity(index);
+				AABB* bounds = world.GetComponent<AABB>(entity);
+				if (bounds && world.HasComponent<Renderable>(entity))
+				{
+					portalSystem.AssignEntity(index, *bounds);
+				}
+			});
+	}
+
+	if (!portalsEnabled)
+	{
+		return;
+	}
+
+	Camera* camera = cameraPool.Get(activeCamera);
+	portalSystem.Update(camera->GetViewProjection(), camera->GetTransform()->GetPosition());
+	portalSystem.Filter(frustumCuller, cameraVisible, cameraVisibleCount);
+
+	portalTestedTotal += cameraVisibleCount;
+	portalCulledTotal += cameraVisibleCount - portalSystem.GetVisibleCount();
+	cameraVisible = portalSystem.GetVisible();
+	cameraVisibleCount = portalSystem.GetVisibleCount();
+}
+
+/// <summary>
+/// Keys everything in drawList by shader, material, mesh level and distance, then sorts them. Shader
+/// pairs are numbered again whenever a material changed, in dense order, which is all that needs to stay put.
+/// </summary>
+void Game::UpdateRenderQueue()
+{
+	if ((int)materialShaderIds.size() != materialPool.GetCount() || !changeJournal.Get(CHANGE_CHANNEL_MATERIAL).IsEmpty())
+	{
+		std::vector<std::pair<SimpleVertexShader*, SimplePixelShader*>> pairs;
+		materialShaderIds.resize(materialPool.GetCount());
+		for (int i = 0; i < materialPool.GetCount(); i++)
+		{
+			Material& material = materialPool.GetData()[i];
+			std::pair<SimpleVertexShader*, SimplePixelShader*> shaders(material.GetVS(), material.GetPS());
+			auto found = std::find(pairs.begin(), pairs.end(), shaders);
+			materialShaderIds[i] = (uint32_t)(found - pairs.begin());
+			if (found == pairs.end())
+			{
+				pairs.push_back(shaders);
+			}
+		}
+	}
+
+	XMFLOAT3 eye = cameraPool.Get(activeCamera)->GetTransform()->GetPosition();
+	int count = (int)drawList.size();
+	renderQueue.Resize(count);
+	JobCounter counter;
+	jobSystem.ParallelFor(count, [this, eye](int start, int end)
+		{
+			for (int i = start; i < end; i++)
+			{
+				uint32_t index = drawList[i];
+				Entity entity = world.GetEntity(index);
+				Renderable* renderable = world.GetComponent<Renderable>(entity);
+				AABB* bounds = world.GetComponent<AABB>(entity);
+				Material* material = materialPool.Get(renderable->MaterialHandle);
+				uint32_t materialIndex = (uint32_t)(material - materialPool.GetData());
+				Handle<Mesh> mesh = GetLodMesh(renderable->MeshHandle, lodSelector.GetLevel(index));
+
+				XMFLOAT3 offset(bounds->Center.x - eye.x, bounds->Center.y - eye.y, bounds->Center.z - eye.z);
+				float distance = sqrtf(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+				bool translucent = material->GetColorTint().w < 1.0f;
+				renderQueue.Set(i, RenderQueue::MakeKey(0, translucent, materialShaderIds[materialIndex], materialIndex, mesh.Index, distance / DRAW_SORT_DEPTH_RANGE), index);
+			}
+		}, &counter, 256);
+	jobSystem.Wait(&counter);
+
+	if (sortDraws)
+	{
+		renderQueue.Sort(&jobSystem);
+		stateChangesBeforeTotal += renderQueue.GetStats().StateChangesBefore;
+		stateChangesAfterTotal += renderQueue.GetStats().StateChangesAfter;
+	}
+}
+
+/// <summary>
+/// Cuts the sorted queue into runs sharing a mesh and material and gathers each instanced run's matrices.
+/// With instancing off nothing counts as instancable, so it all comes out as one batch drawn one at a time.
+/// </summary>
+void Game::UpdateInstancing()
+{
+	int count = renderQueue.GetCount();
+	const uint32_t* draws = renderQueue.GetValues();
+	instanceDraws.resize(count);
+	JobCounter counter;
+	jobSystem.ParallelFor(count, [this, draws](int start, int end)
+		{
+			for (int i = start; i < end; i++)
+			{
+				uint32_t index = draws[i];
+				Renderable* renderable = world.GetComponent<Renderable>(world.GetEntity(index));
+				Material* material = materialPool.Get(renderable->MaterialHandle);
+				Handle<Mesh> mesh = GetLodMesh(renderable->MeshHandle, lodSelector.GetLevel(index));
+				instanceDraws[i] = { mesh.Index, (uint32_t)(material - materialPool.GetData()), instancingEnabled && material->GetInstancedVS() != nullptr };
+			}
+		}, &counter, 256);
+	jobSystem.Wait(&counter);
+
+	instanceBatcher.Build(instanceDraws.data(), count);
+
+	const InstanceBatch* batches = instanceBatcher.GetBatches();
+	instanceData.resize(instanceBatcher.GetInstanceCount());
+	jobSystem.ParallelFor(instanceBatcher.GetBatchCount(), [this, draws, batches](int start, int end)
+		{
+			for (int b = start; b < end; b++)
+			{
+				const InstanceBatch& batch = batches[b];
+				for (int i = 0; batch.Instanced && i < batch.Count; i++)
+				{
+					Transform* transform = world.GetComponent<Transform>(world.GetEntity(draws[batch.First + i]));
+					instanceData[batch.FirstInstance + i] = { transform->GetWorldMatrix(), transform->GetInverseTransposeMatrix() };
+				}
+			}
+		}, &counter, 16);
+	jobSystem.Wait(&counter);
+
+	instanceFrames++;
+	queuedDrawsTotal += instanceBatcher.GetStats().Draws;
+	drawCallsTotal += instanceBatcher.GetStats().DrawCalls;
+}
+
+/// <summary>
+/// Copies this frame's instances to the GPU, growing the buffer to half again what's needed when it's too small
+/// </summary>
+void Game::UploadInstances()
+{
+	int count = (int)instanceData.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (count > instanceBufferCapacity)
+	{
+		instanceBufferCapacity = count + count / 2;
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC; //Rewritten every frame
+		desc.ByteWidth = sizeof(InstanceData) * instanceBufferCapacity;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		instanceBuffer.Reset();
+		Graphics::Device->CreateBuffer(&desc, nullptr, instanceBuffer.GetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(Graphics::Context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, instanceData.data(), sizeof(InstanceData) * count);
+		Graphics::Context->Unmap(instanceBuffer.Get(), 0);
+	}
+}
+
+/// <summary>
+/// Finds every light's shadow casters for the active camera among the culler's bounds
+/// </summary>
+void Game::UpdateShadowCasters()
+{
+	if (!shadowCastersEnabled)
+	{
+		return;
+	}
+
+	Camera* camera = cameraPool.Get(activeCamera);
+	shadowCasterCuller.Update(camera->GetView(), camera->GetProjection(), lightPool.GetData(), lightPool.GetCount(),
+		shadowCasterSettings, frustumCuller, &jobSystem);
+
+	shadowFrames++;
+	shadowInVolumeTotal += shadowCasterCuller.GetInVolumeTotal();
+	shadowCasterTotal += shadowCasterCuller.GetCasterTotal();
+}
+
+/// <summary>
+/// Bakes if asked to, drops baked entities that moved, then keeps only what the camera's cell sees
+/// out of what the earlier passes let through
+/// </summary>
+void Game::UpdatePvs()
+{
+	if (pvsBakeRequested)
+	{
+		pvsBakeRequested = false;
+		BakePvs();
+	}
+	else if (!pvs.IsEmpty() && world.GetStructuralVersion() != pvsStructuralVersion)
+	{
+		pvs.Clear();
+	}
+	else if (!pvs.IsEmpty())
+	{
+		changeJournal.Get(CHANGE_CHANNEL_TRANSFORM).ForEach([this](uint32_t index)
+			{
+				pvs.Forget(index);
+			});
+	}
+
+	pvsCameraCell = PVS_NO_CELL;
+	if (!pvsEnabled || pvs.IsEmpty())
+	{
+		return;
+	}
+
+	pvsCameraCell = pvs.FindCell(cameraPool.Get(activeCamera)->GetTransform()->GetPosition());
+	int kept = pvs.Filter(pvsCameraCell, cameraVisible, cameraVisibleCount);
+
+	pvsFrames++;
+	pvsFrustumTotal += cameraVisibleCount;
+	pvsSetTotal += pvsCameraCell == PVS_NO_CELL ? cameraVisibleCount : pvs.GetSetSize(pvsCameraCell);
+	pvsKeptTotal += kept;
+	cameraVisible = pvs.GetVisible();
+	cameraVisibleCount = kept;
+}
+
+/// <summary>
+/// Hands every entity without Motion to the baker, with the triangles of the occluders among them.
+/// A single bake loads the saved set instead if it came from the same scene and settings, several
+/// are all baked for the report. Whatever was baked last is saved and kept.
+/// </summary>
+void Game::BakePvs()
+{
+	pvsBaker.Clear();
+	renderQuery.ForEach([this](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds)
+		{
+			if (world.HasComponent<Motion>(entity))
+			{
+				return;
+			}
+
+			pvsBaker.AddObject(entity.Index, bounds);
+			Mesh* mesh = meshPool.Get(renderable.MeshHandle);
+			if (world.HasComponent<Occluder>(entity) && !mesh->GetIndices().empty())
+			{
+				pvsBaker.AddOccluder(mesh->GetPositions().data(), mesh->GetIndices().data(), (int)mesh->GetIndices().size(), transform.GetWorldMatrix(), entity.Index);
+			}
+		});
+	pvsStructuralVersion = world.GetStructuralVersion();
+
+	std::vector<float> sizes;
+	sizes.swap(pvsPendingSizes);
+	if (sizes.empty())
+	{
+		sizes.push_back(pvsSettings.CellSize);
+		if (pvs.Load(pvsPath) && pvs.GetSourceHash() == pvsBaker.GetSourceHash(pvsSettings))
+		{
+			printf("PVS: loaded %s, %d cells\n", pvsPath.string().c_str(), pvs.GetCellCount());
+			return;
+		}
+	}
+
+	for (float size : sizes)
+	{
+		std::string error;
+		pvsSettings.CellSize = size;
+		if (!pvsBaker.Bake(pvsSettings, pvs, &jobSystem, error))
+		{
+			printf("PVS: %s\n", error.c_str());
+			pvs.Clear();
+			continue;
+		}
+
+		const PvsBakeStats& bake = pvsBaker.GetStats();
+		pvsBakes.push_back(bake);
+		printf("PVS: cell size %.1f, %d cells, %llu rays, %.2fs, %d unique sets, %.1f KB, %.1f visible per cell\n",
+			bake.CellSize, bake.Cells, (unsigned long long)bake.Rays, bake.Seconds, bake.UniqueSets, bake.Bytes / 1024.0, bake.AverageVisible);
+	}
+
+	if (!pvs.IsEmpty() && !pvs.Save(pvsPath))
+	{
+		printf("PVS: couldn't write %s\n", pvsPath.string().c_str());
+	}
+}
+
+/// <summary>
+/// Outlines the part of the screen each visible cell was seen through, drawn behind the UI windows
+/// </summary>
+void Game::DrawPortalOverlay()
+{
+	ImDrawList* overlay = ImGui::GetBackgroundDrawList();
+	float width = (float)Window::Width();
+	float height = (float)Window::Height();
+	for (int i = 0; i < portalSystem.GetVisibleCellCount(); i++)
+	{
+		int cell = portalSystem.GetVisibleCells()[i];
+		const PortalRect& rect = portalSystem.GetCellRect(cell);
+		ImVec2 min((rect.MinX * 0.5f + 0.5f) * width, (0.5f - rect.MaxY * 0.5f) * height);
+		ImVec2 max((rect.MaxX * 0.5f + 0.5f) * width, (0.5f - rect.MinY * 0.5f) * height);
+		ImU32 color = cell == portalSystem.GetStats().CameraCell ? IM_COL32(255, 255, 0, 255) : IM_COL32(0, 255, 128, 255);
+		overlay->AddRect(min, max, color);
+
+		char label[16];
+		snprintf(label, sizeof(label), "%d", cell);
+		overlay->AddText(ImVec2(min.x + 4, min.y + 2), color, label);
+	}
+}
+
+/// <summary>
+/// Selects levels for everything the active camera's frustum let through
+/// </summary>
+void Game::UpdateLod()
+{
+	Camera* camera = cameraPool.Get(activeCamera);
+	lodSelector.SetView(camera->GetTransform()->GetPosition(), camera->GetProjection(), (float)Window::Height());
+	lodSelector.Select(frustumCuller, cameraVisible, cameraVisibleCount, lodEnabled ? lodSettings : LodSettings::Disabled(), &jobSystem);
+}
+
+/// <summary>
+/// Follows the mesh's LOD chain down to the level, stopping early at the coarsest mesh it has
+/// </summary>
+Handle<Mesh> Game::GetLodMesh(Handle<Mesh> mesh, int level)
+{
+	for (; level > 0 && mesh.Index < meshLods.size() && !meshLods[mesh.Index].IsNull(); level--)
+	{
+		mesh = meshLods[mesh.Index];
+	}
+	return mesh;
+}
+
+/// <summary>
+/// Rasterizes the occluders inside the frustum, then tests everything the LOD pass kept
+/// against them in parallel. What passes goes into drawList, still in entity order.
+/// </summary>
+void Game::UpdateOcclusion()
+{
+	const uint32_t* visible = lodSelector.GetSelected();
+	int visibleCount = lodSelector.GetSelectedCount();
+	drawList.assign(visible, visible + visibleCount);
+	lastOccludedCount = 0;
+	if (!occlusionEnabled || occluderQuery.Count() == 0)
+	{
+		return;
+	}
+
+	XMFLOAT4X4 viewProjection = cameraPool.Get(activeCamera)->GetViewProjection();
+	Frustum frustum = FrustumFromMatrix(viewProjection);
+	occlusionCuller.Begin(viewProjection);
+	occluderQuery.ForEach([this, &frustum](Entity entity, Transform& transform, Renderable& renderable, AABB& bounds, Occluder& occluder)
+		{
+			Mesh* mesh = meshPool.Get(renderable.MeshHandle);
+			if (FrustumIntersectsAABB(frustum, bounds) && !mesh->GetIndices().empty())
+			{
+				occlusionCuller.AddOccluder(mesh->GetPositions().data(), mesh->GetIndices().data(), (int)mesh->GetIndices().size(), transform.GetWorldMatrix());
+			}
+		});
+	occlusionCuller.Rasterize(&jobSystem);
+
+	//Read only from here on, so the tests split across the workers without locking
+	occlusionResults.resize(visibleCount);
+	JobCounter counter;
+	jobSystem.ParallelFor(visibleCount, [this, visible](int start, int end)
+		{
+			for (int i = start; i < end; i++)
+			{
+				occlusionResults[i] = occlusionCuller.IsVisible(*world.GetComponent<AABB>(world.GetEntity(visible[i])));
+			}
+		}, &counter, 256);
+	jobSystem.Wait(&counter);
+
+	int count = 0;
+	for (int i = 0; i < visibleCount; i++)
+	{
+		if (occlusionResults[i])
+		{
+			drawList[count++] = visible[i];
+		}
+	}
+	drawList.resize(count);
+
+	lastOccludedCount = visibleCount - count;
+	occlusionTestedTotal += visibleCount;
+	occlusionCulledTotal += lastOccludedCount;
+}
+
+/// <summary>
+/// Puts the simulation back the way it was at the end of a recorded frame, then captures
+/// again and compares hashes to check everything really came back
+/// </summary>
+Game::RestoreResult Game::RestoreSnapshot(uint32_t frame)
+{
+	std::vector<unsigned char> snapshot;
+	if (!snapshotHistory.Get(frame, snapshot) || !simulationState.Restore(snapshot))
+	{
+		return RestoreResult::Failed;
+	}
+
+	//Light data lives in the shaders, so make sure it gets sent again
+	for (int i = 0; i < lightPool.GetCount(); i++)
+	{
+		changeJournal.Mark(CHANGE_CHANNEL_LIGHT, i);
+	}
+
+	std::vector<unsigned char> check;
+	simulationState.Capture(frame, check);
+	SnapshotHeader header;
+	std::memcpy(&header, snapshot.data(), sizeof(header));
+
+	//The structural version is part of the hash, so only compare when it hasn't moved on
+	if (header.StructuralVersion != world.GetStructuralVersion())
+	{
+		return RestoreResult::NotCompared;
+	}
+	return SimulationState::Hash(check) == SimulationState::Hash(snapshot) ? RestoreResult::Matched : RestoreResult::Mismatched;
+}
+
+/// <summary>
+/// Rewinds to a recorded frame and steps the frames after it again, checking each one comes
+/// out hashing the same as it was recorded. Benchmark frames all step the same amount, so
+/// nothing but the state itself can make them differ.
+/// </summary>
+/// <returns>False if the restore or any replayed frame didn't match</returns>
+bool Game::CheckRewind(int frames)
+{
+	frames = std::min(frames, snapshotHistory.GetCount() - 1);
+	uint32_t newest = snapshotHistory.GetNewestFrame();
+	uint32_t start = newest - frames;
+
+	std::vector<uint64_t> expected;
+	std::vector<unsigned char> snapshot;
+	for (uint32_t frame = start; frame <= newest; frame++)
+	{
+		if (!snapshotHistory.Get(frame, snapshot))
+		{
+			return false;
+		}
+		expected.push_back(SimulationState::Hash(snapshot));
+	}
+
+	if (RestoreSnapshot(start) != RestoreResult::Matched)
+	{
+		return false;
+	}
+
+	//Replayed frames are compared by hand rather than pushed again over the ones being compared against
+	bool recording = recordHistory;
+	recordHistory = false;
+	simulationFrame = start + 1;
+
+	bool matched = true;
+	for (int i = 1; i <= frames && matched; i++)
+	{
+		Update(BENCHMARK_FIXED_DELTA_TIME, 0);
+		simulationState.Capture(start + i, snapshot);
+		matched = SimulationState::Hash(snapshot) == expected[i];
+	}
+
+	recordHistory = recording;
+	return matched;
+}
+
+/// <summary>
+/// Rows move around in the world whenever entities are created, destroyed or change
+/// components, so point the scene graph back at wherever each transform lives now
+/// </summary>
+void Game::RebindHierarchy()
+{
+	if (boundStructuralVersion == world.GetStructuralVersion())
+	{
+		return;
+	}
+
+	hierarchyQuery.ForEach([this](Entity entity, Transform& transform, HierarchyNode& node)
+		{
+			if (node.Node >= 0 && sceneGraph.GetTransform(node.Node) != &transform)
+			{
+				sceneGraph.SetTransform(node.Node, &transform);
+			}
+		});
+	boundStructuralVersion = world.GetStructuralVersion();
 }
 
 /// <summary>
@@ -538,7 +1970,7 @@ void Game::CreateGameEntity(Mesh mesh, Material mat)
 /// <param name="aspectRatio"></param>
 void Game::CreateCamera(DirectX::XMFLOAT3 pos, float moveSpeed, float lookSpeed, float fov, float aspectRatio)
 {
-	cameraList.push_back(std::make_shared<Camera>(pos, moveSpeed, lookSpeed, fov, aspectRatio));
+	cameraList.push_back(cameraPool.Create(pos, moveSpeed, lookSpeed, fov, aspectRatio));
 }
 
 
@@ -4,18 +4,46 @@
 #include <memory>
 #include <DirectXMath.h>
 #include "Transform.h"
+#include "TransformHierarchy.h"
 #include "GameEntity.h"
+#include "ECS.h"
+#include "Handle.h"
+#include "LooseOctree.h"
+#include "SpatialHashGrid.h"
+#include "DynamicAABBTree.h"
 #include "Camera.h"
 #include "SimpleShader.h"
 #include "Material.h"
 #include "WICTextureLoader.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "JobSystem.h"
+#include "TaskGraph.h"
+#include "Memory.h"
+#include "SceneFile.h"
+#include "ChangeJournal.h"
+#include "SimulationState.h"
+#include "SnapshotHistory.h"
+#include "StressScene.h"
+#include "Benchmark.h"
+#include "FrustumCuller.h"
+#include "VisibilityCache.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "PortalSystem.h"
+#include "PotentiallyVisibleSet.h"
+#include "PvsBaker.h"
+#include "ShadowCasterCuller.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
 
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <vector>
 
+#define SNAPSHOT_HISTORY_FRAMES 120 //Frames of simulation state kept for rewinding
+#define DRAW_SORT_DEPTH_RANGE 1000.0f //Distance the render queue's depth field spans, the camera's far plane
+
 class Game
 {
 public:
@@ -26,15 +54,28 @@ public:
 	Game& operator=(const Game&) = delete; // Remove copy-assignment operator
 
 	// Primary functions
-	void Initialize();
+	void Initialize(const BenchmarkSettings& settings = BenchmarkSettings());
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 	void OnResize();
 
+	//False once a headless run's check has failed
+	bool GetChecksPassed() { return benchmark.GetChecksPassed(); }
+
 private:
 
 	Transform transform;
 
+	//Worker threads for per entity work
+	JobSystem jobSystem;
+
+	//Per frame systems, built once in Initialize
+	TaskGraph updateGraph = TaskGraph(&jobSystem);
+	TaskGraph drawGraph = TaskGraph(&jobSystem);
+	float frameDeltaTime = 0;
+	float frameTotalTime = 0;
+	void BuildFrameGraphs();
+
 	//Gui Helper Methods
 	void UpdateImGui(float deltaTime);
 	void BuildUI();
@@ -42,9 +83,11 @@ private:
 
 	//Game Class Helper Methods
 	void CreateGeometry();
-	void MeshLoaderShell();
+	bool LoadScene(const std::string& name);
+	bool LoadSceneFile(const std::filesystem::path& binaryPath);
+	bool LoadStressScene(const StressSceneSettings& settings);
 	void CreateMaterial(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT4 _colorTint, float _roughness);
-	void CreateGameEntity(Mesh mesh, Material mat);
+	void CreateGameEntity(Handle<Mesh> mesh, Handle<Material> mat);
 	void CreateCamera(DirectX::XMFLOAT3 pos, float moveSpeed, float lookSpeed, float fov, float aspectRatio);
 
 	//Gui Variables
@@ -59,38 +102,222 @@ private:
 
 	float color[4];
 
+	//Every entity's components live in here
+	World world;
+
+	//Structural changes recorded during the frame, applied at the start of the next update
+	CommandBuffer commandBuffer;
+
+	//Queries the per frame systems run over
+	Query<Transform, Renderable, AABB> renderQuery = Query<Transform, Renderable, AABB>(&world);
+	Query<Transform, HierarchyNode> hierarchyQuery = Query<Transform, HierarchyNode>(&world);
+	Query<Transform, Motion> motionQuery = Query<Transform, Motion>(&world);
+	Query<Transform, Renderable, AABB, Occluder> occluderQuery = Query<Transform, Renderable, AABB, Occluder>(&world);
+
+	//Seconds of simulated time the Motion stage has run for
+	float motionTime = 0;
+
 	//Mesh List
-	std::vector<std::shared_ptr<GameEntity>> gameEntities;
+	std::vector<GameEntity> gameEntities;
+
+	//Parent/child links between entity transforms
+	TransformHierarchy sceneGraph;
+	unsigned int boundStructuralVersion = 0;
+	void RebindHierarchy();
+
+	//Entity world bounds, keyed by entity index
+	LooseOctree sceneIndex = LooseOctree(DirectX::XMFLOAT3(0, 0, 0), 256.0f);
+
+	//The same bounds in a BVH, proxies looked up by entity index
+	DynamicAABBTree sceneTree;
+	std::vector<int> treeProxyOfEntity;
+	unsigned int indexedStructuralVersion = 0;
+	std::vector<unsigned char> indexedAlive;
+	std::vector<int> indexQueryResults;
+	void UpdateSceneIndex();
+
+	//Entity positions rebuilt into a hash grid whenever anything moves, ids map back through gridEntities
+	SpatialHashGrid pointGrid = SpatialHashGrid(2.0f);
+	std::vector<Entity> gridEntities;
+
+	//World bounds in SoA form keyed by entity index. Every camera keeps its own cache of what it
+	//saw over them, so it only retests what moved or sits near the edge of its frustum.
+	FrustumCuller frustumCuller;
+	std::vector<VisibilityCache> visibilityCaches; //Same order as cameraList
+	VisibilityCache* activeVisibility = nullptr;
+	bool validateVisibility = false;
+	float cameraTurnRate = 0.0f; //Headless runs turn the camera themselves, nobody is at the mouse
+	uint64_t visibilityFrames = 0;
+	uint64_t visibilityRefreshTotal = 0;
+	uint64_t visibilityRetestedTotal = 0;
+	uint64_t visibilitySkippedTotal = 0;
+	uint64_t visibilityMismatchTotal = 0;
+	void UpdateCulling();
+
+	//Or every camera culled in one multi view pass, which split screen, shadow and reflection views would share
+	bool cullAllCameras = false;
+	int cullViewLimit = CULL_MAX_VIEWS;
+	int culledViewCount = 0; //View 0 is the active camera, the rest follow cameraList
+
+	//What the active camera sees this frame, from whichever of the two ran
+	const uint32_t* cameraVisible = nullptr;
+	int cameraVisibleCount = 0;
+
+	//Cells and portals from the scene. What the frustum let through is cut down to what can be
+	//seen through the portals from the camera's cell. Does nothing for scenes without cells.
+	PortalSystem portalSystem;
+	bool portalsEnabled = true;
+	bool portalOverlay = false;
+	uint64_t portalTestedTotal = 0;
+	uint64_t portalCulledTotal = 0;
+	void UpdatePortals();
+	void DrawPortalOverlay();
+
+	//Baked visibility for whatever doesn't move, saved next to the scene and baked again when it
+	//no longer matches. Entities that moved since, or were never baked, always pass. Any structural
+	//change throws it away, entity indices might not mean the same thing after one.
+	PotentiallyVisibleSet pvs;
+	PvsBaker pvsBaker;
+	PvsBakeSettings pvsSettings;
+	std::filesystem::path pvsPath;
+	std::vector<float> pvsPendingSizes; //Cell sizes to bake on the next update, all but the last only for the report
+	bool pvsBakeRequested = false;
+	bool pvsEnabled = true;
+	unsigned int pvsStructuralVersion = 0;
+	int pvsCameraCell = PVS_NO_CELL;
+	std::vector<PvsBakeStats> pvsBakes;
+	size_t pvsBakesRequested = 0; //Sizes asked for on the command line, each should have baked
+	uint64_t pvsFrames = 0;
+	uint64_t pvsFrustumTotal = 0;
+	uint64_t pvsSetTotal = 0;
+	uint64_t pvsKeptTotal = 0;
+	void UpdatePvs();
+	void BakePvs();
+
+	//Picks a mesh level for everything the camera sees and drops what's too small to matter.
+	//meshLods maps a mesh handle's index to its next coarser mesh, from the scene file.
+	LodSelector lodSelector;
+	LodSettings lodSettings;
+	bool lodEnabled = true;
+	std::vector<Handle<Mesh>> meshLods;
+	void UpdateLod();
+	Handle<Mesh> GetLodMesh(Handle<Mesh> mesh, int level);
+
+	//Occluders in view are rasterized on the CPU and whatever the LOD pass kept is tested
+	//against them. drawList is what survives, it's what Submit draws.
+	OcclusionCuller occlusionCuller;
+	bool occlusionEnabled = true;
+	std::vector<uint32_t> drawList;
+	std::vector<unsigned char> occlusionResults;
+	int lastOccludedCount = 0;
+	uint64_t occlusionTestedTotal = 0;
+	uint64_t occlusionCulledTotal = 0;
+	void UpdateOcclusion();
+
+	//drawList as sort keys, so Submit goes shader by shader and material by material with opaque
+	//draws front to back. materialShaderIds numbers each material's shader pair, by dense index.
+	RenderQueue renderQueue;
+	bool sortDraws = true;
+	std::vector<uint32_t> materialShaderIds;
+	uint64_t stateChangesBeforeTotal = 0;
+	uint64_t stateChangesAfterTotal = 0;
+	void UpdateRenderQueue();
+
+	//Binds the state cache sent on and dropped over Submit, summed over every frame
+	uint64_t stateCallFrames = 0;
+	uint64_t stateCallsIssuedTotal = 0;
+	uint64_t stateCallsElidedTotal = 0;
+
+	//Runs of the render queue sharing a mesh and material, each drawn as one instanced draw.
+	//instanceData is filled on the update side and uploaded by Submit, growing instanceBuffer.
+	InstanceBatcher instanceBatcher;
+	bool instancingEnabled = true;
+	std::vector<InstanceDraw> instanceDraws;
+	std::vector<InstanceData> instanceData;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	int instanceBufferCapacity = 0;
+	uint64_t instanceFrames = 0;
+	uint64_t queuedDrawsTotal = 0;
+	uint64_t drawCallsTotal = 0;
+	void UpdateInstancing();
+	void UploadInstances();
+
+	//What every spot and directional light would draw into its shadow maps. Nothing renders
+	//shadows yet, so it's off unless asked for and only the counts are used.
+	ShadowCasterCuller shadowCasterCuller;
+	ShadowCasterSettings shadowCasterSettings;
+	bool shadowCastersEnabled = false;
+	uint64_t shadowFrames = 0;
+	uint64_t shadowInVolumeTotal = 0;
+	uint64_t shadowCasterTotal = 0;
+	void UpdateShadowCasters();
+
+	//What changed this frame, cleared at the start of every Update
+	ChangeJournal changeJournal;
+	std::vector<uint32_t> entityOfNode; //Scene graph node -> entity index
+	unsigned int frameStructuralVersion = 0;
+	bool structureChanged = true; //Set when entities were added, removed or moved between archetypes
+	int lastChangeCounts[CHANGE_CHANNEL_COUNT] = {};
+	void UpdateEntityBounds(uint32_t index);
+	void IndexEntity(uint32_t index, const AABB& bounds);
+
+	//Global heap allocations made over the whole previous frame
+	uint64_t frameStartAllocations = 0;
+	uint64_t lastFrameAllocations = 0;
+
+	//Made by Update and Draw over every benchmark frame after warmup, which should be none
+	uint64_t steadyAllocationsTotal = 0;
+
+	//Owned resources, everything else refers to these through handles
+	HandlePool<Mesh> meshPool;
+	HandlePool<Material> materialPool;
+	HandlePool<Camera> cameraPool;
+	HandlePool<Light> lightPool;
 
 	//Camera List
-	std::vector<std::shared_ptr<Camera>> cameraList;
+	std::vector<Handle<Camera>> cameraList;
 
 	//Game Entities
 	std::shared_ptr<GameEntity> triangle;
 
 	//camera
-	std::shared_ptr<Camera> activeCamera;
+	Handle<Camera> activeCamera;
 
-	//Shaders
-	std::shared_ptr<SimpleVertexShader> vs;
-	std::shared_ptr<SimplePixelShader> ps;
+	//Simulation state captured at the end of every Update, so recent frames can be restored
+	MaterialPoolState materialState = MaterialPoolState(&materialPool);
+	SimulationState simulationState = SimulationState(&world, &cameraPool, &lightPool, &materialState, &activeCamera, &motionTime);
+	SnapshotHistory snapshotHistory = SnapshotHistory(SNAPSHOT_HISTORY_FRAMES);
+	std::vector<unsigned char> snapshotBuffer;
+	uint32_t simulationFrame = 0;
+	bool recordHistory = true;
+	int rewindFrames = 1;
 
-	//Materials
-	std::vector<std::shared_ptr<Material>> materials;
+	//How a restore went. Its state is captured again and hashed against the snapshot, unless entities
+	//were created or destroyed since, which changes the hash whatever the restore did.
+	enum class RestoreResult { None, Failed, Matched, Mismatched, NotCompared };
+	RestoreResult lastRestore = RestoreResult::None;
+	RestoreResult RestoreSnapshot(uint32_t frame);
 
-	//Mesh List For temp storage
-	std::vector<std::shared_ptr<Mesh>> temp_Meshes;
+	//Frames a headless run rewinds and steps through again at the end, checking they hash the same
+	int rewindCheckFrames = 0;
+	bool CheckRewind(int frames);
 
-	//Lighting
-	DirectX::XMFLOAT3 ambientLightColor;
+	//Set from the command line. Headless runs skip the UI and Present and time every stage.
+	bool headless = false;
+	std::string benchmarkOutput;
+	Benchmark benchmark;
 
-	std::vector<Light> lights;
+	//Shared by the sky and every scene material
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> basicSampler;
 
-	Light directionalLight;
+	//Materials
+	std::vector<Handle<Material>> materials;
 
-	Light pointLight;
+	//Meshes the scene loaded, in scene file order
+	std::vector<Handle<Mesh>> sceneMeshes;
 
-	Light spotLight;
+	//Lighting
+	DirectX::XMFLOAT3 ambientLightColor;
 
 	//SkyBox
 	std::shared_ptr<Sky> skyBox;
@@ -1,55 +1,75 @@
 #include "GameEntity.h"
 
-#include <d3d11.h>
-#include <wrl/client.h>
-#include "Game.h";
+#include "Game.h"
 
 
-GameEntity::GameEntity(Mesh _mesh, Material mat)
+GameEntity::GameEntity(World* world, Entity entity) : world(world), entity(entity)
 {
-	//Create Mesh
-	mesh = std::make_shared<Mesh>(_mesh);
+}
 
-	//Create Material
-	material = std::make_shared<Material>(mat);
+Entity GameEntity::GetEntity()
+{
+	return entity;
+}
 
-	//Create Transform
-	transform = std::make_shared<Transform>();
+Transform* GameEntity::GetTransform()
+{
+	return world->GetComponent<Transform>(entity);
+}
 
+Handle<Mesh> GameEntity::GetMesh()
+{
+	return world->GetComponent<Renderable>(entity)->MeshHandle;
 }
 
-GameEntity::~GameEntity()
+Handle<Material> GameEntity::GetMaterial()
 {
+	return world->GetComponent<Renderable>(entity)->MaterialHandle;
+}
 
+int GameEntity::GetHierarchyNode()
+{
+	HierarchyNode* node = world->GetComponent<HierarchyNode>(entity);
+	return node ? node->Node : -1;
 }
 
-std::shared_ptr<Transform> GameEntity::GetTransform()
+void GameEntity::SetHierarchyNode(int node)
 {
-	return transform;
+	world->AddComponent(entity, HierarchyNode{ node });
 }
 
-std::shared_ptr<Mesh> GameEntity::GetMesh()
+AABB GameEntity::GetWorldBounds()
 {
-	return mesh;
+	return *world->GetComponent<AABB>(entity);
 }
 
-std::shared_ptr<Material> GameEntity::GetMaterial()
+/// <summary>
+/// Refreshes the cached matrices and world bounds. Only touches this
+/// entity's own data, so entities can be updated on any thread.
+/// </summary>
+void GameEntity::Update(Transform& transform, Mesh* mesh, AABB& worldBounds)
 {
-	return material;
+	DirectX::XMFLOAT4X4 world = transform.GetWorldMatrix();
+	transform.GetInverseTransposeMatrix();
+
+	worldBounds = TransformAABB(mesh->GetLocalBounds(), world);
 }
 
-void GameEntity::Draw(std::shared_ptr<Camera> camera, float time)
+/// <summary>
+/// Everything here is a raw pointer, so drawing never touches a reference count
+/// </summary>
+void GameEntity::Draw(Transform& transform, Mesh* mesh, Material* material, Camera* camera, float time)
 {
 	material->GetPS()->SetShader();
 	material->GetVS()->SetShader();
 
-	std::shared_ptr<SimpleVertexShader> vs = material->GetVS();
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
+	SimpleVertexShader* vs = material->GetVS();
+	vs->SetMatrix4x4("world", transform.GetWorldMatrix());
 	vs->SetMatrix4x4("view", camera->GetView());
 	vs->SetMatrix4x4("projection", camera->GetProjection());
-	vs->SetMatrix4x4("worldInvTranspose", transform->GetInverseTransposeMatrix());
+	vs->SetMatrix4x4("worldInvTranspose", transform.GetInverseTransposeMatrix());
 
-	std::shared_ptr<SimplePixelShader> ps = material->GetPS();
+	SimplePixelShader* ps = material->GetPS();
 	ps->SetFloat4("colorTint", material->GetColorTint());
 	ps->SetFloat2("uvScale", material->GetUVScale());
 	ps->SetFloat2("uvOffset", material->GetUVOffset());
@@ -63,4 +83,29 @@ void GameEntity::Draw(std::shared_ptr<Camera> camera, float time)
 	mesh->Draw();
 }
 
+/// <summary>
+/// Draws every entity of a batch at once. Their world matrices are already in the instance buffer,
+/// so only what they share is set here, through the material's instanced vertex shader.
+/// </summary>
+void GameEntity::DrawInstanced(Mesh* mesh, Material* material, Camera* camera, float time, ID3D11Buffer* instances, int instanceCount, int firstInstance)
+{
+	SimpleVertexShader* vs = material->GetInstancedVS();
+	SimplePixelShader* ps = material->GetPS();
+	ps->SetShader();
+	vs->SetShader();
+
+	vs->SetMatrix4x4("view", camera->GetView());
+	vs->SetMatrix4x4("projection", camera->GetProjection());
+
+	ps->SetFloat4("colorTint", material->GetColorTint());
+	ps->SetFloat2("uvScale", material->GetUVScale());
+	ps->SetFloat2("uvOffset", material->GetUVOffset());
+	ps->SetFloat("time", time);
+
+	material->PrepareMaterial(camera->GetTransform()->GetPosition());
+
+	vs->CopyAllBufferData();
+	ps->CopyAllBufferData();
 
+	mesh->DrawInstanced(instances, sizeof(InstanceData), instanceCount, firstInstance);
+}
@@ -1,32 +1,48 @@
 #pragma once
 
-#include "Mesh.h";
-#include "Transform.h";
-#include <memory>;
+#include "Mesh.h"
+#include "Transform.h"
 #include "Camera.h"
 #include "Material.h"
+#include "Bounds.h"
+#include "Components.h"
+#include "ECS.h"
 
-#include <d3d11.h>
-#include <wrl/client.h>
+//What the instanced vertex shader reads per instance, rows as the CPU keeps them
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+};
 
+// --------------------------------------------------------
+// Lightweight handle to an entity in an ECS World. The
+// actual data lives in the world's component columns, so
+// these are cheap to copy around. Pointers returned from
+// the getters are only good until the next structural
+// change in the world.
+// --------------------------------------------------------
 class GameEntity
 {
 	public:
-		GameEntity(Mesh _mesh, Material mat);
-		~GameEntity();
+		GameEntity(World* world, Entity entity);
 
-		std::shared_ptr<Transform> GetTransform();
-		std::shared_ptr<Mesh> GetMesh();
-		std::shared_ptr<Material> GetMaterial();
+		Entity GetEntity();
+		Transform* GetTransform();
+		Handle<Mesh> GetMesh();
+		Handle<Material> GetMaterial();
 
-		void Draw(std::shared_ptr<Camera> camera, float time);
+		int GetHierarchyNode();
+		void SetHierarchyNode(int node);
 
+		AABB GetWorldBounds();
 
-	private:
-		std::shared_ptr<Mesh> mesh;
-		std::shared_ptr<Transform> transform;
-		std::shared_ptr<Material> material;
+		//Per entity work on raw components, used by the systems that iterate the world
+		static void Update(Transform& transform, Mesh* mesh, AABB& worldBounds);
+		static void Draw(Transform& transform, Mesh* mesh, Material* material, Camera* camera, float time);
+		static void DrawInstanced(Mesh* mesh, Material* material, Camera* camera, float time, ID3D11Buffer* instances, int instanceCount, int firstInstance);
 
-		Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+	private:
+		World* world;
+		Entity entity;
 };
-
@@ -122,6 +122,10 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		Context.GetAddressOf());	// Pointer to our Device Context pointer
 	if (FAILED(hr)) return hr;
 
+	// Point the state cache at the new context
+	StateContext.SetDeviceContext(Context);
+	StateCache.SetContext(&StateContext);
+
 	// We're set up
 	apiInitialized = true;
 
@@ -5,6 +5,9 @@
 #include <string>
 #include <wrl/client.h>
 
+#include "D3D11RenderContext.h"
+#include "RenderStateCache.h"
+
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
@@ -17,6 +20,11 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context;
 	inline Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain;
 
+	// Binds go through the cache, which drops the ones that
+	// change nothing before they reach the context
+	inline D3D11RenderContext StateContext;
+	inline RenderStateCache StateCache;
+
 	// Rendering buffers
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
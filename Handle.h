@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define HANDLE_INVALID_INDEX 0xFFFFFFFFu
+
+// --------------------------------------------------------
+// Typed index + generation reference into a HandlePool.
+// The generation changes whenever a slot is reused, so a
+// handle to something that was destroyed never resolves.
+// --------------------------------------------------------
+template<typename T>
+struct Handle
+{
+	uint32_t Index = HANDLE_INVALID_INDEX;
+	uint32_t Generation = 0;
+
+	bool IsNull() const { return Index == HANDLE_INVALID_INDEX; }
+	bool operator==(const Handle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// Owns objects of one type in a dense array
+//
+// Handles go through a slot table, so lookups are two array
+// reads and a generation compare. The objects themselves
+// stay packed (destroying swaps the last one into the hole),
+// so looping over the whole pool is a straight array walk.
+//
+// Pointers from Get are only good until the next Create or
+// Destroy, keep the handle instead.
+// --------------------------------------------------------
+template<typename T>
+class HandlePool
+{
+public:
+	template<typename... Args>
+	Handle<T> Create(Args&&... args)
+	{
+		uint32_t slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (uint32_t)slots.size();
+			slots.push_back({ HANDLE_INVALID_INDEX, 0 });
+		}
+
+		slots[slot].DenseIndex = (uint32_t)dense.size();
+		dense.emplace_back(std::forward<Args>(args)...);
+		denseToSlot.push_back(slot);
+
+		return { slot, slots[slot].Generation };
+	}
+
+	void Destroy(Handle<T> handle)
+	{
+		if (!IsValid(handle))
+		{
+			return;
+		}
+
+		//Move the last object into the hole so the array stays packed
+		uint32_t denseIndex = slots[handle.Index].DenseIndex;
+		uint32_t last = (uint32_t)dense.size() - 1;
+		if (denseIndex != last)
+		{
+			dense[denseIndex] = std::move(dense[last]);
+			denseToSlot[denseIndex] = denseToSlot[last];
+			slots[denseToSlot[denseIndex]].DenseIndex = denseIndex;
+		}
+		dense.pop_back();
+		denseToSlot.pop_back();
+
+		slots[handle.Index].DenseIndex = HANDLE_INVALID_INDEX;
+		slots[handle.Index].Generation++;
+		freeSlots.push_back(handle.Index);
+	}
+
+	bool IsValid(Handle<T> handle) const
+	{
+		return handle.Index < slots.size()
+			&& slots[handle.Index].Generation == handle.Generation
+			&& slots[handle.Index].DenseIndex != HANDLE_INVALID_INDEX;
+	}
+
+	//Returns null for stale or null handles
+	T* Get(Handle<T> handle)
+	{
+		return IsValid(handle) ? &dense[slots[handle.Index].DenseIndex] : nullptr;
+	}
+
+	//Handle for the object currently at a dense index
+	Handle<T> GetHandle(int denseIndex)
+	{
+		uint32_t slot = denseToSlot[denseIndex];
+		return { slot, slots[slot].Generation };
+	}
+
+	int GetCount() { return (int)dense.size(); }
+	T* GetData() { return dense.data(); }
+
+	//Range-for over every live object
+	typename std::vector<T>::iterator begin() { return dense.begin(); }
+	typename std::vector<T>::iterator end() { return dense.end(); }
+
+private:
+	struct Slot
+	{
+		uint32_t DenseIndex;
+		uint32_t Generation;
+	};
+
+	std::vector<T> dense;
+	std::vector<uint32_t> denseToSlot;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+};
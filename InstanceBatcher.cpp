@@ -0,0 +1,51 @@
+#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher() : stats{}
+{
+}
+
+/// <summary>
+/// Splits the draws, in queue order, into instanced runs and the rest
+/// </summary>
+/// <param name="minInstances">Shortest run that gets drawn instanced</param>
+/// <param name="maxInstances">Most instances in one instanced draw</param>
+void InstanceBatcher::Build(const InstanceDraw* draws, int count, int minInstances, int maxInstances)
+{
+	batches.clear();
+	stats = {};
+	stats.Draws = count;
+
+	int i = 0;
+	while (i < count)
+	{
+		const InstanceDraw& first = draws[i];
+		int end = i + 1;
+		while (first.Instancable && end < count && end - i < maxInstances && draws[end].Instancable && draws[end].Mesh == first.Mesh && draws[end].Material == first.Material)
+		{
+			end++;
+		}
+
+		int run = end - i;
+		if (first.Instancable && run >= minInstances)
+		{
+			batches.push_back({ i, run, stats.InstancedDraws, true });
+			stats.InstancedBatches++;
+			stats.InstancedDraws += run;
+			stats.DrawCalls++;
+		}
+		else
+		{
+			//Draws that go one at a time share a batch with the ones before them
+			if (!batches.empty() && !batches.back().Instanced)
+			{
+				batches.back().Count += run;
+			}
+			else
+			{
+				batches.push_back({ i, run, -1, false });
+			}
+			stats.DrawCalls += run;
+		}
+		i = end;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define INSTANCE_MIN_BATCH 2 //Runs shorter than this go out one draw at a time
+#define INSTANCE_MAX_BATCH 4096 //Runs longer than this are split into several instanced draws
+
+//One queued draw, as far as batching cares
+struct InstanceDraw
+{
+	uint32_t Mesh;
+	uint32_t Material;
+	bool Instancable; //Whether its material has an instanced vertex shader
+};
+
+//A run of queued draws, either one instanced draw or drawn one at a time
+struct InstanceBatch
+{
+	int First; //Position in the queue
+	int Count;
+	int FirstInstance; //Where its instances start in the instance data, instanced batches only
+	bool Instanced;
+};
+
+struct InstanceBatchStats
+{
+	int Draws; //Queued draws, one draw call each without instancing
+	int DrawCalls; //Draw calls once batched
+	int InstancedBatches;
+	int InstancedDraws; //Queued draws that went into instanced batches
+};
+
+// --------------------------------------------------------
+// Turns the render queue into instanced batches
+//
+// The queue is sorted by shader, material and mesh, so
+// draws sharing a mesh and material already sit next to
+// each other and a batch is a run of them. Runs are only
+// taken as they come, so translucent draws keep their
+// back to front order and an unsorted queue batches less
+// rather than drawing out of order.
+//
+// Draws that can't be instanced, or runs too short to be
+// worth it, are gathered into batches drawn one at a time.
+// Runs over the maximum are cut into full batches and
+// whatever is left over, which is batched like any other
+// run. Nothing here touches the GPU, the caller fills and
+// draws the instances.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher();
+
+	void Build(const InstanceDraw* draws, int count, int minInstances = INSTANCE_MIN_BATCH, int maxInstances = INSTANCE_MAX_BATCH);
+
+	//Getters
+	int GetBatchCount() { return (int)batches.size(); }
+	const InstanceBatch* GetBatches() { return batches.data(); }
+	int GetInstanceCount() { return stats.InstancedDraws; }
+	const InstanceBatchStats& GetStats() { return stats; }
+
+private:
+	std::vector<InstanceBatch> batches;
+	InstanceBatchStats stats;
+};
@@ -0,0 +1,49 @@
+#include "LightingHelperMethods.hlsli"
+
+// External data constant buffer, the world matrices come with each instance instead
+cbuffer ExternalData : register(b0)
+{
+    matrix view;
+    matrix projection;
+}
+
+// The usual vertex, then the instance's matrices a row at a time from the second input slot
+struct InstancedVertexShaderInput
+{
+    float3 localPosition : POSITION;
+    float2 uv : TEXCOORD;
+    float3 normal : NORMAL;
+    float3 tangent : TANGENT;
+    float4 world0 : WORLD_PER_INSTANCE0;
+    float4 world1 : WORLD_PER_INSTANCE1;
+    float4 world2 : WORLD_PER_INSTANCE2;
+    float4 world3 : WORLD_PER_INSTANCE3;
+    float4 worldInvTranspose0 : WORLD_INV_TRANSPOSE_PER_INSTANCE0;
+    float4 worldInvTranspose1 : WORLD_INV_TRANSPOSE_PER_INSTANCE1;
+    float4 worldInvTranspose2 : WORLD_INV_TRANSPOSE_PER_INSTANCE2;
+    float4 worldInvTranspose3 : WORLD_INV_TRANSPOSE_PER_INSTANCE3;
+};
+
+// The entry point for our vertex shader
+VertexToPixel main(InstancedVertexShaderInput input)
+{
+    VertexToPixel output;
+
+    // Rows as the CPU stores them, so vectors go on the left, same result as VertexShader.hlsl
+    matrix world = matrix(input.world0, input.world1, input.world2, input.world3);
+    float3x3 worldInvTranspose = (float3x3)matrix(input.worldInvTranspose0, input.worldInvTranspose1, input.worldInvTranspose2, input.worldInvTranspose3);
+
+    float4 worldPosition = mul(float4(input.localPosition, 1.0f), world);
+
+    output.screenPosition = mul(projection, mul(view, worldPosition));
+
+    output.uv = input.uv;
+
+    output.normal = mul(input.normal, worldInvTranspose);
+
+    output.worldPosition = worldPosition.xyz;
+
+    output.tangent = mul(input.tangent, (float3x3)world);
+
+    return output;
+}
@@ -0,0 +1,324 @@
+#include "JobSystem.h"
+
+namespace
+{
+	//Which system and which deque the current thread belongs to, set on workers only
+	thread_local JobSystem* currentSystem = nullptr;
+	thread_local int currentThreadIndex = -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ WORK QUEUE ----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+WorkQueue::WorkQueue() : top(0), bottom(0)
+{
+	for (int i = 0; i < JOB_QUEUE_SIZE; i++)
+	{
+		jobs[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+/// <summary>
+/// Owner only. Returns false if the deque is full.
+/// </summary>
+bool WorkQueue::Push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= JOB_QUEUE_SIZE)
+	{
+		return false;
+	}
+
+	jobs[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+/// <summary>
+/// Owner only. Takes the newest job, racing thieves for the very last one.
+/// </summary>
+Job* WorkQueue::Pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		//Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = jobs[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		//Last job, a thief might be grabbing it right now
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+/// <summary>
+/// Any thread. Takes the oldest job.
+/// </summary>
+Job* WorkQueue::Steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	Job* job = jobs[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		//Lost the race to another thief or the owner
+		return nullptr;
+	}
+	return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ JOB SYSTEM ----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// One worker per hardware thread, minus the one we're on
+/// </summary>
+JobSystem::JobSystem()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	Initialize(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+	Initialize(workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	//Let anything still queued finish before the workers go away
+	for (;;)
+	{
+		Job* job = FindJob(0);
+		if (job == nullptr)
+		{
+			break;
+		}
+		Execute(job);
+	}
+
+	shuttingDown.store(true);
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	for (ThreadData* data : threads)
+	{
+		delete[] data->Jobs;
+		delete data;
+	}
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int threadIndex = GetThreadIndex();
+	while (!counter->IsDone())
+	{
+		Job* job = threadIndex >= 0 ? FindJob(threadIndex) : nullptr;
+		if (job != nullptr)
+		{
+			Execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return (unsigned int)threads.size();
+}
+
+void JobSystem::Initialize(unsigned int workerCount)
+{
+	queuedJobs.store(0);
+	sleepingWorkers.store(0);
+	shuttingDown.store(false);
+
+	//Slot 0 belongs to the creating thread
+	for (unsigned int i = 0; i < workerCount + 1; i++)
+	{
+		ThreadData* data = new ThreadData();
+		data->Jobs = new Job[JOB_POOL_SIZE];
+		for (int j = 0; j < JOB_POOL_SIZE; j++)
+		{
+			data->Jobs[j].Active.store(false, std::memory_order_relaxed);
+		}
+		data->RandomState = 0x9E3779B9u * (i + 1);
+		threads.push_back(data);
+	}
+
+	owner = std::this_thread::get_id();
+
+	for (unsigned int i = 1; i < workerCount + 1; i++)
+	{
+		workers.emplace_back(&JobSystem::WorkerLoop, this, (int)i);
+	}
+}
+
+void JobSystem::WorkerLoop(int threadIndex)
+{
+	currentSystem = this;
+	currentThreadIndex = threadIndex;
+
+	while (!shuttingDown.load())
+	{
+		Job* job = FindJob(threadIndex);
+		if (job != nullptr)
+		{
+			Execute(job);
+			continue;
+		}
+
+		//Nothing to steal, park until something gets queued
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		sleepCondition.wait(lock, [this]() { return queuedJobs.load() > 0 || shuttingDown.load(); });
+		sleepingWorkers.fetch_sub(1);
+	}
+}
+
+/// <summary>
+/// The creating thread can make any number of systems, so it's told apart by id
+/// rather than by the thread_local the workers set
+/// </summary>
+int JobSystem::GetThreadIndex()
+{
+	if (currentSystem == this)
+	{
+		return currentThreadIndex;
+	}
+	return std::this_thread::get_id() == owner ? 0 : -1;
+}
+
+/// <summary>
+/// Grabs the next job from this thread's ring. If that slot is still
+/// running from a lap ago we help out until it frees up.
+/// </summary>
+Job* JobSystem::AllocateJob()
+{
+	int threadIndex = GetThreadIndex();
+	ThreadData* data = threads[threadIndex];
+
+	for (;;)
+	{
+		Job* job = &data->Jobs[data->NextJob++ & (JOB_POOL_SIZE - 1)];
+		if (!job->Active.load(std::memory_order_acquire))
+		{
+			job->Active.store(true, std::memory_order_relaxed);
+			return job;
+		}
+
+		Job* other = FindJob(threadIndex);
+		if (other != nullptr)
+		{
+			Execute(other);
+		}
+	}
+}
+
+void JobSystem::Submit(Job* job, JobCounter* counter)
+{
+	job->Counter = counter;
+	if (counter != nullptr)
+	{
+		counter->value.fetch_add(1);
+	}
+
+	//A full deque just means we run it right here
+	int threadIndex = GetThreadIndex();
+	if (!threads[threadIndex]->Queue.Push(job))
+	{
+		Execute(job);
+		return;
+	}
+
+	queuedJobs.fetch_add(1);
+	if (sleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		sleepCondition.notify_one();
+	}
+}
+
+/// <summary>
+/// Own deque first (newest work, still warm in cache), then steal
+/// from everyone else starting at a random victim
+/// </summary>
+Job* JobSystem::FindJob(int threadIndex)
+{
+	ThreadData* data = threads[threadIndex];
+	Job* job = data->Queue.Pop();
+	if (job == nullptr)
+	{
+		unsigned int threadCount = (unsigned int)threads.size();
+
+		//xorshift is plenty random for picking victims
+		unsigned int random = data->RandomState;
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		data->RandomState = random;
+
+		for (unsigned int i = 0; i < threadCount && job == nullptr; i++)
+		{
+			unsigned int victim = (random + i) % threadCount;
+			if (victim != (unsigned int)threadIndex)
+			{
+				job = threads[victim]->Queue.Steal();
+			}
+		}
+	}
+
+	if (job != nullptr)
+	{
+		queuedJobs.fetch_sub(1);
+	}
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	//The slot can be reused as soon as Invoke starts, so grab the counter first
+	JobCounter* counter = job->Counter;
+	job->Invoke(job);
+
+	if (counter != nullptr)
+	{
+		counter->value.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Sizes for the per thread job storage
+#define JOB_PAYLOAD_SIZE 96 //Bytes available for a job's captured data
+#define JOB_POOL_SIZE 8192 //Jobs per thread, must be a power of 2
+#define JOB_QUEUE_SIZE 4096 //Deque slots per thread, must be a power of 2
+
+// --------------------------------------------------------
+// Counts outstanding jobs. Anything that needs to wait on
+// a group of jobs hands the same counter to each of them.
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter() : value(0) {}
+
+	bool IsDone() { return value.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> value;
+};
+
+// --------------------------------------------------------
+// A single unit of work. The callable is stored inline so
+// submitting a job never touches the heap.
+// --------------------------------------------------------
+struct Job
+{
+	void (*Invoke)(Job* job);
+	JobCounter* Counter;
+	std::atomic<bool> Active;
+	alignas(16) unsigned char Payload[JOB_PAYLOAD_SIZE];
+};
+
+// --------------------------------------------------------
+// Chase-Lev work stealing deque. The owning thread pushes
+// and pops at the bottom, every other thread steals from
+// the top.
+// --------------------------------------------------------
+class WorkQueue
+{
+public:
+	WorkQueue();
+
+	bool Push(Job* job);
+	Job* Pop();
+	Job* Steal();
+
+private:
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	std::atomic<Job*> jobs[JOB_QUEUE_SIZE];
+};
+
+// --------------------------------------------------------
+// Work stealing job system
+//
+// The thread that creates the system is thread 0, and each
+// worker gets its own deque. Jobs may only be submitted
+// from thread 0 or from inside other jobs.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	JobSystem();
+	JobSystem(unsigned int workerCount);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// --------------------------------------------------------
+	// Queues a callable with no arguments
+	// --------------------------------------------------------
+	template<typename Function>
+	void Run(Function&& function, JobCounter* counter = nullptr)
+	{
+		using Callable = std::decay_t<Function>;
+		static_assert(sizeof(Callable) <= JOB_PAYLOAD_SIZE, "Job captures too much data, capture a pointer instead");
+		static_assert(alignof(Callable) <= 16, "Job payload alignment is too large");
+
+		//Threads that don't belong to this system can't own jobs, so just do the work
+		if (GetThreadIndex() < 0)
+		{
+			function();
+			return;
+		}
+
+		Job* job = AllocateJob();
+		new (job->Payload) Callable(std::forward<Function>(function));
+		job->Invoke = [](Job* self)
+		{
+			//Move the work onto the stack and free the slot before running,
+			//so jobs that wait on other jobs never pin the ring
+			Callable* stored = std::launder(reinterpret_cast<Callable*>(self->Payload));
+			Callable callable(std::move(*stored));
+			stored->~Callable();
+			self->Active.store(false, std::memory_order_release);
+			callable();
+		};
+		Submit(job, counter);
+	}
+
+	// --------------------------------------------------------
+	// Calls function(start, end) over [0, count). Ranges split
+	// in half whenever they're bigger than the grain size, so
+	// idle threads steal big chunks first and the split depth
+	// adapts to how busy everyone is.
+	// --------------------------------------------------------
+	template<typename Function>
+	void ParallelFor(int count, Function function, JobCounter* counter, int minGrain = 1)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+
+		int grain = count / (int)(GetThreadCount() * 4);
+		if (grain < minGrain)
+		{
+			grain = minGrain;
+		}
+
+		RunRange(0, count, grain, function, counter);
+	}
+
+	//Blocks until the counter hits zero, running other jobs in the meantime
+	void Wait(JobCounter* counter);
+
+	unsigned int GetThreadCount();
+
+private:
+	struct ThreadData
+	{
+		WorkQueue Queue;
+		Job* Jobs = nullptr;
+		unsigned int NextJob = 0;
+		unsigned int RandomState = 0;
+	};
+
+	std::vector<ThreadData*> threads;
+	std::vector<std::thread> workers;
+	std::thread::id owner; //Thread 0, found by id so other systems made on it can't take its place
+
+	//Jobs pushed but not yet picked up, used to park idle workers
+	std::atomic<int> queuedJobs;
+	std::atomic<int> sleepingWorkers;
+	std::atomic<bool> shuttingDown;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+
+	template<typename Function>
+	void RunRange(int start, int end, int grain, Function function, JobCounter* counter)
+	{
+		Run([this, start, end, grain, function, counter]()
+			{
+				//Keep the front half, hand the back half to whoever wants it
+				int rangeEnd = end;
+				while (rangeEnd - start > grain)
+				{
+					int middle = start + (rangeEnd - start) / 2;
+					RunRange(middle, rangeEnd, grain, function, counter);
+					rangeEnd = middle;
+				}
+				function(start, rangeEnd);
+			}, counter);
+	}
+
+	void Initialize(unsigned int workerCount);
+	void WorkerLoop(int threadIndex);
+	int GetThreadIndex();
+	Job* AllocateJob();
+	void Submit(Job* job, JobCounter* counter);
+	Job* FindJob(int threadIndex);
+	void Execute(Job* job);
+};
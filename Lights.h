@@ -6,6 +6,8 @@
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT 2
 
+#define MAX_SHADER_LIGHTS 5 //Size of the lights array in the pixel shaders
+
 struct Light
 {
 	int Type; // Which kind of light? 0, 1 or 2 (see above)
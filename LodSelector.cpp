@@ -0,0 +1,162 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Simd.h"
+
+using namespace Simd;
+
+LodSelector::LodSelector() :
+	eye(0, 0, 0),
+	pixelScale(1.0f),
+	selectedCount(0),
+	histogram{}
+{
+}
+
+void LodSelector::Resize(int slotCount)
+{
+	levels.resize(slotCount, 0.0f);
+	selected.resize(slotCount);
+}
+
+/// <summary>
+/// Takes the eye and the pixel scale from the camera. projection._22 is cot(fov / 2) for a perspective
+/// projection, so a sphere of radius r at distance d covers about r * _22 / d of half the viewport.
+/// </summary>
+void LodSelector::SetView(const DirectX::XMFLOAT3& newEye, const DirectX::XMFLOAT4X4& projection, float viewportHeight)
+{
+	eye = newEye;
+	pixelScale = projection._22 * viewportHeight * 0.5f;
+}
+
+/// <summary>
+/// Selects levels for the slots in the list. Long lists are split into runs of LOD_JOB_SLOTS across
+/// the workers, each writing its own part of the selected list, then the gaps are closed.
+/// </summary>
+/// <returns>How many slots were selected, the rest were too small to draw</returns>
+int LodSelector::Select(FrustumCuller& culler, const uint32_t* slots, int count, const LodSettings& settings, JobSystem* jobSystem)
+{
+	if ((int)levels.size() < culler.GetSlotCount())
+	{
+		Resize(culler.GetSlotCount());
+	}
+
+	int jobCount = (count + LOD_JOB_SLOTS - 1) / LOD_JOB_SLOTS;
+	jobCounts.resize(jobCount);
+	jobHistograms.assign(jobCount * (LOD_MAX_LEVELS + 1), 0);
+	if (!jobSystem || jobCount < 2)
+	{
+		for (int job = 0; job < jobCount; job++)
+		{
+			int first = job * LOD_JOB_SLOTS;
+			jobCounts[job] = SelectRange(culler, slots + first, std::min(count - first, LOD_JOB_SLOTS), settings, selected.data() + first, jobHistograms.data() + job * (LOD_MAX_LEVELS + 1));
+		}
+	}
+	else
+	{
+		JobCounter counter;
+		jobSystem->ParallelFor(jobCount, [this, &culler, slots, count, &settings](int start, int end)
+			{
+				for (int job = start; job < end; job++)
+				{
+					int first = job * LOD_JOB_SLOTS;
+					jobCounts[job] = SelectRange(culler, slots + first, std::min(count - first, LOD_JOB_SLOTS), settings, selected.data() + first, jobHistograms.data() + job * (LOD_MAX_LEVELS + 1));
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+	}
+
+	selectedCount = 0;
+	std::fill(histogram, histogram + LOD_MAX_LEVELS + 1, 0);
+	for (int job = 0; job < jobCount; job++)
+	{
+		const uint32_t* run = selected.data() + job * LOD_JOB_SLOTS;
+		if (run != selected.data() + selectedCount)
+		{
+			std::memmove(selected.data() + selectedCount, run, jobCounts[job] * sizeof(uint32_t));
+		}
+		selectedCount += jobCounts[job];
+
+		for (int level = 0; level <= LOD_MAX_LEVELS; level++)
+		{
+			histogram[level] += jobHistograms[job * (LOD_MAX_LEVELS + 1) + level];
+		}
+	}
+	return selectedCount;
+}
+
+/// <summary>
+/// The kernel, eight slots at a time. A slot's pixel radius is definitely below threshold k when it's
+/// under the bottom of k's band and definitely above it when it's over the top. Counting the thresholds
+/// it's definitely below gives the finest level it may use, counting the ones it isn't definitely above
+/// gives the coarsest, and its old level is clamped between the two.
+/// </summary>
+/// <returns>How many slots were written to output</returns>
+int LodSelector::SelectRange(FrustumCuller& culler, const uint32_t* slots, int count, const LodSettings& settings, uint32_t* output, int* counts)
+{
+	float thresholds[LOD_MAX_LEVELS];
+	std::memcpy(thresholds, settings.LevelPixels, sizeof(settings.LevelPixels));
+	thresholds[LOD_MAX_LEVELS - 1] = settings.CullPixels;
+
+	Float8 bandBottom[LOD_MAX_LEVELS];
+	Float8 bandTop[LOD_MAX_LEVELS];
+	for (int k = 0; k < LOD_MAX_LEVELS; k++)
+	{
+		bandBottom[k] = Splat(thresholds[k] * (1.0f - settings.Hysteresis));
+		bandTop[k] = Splat(thresholds[k] * (1.0f + settings.Hysteresis));
+	}
+
+	Float8 eyeX = Splat(eye.x);
+	Float8 eyeY = Splat(eye.y);
+	Float8 eyeZ = Splat(eye.z);
+	Float8 scale = Splat(pixelScale);
+	Float8 one = Splat(1.0f);
+
+	int written = 0;
+	float bounds[6][CULL_BLOCK_SIZE];
+	float current[SIMD_WIDTH];
+	float chosen[SIMD_WIDTH];
+	for (int first = 0; first < count; first += SIMD_WIDTH)
+	{
+		int laneCount = std::min(count - first, SIMD_WIDTH);
+		culler.GatherBounds(slots + first, laneCount, bounds);
+		for (int lane = 0; lane < SIMD_WIDTH; lane++)
+		{
+			current[lane] = lane < laneCount ? levels[slots[first + lane]] : 0.0f;
+		}
+
+		Float8 ex = Load(bounds[3]);
+		Float8 ey = Load(bounds[4]);
+		Float8 ez = Load(bounds[5]);
+		Float8 dx = Sub(Load(bounds[0]), eyeX);
+		Float8 dy = Sub(Load(bounds[1]), eyeY);
+		Float8 dz = Sub(Load(bounds[2]), eyeZ);
+		Float8 radius = Sqrt(Add(Add(Mul(ex, ex), Mul(ey, ey)), Mul(ez, ez)));
+		Float8 distance = Sqrt(Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz)));
+		Float8 pixels = Div(Mul(radius, scale), distance);
+
+		Float8 finest = Splat(0.0f);
+		Float8 coarsest = Splat(0.0f);
+		for (int k = 0; k < LOD_MAX_LEVELS; k++)
+		{
+			finest = Add(finest, And(Less(pixels, bandBottom[k]), one));
+			coarsest = Add(coarsest, And(Less(pixels, bandTop[k]), one));
+		}
+		Store(chosen, Min(Max(Load(current), finest), coarsest));
+
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			uint32_t slot = slots[first + lane];
+			int level = (int)chosen[lane];
+			levels[slot] = chosen[lane];
+			counts[level]++;
+			if (level != LOD_CULLED)
+			{
+				output[written++] = slot;
+			}
+		}
+	}
+	return written;
+}
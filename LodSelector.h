@@ -0,0 +1,75 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+#define LOD_MAX_LEVELS 4 //Mesh levels to choose from, 0 is the full mesh
+#define LOD_CULLED LOD_MAX_LEVELS //The level past the last one, too small to draw at all
+#define LOD_JOB_SLOTS 4096 //Slots per parallel job, each job writes its own run of the output
+
+// --------------------------------------------------------
+// Where the levels change, as a projected radius in pixels.
+// Thresholds have to go down from one level to the next.
+// --------------------------------------------------------
+struct LodSettings
+{
+	float LevelPixels[LOD_MAX_LEVELS - 1] = { 96.0f, 40.0f, 16.0f }; //Below LevelPixels[i], level i + 1 is used
+	float CullPixels = 1.5f; //Below this nothing is drawn, small feature culling
+	float Hysteresis = 0.15f; //Fraction either side of a threshold where the current level is kept
+
+	//Level 0 for everything and nothing dropped
+	static LodSettings Disabled() { return { { 0, 0, 0 }, 0, 0 }; }
+};
+
+// --------------------------------------------------------
+// Screen space LOD selection
+//
+// Every slot's bounds (read out of a FrustumCuller) are
+// turned into the radius in pixels of the sphere around
+// them, eight slots at a time. That picks the level, with
+// a band around every threshold where the level the slot
+// had last time is kept, so something sitting right on a
+// threshold doesn't pop back and forth every frame. The
+// last threshold drops the slot entirely.
+//
+// The level a slot selects doesn't say anything about which
+// mesh it has, the caller maps levels to meshes and clamps
+// to however many it really has.
+// --------------------------------------------------------
+class LodSelector
+{
+public:
+	LodSelector();
+
+	//New slots start at level 0
+	void Resize(int slotCount);
+	void SetView(const DirectX::XMFLOAT3& eye, const DirectX::XMFLOAT4X4& projection, float viewportHeight);
+
+	//Picks a level for every slot in the list. Slots that aren't culled end up in the selected list, in the same order.
+	int Select(FrustumCuller& culler, const uint32_t* slots, int count, const LodSettings& settings, JobSystem* jobSystem = nullptr);
+
+	//Getters
+	const uint32_t* GetSelected() { return selected.data(); }
+	int GetSelectedCount() { return selectedCount; }
+	int GetLevel(uint32_t slot) { return (int)levels[slot]; }
+	const int* GetHistogram() { return histogram; } //Slots per level for the last Select, LOD_CULLED last
+
+private:
+	DirectX::XMFLOAT3 eye;
+	float pixelScale; //Projected pixels per unit of radius at a distance of one
+
+	//Kept as floats so the SIMD pass can clamp them directly
+	std::vector<float> levels;
+
+	std::vector<uint32_t> selected;
+	int selectedCount;
+	int histogram[LOD_MAX_LEVELS + 1];
+	std::vector<int> jobCounts;
+	std::vector<int> jobHistograms;
+
+	int SelectRange(FrustumCuller& culler, const uint32_t* slots, int count, const LodSettings& settings, uint32_t* output, int* counts);
+};
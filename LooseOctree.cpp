@@ -0,0 +1,375 @@
+#include "LooseOctree.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+//How a node's loose bounds relate to a query
+#define OCTREE_OUTSIDE 0
+#define OCTREE_INTERSECTS 1
+#define OCTREE_INSIDE 2
+
+LooseOctree::LooseOctree(DirectX::XMFLOAT3 center, float halfSize, int maxDepth) :
+	center(center),
+	halfSize(halfSize),
+	maxDepth(maxDepth),
+	itemCount(0)
+{
+	Clear();
+}
+
+void LooseOctree::Insert(int item, const AABB& bounds)
+{
+	if (item >= (int)items.size())
+	{
+		items.resize(item + 1, { {}, -1, -1, -1 });
+	}
+	else if (items[item].Node >= 0)
+	{
+		UnlinkItem(item);
+	}
+
+	items[item].Bounds = bounds;
+	LinkItem(item, FindOrCreateNode(bounds, GetTargetDepth(bounds)));
+}
+
+void LooseOctree::Remove(int item)
+{
+	if (!Contains(item))
+	{
+		return;
+	}
+
+	UnlinkItem(item);
+}
+
+/// <summary>
+/// Keeps the item where it is whenever its node can still hold it, which is
+/// most frames for anything moving at a sensible speed
+/// </summary>
+void LooseOctree::Move(int item, const AABB& bounds)
+{
+	if (!Contains(item))
+	{
+		Insert(item, bounds);
+		return;
+	}
+
+	OctreeItem& entry = items[item];
+	const OctreeNode& node = nodes[entry.Node];
+	int targetDepth = GetTargetDepth(bounds);
+
+	//Allow one level of slack so items shrinking slightly don't bounce between levels
+	bool rightLevel = node.Depth == targetDepth || node.Depth == targetDepth - 1;
+	bool stillFits = entry.Node == 0 ? targetDepth == 0 : AABBContainsAABB(GetLooseBounds(entry.Node), bounds);
+	if (rightLevel && stillFits)
+	{
+		entry.Bounds = bounds;
+		return;
+	}
+
+	UnlinkItem(item);
+	entry.Bounds = bounds;
+	LinkItem(item, FindOrCreateNode(bounds, targetDepth));
+}
+
+void LooseOctree::Clear()
+{
+	nodes.clear();
+	freeNodes.clear();
+	items.clear();
+	itemCount = 0;
+
+	OctreeNode root;
+	root.Center = center;
+	root.HalfSize = halfSize;
+	root.Depth = 0;
+	root.Parent = -1;
+	for (int& child : root.Children)
+	{
+		child = -1;
+	}
+	root.FirstItem = -1;
+	root.SubtreeItems = 0;
+	nodes.push_back(root);
+}
+
+void LooseOctree::QueryAABB(const AABB& box, std::vector<int>& results)
+{
+	Query(
+		[&](const AABB& loose)
+		{
+			if (!AABBIntersectsAABB(loose, box)) return OCTREE_OUTSIDE;
+			return AABBContainsAABB(box, loose) ? OCTREE_INSIDE : OCTREE_INTERSECTS;
+		},
+		[&](const AABB& bounds) { return AABBIntersectsAABB(bounds, box); },
+		results);
+}
+
+void LooseOctree::QuerySphere(DirectX::XMFLOAT3 sphereCenter, float radius, std::vector<int>& results)
+{
+	Query(
+		[&](const AABB& loose)
+		{
+			return AABBIntersectsSphere(loose, sphereCenter, radius) ? OCTREE_INTERSECTS : OCTREE_OUTSIDE;
+		},
+		[&](const AABB& bounds) { return AABBIntersectsSphere(bounds, sphereCenter, radius); },
+		results);
+}
+
+void LooseOctree::QueryFrustum(const Frustum& frustum, std::vector<int>& results)
+{
+	Query(
+		[&](const AABB& loose)
+		{
+			if (!FrustumIntersectsAABB(frustum, loose)) return OCTREE_OUTSIDE;
+			return FrustumContainsAABB(frustum, loose) ? OCTREE_INSIDE : OCTREE_INTERSECTS;
+		},
+		[&](const AABB& bounds) { return FrustumIntersectsAABB(frustum, bounds); },
+		results);
+}
+
+bool LooseOctree::Contains(int item)
+{
+	return item >= 0 && item < (int)items.size() && items[item].Node >= 0;
+}
+
+AABB LooseOctree::GetItemBounds(int item)
+{
+	return items[item].Bounds;
+}
+
+int LooseOctree::GetItemCount()
+{
+	return itemCount;
+}
+
+int LooseOctree::GetNodeCount()
+{
+	return (int)(nodes.size() - freeNodes.size());
+}
+
+int LooseOctree::GetItemCapacity()
+{
+	return (int)items.size();
+}
+
+/// <summary>
+/// Deepest level whose cells are still at least as big as the item
+/// </summary>
+int LooseOctree::GetTargetDepth(const AABB& bounds)
+{
+	//Anything with its center outside the world lives in the root
+	if (fabsf(bounds.Center.x - center.x) > halfSize ||
+		fabsf(bounds.Center.y - center.y) > halfSize ||
+		fabsf(bounds.Center.z - center.z) > halfSize)
+	{
+		return 0;
+	}
+
+	float largest = fmaxf(bounds.Extents.x, fmaxf(bounds.Extents.y, bounds.Extents.z));
+	if (largest <= 0)
+	{
+		return maxDepth;
+	}
+	if (largest >= halfSize)
+	{
+		return 0;
+	}
+
+	int depth = (int)floorf(log2f(halfSize / largest));
+	return depth < maxDepth ? depth : maxDepth;
+}
+
+int LooseOctree::FindOrCreateNode(const AABB& bounds, int depth)
+{
+	int node = 0;
+	for (int level = 0; level < depth; level++)
+	{
+		const OctreeNode& current = nodes[node];
+		int octant =
+			(bounds.Center.x >= current.Center.x ? 1 : 0) |
+			(bounds.Center.y >= current.Center.y ? 2 : 0) |
+			(bounds.Center.z >= current.Center.z ? 4 : 0);
+
+		int child = current.Children[octant];
+		if (child < 0)
+		{
+			child = AllocateNode(node, octant);
+		}
+		node = child;
+	}
+	return node;
+}
+
+int LooseOctree::AllocateNode(int parent, int octant)
+{
+	int index;
+	if (!freeNodes.empty())
+	{
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		index = (int)nodes.size();
+		nodes.push_back({});
+	}
+
+	//Parent is read after the push since it may have moved
+	const OctreeNode& parentNode = nodes[parent];
+	float childHalf = parentNode.HalfSize * 0.5f;
+
+	OctreeNode& node = nodes[index];
+	node.Center.x = parentNode.Center.x + ((octant & 1) ? childHalf : -childHalf);
+	node.Center.y = parentNode.Center.y + ((octant & 2) ? childHalf : -childHalf);
+	node.Center.z = parentNode.Center.z + ((octant & 4) ? childHalf : -childHalf);
+	node.HalfSize = childHalf;
+	node.Depth = parentNode.Depth + 1;
+	node.Parent = parent;
+	for (int& child : node.Children)
+	{
+		child = -1;
+	}
+	node.FirstItem = -1;
+	node.SubtreeItems = 0;
+
+	nodes[parent].Children[octant] = index;
+	return index;
+}
+
+void LooseOctree::LinkItem(int item, int node)
+{
+	OctreeItem& entry = items[item];
+	entry.Node = node;
+	entry.Prev = -1;
+	entry.Next = nodes[node].FirstItem;
+	if (entry.Next >= 0)
+	{
+		items[entry.Next].Prev = item;
+	}
+	nodes[node].FirstItem = item;
+
+	for (int current = node; current >= 0; current = nodes[current].Parent)
+	{
+		nodes[current].SubtreeItems++;
+	}
+	itemCount++;
+}
+
+/// <summary>
+/// Takes the item out of its node and hands back any nodes left empty
+/// </summary>
+void LooseOctree::UnlinkItem(int item)
+{
+	OctreeItem& entry = items[item];
+	int node = entry.Node;
+
+	if (entry.Prev >= 0)
+	{
+		items[entry.Prev].Next = entry.Next;
+	}
+	else
+	{
+		nodes[node].FirstItem = entry.Next;
+	}
+	if (entry.Next >= 0)
+	{
+		items[entry.Next].Prev = entry.Prev;
+	}
+	entry.Node = -1;
+
+	for (int current = node; current >= 0;)
+	{
+		OctreeNode& currentNode = nodes[current];
+		int parent = currentNode.Parent;
+		currentNode.SubtreeItems--;
+
+		//Only leaves can be empty, since a node with children has items below it
+		if (currentNode.SubtreeItems == 0 && parent >= 0)
+		{
+			for (int& child : nodes[parent].Children)
+			{
+				if (child == current)
+				{
+					child = -1;
+				}
+			}
+			freeNodes.push_back(current);
+		}
+		current = parent;
+	}
+	itemCount--;
+}
+
+AABB LooseOctree::GetLooseBounds(int node)
+{
+	float looseHalf = nodes[node].HalfSize * 2.0f;
+	return { nodes[node].Center, XMFLOAT3(looseHalf, looseHalf, looseHalf) };
+}
+
+void LooseOctree::CollectSubtree(int node, std::vector<int>& results)
+{
+	size_t base = stack.size();
+	stack.push_back(node);
+	while (stack.size() > base)
+	{
+		int current = stack.back();
+		stack.pop_back();
+
+		for (int item = nodes[current].FirstItem; item >= 0; item = items[item].Next)
+		{
+			results.push_back(item);
+		}
+		for (int child : nodes[current].Children)
+		{
+			if (child >= 0)
+			{
+				stack.push_back(child);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Walks the tree, skipping nodes outside the query and taking whole
+/// subtrees without testing items once a node is fully inside it
+/// </summary>
+template<typename NodeTest, typename ItemTest>
+void LooseOctree::Query(NodeTest nodeTest, ItemTest itemTest, std::vector<int>& results)
+{
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+
+		//The root can hold items outside the world, so it's never culled as a whole
+		int result = node == 0 ? OCTREE_INTERSECTS : nodeTest(GetLooseBounds(node));
+		if (result == OCTREE_OUTSIDE)
+		{
+			continue;
+		}
+		if (result == OCTREE_INSIDE)
+		{
+			CollectSubtree(node, results);
+			continue;
+		}
+
+		for (int item = nodes[node].FirstItem; item >= 0; item = items[item].Next)
+		{
+			if (itemTest(items[item].Bounds))
+			{
+				results.push_back(item);
+			}
+		}
+		for (int child : nodes[node].Children)
+		{
+			if (child >= 0)
+			{
+				stack.push_back(child);
+			}
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+
+#define OCTREE_DEFAULT_DEPTH 8
+
+// --------------------------------------------------------
+// Loose octree over item bounds
+//
+// Every node's bounds are twice the size of its cell, so an
+// item only has to have its center inside a cell and be no
+// bigger than the cell to fit. That means the right depth
+// comes straight from the item's size, and an item that
+// moves a little almost never has to change nodes.
+//
+// Items are identified by small non negative ints picked by
+// the caller (entity indices, for example). Nodes come from
+// a pool and are handed back as soon as they empty out.
+// Items that leave the world bounds are kept in the root.
+// --------------------------------------------------------
+class LooseOctree
+{
+public:
+	LooseOctree(DirectX::XMFLOAT3 center, float halfSize, int maxDepth = OCTREE_DEFAULT_DEPTH);
+
+	void Insert(int item, const AABB& bounds);
+	void Remove(int item);
+	void Move(int item, const AABB& bounds); //Inserts if the item isn't in the tree yet
+	void Clear();
+
+	//Queries append matching items to results
+	void QueryAABB(const AABB& box, std::vector<int>& results);
+	void QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<int>& results);
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& results);
+
+	//Getters
+	bool Contains(int item);
+	AABB GetItemBounds(int item);
+	int GetItemCount();
+	int GetNodeCount();
+	int GetItemCapacity(); //One past the largest item id seen
+
+private:
+	struct OctreeNode
+	{
+		DirectX::XMFLOAT3 Center;
+		float HalfSize; //Half the cell size, the loose bounds are twice this
+		int Depth;
+		int Parent;
+		int Children[8];
+		int FirstItem;
+		int SubtreeItems;
+	};
+
+	struct OctreeItem
+	{
+		AABB Bounds;
+		int Node; //-1 when the item isn't in the tree
+		int Prev;
+		int Next;
+	};
+
+	DirectX::XMFLOAT3 center;
+	float halfSize;
+	int maxDepth;
+	int itemCount;
+
+	//Node pool, index 0 is always the root
+	std::vector<OctreeNode> nodes;
+	std::vector<int> freeNodes;
+	std::vector<OctreeItem> items;
+
+	//Reused between queries so they don't allocate
+	std::vector<int> stack;
+
+	int GetTargetDepth(const AABB& bounds);
+	int FindOrCreateNode(const AABB& bounds, int depth);
+	int AllocateNode(int parent, int octant);
+	void LinkItem(int item, int node);
+	void UnlinkItem(int item);
+	AABB GetLooseBounds(int node);
+	void CollectSubtree(int node, std::vector<int>& results);
+
+	template<typename NodeTest, typename ItemTest>
+	void Query(NodeTest nodeTest, ItemTest itemTest, std::vector<int>& results);
+};
@@ -6,6 +6,8 @@
 #include "Graphics.h"
 #include "Game.h"
 #include "Input.h"
+#include "BenchmarkSuite.h"
+#include "PathHelpers.h"
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -57,6 +59,32 @@ int WINAPI WinMain(
 	bool statsInTitleBar = true;
 	bool vsync = false;
 
+	// Stress scene and benchmark switches
+	BenchmarkSettings benchmarkSettings;
+	std::string commandLineError;
+	if (!BenchmarkSettings::Parse(lpCmdLine, benchmarkSettings, commandLineError))
+	{
+		printf("Command line: %s\n", commandLineError.c_str());
+		return E_INVALIDARG;
+	}
+
+	// System suites only need the CPU, so they run before there's a window or device
+	if (!benchmarkSettings.Suites.empty())
+	{
+		Benchmark suiteResults;
+		if (!RunBenchmarkSuites(benchmarkSettings, suiteResults, commandLineError))
+		{
+			printf("Command line: %s\n", commandLineError.c_str());
+			return E_INVALIDARG;
+		}
+		if (!suiteResults.WriteJson(FixPath(benchmarkSettings.OutputPath)))
+		{
+			printf("Suites: couldn't write %s\n", benchmarkSettings.OutputPath.c_str());
+			return E_FAIL;
+		}
+		return suiteResults.GetChecksPassed() ? S_OK : E_FAIL;
+	}
+
 	// The main application object
 	game = new Game();
 
@@ -83,8 +111,12 @@ int WINAPI WinMain(
 	// Initalize the input system, which requires the window handle
 	Input::Initialize(Window::Handle());
 
+	// Benchmarks only need the device, not anything on screen
+	if (benchmarkSettings.Frames > 0)
+		ShowWindow(Window::Handle(), SW_HIDE);
+
 	// Now the game itself can be initialzied
-	game->Initialize();
+	game->Initialize(benchmarkSettings);
 
 	// Time tracking
 	LARGE_INTEGER perfFreq{};
@@ -142,9 +174,12 @@ int WINAPI WinMain(
 		}
 	}
 
+	// Headless runs fail if any of their checks did, so scripts can tell
+	bool checksPassed = game->GetChecksPassed();
+
 	// Clean up
 	delete game;
 	Input::ShutDown();
 	Graphics::ShutDown();
-	return (HRESULT)msg.wParam;
+	return checksPassed ? (HRESULT)msg.wParam : E_FAIL;
 }
@@ -1,6 +1,6 @@
 #include "Material.h"
 
-Material::Material(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT4 _colorTint, float _roughness) : uvOffset(0, 0), uvScale(1, 1), roughness(0)
+Material::Material(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT4 _colorTint, float _roughness) : uvOffset(0, 0), uvScale(1, 1), roughness(0), dirty(true)
 {
 	vs = _vs;
 
@@ -17,14 +17,19 @@ Material::Material(std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<Simp
 	uvScale = _uvScale;
 }
 
-std::shared_ptr<SimpleVertexShader> Material::GetVS()
+SimpleVertexShader* Material::GetVS()
 {
-	return vs;
+	return vs.get();
 }
 
-std::shared_ptr<SimplePixelShader> Material::GetPS()
+SimpleVertexShader* Material::GetInstancedVS()
 {
-	return ps;
+	return instancedVS.get();
+}
+
+SimplePixelShader* Material::GetPS()
+{
+	return ps.get();
 }
 
 DirectX::XMFLOAT4 Material::GetColorTint()
@@ -42,57 +47,81 @@ DirectX::XMFLOAT2 Material::GetUVOffset()
 	return uvOffset;
 }
 
+float Material::GetRoughness()
+{
+	return roughness;
+}
+
 void Material::SetColorTint(DirectX::XMFLOAT4 _colorTint)
 {
 	colorTint = _colorTint;
+	dirty = true;
 }
 
 void Material::SetVS(std::shared_ptr<SimpleVertexShader> _vs)
 {
 	vs = _vs;
+	dirty = true;
+}
+
+void Material::SetInstancedVS(std::shared_ptr<SimpleVertexShader> _vs)
+{
+	instancedVS = _vs;
+	dirty = true;
 }
 
 void Material::SetPS(std::shared_ptr<SimplePixelShader> _ps)
 {
 	ps = _ps;
+	dirty = true;
 }
 
 void Material::SetUVOffset(float x, float y)
 {
 	uvOffset = DirectX::XMFLOAT2(x, y);
+	dirty = true;
 }
 
 void Material::SetUVScale(float x, float y)
 {
 	uvScale = DirectX::XMFLOAT2(x, y);
+	dirty = true;
+}
+
+void Material::SetRoughness(float _roughness)
+{
+	roughness = _roughness;
+	dirty = true;
 }
 
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texturePtr)
 {
 	textureSRVs.insert({ name, texturePtr });
+	dirty = true;
 }
 
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerPtr)
 {
 	samplers.insert({ name, samplerPtr });
+	dirty = true;
 }
 
 void Material::PrepareMaterial(DirectX::XMFLOAT3 cameraPos)
 {
 	for (auto& t : textureSRVs) 
 	{ 
-		ps->SetShaderResourceView(t.first.c_str(), t.second); 
+		ps->SetShaderResourceView(t.first, t.second); 
 	}
 	for (auto& s : samplers) 
 	{ 
-		ps->SetSamplerState(s.first.c_str(), s.second); 
+		ps->SetSamplerState(s.first, s.second); 
 	}
 
 	ps->SetFloat3("cameraPos", cameraPos);
 	ps->SetFloat("roughness", roughness);
 }
 
-void Material::PrepareLight(std::vector<Light> lights)
+void Material::PrepareLight(const Light* lights, int lightCount)
 {
 	/*for (int i = 0; i < lights.size(); i++)
 	{
@@ -109,7 +138,36 @@ void Material::PrepareLight(std::vector<Light> lights)
 	ps->SetFloat3("ambientLightColor", DirectX::XMFLOAT3(1, .81f, 0.87f));
 
 
-	ps->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
+	//Anything past what the shader holds would make the whole upload fail
+	ps->SetData("lights", lights, sizeof(Light) * (lightCount < MAX_SHADER_LIGHTS ? lightCount : MAX_SHADER_LIGHTS));
+}
+
+bool Material::ConsumeDirty()
+{
+	bool wasDirty = dirty;
+	dirty = false;
+	return wasDirty;
 }
 
+int MaterialPoolState::GetMaterialCount()
+{
+	return materials->GetCount();
+}
 
+MaterialState MaterialPoolState::GetMaterialState(int index)
+{
+	Material& material = materials->GetData()[index];
+	return { material.GetColorTint(), material.GetUVScale(), material.GetUVOffset(), material.GetRoughness() };
+}
+
+/// <summary>
+/// Goes through the setters so the material is marked dirty like any other change
+/// </summary>
+void MaterialPoolState::SetMaterialState(int index, const MaterialState& state)
+{
+	Material& material = materials->GetData()[index];
+	material.SetColorTint(state.ColorTint);
+	material.SetUVScale(state.UVScale.x, state.UVScale.y);
+	material.SetUVOffset(state.UVOffset.x, state.UVOffset.y);
+	material.SetRoughness(state.Roughness);
+}
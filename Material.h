@@ -4,6 +4,8 @@
 #include <memory>
 #include <DirectXMath.h>
 #include "Lights.h";
+#include "Handle.h"
+#include "SimulationState.h"
 
 
 class Material
@@ -22,27 +24,35 @@ public:
 		DirectX::XMFLOAT2 _uvOffset,
 		DirectX::XMFLOAT2 _uvScale);
 
-	std::shared_ptr<SimpleVertexShader> GetVS();
-	std::shared_ptr<SimplePixelShader> GetPS();
+	SimpleVertexShader* GetVS();
+	SimpleVertexShader* GetInstancedVS(); //Null when the material can't be drawn instanced
+	SimplePixelShader* GetPS();
 	DirectX::XMFLOAT4 GetColorTint();
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
+	float GetRoughness();
 
 	void SetColorTint(DirectX::XMFLOAT4 _colorTint);
 	void SetVS(std::shared_ptr<SimpleVertexShader> _vs);
+	void SetInstancedVS(std::shared_ptr<SimpleVertexShader> _vs);
 	void SetPS(std::shared_ptr<SimplePixelShader> _ps);
 	void SetUVOffset(float x, float y);
 	void SetUVScale(float x, float y);
+	void SetRoughness(float _roughness);
 
 	void AddTextureSRV(std:: string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texturePtr);
 	void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerPtr);
 
 	void PrepareMaterial(DirectX::XMFLOAT3 cameraPos);
 
-	void PrepareLight(std::vector<Light> lights);
+	void PrepareLight(const Light* lights, int lightCount);
+
+	//True once after any setter ran, so change tracking can pick it up
+	bool ConsumeDirty();
 
 private:
 	std::shared_ptr<SimpleVertexShader> vs;
+	std::shared_ptr<SimpleVertexShader> instancedVS; //Same output as vs, world matrices read per instance
 	std::shared_ptr<SimplePixelShader> ps;
 	DirectX::XMFLOAT4 colorTint;
 
@@ -56,5 +66,23 @@ private:
 	//Material Properties
 	float roughness;
 
+	bool dirty;
+
 };
 
+// --------------------------------------------------------
+// Hands snapshots the parameters of every material in a
+// pool, in pool order
+// --------------------------------------------------------
+class MaterialPoolState : public IMaterialStateSource
+{
+public:
+	MaterialPoolState(HandlePool<Material>* materials) : materials(materials) {}
+
+	int GetMaterialCount() override;
+	MaterialState GetMaterialState(int index) override;
+	void SetMaterialState(int index, const MaterialState& state) override;
+
+private:
+	HandlePool<Material>* materials;
+};
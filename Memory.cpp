@@ -0,0 +1,245 @@
+#include "Memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	std::atomic<uint64_t> allocationCount(0);
+	std::atomic<uint64_t> allocationBytes(0);
+
+	//Every thread's frame allocator, so BeginFrame can reset them all
+	std::mutex frameRegistryMutex;
+	std::vector<std::unique_ptr<LinearAllocator>>& GetFrameRegistry()
+	{
+		static std::vector<std::unique_ptr<LinearAllocator>> registry;
+		return registry;
+	}
+
+	thread_local LinearAllocator* threadFrameAllocator = nullptr;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ LINEAR ALLOCATOR ----------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+LinearAllocator::LinearAllocator(size_t capacity) : capacity(capacity), offset(0), used(0)
+{
+	buffer = static_cast<unsigned char*>(::operator new(capacity, std::align_val_t(64)));
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	Reset();
+	::operator delete(buffer, std::align_val_t(64));
+}
+
+void* LinearAllocator::Allocate(size_t size, size_t alignment)
+{
+	used += size;
+
+	size_t start = AlignUp(offset, alignment);
+	if (start + size <= capacity)
+	{
+		offset = start + size;
+		return buffer + start;
+	}
+
+	//Out of room this frame, take it from the heap and grow on Reset
+	std::align_val_t blockAlignment = std::align_val_t(alignment < 16 ? 16 : alignment);
+	void* block = ::operator new(size, blockAlignment);
+	overflowBlocks.push_back({ block, blockAlignment });
+	return block;
+}
+
+/// <summary>
+/// Frees everything at once. If the buffer overflowed it's regrown to fit,
+/// so the same workload next frame stays inside it.
+/// </summary>
+void LinearAllocator::Reset()
+{
+	if (!overflowBlocks.empty())
+	{
+		for (const OverflowBlock& block : overflowBlocks)
+		{
+			::operator delete(block.Memory, block.Alignment);
+		}
+		overflowBlocks.clear();
+
+		//Room for last frame plus alignment padding and a little headroom
+		size_t newCapacity = capacity;
+		while (newCapacity < used * 2)
+		{
+			newCapacity *= 2;
+		}
+		::operator delete(buffer, std::align_val_t(64));
+		buffer = static_cast<unsigned char*>(::operator new(newCapacity, std::align_val_t(64)));
+		capacity = newCapacity;
+	}
+
+	offset = 0;
+	used = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ FRAME MEMORY --------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+LinearAllocator& FrameMemory::GetThreadAllocator()
+{
+	if (threadFrameAllocator == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(frameRegistryMutex);
+		GetFrameRegistry().push_back(std::make_unique<LinearAllocator>(FRAME_ALLOCATOR_SIZE));
+		threadFrameAllocator = GetFrameRegistry().back().get();
+	}
+	return *threadFrameAllocator;
+}
+
+void FrameMemory::BeginFrame()
+{
+	std::lock_guard<std::mutex> lock(frameRegistryMutex);
+	for (std::unique_ptr<LinearAllocator>& allocator : GetFrameRegistry())
+	{
+		allocator->Reset();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ POOL ALLOCATOR ------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+PoolAllocator::PoolAllocator(size_t blockSize, size_t alignment, int blocksPerPage) :
+	blockSize(AlignUp(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize, alignment)),
+	alignment(alignment),
+	blocksPerPage(blocksPerPage),
+	liveCount(0),
+	freeList(nullptr)
+{
+}
+
+PoolAllocator::~PoolAllocator()
+{
+	for (void* page : pages)
+	{
+		::operator delete(page, std::align_val_t(alignment));
+	}
+}
+
+void* PoolAllocator::Allocate()
+{
+	if (freeList == nullptr)
+	{
+		AddPage();
+	}
+
+	FreeBlock* block = freeList;
+	freeList = block->Next;
+	liveCount++;
+	return block;
+}
+
+void PoolAllocator::Free(void* block)
+{
+	FreeBlock* freed = static_cast<FreeBlock*>(block);
+	freed->Next = freeList;
+	freeList = freed;
+	liveCount--;
+}
+
+void PoolAllocator::AddPage()
+{
+	unsigned char* page = static_cast<unsigned char*>(::operator new(blockSize * blocksPerPage, std::align_val_t(alignment)));
+	pages.push_back(page);
+
+	//Thread the new blocks onto the free list, first block first
+	for (int i = blocksPerPage - 1; i >= 0; i--)
+	{
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(page + blockSize * i);
+		block->Next = freeList;
+		freeList = block;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ ALLOCATION COUNTER --------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+uint64_t AllocationCounter::GetCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetBytes()
+{
+	return allocationBytes.load(std::memory_order_relaxed);
+}
+
+#if MEMORY_TRACK_ALLOCATIONS
+
+namespace
+{
+	void* CountedAllocate(size_t size)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+		void* memory = std::malloc(size ? size : 1);
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	void* CountedAllocateAligned(size_t size, std::align_val_t alignment)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+		size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+		void* memory = std::aligned_alloc(align, AlignUp(size ? size : 1, align));
+#endif
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	void FreeAligned(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+//Replacements for the global allocation functions, every other form forwards to these
+void* operator new(size_t size) { return CountedAllocate(size); }
+void* operator new[](size_t size) { return CountedAllocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+void* operator new(size_t size, std::align_val_t alignment) { return CountedAllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return CountedAllocateAligned(size, alignment); }
+void operator delete(void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+
+#endif
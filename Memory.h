@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define MEMORY_TRACK_ALLOCATIONS 1 //Counts every global new, set to 0 to leave operator new alone
+#define FRAME_ALLOCATOR_SIZE (1024 * 1024) //Starting bytes per thread, grows to the high water mark
+
+// --------------------------------------------------------
+// Bump allocator. Allocating is a pointer bump and nothing
+// is freed until Reset. If a frame needs more than the
+// buffer holds, the extra comes from the heap and the
+// buffer grows on the next Reset, so a steady frame ends
+// up never touching the heap.
+// --------------------------------------------------------
+class LinearAllocator
+{
+public:
+	LinearAllocator(size_t capacity);
+	~LinearAllocator();
+	LinearAllocator(const LinearAllocator&) = delete;
+	LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+	void* Allocate(size_t size, size_t alignment = 16);
+	void Reset();
+
+	template<typename T>
+	T* AllocateArray(int count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	size_t GetUsed() { return used; }
+	size_t GetCapacity() { return capacity; }
+
+private:
+	//Freed with the same alignment they were made with, aligned deletes have to match
+	struct OverflowBlock
+	{
+		void* Memory;
+		std::align_val_t Alignment;
+	};
+
+	unsigned char* buffer;
+	size_t capacity;
+	size_t offset;
+
+	//Everything handed out this frame, including overflow
+	size_t used;
+	std::vector<OverflowBlock> overflowBlocks;
+};
+
+// --------------------------------------------------------
+// One LinearAllocator per thread, all reset together once a
+// frame. Memory from these is only good until the next
+// BeginFrame, and BeginFrame must run while no jobs are.
+// --------------------------------------------------------
+class FrameMemory
+{
+public:
+	static LinearAllocator& GetThreadAllocator();
+	static void BeginFrame();
+};
+
+// --------------------------------------------------------
+// Fixed size blocks carved out of bigger pages, with freed
+// blocks kept on a free list. Not thread safe.
+// --------------------------------------------------------
+class PoolAllocator
+{
+public:
+	PoolAllocator(size_t blockSize, size_t alignment = 16, int blocksPerPage = 256);
+	~PoolAllocator();
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	void* Allocate();
+	void Free(void* block);
+
+	int GetLiveCount() { return liveCount; }
+	int GetPageCount() { return (int)pages.size(); }
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* Next;
+	};
+
+	size_t blockSize;
+	size_t alignment;
+	int blocksPerPage;
+	int liveCount;
+	FreeBlock* freeList;
+	std::vector<void*> pages;
+
+	void AddPage();
+};
+
+// --------------------------------------------------------
+// Typed wrapper around a PoolAllocator
+// --------------------------------------------------------
+template<typename T>
+class ObjectPool
+{
+public:
+	ObjectPool(int blocksPerPage = 256) : allocator(sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T), alignof(T) < 16 ? 16 : alignof(T), blocksPerPage) {}
+
+	template<typename... Args>
+	T* Create(Args&&... args)
+	{
+		return new (allocator.Allocate()) T(std::forward<Args>(args)...);
+	}
+
+	void Destroy(T* object)
+	{
+		object->~T();
+		allocator.Free(object);
+	}
+
+	int GetLiveCount() { return allocator.GetLiveCount(); }
+
+private:
+	PoolAllocator allocator;
+};
+
+// --------------------------------------------------------
+// STL allocator that bumps out of a given LinearAllocator.
+// Deallocation does nothing, memory comes back on Reset.
+// --------------------------------------------------------
+template<typename T>
+class LinearStlAllocator
+{
+public:
+	using value_type = T;
+
+	LinearStlAllocator(LinearAllocator* allocator) : allocator(allocator) {}
+
+	template<typename U>
+	LinearStlAllocator(const LinearStlAllocator<U>& other) : allocator(other.allocator) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(allocator->Allocate(sizeof(T) * count, alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const LinearStlAllocator<U>& other) const { return allocator == other.allocator; }
+	template<typename U>
+	bool operator!=(const LinearStlAllocator<U>& other) const { return allocator != other.allocator; }
+
+	LinearAllocator* allocator;
+};
+
+// --------------------------------------------------------
+// STL allocator over the calling thread's frame allocator,
+// for containers that only live for the current frame
+// --------------------------------------------------------
+template<typename T>
+class FrameStlAllocator
+{
+public:
+	using value_type = T;
+
+	FrameStlAllocator() = default;
+
+	template<typename U>
+	FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(FrameMemory::GetThreadAllocator().Allocate(sizeof(T) * count, alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const FrameStlAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const FrameStlAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+
+// --------------------------------------------------------
+// Running totals of global heap allocations (every form of
+// operator new). Take a snapshot before a frame and compare
+// after it to check the frame didn't touch the heap.
+// --------------------------------------------------------
+class AllocationCounter
+{
+public:
+	static uint64_t GetCount();
+	static uint64_t GetBytes();
+};
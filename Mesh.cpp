@@ -7,6 +7,8 @@ Mesh::Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCo
 {
 	color = XMFLOAT4(0, 0, 0, 0);
 
+	CalculateBounds(vertices, vertexCount);
+
 	CreateMeshBuffers(vertices, vertexCount, indices, indexCount);
 }
 
@@ -203,6 +205,8 @@ Mesh::Mesh(const char* objFile)
 
 	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCounter);
 
+	CalculateBounds(&verts[0], vertCounter);
+
 	CreateMeshBuffers(&verts[0], vertCounter, &indices[0], indexCounter);
 }
 
@@ -216,12 +220,28 @@ void Mesh::Draw()
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 
-	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	Graphics::StateCache.SetVertexBuffer(0, vertexBuffer.Get(), stride, offset);
+	Graphics::StateCache.SetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 	Graphics::Context->DrawIndexed(indexBufferCount, 0, 0);
 }
 
+/// <summary>
+/// Draws the mesh once per instance, the instances' data bound to the second input slot
+/// </summary>
+/// <param name="firstInstance">Where in the instance buffer this draw's instances start</param>
+void Mesh::DrawInstanced(ID3D11Buffer* instances, unsigned int instanceStride, int instanceCount, int firstInstance)
+{
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+
+	Graphics::StateCache.SetVertexBuffer(0, vertexBuffer.Get(), stride, offset);
+	Graphics::StateCache.SetVertexBuffer(1, instances, instanceStride, 0);
+	Graphics::StateCache.SetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+
+	Graphics::Context->DrawIndexedInstanced(indexBufferCount, instanceCount, 0, 0, firstInstance);
+}
+
 DirectX::XMFLOAT4 Mesh::XMGetColor()
 {
 	return DirectX::XMFLOAT4();
@@ -232,6 +252,14 @@ void Mesh::CreateMeshBuffers(Vertex* vertices, int vertexCount, unsigned int* in
 	vertexBufferCount = vertexCount;
 	indexBufferCount = indexCount;
 
+	//Positions and indices stay on the CPU too, the GPU copies can't be read back
+	cpuPositions.resize(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		cpuPositions[i] = vertices[i].Position;
+	}
+	cpuIndices.assign(indices, indices + indexCount);
+
 	// Create a VERTEX BUFFER
 	{
 		// First, we need to describe the buffer we want Direct3D to make on the GPU
@@ -279,6 +307,27 @@ void Mesh::CreateMeshBuffers(Vertex* vertices, int vertexCount, unsigned int* in
 	}
 }
 
+void Mesh::CalculateBounds(Vertex* vertices, int vertexCount)
+{
+	if (vertexCount <= 0)
+	{
+		localBounds = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+		return;
+	}
+
+	XMVECTOR minPos = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR maxPos = minPos;
+	for (int i = 1; i < vertexCount; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&vertices[i].Position);
+		minPos = XMVectorMin(minPos, pos);
+		maxPos = XMVectorMax(maxPos, pos);
+	}
+
+	XMStoreFloat3(&localBounds.Center, (minPos + maxPos) * 0.5f);
+	XMStoreFloat3(&localBounds.Extents, (maxPos - minPos) * 0.5f);
+}
+
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
 	// Reset tangents
@@ -373,3 +422,7 @@ int Mesh::GetVertexCount()
 	return vertexBufferCount;
 }
 
+AABB Mesh::GetLocalBounds()
+{
+	return localBounds;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "Graphics.h"
 #include "Vertex.h"
+#include "Bounds.h"
 
 #include <fstream>
 #include <stdexcept>
@@ -22,7 +23,14 @@ public:
 	int GetIndexCount();
 	int GetVertexCount();
 
+	AABB GetLocalBounds();
+
+	//CPU side copy of the geometry, for the software occlusion rasterizer
+	const std::vector<DirectX::XMFLOAT3>& GetPositions() { return cpuPositions; }
+	const std::vector<unsigned int>& GetIndices() { return cpuIndices; }
+
 	void Draw();
+	void DrawInstanced(ID3D11Buffer* instances, unsigned int instanceStride, int instanceCount, int firstInstance);
 	
 	DirectX::XMFLOAT4 XMGetColor();
 	float* PtrGetColor();
@@ -38,7 +46,14 @@ private:
 	int indexBufferCount;
 	int vertexBufferCount;
 
+	//Object space box around every vertex
+	AABB localBounds;
+
+	std::vector<DirectX::XMFLOAT3> cpuPositions;
+	std::vector<unsigned int> cpuIndices;
+
 	//Methods
+	void CalculateBounds(Vertex* vertices, int vertexCount);
 	void CreateMeshBuffers(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
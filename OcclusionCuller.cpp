@@ -0,0 +1,391 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+using namespace Simd;
+
+namespace
+{
+	//Pixel coordinate to the tile holding it, clamped to the buffer before anything can overflow
+	int TileX(float x)
+	{
+		return (int)std::clamp(x, 0.0f, OCCLUSION_WIDTH - 1.0f) / OCCLUSION_TILE_WIDTH;
+	}
+
+	int TileY(float y)
+	{
+		return (int)std::clamp(y, 0.0f, OCCLUSION_HEIGHT - 1.0f) / OCCLUSION_TILE_HEIGHT;
+	}
+}
+
+OcclusionCuller::OcclusionCuller() :
+	viewProjection{},
+	lastTriangleCount(0),
+	reference(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, std::numeric_limits<float>::max()),
+	working(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 0.0f),
+	coverage(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 0),
+	coarse(OCCLUSION_COARSE_X * OCCLUSION_BANDS, std::numeric_limits<float>::max())
+{
+}
+
+void OcclusionCuller::Begin(const DirectX::XMFLOAT4X4& _viewProjection)
+{
+	viewProjection = _viewProjection;
+	occluders.clear();
+	lastTriangleCount = 0;
+
+	//Nothing drawn yet, so every pixel is as far away as it gets
+	std::fill(reference.begin(), reference.end(), std::numeric_limits<float>::max());
+	std::fill(working.begin(), working.end(), 0.0f);
+	std::fill(coverage.begin(), coverage.end(), 0u);
+	std::fill(coarse.begin(), coarse.end(), std::numeric_limits<float>::max());
+}
+
+void OcclusionCuller::AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, int indexCount, const DirectX::XMFLOAT4X4& world)
+{
+	occluders.push_back({ positions, indices, indexCount, world });
+}
+
+/// <summary>
+/// Sets up and bins every occluder (one job each), then rasterizes each band of tile rows
+/// (one job each). With no job system both passes just run in order on this thread.
+/// </summary>
+void OcclusionCuller::Rasterize(JobSystem* jobSystem)
+{
+	if ((int)bins.size() < (int)occluders.size())
+	{
+		bins.resize(occluders.size());
+	}
+
+	if (jobSystem)
+	{
+		JobCounter counter;
+		jobSystem->ParallelFor((int)occluders.size(), [this](int start, int end)
+			{
+				for (int i = start; i < end; i++)
+				{
+					SetupOccluder(i);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+
+		jobSystem->ParallelFor(OCCLUSION_BANDS, [this](int start, int end)
+			{
+				for (int band = start; band < end; band++)
+				{
+					RasterizeBand(band);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+	}
+	else
+	{
+		for (int i = 0; i < (int)occluders.size(); i++)
+		{
+			SetupOccluder(i);
+		}
+		for (int band = 0; band < OCCLUSION_BANDS; band++)
+		{
+			RasterizeBand(band);
+		}
+	}
+
+	lastTriangleCount = 0;
+	for (int i = 0; i < (int)occluders.size(); i++)
+	{
+		lastTriangleCount += (int)bins[i].Triangles.size();
+	}
+}
+
+/// <summary>
+/// Projects the box's corners and checks the depth of every tile the result covers
+/// </summary>
+/// <returns>False only if the whole box is behind what's already been drawn</returns>
+bool OcclusionCuller::IsVisible(const AABB& box)
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+
+	float minX = std::numeric_limits<float>::max();
+	float minY = std::numeric_limits<float>::max();
+	float maxX = -std::numeric_limits<float>::max();
+	float maxY = -std::numeric_limits<float>::max();
+	float nearest = std::numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMVECTOR point = XMVectorSet(
+			box.Center.x + ((corner & 1) ? box.Extents.x : -box.Extents.x),
+			box.Center.y + ((corner & 2) ? box.Extents.y : -box.Extents.y),
+			box.Center.z + ((corner & 4) ? box.Extents.z : -box.Extents.z),
+			1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(point, matrix));
+
+		//Anything reaching the near plane could cover the whole screen
+		if (clip.w < OCCLUSION_NEAR_W)
+		{
+			return true;
+		}
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		float y = (0.5f - clip.y / clip.w * 0.5f) * OCCLUSION_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.w);
+	}
+
+	if (maxX < 0 || maxY < 0 || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+	{
+		return false; //Entirely off screen
+	}
+	int minTileX = TileX(minX);
+	int maxTileX = TileX(maxX);
+	int minTileY = TileY(minY);
+	int maxTileY = TileY(maxY);
+
+	//Coarse cells first, behind the farthest depth of each one it touches means behind every tile
+	bool behindCoarse = true;
+	for (int band = minTileY / OCCLUSION_BAND_ROWS; band <= maxTileY / OCCLUSION_BAND_ROWS && behindCoarse; band++)
+	{
+		for (int coarseX = minTileX / OCCLUSION_COARSE_WIDTH; coarseX <= maxTileX / OCCLUSION_COARSE_WIDTH; coarseX++)
+		{
+			if (coarse[band * OCCLUSION_COARSE_X + coarseX] >= nearest)
+			{
+				behindCoarse = false;
+				break;
+			}
+		}
+	}
+	if (behindCoarse)
+	{
+		return false;
+	}
+
+	//Eight tiles of a row at a time, lanes past the box are masked off
+	Float8 boxDepth = Splat(-nearest);
+	for (int tileY = minTileY; tileY <= maxTileY; tileY++)
+	{
+		const float* row = reference.data() + tileY * OCCLUSION_TILES_X;
+		for (int tileX = minTileX; tileX <= maxTileX; tileX += SIMD_WIDTH)
+		{
+			int lanes = std::min(maxTileX - tileX + 1, SIMD_WIDTH);
+			unsigned int laneMask = (1u << lanes) - 1;
+			float padded[SIMD_WIDTH];
+			const float* depths = row + tileX;
+			if (tileX + SIMD_WIDTH > OCCLUSION_TILES_X)
+			{
+				std::fill(padded, padded + SIMD_WIDTH, 0.0f);
+				std::copy(depths, depths + lanes, padded);
+				depths = padded;
+			}
+
+			//Visible wherever the box starts in front of the tile's reference depth
+			if (Mask(AtLeastZero(Add(Load(depths), boxDepth))) & laneMask)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// Transforms one occluder, throws away back facing and unusable triangles, turns the rest
+/// into edge equations and files them in every band they overlap
+/// </summary>
+void OcclusionCuller::SetupOccluder(int index)
+{
+	const Occluder& occluder = occluders[index];
+	OccluderBins& output = bins[index];
+	output.Triangles.clear();
+	for (std::vector<uint32_t>& bin : output.Bins)
+	{
+		bin.clear();
+	}
+
+	//Vertices are shared between triangles, so transform each one once
+	unsigned int vertexCount = 0;
+	for (int i = 0; i < occluder.IndexCount; i++)
+	{
+		vertexCount = std::max(vertexCount, occluder.Indices[i] + 1);
+	}
+	output.Clip.resize(vertexCount);
+	XMMATRIX matrix = XMMatrixMultiply(XMLoadFloat4x4(&occluder.World), XMLoadFloat4x4(&viewProjection));
+	XMVector3TransformStream(output.Clip.data(), sizeof(XMFLOAT4), occluder.Positions, sizeof(XMFLOAT3), vertexCount, matrix);
+
+	for (int i = 0; i + 2 < occluder.IndexCount; i += 3)
+	{
+		float x[3], y[3], w[3];
+		bool usable = true;
+		for (int v = 0; v < 3; v++)
+		{
+			const XMFLOAT4& clip = output.Clip[occluder.Indices[i + v]];
+			if (clip.w < OCCLUSION_NEAR_W)
+			{
+				usable = false;
+				break;
+			}
+			x[v] = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+			y[v] = (0.5f - clip.y / clip.w * 0.5f) * OCCLUSION_HEIGHT;
+			w[v] = clip.w;
+		}
+		if (!usable)
+		{
+			continue;
+		}
+
+		//D3D's front faces are clockwise on screen, which is a positive area with y pointing down
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (!(area > 0))
+		{
+			continue;
+		}
+
+		float minX = std::min({ x[0], x[1], x[2] });
+		float maxX = std::max({ x[0], x[1], x[2] });
+		float minY = std::min({ y[0], y[1], y[2] });
+		float maxY = std::max({ y[0], y[1], y[2] });
+		if (maxX < 0 || maxY < 0 || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+		{
+			continue;
+		}
+
+		ScreenTriangle triangle;
+		triangle.MinTileX = TileX(minX);
+		triangle.MaxTileX = TileX(maxX);
+		triangle.MinTileY = TileY(minY);
+		triangle.MaxTileY = TileY(maxY);
+
+		//Edge from vertex i to j is A*x + B*y + C, positive on the inside
+		for (int e = 0; e < 3; e++)
+		{
+			int j = (e + 1) % 3;
+			triangle.EdgeA[e] = y[e] - y[j];
+			triangle.EdgeB[e] = x[j] - x[e];
+			triangle.EdgeC[e] = (y[j] - y[e]) * x[e] - (x[j] - x[e]) * y[e];
+		}
+		triangle.Depth = std::max({ w[0], w[1], w[2] });
+
+		uint32_t triangleIndex = (uint32_t)output.Triangles.size();
+		output.Triangles.push_back(triangle);
+		for (int band = triangle.MinTileY / OCCLUSION_BAND_ROWS; band <= triangle.MaxTileY / OCCLUSION_BAND_ROWS; band++)
+		{
+			output.Bins[band].push_back(triangleIndex);
+		}
+	}
+}
+
+/// <summary>
+/// Everything binned into one band, in occluder order so results never depend on timing
+/// </summary>
+void OcclusionCuller::RasterizeBand(int band)
+{
+	int firstRow = band * OCCLUSION_BAND_ROWS;
+	int lastRow = firstRow + OCCLUSION_BAND_ROWS - 1;
+	for (int i = 0; i < (int)occluders.size(); i++)
+	{
+		const OccluderBins& occluderBins = bins[i];
+		for (uint32_t triangle : occluderBins.Bins[band])
+		{
+			RasterizeTriangle(occluderBins.Triangles[triangle], firstRow, lastRow);
+		}
+	}
+	BuildCoarseBand(band);
+}
+
+/// <summary>
+/// Builds each tile's coverage mask a row of 8 pixel centers at a time, then merges it in
+/// </summary>
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int lastRow)
+{
+	Float8 a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		a[e] = Splat(triangle.EdgeA[e]);
+		b[e] = Splat(triangle.EdgeB[e]);
+		c[e] = Splat(triangle.EdgeC[e]);
+	}
+
+	int minRow = std::max(triangle.MinTileY, firstRow);
+	int maxRow = std::min(triangle.MaxTileY, lastRow);
+	for (int tileY = minRow; tileY <= maxRow; tileY++)
+	{
+		for (int tileX = triangle.MinTileX; tileX <= triangle.MaxTileX; tileX++)
+		{
+			//The x part of each edge is the same for all four rows
+			Float8 x = Sequence(tileX * OCCLUSION_TILE_WIDTH + 0.5f);
+			Float8 edgeX[3];
+			for (int e = 0; e < 3; e++)
+			{
+				edgeX[e] = Add(Mul(a[e], x), c[e]);
+			}
+
+			uint32_t mask = 0;
+			for (int row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+			{
+				Float8 y = Splat(tileY * OCCLUSION_TILE_HEIGHT + row + 0.5f);
+				Float8 inside = AboveZero(Add(edgeX[0], Mul(b[0], y)));
+				inside = And(inside, AboveZero(Add(edgeX[1], Mul(b[1], y))));
+				inside = And(inside, AboveZero(Add(edgeX[2], Mul(b[2], y))));
+				mask |= Mask(inside) << (row * OCCLUSION_TILE_WIDTH);
+			}
+
+			if (mask)
+			{
+				MergeTile(tileY * OCCLUSION_TILES_X + tileX, mask, triangle.Depth);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Adds coverage at a known depth to a tile's working layer and, once the layer covers
+/// the whole tile, moves it into the reference depth
+/// </summary>
+void OcclusionCuller::MergeTile(int tile, uint32_t mask, float depth)
+{
+	//Behind everything already there, it can't hide anything new
+	if (depth >= reference[tile])
+	{
+		return;
+	}
+
+	//Closer than the working layer, so start a new layer rather than drag this one's depth back
+	if (coverage[tile] && depth < working[tile])
+	{
+		coverage[tile] = 0;
+		working[tile] = 0;
+	}
+
+	coverage[tile] |= mask;
+	working[tile] = std::max(working[tile], depth);
+	if (coverage[tile] == 0xFFFFFFFFu)
+	{
+		reference[tile] = std::min(reference[tile], working[tile]);
+		coverage[tile] = 0;
+		working[tile] = 0;
+	}
+}
+
+/// <summary>
+/// Takes the farthest reference depth under each coarse cell of a band. Only the band's own
+/// job writes its cells, so this runs right after the band is rasterized.
+/// </summary>
+void OcclusionCuller::BuildCoarseBand(int band)
+{
+	for (int coarseX = 0; coarseX < OCCLUSION_COARSE_X; coarseX++)
+	{
+		Float8 farthest = Splat(0.0f);
+		for (int tileY = band * OCCLUSION_BAND_ROWS; tileY < (band + 1) * OCCLUSION_BAND_ROWS; tileY++)
+		{
+			farthest = Max(farthest, Load(reference.data() + tileY * OCCLUSION_TILES_X + coarseX * OCCLUSION_COARSE_WIDTH));
+		}
+		float lanes[SIMD_WIDTH];
+		Store(lanes, farthest);
+		coarse[band * OCCLUSION_COARSE_X + coarseX] = *std::max_element(lanes, lanes + SIMD_WIDTH);
+	}
+}
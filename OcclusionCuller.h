@@ -0,0 +1,122 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+#include "Simd.h"
+
+#define OCCLUSION_WIDTH 320
+#define OCCLUSION_HEIGHT 192
+#define OCCLUSION_TILE_WIDTH SIMD_WIDTH //One row of a tile is one SIMD register
+#define OCCLUSION_TILE_HEIGHT 4 //8x4 pixels, so a tile's coverage fits in 32 bits
+#define OCCLUSION_TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT)
+#define OCCLUSION_BAND_ROWS 4 //Tile rows per bin, each bin is rasterized by one job
+#define OCCLUSION_BANDS (OCCLUSION_TILES_Y / OCCLUSION_BAND_ROWS)
+#define OCCLUSION_COARSE_WIDTH SIMD_WIDTH //Tiles across one coarse cell, a coarse cell is that by a band
+#define OCCLUSION_COARSE_X (OCCLUSION_TILES_X / OCCLUSION_COARSE_WIDTH)
+#define OCCLUSION_NEAR_W 0.001f //Occluder triangles closer than this are skipped rather than clipped
+
+// --------------------------------------------------------
+// Masked software occlusion culling
+//
+// A few big occluder meshes are rasterized on the CPU into
+// a small depth buffer, then boxes are tested against it.
+// There is no per pixel depth. Each 8x4 tile keeps a
+// reference depth that every pixel is known to be in front
+// of, plus a working layer: a 32 bit coverage mask and the
+// farthest depth of the triangles covering it. Once the
+// mask fills up, the working depth becomes the reference
+// depth. That is the masked, two layer scheme from
+// Andersson et al. 2015, "Masked Software Occlusion
+// Culling".
+//
+// On top of the tiles sits one coarse level: per band,
+// the farthest reference depth of each run of 8 tiles.
+// Boxes behind every coarse cell they touch are rejected
+// without reading single tiles, which is what big boxes
+// behind a wall mostly are.
+//
+// Depths are view space distance (clip w), so they stay
+// linear and precise. Everything errs towards visible:
+// - triangles crossing the near plane are skipped
+// - pixels on an edge count as uncovered
+// - a box only counts as hidden when it is behind the
+//   reference depth of every tile it touches
+//
+// Rasterizing is split in two passes. First every occluder
+// is transformed and its triangles binned by band of tile
+// rows, one job per occluder. Then each band is rasterized
+// by its own job, so no two jobs ever touch the same tile.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	//Clears the buffer and the occluder list for a new view
+	void Begin(const DirectX::XMFLOAT4X4& viewProjection);
+
+	//The arrays have to stay alive until Rasterize is done
+	void AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, int indexCount, const DirectX::XMFLOAT4X4& world);
+	void Rasterize(JobSystem* jobSystem = nullptr);
+
+	//Safe to call from many threads at once once Rasterize is done
+	bool IsVisible(const AABB& box);
+
+	//Getters
+	int GetOccluderCount() { return (int)occluders.size(); }
+	int GetTriangleCount() { return lastTriangleCount; } //Front facing triangles that made it into a bin
+	float GetTileDepth(int tileX, int tileY) { return reference[tileY * OCCLUSION_TILES_X + tileX]; }
+	float GetCoarseDepth(int coarseX, int band) { return coarse[band * OCCLUSION_COARSE_X + coarseX]; }
+
+private:
+	struct Occluder
+	{
+		const DirectX::XMFLOAT3* Positions;
+		const unsigned int* Indices;
+		int IndexCount;
+		DirectX::XMFLOAT4X4 World;
+	};
+
+	//Screen space triangle, ready to rasterize
+	struct ScreenTriangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float Depth; //Farthest vertex, so the whole triangle is in front of it
+		int MinTileX, MaxTileX;
+		int MinTileY, MaxTileY;
+	};
+
+	//Output of setting up one occluder, kept between frames so nothing is reallocated
+	struct OccluderBins
+	{
+		std::vector<DirectX::XMFLOAT4> Clip;
+		std::vector<ScreenTriangle> Triangles;
+		std::vector<uint32_t> Bins[OCCLUSION_BANDS];
+	};
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<Occluder> occluders;
+	std::vector<OccluderBins> bins;
+	int lastTriangleCount;
+
+	//Per tile, row major
+	std::vector<float> reference;
+	std::vector<float> working;
+	std::vector<uint32_t> coverage;
+
+	//Per coarse cell, the farthest reference depth under it
+	std::vector<float> coarse;
+
+	void SetupOccluder(int index);
+	void RasterizeBand(int band);
+	void RasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int lastRow);
+	void MergeTile(int tile, uint32_t mask, float depth);
+	void BuildCoarseBand(int band);
+};
@@ -0,0 +1,421 @@
+#include "PortalSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	const PortalRect fullScreen = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+	PortalRect Intersect(const PortalRect& a, const PortalRect& b)
+	{
+		return { a.MinX > b.MinX ? a.MinX : b.MinX, a.MinY > b.MinY ? a.MinY : b.MinY,
+			a.MaxX < b.MaxX ? a.MaxX : b.MaxX, a.MaxY < b.MaxY ? a.MaxY : b.MaxY };
+	}
+
+	PortalRect Union(const PortalRect& a, const PortalRect& b)
+	{
+		return { a.MinX < b.MinX ? a.MinX : b.MinX, a.MinY < b.MinY ? a.MinY : b.MinY,
+			a.MaxX > b.MaxX ? a.MaxX : b.MaxX, a.MaxY > b.MaxY ? a.MaxY : b.MaxY };
+	}
+
+	bool Contains(const PortalRect& outer, const PortalRect& inner)
+	{
+		return inner.MinX >= outer.MinX && inner.MinY >= outer.MinY && inner.MaxX <= outer.MaxX && inner.MaxY <= outer.MaxY;
+	}
+
+	bool PointInAABB(const AABB& box, const XMFLOAT3& point)
+	{
+		return fabsf(point.x - box.Center.x) <= box.Extents.x
+			&& fabsf(point.y - box.Center.y) <= box.Extents.y
+			&& fabsf(point.z - box.Center.z) <= box.Extents.z;
+	}
+}
+
+PortalSystem::PortalSystem() :
+	frame(0),
+	viewProjection{},
+	eye(0, 0, 0),
+	steps(0),
+	stats{}
+{
+	stats.CameraCell = PORTAL_NO_CELL;
+}
+
+void PortalSystem::Clear()
+{
+	cells.clear();
+	portals.clear();
+	std::fill(entityCells.begin(), entityCells.end(), PORTAL_NO_CELL);
+	cellFrames.clear();
+	cellRects.clear();
+	portalFrames.clear();
+	portalRects.clear();
+	onPath.clear();
+	visibleCells.clear();
+}
+
+int PortalSystem::AddCell(const AABB& bounds)
+{
+	cells.push_back({ bounds, {} });
+	cellFrames.push_back(0);
+	cellRects.push_back(fullScreen);
+	onPath.push_back(0);
+	return (int)cells.size() - 1;
+}
+
+/// <summary>
+/// Copies the polygon and works out its plane with Newell's method, which copes with
+/// slightly uneven polygons. The normal is turned to face from the first cell's centre.
+/// </summary>
+int PortalSystem::AddPortal(int cellA, int cellB, const DirectX::XMFLOAT3* vertices, int vertexCount)
+{
+	if (cellA < 0 || cellB < 0 || cellA >= (int)cells.size() || cellB >= (int)cells.size() || cellA == cellB
+		|| vertexCount < 3 || vertexCount > PORTAL_MAX_VERTICES)
+	{
+		return -1;
+	}
+
+	Portal portal = {};
+	portal.Cells[0] = cellA;
+	portal.Cells[1] = cellB;
+	portal.VertexCount = vertexCount;
+	std::memcpy(portal.Vertices, vertices, vertexCount * sizeof(XMFLOAT3));
+
+	XMFLOAT3 normal(0, 0, 0);
+	XMFLOAT3 centroid(0, 0, 0);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& a = vertices[i];
+		const XMFLOAT3& b = vertices[(i + 1) % vertexCount];
+		normal.x += (a.y - b.y) * (a.z + b.z);
+		normal.y += (a.z - b.z) * (a.x + b.x);
+		normal.z += (a.x - b.x) * (a.y + b.y);
+		centroid.x += a.x / vertexCount;
+		centroid.y += a.y / vertexCount;
+		centroid.z += a.z / vertexCount;
+	}
+	float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	if (length <= 0.0f)
+	{
+		return -1;
+	}
+
+	const XMFLOAT3& from = cells[cellA].Bounds.Center;
+	float facing = normal.x * (centroid.x - from.x) + normal.y * (centroid.y - from.y) + normal.z * (centroid.z - from.z);
+	float scale = (facing < 0 ? -1.0f : 1.0f) / length;
+	portal.Plane = XMFLOAT4(normal.x * scale, normal.y * scale, normal.z * scale, 0.0f);
+	portal.Plane.w = -(portal.Plane.x * centroid.x + portal.Plane.y * centroid.y + portal.Plane.z * centroid.z);
+
+	portals.push_back(portal);
+	portalFrames.push_back(0);
+	portalRects.push_back(fullScreen);
+	int index = (int)portals.size() - 1;
+	cells[cellA].Portals.push_back(index);
+	cells[cellB].Portals.push_back(index);
+	return index;
+}
+
+int PortalSystem::FindCell(const DirectX::XMFLOAT3& point)
+{
+	for (int i = 0; i < (int)cells.size(); i++)
+	{
+		if (PointInAABB(cells[i].Bounds, point))
+		{
+			return i;
+		}
+	}
+	return PORTAL_NO_CELL;
+}
+
+void PortalSystem::ResizeEntities(int slotCount)
+{
+	entityCells.resize(slotCount, PORTAL_NO_CELL);
+}
+
+/// <summary>
+/// Puts the entity in the first cell wholly containing its bounds, or in none
+/// </summary>
+void PortalSystem::AssignEntity(uint32_t slot, const AABB& bounds)
+{
+	if (slot >= entityCells.size())
+	{
+		entityCells.resize(slot + 1, PORTAL_NO_CELL);
+	}
+
+	entityCells[slot] = PORTAL_NO_CELL;
+	for (int i = 0; i < (int)cells.size(); i++)
+	{
+		if (AABBContainsAABB(cells[i].Bounds, bounds))
+		{
+			entityCells[slot] = i;
+			return;
+		}
+	}
+}
+
+void PortalSystem::RemoveEntity(uint32_t slot)
+{
+	if (slot < entityCells.size())
+	{
+		entityCells[slot] = PORTAL_NO_CELL;
+	}
+}
+
+/// <summary>
+/// Finds the eye's cell and walks out from it. An eye outside every cell can't say anything
+/// about what's visible, so then every cell is.
+/// </summary>
+/// <returns>How many cells are visible</returns>
+int PortalSystem::Update(const DirectX::XMFLOAT4X4& _viewProjection, const DirectX::XMFLOAT3& _eye)
+{
+	viewProjection = _viewProjection;
+	eye = _eye;
+	frame++;
+	visibleCells.clear();
+	steps = 0;
+
+	int cameraCell = FindCell(eye);
+	stats = {};
+	stats.CameraCell = cameraCell;
+	if (cameraCell == PORTAL_NO_CELL)
+	{
+		ShowAll();
+	}
+	else
+	{
+		Visit(cameraCell, fullScreen, 0);
+		if (stats.Truncated)
+		{
+			ShowAll();
+		}
+	}
+
+	stats.VisibleCells = (int)visibleCells.size();
+	return stats.VisibleCells;
+}
+
+/// <summary>
+/// Marks the cell seen through the rectangle, then follows every portal out of it that the
+/// eye is behind and that overlaps the rectangle. A cell already seen through a rectangle
+/// covering this one has nothing new to show, so the walk stops there.
+/// </summary>
+void PortalSystem::Visit(int cell, const PortalRect& rect, int depth)
+{
+	if (cellFrames[cell] == frame)
+	{
+		if (Contains(cellRects[cell], rect))
+		{
+			return;
+		}
+		cellRects[cell] = Union(cellRects[cell], rect);
+	}
+	else
+	{
+		cellFrames[cell] = frame;
+		cellRects[cell] = rect;
+		visibleCells.push_back(cell);
+	}
+	stats.DeepestPath = depth > stats.DeepestPath ? depth : stats.DeepestPath;
+
+	onPath[cell] = 1;
+	for (int index : cells[cell].Portals)
+	{
+		const Portal& portal = portals[index];
+		int next = portal.Cells[0] == cell ? portal.Cells[1] : portal.Cells[0];
+
+		//A ray through convex cells never comes back into one, so paths don't either
+		if (onPath[next])
+		{
+			continue;
+		}
+		if (++steps > PORTAL_MAX_STEPS)
+		{
+			stats.Truncated = true;
+			break;
+		}
+		stats.PortalsTested++;
+
+		//Signed distance of the eye past the portal, in the direction of travel
+		float side = portal.Plane.x * eye.x + portal.Plane.y * eye.y + portal.Plane.z * eye.z + portal.Plane.w;
+		side = portal.Cells[0] == cell ? side : -side;
+		if (side > PORTAL_PLANE_EPSILON)
+		{
+			continue; //The eye is already on the far side, so it can't look through it this way
+		}
+
+		PortalRect narrowed = rect;
+		if (side < -PORTAL_PLANE_EPSILON)
+		{
+			PortalRect portalRect;
+			if (!ProjectPortal(index, portalRect))
+			{
+				continue;
+			}
+			narrowed = Intersect(rect, portalRect);
+			if (narrowed.IsEmpty())
+			{
+				continue;
+			}
+		}
+
+		stats.PortalsPassed++;
+		Visit(next, narrowed, depth + 1);
+	}
+	onPath[cell] = 0;
+}
+
+/// <summary>
+/// The screen rectangle around the portal, clipped to the screen. The polygon is clipped
+/// against the near plane first so vertices behind the eye don't flip across the screen.
+/// Cached for the frame, since it's the same whichever cell the portal is reached from.
+/// </summary>
+/// <returns>False if none of the portal is in front of the eye or on screen</returns>
+bool PortalSystem::ProjectPortal(int index, PortalRect& rect)
+{
+	if (portalFrames[index] == frame)
+	{
+		rect = portalRects[index];
+		return !rect.IsEmpty();
+	}
+	portalFrames[index] = frame;
+
+	const Portal& portal = portals[index];
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+	XMFLOAT4 clip[PORTAL_MAX_VERTICES];
+	for (int i = 0; i < portal.VertexCount; i++)
+	{
+		XMStoreFloat4(&clip[i], XMVector4Transform(XMVectorSet(portal.Vertices[i].x, portal.Vertices[i].y, portal.Vertices[i].z, 1.0f), matrix));
+	}
+
+	//One Sutherland-Hodgman pass against w = PORTAL_NEAR_W adds at most one vertex
+	XMFLOAT4 clipped[PORTAL_MAX_VERTICES + 1];
+	int clippedCount = 0;
+	for (int i = 0; i < portal.VertexCount; i++)
+	{
+		const XMFLOAT4& a = clip[i];
+		const XMFLOAT4& b = clip[(i + 1) % portal.VertexCount];
+		bool aInside = a.w >= PORTAL_NEAR_W;
+		bool bInside = b.w >= PORTAL_NEAR_W;
+		if (aInside)
+		{
+			clipped[clippedCount++] = a;
+		}
+		if (aInside != bInside)
+		{
+			float t = (PORTAL_NEAR_W - a.w) / (b.w - a.w);
+			clipped[clippedCount++] = XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, PORTAL_NEAR_W);
+		}
+	}
+
+	rect = { 1.0f, 1.0f, -1.0f, -1.0f };
+	for (int i = 0; i < clippedCount; i++)
+	{
+		float x = clipped[i].x / clipped[i].w;
+		float y = clipped[i].y / clipped[i].w;
+		rect = Union(rect, { x, y, x, y });
+	}
+	rect = clippedCount > 0 ? Intersect(rect, fullScreen) : PortalRect{ 1.0f, 1.0f, -1.0f, -1.0f };
+	portalRects[index] = rect;
+	return !rect.IsEmpty();
+}
+
+/// <summary>
+/// The screen rectangle around the box's corners, or false when it reaches behind the near
+/// plane. That only happens close up, and then the box is treated as covering everything.
+/// </summary>
+bool PortalSystem::ProjectBounds(const AABB& bounds, PortalRect& rect)
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+	rect = { 1.0f, 1.0f, -1.0f, -1.0f };
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(
+			bounds.Center.x + ((corner & 1) ? bounds.Extents.x : -bounds.Extents.x),
+			bounds.Center.y + ((corner & 2) ? bounds.Extents.y : -bounds.Extents.y),
+			bounds.Center.z + ((corner & 4) ? bounds.Extents.z : -bounds.Extents.z),
+			1.0f), matrix));
+		if (clip.w < PORTAL_NEAR_W)
+		{
+			return false;
+		}
+
+		float x = clip.x / clip.w;
+		float y = clip.y / clip.w;
+		rect = Union(rect, { x, y, x, y });
+	}
+	return true;
+}
+
+void PortalSystem::ShowAll()
+{
+	visibleCells.clear();
+	for (int i = 0; i < (int)cells.size(); i++)
+	{
+		cellFrames[i] = frame;
+		cellRects[i] = fullScreen;
+		visibleCells.push_back(i);
+	}
+}
+
+/// <summary>
+/// Drops slots in cells the walk never reached, and slots whose screen rectangle misses
+/// everything seen of their cell. Bounds come out of the culler eight at a time.
+/// </summary>
+/// <returns>How many slots were kept</returns>
+int PortalSystem::Filter(FrustumCuller& culler, const uint32_t* slots, int count)
+{
+	visible.clear();
+	stats.EntitiesTested = count;
+	stats.HiddenByCell = 0;
+	stats.HiddenByRect = 0;
+
+	float bounds[6][CULL_BLOCK_SIZE];
+	for (int first = 0; first < count; first += CULL_BLOCK_SIZE)
+	{
+		int laneCount = count - first < CULL_BLOCK_SIZE ? count - first : CULL_BLOCK_SIZE;
+		bool gathered = false;
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			uint32_t slot = slots[first + lane];
+			int cell = GetEntityCell(slot);
+			if (cell == PORTAL_NO_CELL)
+			{
+				visible.push_back(slot);
+				continue;
+			}
+			if (cellFrames[cell] != frame)
+			{
+				stats.HiddenByCell++;
+				continue;
+			}
+
+			//A cell seen through the whole screen keeps everything in it
+			const PortalRect& cellRect = cellRects[cell];
+			if (Contains(cellRect, fullScreen))
+			{
+				visible.push_back(slot);
+				continue;
+			}
+
+			if (!gathered)
+			{
+				culler.GatherBounds(slots + first, laneCount, bounds);
+				gathered = true;
+			}
+			AABB box = { XMFLOAT3(bounds[0][lane], bounds[1][lane], bounds[2][lane]), XMFLOAT3(bounds[3][lane], bounds[4][lane], bounds[5][lane]) };
+			PortalRect boxRect;
+			if (ProjectBounds(box, boxRect) && Intersect(boxRect, cellRect).IsEmpty())
+			{
+				stats.HiddenByRect++;
+				continue;
+			}
+			visible.push_back(slot);
+		}
+	}
+	return (int)visible.size();
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "FrustumCuller.h"
+
+#define PORTAL_MAX_VERTICES 8 //Corners per portal polygon
+#define PORTAL_NO_CELL -1
+#define PORTAL_NEAR_W 0.01f //Portal vertices closer than this in clip space w are clipped away
+#define PORTAL_PLANE_EPSILON 0.05f //An eye this close to a portal's plane looks through all of it
+#define PORTAL_MAX_STEPS 4096 //Portals walked through per Update before giving up and showing every cell
+
+// --------------------------------------------------------
+// Normalized device coordinates, -1 to 1 on both axes
+// --------------------------------------------------------
+struct PortalRect
+{
+	float MinX;
+	float MinY;
+	float MaxX;
+	float MaxY;
+
+	bool IsEmpty() const { return MinX >= MaxX || MinY >= MaxY; }
+};
+
+//What the last Update and Filter did
+struct PortalStats
+{
+	int CameraCell; //PORTAL_NO_CELL when the eye isn't in any cell, and every cell counts as visible
+	int VisibleCells;
+	int PortalsTested;
+	int PortalsPassed; //Tested portals that were in front of the eye and inside the rectangle so far
+	int DeepestPath; //Portals between the camera's cell and the furthest cell reached
+	bool Truncated; //Ran out of PORTAL_MAX_STEPS, every cell was shown
+	int EntitiesTested;
+	int HiddenByCell; //In a cell nothing was seen through
+	int HiddenByRect; //In a visible cell, but outside everything seen of it
+};
+
+// --------------------------------------------------------
+// Cell and portal visibility for indoor scenes
+//
+// Cells are convex zones, here boxes, and portals are the
+// convex polygons in the openings between two of them.
+// Every Update starts in the cell holding the eye with the
+// whole screen and walks out through its portals. Each
+// portal is projected and its screen rectangle intersected
+// with the one it was reached through, and the walk only
+// carries on while that stays non-empty, so every cell it
+// reaches comes with the part of the screen it can be seen
+// through.
+//
+// Entities are assigned to the cell that wholly contains
+// their bounds. Anything that straddles cells or sits
+// outside all of them has no cell and always passes, it's
+// left to the other culling stages.
+//
+// Slots are the same entity indices FrustumCuller uses, so
+// its visible list can be filtered directly, with the
+// bounds read back out of the culler.
+// --------------------------------------------------------
+class PortalSystem
+{
+public:
+	PortalSystem();
+
+	void Clear();
+	int AddCell(const AABB& bounds);
+
+	//Vertices go around the polygon in either order. Returns -1 if the cells or the vertex count are bad.
+	int AddPortal(int cellA, int cellB, const DirectX::XMFLOAT3* vertices, int vertexCount);
+
+	//The first cell containing the point, or PORTAL_NO_CELL
+	int FindCell(const DirectX::XMFLOAT3& point);
+
+	//Entities
+	void ResizeEntities(int slotCount);
+	void AssignEntity(uint32_t slot, const AABB& bounds);
+	void RemoveEntity(uint32_t slot);
+
+	//Walks the portals from the eye's cell, returns how many cells are visible
+	int Update(const DirectX::XMFLOAT4X4& viewProjection, const DirectX::XMFLOAT3& eye);
+
+	//Keeps the slots whose cell is visible and whose bounds land inside what's visible of it, in the same order
+	int Filter(FrustumCuller& culler, const uint32_t* slots, int count);
+
+	//Getters
+	int GetCellCount() { return (int)cells.size(); }
+	int GetPortalCount() { return (int)portals.size(); }
+	const AABB& GetCellBounds(int cell) { return cells[cell].Bounds; }
+	bool IsCellVisible(int cell) { return cellFrames[cell] == frame; }
+	const PortalRect& GetCellRect(int cell) { return cellRects[cell]; } //Only meaningful for visible cells
+	const int* GetVisibleCells() { return visibleCells.data(); }
+	int GetVisibleCellCount() { return (int)visibleCells.size(); }
+	int GetEntityCell(uint32_t slot) { return slot < entityCells.size() ? entityCells[slot] : PORTAL_NO_CELL; }
+	const uint32_t* GetVisible() { return visible.data(); }
+	int GetVisibleCount() { return (int)visible.size(); }
+	const PortalStats& GetStats() { return stats; }
+
+private:
+	struct Cell
+	{
+		AABB Bounds;
+		std::vector<int> Portals;
+	};
+
+	struct Portal
+	{
+		int Cells[2];
+		int VertexCount;
+		DirectX::XMFLOAT3 Vertices[PORTAL_MAX_VERTICES];
+		DirectX::XMFLOAT4 Plane; //Normal points from Cells[0] into Cells[1]
+	};
+
+	std::vector<Cell> cells;
+	std::vector<Portal> portals;
+	std::vector<int> entityCells;
+
+	//Per Update. Cells and portals are stamped with the frame instead of cleared.
+	uint32_t frame;
+	DirectX::XMFLOAT4X4 viewProjection;
+	DirectX::XMFLOAT3 eye;
+	std::vector<uint32_t> cellFrames;
+	std::vector<PortalRect> cellRects; //Union of every rectangle a cell was reached through
+	std::vector<uint32_t> portalFrames;
+	std::vector<PortalRect> portalRects; //The portal's own screen rectangle, the same whichever way it's reached
+	std::vector<unsigned char> onPath;
+	std::vector<int> visibleCells;
+	std::vector<uint32_t> visible;
+	int steps;
+	PortalStats stats;
+
+	void Visit(int cell, const PortalRect& rect, int depth);
+	bool ProjectPortal(int portal, PortalRect& rect);
+	bool ProjectBounds(const AABB& bounds, PortalRect& rect);
+	void ShowAll();
+};
@@ -0,0 +1,313 @@
+#include "PotentiallyVisibleSet.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	struct PvsFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceHash;
+		DirectX::XMFLOAT3 Origin;
+		float CellSize;
+		int32_t Dimensions[3];
+		uint32_t ObjectCount;
+		uint32_t SetCount;
+		uint32_t DirectoryCount;
+		uint32_t WordCount;
+		uint32_t Padding;
+	};
+
+	template<typename T>
+	void WriteArray(std::ofstream& output, const std::vector<T>& values)
+	{
+		output.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadArray(std::ifstream& input, std::vector<T>& values, size_t count)
+	{
+		values.resize(count);
+		return (bool)input.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+	}
+}
+
+PotentiallyVisibleSet::PotentiallyVisibleSet() :
+	origin(0, 0, 0),
+	cellSize(1.0f),
+	dimensions{},
+	objectCount(0),
+	sourceHash(0)
+{
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+	cellSets.clear();
+	sets.clear();
+	directory.clear();
+	words.clear();
+	baked.clear();
+	visible.clear();
+	setLookup.clear();
+	objectCount = 0;
+	sourceHash = 0;
+}
+
+void PotentiallyVisibleSet::Begin(const DirectX::XMFLOAT3& _origin, float _cellSize, const int _dimensions[3], uint32_t _objectCount, uint64_t _sourceHash)
+{
+	Clear();
+	origin = _origin;
+	cellSize = _cellSize;
+	std::memcpy(dimensions, _dimensions, sizeof(dimensions));
+	objectCount = _objectCount;
+	sourceHash = _sourceHash;
+	cellSets.assign((size_t)dimensions[0] * dimensions[1] * dimensions[2], 0);
+	baked.assign((objectCount + 63) / 64, 0);
+}
+
+void PotentiallyVisibleSet::SetBaked(uint32_t object)
+{
+	baked[object >> 6] |= 1ull << (object & 63);
+}
+
+/// <summary>
+/// Packs a full bitset of objectCount bits into the sparse form. If another cell already
+/// has the same set the cell shares it, otherwise it's appended.
+/// </summary>
+void PotentiallyVisibleSet::SetCell(int cell, const uint64_t* bits)
+{
+	int wordCount = (int)((objectCount + 63) / 64);
+	int entryCount = GetEntryCount();
+	scratchDirectory.assign(entryCount, {});
+	scratchWords.clear();
+
+	//FNV-1a over what's stored, which is the same for equal sets
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t value)
+	{
+		hash ^= value;
+		hash *= 1099511628211ull;
+	};
+
+	uint32_t visibleCount = 0;
+	for (int entry = 0; entry < entryCount; entry++)
+	{
+		DirectoryEntry& scratch = scratchDirectory[entry];
+		scratch.FirstWord = (uint32_t)scratchWords.size();
+		int first = entry * PVS_WORDS_PER_ENTRY;
+		int last = first + PVS_WORDS_PER_ENTRY < wordCount ? first + PVS_WORDS_PER_ENTRY : wordCount;
+		for (int word = first; word < last; word++)
+		{
+			if (bits[word])
+			{
+				scratch.NonZero |= 1ull << (word - first);
+				scratchWords.push_back(bits[word]);
+				visibleCount += std::popcount(bits[word]);
+				mix(bits[word]);
+			}
+		}
+		mix(scratch.NonZero);
+	}
+
+	std::vector<uint32_t>& candidates = setLookup[hash];
+	for (uint32_t candidate : candidates)
+	{
+		const VisibleSet& set = sets[candidate];
+		if (set.VisibleCount != visibleCount)
+		{
+			continue;
+		}
+
+		bool same = true;
+		uint32_t base = directory[set.FirstEntry].FirstWord;
+		for (int entry = 0; entry < entryCount && same; entry++)
+		{
+			same = directory[set.FirstEntry + entry].NonZero == scratchDirectory[entry].NonZero;
+		}
+		same = same && (scratchWords.empty() || std::memcmp(words.data() + base, scratchWords.data(), scratchWords.size() * sizeof(uint64_t)) == 0);
+		if (same)
+		{
+			cellSets[cell] = candidate;
+			return;
+		}
+	}
+
+	uint32_t base = (uint32_t)words.size();
+	sets.push_back({ (uint32_t)directory.size(), visibleCount });
+	for (DirectoryEntry entry : scratchDirectory)
+	{
+		entry.FirstWord += base;
+		directory.push_back(entry);
+	}
+	words.insert(words.end(), scratchWords.begin(), scratchWords.end());
+	candidates.push_back((uint32_t)sets.size() - 1);
+	cellSets[cell] = (uint32_t)sets.size() - 1;
+}
+
+int PotentiallyVisibleSet::FindCell(const DirectX::XMFLOAT3& point)
+{
+	if (cellSets.empty())
+	{
+		return PVS_NO_CELL;
+	}
+
+	float local[3] = { (point.x - origin.x) / cellSize, (point.y - origin.y) / cellSize, (point.z - origin.z) / cellSize };
+	int cell[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		//Compared as floats first, far away points would overflow the int
+		if (!(local[axis] >= 0.0f && local[axis] < (float)dimensions[axis]))
+		{
+			return PVS_NO_CELL;
+		}
+		cell[axis] = (int)local[axis];
+		cell[axis] = cell[axis] < dimensions[axis] ? cell[axis] : dimensions[axis] - 1;
+	}
+	return (cell[2] * dimensions[1] + cell[1]) * dimensions[0] + cell[0];
+}
+
+AABB PotentiallyVisibleSet::GetCellBounds(int cell)
+{
+	float half = cellSize * 0.5f;
+	int x = cell % dimensions[0];
+	int y = (cell / dimensions[0]) % dimensions[1];
+	int z = cell / (dimensions[0] * dimensions[1]);
+	return { DirectX::XMFLOAT3(origin.x + (x * 2 + 1) * half, origin.y + (y * 2 + 1) * half, origin.z + (z * 2 + 1) * half), DirectX::XMFLOAT3(half, half, half) };
+}
+
+/// <summary>
+/// The object's directory entry says whether its word was stored, and the set bits below
+/// it in the entry count how many stored words come first
+/// </summary>
+bool PotentiallyVisibleSet::IsVisible(int cell, uint32_t object)
+{
+	if (cell == PVS_NO_CELL || !IsBaked(object))
+	{
+		return true;
+	}
+
+	uint32_t word = object >> 6;
+	const DirectoryEntry& entry = directory[sets[cellSets[cell]].FirstEntry + word / PVS_WORDS_PER_ENTRY];
+	uint32_t bit = word % PVS_WORDS_PER_ENTRY;
+	if (!((entry.NonZero >> bit) & 1))
+	{
+		return false;
+	}
+	uint64_t below = entry.NonZero & ((1ull << bit) - 1);
+	return (words[entry.FirstWord + std::popcount(below)] >> (object & 63)) & 1;
+}
+
+int PotentiallyVisibleSet::Filter(int cell, const uint32_t* slots, int count)
+{
+	visible.clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (IsVisible(cell, slots[i]))
+		{
+			visible.push_back(slots[i]);
+		}
+	}
+	return (int)visible.size();
+}
+
+size_t PotentiallyVisibleSet::GetMemoryUsed()
+{
+	return cellSets.size() * sizeof(uint32_t) + sets.size() * sizeof(VisibleSet) + directory.size() * sizeof(DirectoryEntry)
+		+ words.size() * sizeof(uint64_t) + baked.size() * sizeof(uint64_t);
+}
+
+/// <summary>
+/// Header, then the cell, set, directory, word and baked arrays one after another
+/// </summary>
+bool PotentiallyVisibleSet::Save(const std::filesystem::path& path)
+{
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	if (!output)
+	{
+		return false;
+	}
+
+	PvsFileHeader header = {};
+	header.Magic = PVS_FILE_MAGIC;
+	header.Version = PVS_FILE_VERSION;
+	header.SourceHash = sourceHash;
+	header.Origin = origin;
+	header.CellSize = cellSize;
+	std::memcpy(header.Dimensions, dimensions, sizeof(dimensions));
+	header.ObjectCount = objectCount;
+	header.SetCount = (uint32_t)sets.size();
+	header.DirectoryCount = (uint32_t)directory.size();
+	header.WordCount = (uint32_t)words.size();
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	WriteArray(output, cellSets);
+	WriteArray(output, sets);
+	WriteArray(output, directory);
+	WriteArray(output, words);
+	WriteArray(output, baked);
+	return (bool)output;
+}
+
+/// <summary>
+/// Reads a saved set back and checks every index in it, so lookups can trust them
+/// </summary>
+/// <returns>False if the file is missing, truncated or inconsistent, the set is left empty then</returns>
+bool PotentiallyVisibleSet::Load(const std::filesystem::path& path)
+{
+	Clear();
+	std::ifstream input(path, std::ios::binary);
+	PvsFileHeader header;
+	if (!input || !input.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.Magic != PVS_FILE_MAGIC || header.Version != PVS_FILE_VERSION || !(header.CellSize > 0.0f))
+	{
+		return false;
+	}
+
+	uint64_t cellCount = 1;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (header.Dimensions[axis] <= 0 || header.Dimensions[axis] > PVS_MAX_CELLS)
+		{
+			return false;
+		}
+		cellCount *= header.Dimensions[axis];
+	}
+
+	origin = header.Origin;
+	cellSize = header.CellSize;
+	std::memcpy(dimensions, header.Dimensions, sizeof(dimensions));
+	objectCount = header.ObjectCount;
+	sourceHash = header.SourceHash;
+	uint32_t entryCount = (uint32_t)GetEntryCount();
+	bool valid = cellCount <= PVS_MAX_CELLS
+		&& (uint64_t)header.SetCount * entryCount == header.DirectoryCount
+		&& ReadArray(input, cellSets, (size_t)cellCount)
+		&& ReadArray(input, sets, header.SetCount)
+		&& ReadArray(input, directory, header.DirectoryCount)
+		&& ReadArray(input, words, header.WordCount)
+		&& ReadArray(input, baked, (objectCount + 63) / 64);
+
+	for (size_t i = 0; valid && i < cellSets.size(); i++)
+	{
+		valid = cellSets[i] < sets.size();
+	}
+	for (size_t i = 0; valid && i < sets.size(); i++)
+	{
+		valid = (uint64_t)sets[i].FirstEntry + entryCount <= directory.size();
+	}
+	for (size_t i = 0; valid && i < directory.size(); i++)
+	{
+		valid = (uint64_t)directory[i].FirstWord + std::popcount(directory[i].NonZero) <= words.size();
+	}
+
+	if (!valid)
+	{
+		Clear();
+	}
+	return valid;
+}
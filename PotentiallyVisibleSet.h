@@ -0,0 +1,106 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "Bounds.h"
+
+#define PVS_FILE_MAGIC 0x31535650u //"PVS1"
+#define PVS_FILE_VERSION 1
+#define PVS_NO_CELL -1
+#define PVS_MAX_CELLS (1 << 18)
+#define PVS_WORDS_PER_ENTRY 64 //Bitset words one directory entry covers, so 4096 objects
+
+// --------------------------------------------------------
+// Baked per cell visibility, looked up in constant time
+//
+// The baked volume is a grid of equal cubes. Each cell
+// points at one visible set, a bitset over object indices,
+// and cells that see exactly the same objects share one.
+// Sets are stored sparse: only the non-zero 64 bit words
+// are kept, and a directory entry per 4096 objects says
+// which of its words are there. Finding an object's word
+// is one popcount, so a lookup never scans anything.
+//
+// Objects that weren't part of the bake aren't answered
+// for and always count as visible, and so does everything
+// when the point is outside the grid.
+//
+// PvsBaker fills one in. It can be saved next to the scene
+// and loaded back, the source hash says what it was baked
+// from so a stale one can be told apart.
+// --------------------------------------------------------
+class PotentiallyVisibleSet
+{
+public:
+	PotentiallyVisibleSet();
+
+	void Clear();
+	bool IsEmpty() { return cellSets.empty(); }
+
+	//Building, cells in any order. Every cell has to be set before the result is used.
+	void Begin(const DirectX::XMFLOAT3& origin, float cellSize, const int dimensions[3], uint32_t objectCount, uint64_t sourceHash);
+	void SetBaked(uint32_t object);
+	void SetCell(int cell, const uint64_t* bits);
+
+	//For an object that moved since the bake, it's always visible from then on
+	void Forget(uint32_t object) { if (object < objectCount) baked[object >> 6] &= ~(1ull << (object & 63)); }
+
+	int FindCell(const DirectX::XMFLOAT3& point);
+	AABB GetCellBounds(int cell);
+	bool IsBaked(uint32_t object) { return object < objectCount && ((baked[object >> 6] >> (object & 63)) & 1); }
+	bool IsVisible(int cell, uint32_t object);
+
+	//Keeps the slots visible from the cell, in the same order
+	int Filter(int cell, const uint32_t* slots, int count);
+
+	bool Save(const std::filesystem::path& path);
+	bool Load(const std::filesystem::path& path);
+
+	//Getters
+	uint64_t GetSourceHash() { return sourceHash; }
+	float GetCellSize() { return cellSize; }
+	int GetCellCount() { return (int)cellSets.size(); }
+	int GetSetCount() { return (int)sets.size(); }
+	int GetSetSize(int cell) { return cell == PVS_NO_CELL ? -1 : (int)sets[cellSets[cell]].VisibleCount; } //Objects visible from the cell
+	size_t GetMemoryUsed();
+	const uint32_t* GetVisible() { return visible.data(); }
+	int GetVisibleCount() { return (int)visible.size(); }
+
+private:
+	struct VisibleSet
+	{
+		uint32_t FirstEntry;
+		uint32_t VisibleCount;
+	};
+
+	struct DirectoryEntry
+	{
+		uint64_t NonZero; //Bit i set when word i of the entry's run is stored
+		uint32_t FirstWord;
+		uint32_t Padding;
+	};
+
+	DirectX::XMFLOAT3 origin;
+	float cellSize;
+	int dimensions[3];
+	uint32_t objectCount;
+	uint64_t sourceHash;
+
+	std::vector<uint32_t> cellSets;
+	std::vector<VisibleSet> sets;
+	std::vector<DirectoryEntry> directory;
+	std::vector<uint64_t> words;
+	std::vector<uint64_t> baked;
+	std::vector<uint32_t> visible;
+
+	//Only while building, set hash -> sets with it
+	std::unordered_map<uint64_t, std::vector<uint32_t>> setLookup;
+	std::vector<DirectoryEntry> scratchDirectory;
+	std::vector<uint64_t> scratchWords;
+
+	int GetEntryCount() { return (int)((objectCount + 64 * PVS_WORDS_PER_ENTRY - 1) / (64 * PVS_WORDS_PER_ENTRY)); }
+};
@@ -0,0 +1,444 @@
+#include "PvsBaker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	const float rayEpsilon = 1e-4f; //Along the segment, so hits right at either end don't count
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	//Per cell, so the points a cell gets don't depend on which worker baked it
+	struct BakeRandom
+	{
+		uint32_t state;
+
+		float Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (float)(state >> 8) / (float)(1 << 24);
+		}
+	};
+
+	//FNV-1a over raw bytes
+	void HashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+}
+
+void PvsBaker::Clear()
+{
+	objects.clear();
+	triangles.clear();
+	bvhTriangles.clear();
+	nodes.clear();
+}
+
+void PvsBaker::AddObject(uint32_t object, const AABB& bounds)
+{
+	objects.push_back({ object, bounds });
+}
+
+void PvsBaker::AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, int indexCount, const DirectX::XMFLOAT4X4& world, uint32_t owner)
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&world);
+	for (int i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMFLOAT3 corners[3];
+		for (int k = 0; k < 3; k++)
+		{
+			XMStoreFloat3(&corners[k], XMVector3TransformCoord(XMLoadFloat3(&positions[indices[i + k]]), matrix));
+		}
+		triangles.push_back({ corners[0], Subtract(corners[1], corners[0]), Subtract(corners[2], corners[0]), owner });
+	}
+}
+
+uint64_t PvsBaker::GetSourceHash(const PvsBakeSettings& settings)
+{
+	uint64_t hash = 14695981039346656037ull;
+	HashBytes(hash, &settings.CellSize, sizeof(settings.CellSize));
+	HashBytes(hash, &settings.SamplesPerCell, sizeof(settings.SamplesPerCell));
+	HashBytes(hash, &settings.Seed, sizeof(settings.Seed));
+	HashBytes(hash, objects.data(), objects.size() * sizeof(Object));
+	HashBytes(hash, triangles.data(), triangles.size() * sizeof(Triangle));
+	return hash;
+}
+
+/// <summary>
+/// Sizes the grid to the objects' bounds, then bakes it a batch of cells at a time
+/// </summary>
+/// <returns>False if there's nothing to bake or the grid would be too big, error says which</returns>
+bool PvsBaker::Bake(const PvsBakeSettings& settings, PotentiallyVisibleSet& output, JobSystem* jobSystem, std::string& error)
+{
+	auto start = std::chrono::steady_clock::now();
+	stats = {};
+	stats.CellSize = settings.CellSize;
+
+	if (objects.empty())
+	{
+		error = "no static objects to bake";
+		return false;
+	}
+	if (!(settings.CellSize > 0.0f) || settings.SamplesPerCell < 1)
+	{
+		error = "cell size and samples per cell have to be positive";
+		return false;
+	}
+
+	XMFLOAT3 min = objects[0].Bounds.Center;
+	XMFLOAT3 max = min;
+	uint32_t objectCount = 0;
+	for (const Object& object : objects)
+	{
+		const AABB& box = object.Bounds;
+		min = XMFLOAT3(std::min(min.x, box.Center.x - box.Extents.x), std::min(min.y, box.Center.y - box.Extents.y), std::min(min.z, box.Center.z - box.Extents.z));
+		max = XMFLOAT3(std::max(max.x, box.Center.x + box.Extents.x), std::max(max.y, box.Center.y + box.Extents.y), std::max(max.z, box.Center.z + box.Extents.z));
+		objectCount = std::max(objectCount, object.Index + 1);
+	}
+
+	int dimensions[3];
+	float size[3] = { max.x - min.x, max.y - min.y, max.z - min.z };
+	double cellCount = 1;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		dimensions[axis] = std::max((int)std::ceil(size[axis] / settings.CellSize), 1);
+		cellCount *= dimensions[axis];
+	}
+	if (cellCount > PVS_MAX_CELLS)
+	{
+		error = "cell size " + std::to_string(settings.CellSize) + " needs " + std::to_string((uint64_t)cellCount) + " cells, more than " + std::to_string(PVS_MAX_CELLS);
+		return false;
+	}
+
+	BuildBvh();
+	output.Begin(min, settings.CellSize, dimensions, objectCount, GetSourceHash(settings));
+	for (const Object& object : objects)
+	{
+		output.SetBaked(object.Index);
+	}
+
+	int cells = (int)cellCount;
+	size_t wordCount = (objectCount + 63) / 64;
+	std::vector<uint64_t> bits(PVS_BAKE_BATCH * wordCount);
+	uint64_t batchRays[PVS_BAKE_BATCH];
+	for (int first = 0; first < cells; first += PVS_BAKE_BATCH)
+	{
+		int count = std::min(cells - first, PVS_BAKE_BATCH);
+		std::fill(bits.begin(), bits.end(), 0ull);
+		auto bakeRange = [&](int rangeStart, int rangeEnd)
+		{
+			for (int i = rangeStart; i < rangeEnd; i++)
+			{
+				batchRays[i] = BakeCell(first + i, settings, min, dimensions, bits.data() + i * wordCount);
+			}
+		};
+
+		if (jobSystem)
+		{
+			JobCounter counter;
+			jobSystem->ParallelFor(count, bakeRange, &counter);
+			jobSystem->Wait(&counter);
+		}
+		else
+		{
+			bakeRange(0, count);
+		}
+
+		//In cell order, so sets are numbered the same however the cells were spread
+		for (int i = 0; i < count; i++)
+		{
+			output.SetCell(first + i, bits.data() + i * wordCount);
+			stats.Rays += batchRays[i];
+		}
+	}
+
+	uint64_t visibleTotal = 0;
+	for (int cell = 0; cell < cells; cell++)
+	{
+		visibleTotal += output.GetSetSize(cell);
+	}
+
+	stats.Cells = cells;
+	stats.Objects = (int)objects.size();
+	stats.Triangles = (int)triangles.size();
+	stats.Bytes = output.GetMemoryUsed();
+	stats.UniqueSets = output.GetSetCount();
+	stats.AverageVisible = (float)visibleTotal / cells;
+	stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+/// <summary>
+/// Scatters the cell's sample points and aims rays from them at every object until one gets through.
+/// Objects are done one at a time, so most of them stop after their first unblocked ray.
+/// </summary>
+/// <returns>How many rays were cast</returns>
+uint64_t PvsBaker::BakeCell(int cell, const PvsBakeSettings& settings, const DirectX::XMFLOAT3& origin, const int dimensions[3], uint64_t* bits)
+{
+	int x = cell % dimensions[0];
+	int y = (cell / dimensions[0]) % dimensions[1];
+	int z = cell / (dimensions[0] * dimensions[1]);
+	float half = settings.CellSize * 0.5f;
+	AABB cellBounds = { XMFLOAT3(origin.x + (x * 2 + 1) * half, origin.y + (y * 2 + 1) * half, origin.z + (z * 2 + 1) * half), XMFLOAT3(half, half, half) };
+
+	std::vector<XMFLOAT3> samples;
+	std::vector<int> blockers(settings.SamplesPerCell, -1);
+	GetSamplePoints(cell, cellBounds, settings, samples);
+
+	uint64_t rays = 0;
+	for (const Object& object : objects)
+	{
+		bool visible = AABBIntersectsAABB(cellBounds, object.Bounds);
+		const XMFLOAT3& center = object.Bounds.Center;
+		XMFLOAT3 reach(object.Bounds.Extents.x * 0.9f, object.Bounds.Extents.y * 0.9f, object.Bounds.Extents.z * 0.9f);
+		for (int target = 0; target < PVS_TARGET_POINTS && !visible; target++)
+		{
+			XMFLOAT3 point = center;
+			if (target > 0)
+			{
+				int corner = target - 1;
+				point = XMFLOAT3(center.x + ((corner & 1) ? reach.x : -reach.x), center.y + ((corner & 2) ? reach.y : -reach.y), center.z + ((corner & 4) ? reach.z : -reach.z));
+			}
+
+			for (int sample = 0; sample < settings.SamplesPerCell; sample++)
+			{
+				rays++;
+				if (!IsBlocked(samples[sample], point, object.Index, blockers[sample]))
+				{
+					visible = true;
+					break;
+				}
+			}
+		}
+
+		if (visible)
+		{
+			bits[object.Index >> 6] |= 1ull << (object.Index & 63);
+		}
+	}
+	return rays;
+}
+
+/// <summary>
+/// Jitters the samples over a grid of strata spread evenly through the cell, so they don't bunch up.
+/// The jitter is seeded per cell, so the points don't depend on which worker bakes it.
+/// </summary>
+void PvsBaker::GetSamplePoints(int cell, const AABB& cellBounds, const PvsBakeSettings& settings, std::vector<DirectX::XMFLOAT3>& samples)
+{
+	BakeRandom random{ (settings.Seed ? settings.Seed : 1u) ^ ((uint32_t)cell * 0x9E3779B9u) };
+	random.state = random.state ? random.state : 1u;
+	samples.resize(settings.SamplesPerCell);
+
+	int divisions = 1;
+	while (divisions * divisions * divisions < settings.SamplesPerCell)
+	{
+		divisions++;
+	}
+	int strata = divisions * divisions * divisions;
+	float stratumSize = settings.CellSize / divisions;
+	XMFLOAT3 corner(cellBounds.Center.x - cellBounds.Extents.x, cellBounds.Center.y - cellBounds.Extents.y, cellBounds.Center.z - cellBounds.Extents.z);
+	for (int i = 0; i < settings.SamplesPerCell; i++)
+	{
+		int stratum = (int)((int64_t)i * strata / settings.SamplesPerCell);
+		samples[i] = XMFLOAT3(
+			corner.x + (stratum % divisions + random.Next()) * stratumSize,
+			corner.y + (stratum / divisions % divisions + random.Next()) * stratumSize,
+			corner.z + (stratum / (divisions * divisions) + random.Next()) * stratumSize);
+	}
+}
+
+void PvsBaker::BuildBvh()
+{
+	nodes.clear();
+	bvhTriangles.clear();
+	if (triangles.empty())
+	{
+		return;
+	}
+
+	std::vector<XMFLOAT3> centroids(triangles.size());
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		const Triangle& triangle = triangles[i];
+		centroids[i] = XMFLOAT3(
+			triangle.Vertex.x + (triangle.Edge1.x + triangle.Edge2.x) / 3.0f,
+			triangle.Vertex.y + (triangle.Edge1.y + triangle.Edge2.y) / 3.0f,
+			triangle.Vertex.z + (triangle.Edge1.z + triangle.Edge2.z) / 3.0f);
+	}
+
+	std::vector<int> order(triangles.size());
+	std::iota(order.begin(), order.end(), 0);
+	nodes.push_back({});
+	BuildNode(0, 0, (int)triangles.size(), order, centroids);
+
+	//Leaves refer to runs of order. The added order stays as it was, the source hash is over that.
+	bvhTriangles.resize(triangles.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		bvhTriangles[i] = triangles[order[i]];
+	}
+}
+
+/// <summary>
+/// Splits at the median centroid along the longest axis of the centroids' bounds
+/// </summary>
+void PvsBaker::BuildNode(int node, int first, int count, std::vector<int>& order, const std::vector<DirectX::XMFLOAT3>& centroids)
+{
+	XMFLOAT3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT3 centroidMin = min;
+	XMFLOAT3 centroidMax = max;
+	for (int i = first; i < first + count; i++)
+	{
+		const Triangle& triangle = triangles[order[i]];
+		XMFLOAT3 corners[3] =
+		{
+			triangle.Vertex,
+			XMFLOAT3(triangle.Vertex.x + triangle.Edge1.x, triangle.Vertex.y + triangle.Edge1.y, triangle.Vertex.z + triangle.Edge1.z),
+			XMFLOAT3(triangle.Vertex.x + triangle.Edge2.x, triangle.Vertex.y + triangle.Edge2.y, triangle.Vertex.z + triangle.Edge2.z),
+		};
+		for (const XMFLOAT3& corner : corners)
+		{
+			min = XMFLOAT3(std::min(min.x, corner.x), std::min(min.y, corner.y), std::min(min.z, corner.z));
+			max = XMFLOAT3(std::max(max.x, corner.x), std::max(max.y, corner.y), std::max(max.z, corner.z));
+		}
+		const XMFLOAT3& centroid = centroids[order[i]];
+		centroidMin = XMFLOAT3(std::min(centroidMin.x, centroid.x), std::min(centroidMin.y, centroid.y), std::min(centroidMin.z, centroid.z));
+		centroidMax = XMFLOAT3(std::max(centroidMax.x, centroid.x), std::max(centroidMax.y, centroid.y), std::max(centroidMax.z, centroid.z));
+	}
+	nodes[node].Min = min;
+	nodes[node].Max = max;
+
+	float spread[3] = { centroidMax.x - centroidMin.x, centroidMax.y - centroidMin.y, centroidMax.z - centroidMin.z };
+	int axis = spread[0] > spread[1] ? (spread[0] > spread[2] ? 0 : 2) : (spread[1] > spread[2] ? 1 : 2);
+	if (count <= PVS_BVH_LEAF_SIZE || spread[axis] <= 0.0f)
+	{
+		nodes[node].First = first;
+		nodes[node].Count = count;
+		return;
+	}
+
+	int middle = first + count / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+		[&centroids, axis](int a, int b) { return (&centroids[a].x)[axis] < (&centroids[b].x)[axis]; });
+
+	int children = (int)nodes.size();
+	nodes.push_back({});
+	nodes.push_back({});
+	nodes[node].First = children;
+	nodes[node].Count = 0;
+	BuildNode(children, first, middle - first, order, centroids);
+	BuildNode(children + 1, middle, first + count - middle, order, centroids);
+}
+
+/// <summary>
+/// Whether any occluder triangle not belonging to the target crosses the segment. Stops at the
+/// first one found, the closest doesn't matter. Only reads the BVH, so any number of threads can call it.
+/// </summary>
+/// <param name="blocker">The triangle that blocked the last ray from the same point, tried before the BVH and updated on a hit</param>
+bool PvsBaker::IsBlocked(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to, uint32_t target, int& blocker)
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	XMFLOAT3 direction = Subtract(to, from);
+
+	//Rays from one point are mostly stopped by the same wall
+	if (blocker >= 0 && bvhTriangles[blocker].Owner != target && HitsTriangle(from, direction, bvhTriangles[blocker]))
+	{
+		return true;
+	}
+
+	XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	int stack[64];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0)
+	{
+		const BvhNode& node = nodes[stack[--depth]];
+
+		//Slab test over the segment, t from 0 to 1
+		float tMin = 0.0f;
+		float tMax = 1.0f;
+		const float* o = &from.x;
+		const float* inv = &inverse.x;
+		const float* lo = &node.Min.x;
+		const float* hi = &node.Max.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t1 = (lo[axis] - o[axis]) * inv[axis];
+			float t2 = (hi[axis] - o[axis]) * inv[axis];
+			tMin = fmaxf(tMin, fminf(t1, t2));
+			tMax = fminf(tMax, fmaxf(t1, t2));
+		}
+		if (tMin > tMax)
+		{
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			stack[depth++] = node.First;
+			stack[depth++] = node.First + 1;
+			continue;
+		}
+
+		for (int i = node.First; i < node.First + node.Count; i++)
+		{
+			if (bvhTriangles[i].Owner != target && HitsTriangle(from, direction, bvhTriangles[i]))
+			{
+				blocker = i;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// Moller-Trumbore over the segment from + t * direction, t in 0 to 1. Both sides count.
+/// </summary>
+bool PvsBaker::HitsTriangle(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& direction, const Triangle& triangle)
+{
+	XMFLOAT3 p = Cross(direction, triangle.Edge2);
+	float determinant = Dot(triangle.Edge1, p);
+	if (fabsf(determinant) < 1e-12f)
+	{
+		return false;
+	}
+	float inverseDeterminant = 1.0f / determinant;
+	XMFLOAT3 s = Subtract(from, triangle.Vertex);
+	float u = Dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+	XMFLOAT3 q = Cross(s, triangle.Edge1);
+	float v = Dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+	float t = Dot(triangle.Edge2, q) * inverseDeterminant;
+	return t > rayEpsilon && t < 1.0f - rayEpsilon;
+}
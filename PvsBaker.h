@@ -0,0 +1,114 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+#include "PotentiallyVisibleSet.h"
+
+#define PVS_BAKE_BATCH 64 //Cells baked in parallel before their bitsets are packed
+#define PVS_BVH_LEAF_SIZE 4 //Triangles per BVH leaf
+#define PVS_TARGET_POINTS 9 //Points aimed at on every object, its centre and eight corners pulled in a little
+
+struct PvsBakeSettings
+{
+	float CellSize = 8.0f;
+	int SamplesPerCell = 27; //Ray origins, one jittered through each of a 3x3x3 grid of strata
+	uint32_t Seed = 1;
+};
+
+//What a bake did, one line of the bake time against cell size report
+struct PvsBakeStats
+{
+	float CellSize;
+	int Cells;
+	int Objects;
+	int Triangles; //Occluder triangles in the BVH
+	uint64_t Rays;
+	double Seconds;
+	size_t Bytes; //Memory the result takes, the same as its file bar the header
+	int UniqueSets;
+	float AverageVisible; //Objects per cell
+};
+
+// --------------------------------------------------------
+// Offline potentially visible set baking for static scenes
+//
+// The space around the objects is cut into a grid of cubes.
+// From jittered sample points in every cell a ray is
+// aimed at points on each object, and the first one to get
+// there unblocked makes the object visible from the cell.
+// Rays are only blocked by occluder triangles, kept in a
+// BVH built once per bake. An object never blocks rays
+// aimed at itself, so walls can be both.
+//
+// Sampling can miss something seen through a gap between
+// sample points, so more samples give a safer set. Objects
+// overlapping a cell are always visible from it.
+//
+// Cells are baked in parallel batches, then packed into
+// the PotentiallyVisibleSet in cell order, so the result
+// doesn't depend on the number of workers.
+// --------------------------------------------------------
+class PvsBaker
+{
+public:
+	void Clear();
+
+	//Static objects, keyed by the index they'll be looked up by
+	void AddObject(uint32_t object, const AABB& bounds);
+
+	//Triangles that block rays, in world space. owner is the object they belong to, if any.
+	void AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, int indexCount, const DirectX::XMFLOAT4X4& world, uint32_t owner);
+
+	//Changes with anything that would change the bake
+	uint64_t GetSourceHash(const PvsBakeSettings& settings);
+
+	bool Bake(const PvsBakeSettings& settings, PotentiallyVisibleSet& output, JobSystem* jobSystem, std::string& error);
+
+	//Where a cell's rays start from, the same for the same cell and settings every bake
+	static void GetSamplePoints(int cell, const AABB& cellBounds, const PvsBakeSettings& settings, std::vector<DirectX::XMFLOAT3>& samples);
+
+	//Getters
+	const PvsBakeStats& GetStats() { return stats; }
+
+private:
+	struct Object
+	{
+		uint32_t Index;
+		AABB Bounds;
+	};
+
+	//Edges ready for the ray test
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 Vertex;
+		DirectX::XMFLOAT3 Edge1;
+		DirectX::XMFLOAT3 Edge2;
+		uint32_t Owner;
+	};
+
+	//Children of an internal node sit next to each other at First, a leaf's triangles start at First
+	struct BvhNode
+	{
+		DirectX::XMFLOAT3 Min;
+		int First;
+		DirectX::XMFLOAT3 Max;
+		int Count; //0 for internal nodes
+	};
+
+	std::vector<Object> objects;
+	std::vector<Triangle> triangles;
+	std::vector<Triangle> bvhTriangles; //The same, in BVH leaf order
+	std::vector<BvhNode> nodes;
+	PvsBakeStats stats = {};
+
+	void BuildBvh();
+	void BuildNode(int node, int first, int count, std::vector<int>& order, const std::vector<DirectX::XMFLOAT3>& centroids);
+	bool IsBlocked(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to, uint32_t target, int& blocker);
+	static bool HitsTriangle(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& direction, const Triangle& triangle);
+	uint64_t BakeCell(int cell, const PvsBakeSettings& settings, const DirectX::XMFLOAT3& origin, const int dimensions[3], uint64_t* bits);
+};
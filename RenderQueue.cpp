@@ -0,0 +1,232 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+namespace
+{
+	const int passShift = 64 - RENDER_KEY_PASS_BITS;
+	const int translucentShift = passShift - 1;
+
+	//Opaque fields, state first
+	const int opaqueMeshShift = RENDER_KEY_DEPTH_BITS;
+	const int opaqueMaterialShift = opaqueMeshShift + RENDER_KEY_MESH_BITS;
+	const int opaqueShaderShift = opaqueMaterialShift + RENDER_KEY_MATERIAL_BITS;
+
+	//Translucent fields, depth first
+	const int translucentMaterialShift = RENDER_KEY_MESH_BITS;
+	const int translucentShaderShift = translucentMaterialShift + RENDER_KEY_MATERIAL_BITS;
+	const int translucentDepthShift = translucentShaderShift + RENDER_KEY_SHADER_BITS;
+
+	static_assert(opaqueShaderShift + RENDER_KEY_SHADER_BITS == translucentShift, "Opaque key fields have to fill the key");
+	static_assert(translucentDepthShift + RENDER_KEY_DEPTH_BITS == translucentShift, "Translucent key fields have to fill the key");
+
+	inline uint64_t Field(uint64_t key, int shift, int bits)
+	{
+		return (key >> shift) & ((1ull << bits) - 1);
+	}
+}
+
+RenderQueue::RenderQueue() : stats{}
+{
+}
+
+void RenderQueue::Clear()
+{
+	keys.clear();
+	values.clear();
+}
+
+void RenderQueue::Resize(int count)
+{
+	keys.resize(count);
+	values.resize(count);
+}
+
+void RenderQueue::Add(uint64_t key, uint32_t value)
+{
+	keys.push_back(key);
+	values.push_back(value);
+}
+
+/// <summary>
+/// Packs a draw's key, see the layout at the top of RenderQueue.h
+/// </summary>
+/// <param name="depth">Distance from the camera as a fraction of the depth range, clamped to 0 to 1</param>
+uint64_t RenderQueue::MakeKey(uint32_t pass, bool translucent, uint32_t shader, uint32_t material, uint32_t mesh, float depth)
+{
+	uint64_t depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+	uint64_t depthBits = (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * depthMax + 0.5f);
+	uint64_t key = Field(pass, 0, RENDER_KEY_PASS_BITS) << passShift;
+	uint64_t state = Field(shader, 0, RENDER_KEY_SHADER_BITS);
+	state = (state << RENDER_KEY_MATERIAL_BITS) | Field(material, 0, RENDER_KEY_MATERIAL_BITS);
+	state = (state << RENDER_KEY_MESH_BITS) | Field(mesh, 0, RENDER_KEY_MESH_BITS);
+	if (translucent)
+	{
+		return key | (1ull << translucentShift) | ((depthMax - depthBits) << translucentDepthShift) | state;
+	}
+	return key | (state << opaqueMeshShift) | depthBits;
+}
+
+uint32_t RenderQueue::GetShader(uint64_t key)
+{
+	bool translucent = (key >> translucentShift) & 1;
+	return (uint32_t)Field(key, translucent ? translucentShaderShift : opaqueShaderShift, RENDER_KEY_SHADER_BITS);
+}
+
+uint32_t RenderQueue::GetMaterial(uint64_t key)
+{
+	bool translucent = (key >> translucentShift) & 1;
+	return (uint32_t)Field(key, translucent ? translucentMaterialShift : opaqueMaterialShift, RENDER_KEY_MATERIAL_BITS);
+}
+
+uint32_t RenderQueue::GetMesh(uint64_t key)
+{
+	bool translucent = (key >> translucentShift) & 1;
+	return (uint32_t)Field(key, translucent ? 0 : opaqueMeshShift, RENDER_KEY_MESH_BITS);
+}
+
+/// <summary>
+/// Sorts the keys ascending, values along with them. One counting pass finds the digits worth
+/// sorting on, then each of those gets a count, an offset and a scatter, the count and scatter
+/// split across the chunks.
+/// </summary>
+void RenderQueue::Sort(JobSystem* jobSystem)
+{
+	int count = (int)keys.size();
+	stats = {};
+	stats.Items = count;
+	stats.StateChangesBefore = CountStateChanges(keys.data(), count);
+	if (count < 2)
+	{
+		stats.StateChangesAfter = stats.StateChangesBefore;
+		return;
+	}
+
+	int chunkCount = jobSystem ? std::clamp(count / RENDER_SORT_CHUNK_MIN, 1, RENDER_SORT_MAX_CHUNKS) : 1;
+	int chunkSize = (count + chunkCount - 1) / chunkCount;
+	auto forEachChunk = [jobSystem, chunkCount](auto function)
+	{
+		if (chunkCount == 1)
+		{
+			function(0);
+			return;
+		}
+
+		JobCounter counter;
+		jobSystem->ParallelFor(chunkCount, [&function](int start, int end)
+			{
+				for (int chunk = start; chunk < end; chunk++)
+				{
+					function(chunk);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+	};
+
+	scratchKeys.resize(count);
+	scratchValues.resize(count);
+	histograms.assign((size_t)chunkCount * RENDER_SORT_PASSES * RENDER_SORT_BUCKETS, 0);
+	uint32_t* counts = histograms.data();
+	auto chunkHistogram = [counts](int chunk, int pass) { return counts + ((size_t)chunk * RENDER_SORT_PASSES + pass) * RENDER_SORT_BUCKETS; };
+
+	//Every digit at once, on the keys as they came in
+	const uint64_t* sourceKeys = keys.data();
+	forEachChunk([&](int chunk)
+		{
+			int end = std::min(count, (chunk + 1) * chunkSize);
+			for (int i = chunk * chunkSize; i < end; i++)
+			{
+				uint64_t key = sourceKeys[i];
+				for (int pass = 0; pass < RENDER_SORT_PASSES; pass++)
+				{
+					chunkHistogram(chunk, pass)[(key >> (pass * RENDER_SORT_DIGIT_BITS)) & (RENDER_SORT_BUCKETS - 1)]++;
+				}
+			}
+		});
+
+	uint64_t* fromKeys = keys.data();
+	uint32_t* fromValues = values.data();
+	uint64_t* toKeys = scratchKeys.data();
+	uint32_t* toValues = scratchValues.data();
+	bool countsCurrent = true;
+	for (int pass = 0; pass < RENDER_SORT_PASSES; pass++)
+	{
+		int shift = pass * RENDER_SORT_DIGIT_BITS;
+
+		//The first counts are still right for the digit every key shares, the keys haven't moved yet
+		int firstDigit = (int)((keys[0] >> shift) & (RENDER_SORT_BUCKETS - 1));
+		uint32_t sharing = 0;
+		for (int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			sharing += chunkHistogram(chunk, pass)[firstDigit];
+		}
+		if (sharing == (uint32_t)count)
+		{
+			continue;
+		}
+
+		if (!countsCurrent)
+		{
+			forEachChunk([&](int chunk)
+				{
+					uint32_t* histogram = chunkHistogram(chunk, pass);
+					std::fill(histogram, histogram + RENDER_SORT_BUCKETS, 0u);
+					int end = std::min(count, (chunk + 1) * chunkSize);
+					for (int i = chunk * chunkSize; i < end; i++)
+					{
+						histogram[(fromKeys[i] >> shift) & (RENDER_SORT_BUCKETS - 1)]++;
+					}
+				});
+		}
+
+		//Bucket by bucket, and chunk by chunk within a bucket, so equal digits keep their order
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < RENDER_SORT_BUCKETS; bucket++)
+		{
+			for (int chunk = 0; chunk < chunkCount; chunk++)
+			{
+				uint32_t& slot = chunkHistogram(chunk, pass)[bucket];
+				uint32_t bucketCount = slot;
+				slot = offset;
+				offset += bucketCount;
+			}
+		}
+
+		forEachChunk([&](int chunk)
+			{
+				uint32_t* offsets = chunkHistogram(chunk, pass);
+				int end = std::min(count, (chunk + 1) * chunkSize);
+				for (int i = chunk * chunkSize; i < end; i++)
+				{
+					uint32_t target = offsets[(fromKeys[i] >> shift) & (RENDER_SORT_BUCKETS - 1)]++;
+					toKeys[target] = fromKeys[i];
+					toValues[target] = fromValues[i];
+				}
+			});
+
+		std::swap(fromKeys, toKeys);
+		std::swap(fromValues, toValues);
+		countsCurrent = false;
+		stats.Passes++;
+	}
+
+	if (fromKeys != keys.data())
+	{
+		keys.swap(scratchKeys);
+		values.swap(scratchValues);
+	}
+	stats.StateChangesAfter = CountStateChanges(keys.data(), count);
+}
+
+/// <summary>
+/// Switches of shader, material or mesh from one draw to the next, each counted on its own
+/// </summary>
+int RenderQueue::CountStateChanges(const uint64_t* keys, int count)
+{
+	int changes = 0;
+	for (int i = 1; i < count; i++)
+	{
+		changes += (GetShader(keys[i]) != GetShader(keys[i - 1])) + (GetMaterial(keys[i]) != GetMaterial(keys[i - 1])) + (GetMesh(keys[i]) != GetMesh(keys[i - 1]));
+	}
+	return changes;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+//Key layout, from the top bit down. Opaque draws group by state and go front to back within it,
+//translucent ones go back to front first and only group by state at equal depth.
+//  pass 4 | translucent 1 | shader 12 | material 16 | mesh 16 | depth 15
+//  pass 4 | translucent 1 | far to near 15 | shader 12 | material 16 | mesh 16
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_MESH_BITS 16
+#define RENDER_KEY_DEPTH_BITS 15
+
+#define RENDER_SORT_DIGIT_BITS 8
+#define RENDER_SORT_BUCKETS (1 << RENDER_SORT_DIGIT_BITS)
+#define RENDER_SORT_PASSES (64 / RENDER_SORT_DIGIT_BITS)
+#define RENDER_SORT_MAX_CHUNKS 32 //Runs of the queue sorted by separate jobs, each with its own histograms
+#define RENDER_SORT_CHUNK_MIN 16384 //Items a chunk has to have before splitting the work is worth it
+
+//What the last sort did
+struct RenderQueueStats
+{
+	int Items;
+	int Passes; //Radix passes run, digits that were the same in every key are skipped
+	int StateChangesBefore; //Shader, material and mesh switches walking the queue in the order it was filled
+	int StateChangesAfter; //The same walking it sorted
+};
+
+// --------------------------------------------------------
+// Draws to submit, each a 64 bit key and a value
+//
+// The key packs everything the order should depend on, so
+// sorting the keys as plain integers puts draws sharing
+// state next to each other. Values ride along, they're
+// whatever the submitter needs to find the draw again.
+//
+// The sort is a least significant digit radix sort, a
+// byte at a time. Each chunk counts its own digits and
+// scatters into its own ranges, so chunks run as separate
+// jobs and the result is stable whatever the job count.
+// Every digit's histogram is taken in the one counting
+// pass, and a digit every key shares is skipped.
+//
+// IDs wider than their field wrap, which only costs some
+// grouping. Depth is a 0 to 1 fraction of the range.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void Clear();
+
+	//Sizes the queue to count items, so jobs can fill their own with Set
+	void Resize(int count);
+	void Set(int item, uint64_t key, uint32_t value) { keys[item] = key; values[item] = value; }
+	void Add(uint64_t key, uint32_t value);
+
+	void Sort(JobSystem* jobSystem = nullptr);
+
+	static uint64_t MakeKey(uint32_t pass, bool translucent, uint32_t shader, uint32_t material, uint32_t mesh, float depth);
+	static uint32_t GetShader(uint64_t key);
+	static uint32_t GetMaterial(uint64_t key);
+	static uint32_t GetMesh(uint64_t key);
+
+	//Getters
+	int GetCount() { return (int)keys.size(); }
+	const uint64_t* GetKeys() { return keys.data(); }
+	const uint32_t* GetValues() { return values.data(); }
+	const RenderQueueStats& GetStats() { return stats; }
+
+private:
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> values;
+	std::vector<uint64_t> scratchKeys;
+	std::vector<uint32_t> scratchValues;
+	std::vector<uint32_t> histograms; //Per chunk, pass and bucket, then turned into each chunk's write offsets
+	RenderQueueStats stats;
+
+	static int CountStateChanges(const uint64_t* keys, int count);
+};
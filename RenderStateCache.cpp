@@ -0,0 +1,211 @@
+#include "RenderStateCache.h"
+
+#include <cstring>
+
+namespace
+{
+	//Slot bit sets, one or more words of them
+	template<typename T>
+	inline bool HasBit(const T* words, uint32_t slot)
+	{
+		const uint32_t wordBits = sizeof(T) * 8;
+		return (words[slot / wordBits] >> (slot % wordBits)) & 1;
+	}
+
+	template<typename T>
+	inline void SetBit(T* words, uint32_t slot)
+	{
+		const uint32_t wordBits = sizeof(T) * 8;
+		words[slot / wordBits] |= (T)1 << (slot % wordBits);
+	}
+}
+
+RenderStateCache::RenderStateCache() : context(nullptr), enabled(true), stats{}, lastFrameStats{}
+{
+	Invalidate();
+}
+
+void RenderStateCache::SetContext(IRenderContext* context)
+{
+	this->context = context;
+	Invalidate();
+}
+
+void RenderStateCache::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+}
+
+/// <summary>
+/// Keeps the finished frame's counts and starts over, forgetting the bindings
+/// </summary>
+void RenderStateCache::BeginFrame()
+{
+	lastFrameStats = stats;
+	stats = {};
+	Invalidate();
+}
+
+/// <summary>
+/// Forgets every slot, so the next bind to each goes through whatever it is.
+/// The remembered pointers are only compared, never used, so they can stay.
+/// </summary>
+void RenderStateCache::Invalidate()
+{
+	inputLayoutKnown = false;
+	vertexShaderKnown = false;
+	pixelShaderKnown = false;
+	indexBufferKnown = false;
+	rasterizerKnown = false;
+	depthStencilKnown = false;
+	std::memset(constantBuffersKnown, 0, sizeof(constantBuffersKnown));
+	std::memset(samplersKnown, 0, sizeof(samplersKnown));
+	std::memset(shaderResourcesKnown, 0, sizeof(shaderResourcesKnown));
+	vertexBuffersKnown = 0;
+}
+
+void RenderStateCache::SetInputLayout(ID3D11InputLayout* layout)
+{
+	if (Elide(inputLayoutKnown && inputLayout == layout))
+	{
+		return;
+	}
+	inputLayout = layout;
+	inputLayoutKnown = true;
+	context->SetInputLayout(layout);
+}
+
+void RenderStateCache::SetVertexShader(ID3D11VertexShader* shader)
+{
+	if (Elide(vertexShaderKnown && vertexShader == shader))
+	{
+		return;
+	}
+	vertexShader = shader;
+	vertexShaderKnown = true;
+	context->SetVertexShader(shader);
+}
+
+void RenderStateCache::SetPixelShader(ID3D11PixelShader* shader)
+{
+	if (Elide(pixelShaderKnown && pixelShader == shader))
+	{
+		return;
+	}
+	pixelShader = shader;
+	pixelShaderKnown = true;
+	context->SetPixelShader(shader);
+}
+
+void RenderStateCache::SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer)
+{
+	bool tracked = slot < STATE_CACHE_CB_SLOTS;
+	if (Elide(tracked && HasBit(&constantBuffersKnown[stage], slot) && constantBuffers[stage][slot] == buffer))
+	{
+		return;
+	}
+	if (tracked)
+	{
+		constantBuffers[stage][slot] = buffer;
+		SetBit(&constantBuffersKnown[stage], slot);
+	}
+	context->SetConstantBuffer(stage, slot, buffer);
+}
+
+void RenderStateCache::SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv)
+{
+	bool tracked = slot < STATE_CACHE_SRV_SLOTS;
+	if (Elide(tracked && HasBit(shaderResourcesKnown[stage], slot) && shaderResources[stage][slot] == srv))
+	{
+		return;
+	}
+	if (tracked)
+	{
+		shaderResources[stage][slot] = srv;
+		SetBit(shaderResourcesKnown[stage], slot);
+	}
+	context->SetShaderResource(stage, slot, srv);
+}
+
+void RenderStateCache::SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler)
+{
+	bool tracked = slot < STATE_CACHE_SAMPLER_SLOTS;
+	if (Elide(tracked && HasBit(&samplersKnown[stage], slot) && samplers[stage][slot] == sampler))
+	{
+		return;
+	}
+	if (tracked)
+	{
+		samplers[stage][slot] = sampler;
+		SetBit(&samplersKnown[stage], slot);
+	}
+	context->SetSampler(stage, slot, sampler);
+}
+
+void RenderStateCache::SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+	bool tracked = slot < STATE_CACHE_VERTEX_BUFFER_SLOTS;
+	if (Elide(tracked && HasBit(&vertexBuffersKnown, slot) && vertexBuffers[slot].Buffer == buffer &&
+		vertexBuffers[slot].Stride == stride && vertexBuffers[slot].Offset == offset))
+	{
+		return;
+	}
+	if (tracked)
+	{
+		vertexBuffers[slot] = { buffer, stride, offset };
+		SetBit(&vertexBuffersKnown, slot);
+	}
+	context->SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void RenderStateCache::SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset)
+{
+	if (Elide(indexBufferKnown && indexBuffer == buffer && indexFormat == format && indexOffset == offset))
+	{
+		return;
+	}
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	indexBufferKnown = true;
+	context->SetIndexBuffer(buffer, format, offset);
+}
+
+void RenderStateCache::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	if (Elide(rasterizerKnown && rasterizerState == state))
+	{
+		return;
+	}
+	rasterizerState = state;
+	rasterizerKnown = true;
+	context->SetRasterizerState(state);
+}
+
+void RenderStateCache::SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef)
+{
+	if (Elide(depthStencilKnown && depthStencilState == state && this->stencilRef == stencilRef))
+	{
+		return;
+	}
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	depthStencilKnown = true;
+	context->SetDepthStencilState(state, stencilRef);
+}
+
+/// <summary>
+/// Counts the call one way or the other
+/// </summary>
+/// <param name="same">Whether the slot already holds what's being bound</param>
+/// <returns>True when the call should be dropped</returns>
+bool RenderStateCache::Elide(bool same)
+{
+	if (enabled && same)
+	{
+		stats.Elided++;
+		return true;
+	}
+	stats.Issued++;
+	return false;
+}
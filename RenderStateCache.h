@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+
+//Only ever handled by pointer here, so the cache and anything testing it build without d3d11.h
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11Buffer;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RasterizerState;
+struct ID3D11DepthStencilState;
+
+#define RENDER_STAGE_VERTEX 0
+#define RENDER_STAGE_PIXEL 1
+#define RENDER_STAGE_COUNT 2
+
+#define STATE_CACHE_CB_SLOTS 14 //D3D11's constant buffer slots per stage
+#define STATE_CACHE_SRV_SLOTS 128 //D3D11's shader resource slots per stage
+#define STATE_CACHE_SAMPLER_SLOTS 16 //D3D11's sampler slots per stage
+#define STATE_CACHE_VERTEX_BUFFER_SLOTS 16 //Input slots tracked, anything past these is always sent
+
+// --------------------------------------------------------
+// The binding calls the cache forwards, one slot at a time.
+// D3D11RenderContext sends them to a device context, tests
+// can record them instead.
+// --------------------------------------------------------
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() = default;
+
+	virtual void SetInputLayout(ID3D11InputLayout* layout) = 0;
+	virtual void SetVertexShader(ID3D11VertexShader* shader) = 0;
+	virtual void SetPixelShader(ID3D11PixelShader* shader) = 0;
+	virtual void SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer) = 0;
+	virtual void SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv) = 0;
+	virtual void SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler) = 0;
+	virtual void SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset) = 0; //format is a DXGI_FORMAT
+	virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+	virtual void SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef) = 0;
+};
+
+//Binding calls over a frame
+struct RenderStateStats
+{
+	int Issued; //Sent on to the context
+	int Elided; //Dropped, the slot already held that
+};
+
+// --------------------------------------------------------
+// Sits in front of the context and drops binds that would
+// leave a slot as it was
+//
+// Every shader, constant buffer, shader resource, sampler,
+// vertex and index buffer and rasterizer and depth state
+// slot remembers what was last sent to it, and a bind only
+// goes through when it's something else. Draws sorted by
+// state mostly repeat the last one's bindings, so most of
+// their calls stop here.
+//
+// Anything binding behind the cache's back leaves it
+// wrong, so whoever does has to Invalidate it after. The
+// UI renderer binds its own, which is why BeginFrame
+// invalidates too. Disabled, every call goes through but
+// is still counted.
+// --------------------------------------------------------
+class RenderStateCache
+{
+public:
+	RenderStateCache();
+
+	void SetContext(IRenderContext* context);
+	void SetEnabled(bool enabled);
+	void BeginFrame();
+	void Invalidate();
+
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetConstantBuffer(int stage, uint32_t slot, ID3D11Buffer* buffer);
+	void SetShaderResource(int stage, uint32_t slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(int stage, uint32_t slot, ID3D11SamplerState* sampler);
+	void SetVertexBuffer(uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset);
+	void SetRasterizerState(ID3D11RasterizerState* state);
+	void SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef);
+
+	//Getters
+	bool GetEnabled() { return enabled; }
+	const RenderStateStats& GetStats() { return stats; } //The frame so far
+	const RenderStateStats& GetLastFrameStats() { return lastFrameStats; }
+
+private:
+	struct VertexBufferSlot
+	{
+		ID3D11Buffer* Buffer;
+		uint32_t Stride;
+		uint32_t Offset;
+	};
+
+	IRenderContext* context;
+	bool enabled;
+
+	//Whether each slot's value is really what the context holds, cleared by Invalidate
+	bool inputLayoutKnown;
+	bool vertexShaderKnown;
+	bool pixelShaderKnown;
+	bool indexBufferKnown;
+	bool rasterizerKnown;
+	bool depthStencilKnown;
+	uint32_t constantBuffersKnown[RENDER_STAGE_COUNT]; //A bit per slot
+	uint64_t samplersKnown[RENDER_STAGE_COUNT];
+	uint64_t shaderResourcesKnown[RENDER_STAGE_COUNT][STATE_CACHE_SRV_SLOTS / 64];
+	uint32_t vertexBuffersKnown;
+
+	ID3D11InputLayout* inputLayout;
+	ID3D11VertexShader* vertexShader;
+	ID3D11PixelShader* pixelShader;
+	ID3D11Buffer* constantBuffers[RENDER_STAGE_COUNT][STATE_CACHE_CB_SLOTS];
+	ID3D11ShaderResourceView* shaderResources[RENDER_STAGE_COUNT][STATE_CACHE_SRV_SLOTS];
+	ID3D11SamplerState* samplers[RENDER_STAGE_COUNT][STATE_CACHE_SAMPLER_SLOTS];
+	VertexBufferSlot vertexBuffers[STATE_CACHE_VERTEX_BUFFER_SLOTS];
+	ID3D11Buffer* indexBuffer;
+	uint32_t indexFormat;
+	uint32_t indexOffset;
+	ID3D11RasterizerState* rasterizerState;
+	ID3D11DepthStencilState* depthStencilState;
+	uint32_t stencilRef;
+
+	RenderStateStats stats;
+	RenderStateStats lastFrameStats;
+
+	bool Elide(bool same);
+};
@@ -0,0 +1,766 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SCENE FILE ----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+SceneFile::SceneFile() : data(nullptr), size(0), header(nullptr), fileHandle(nullptr), mappingHandle(nullptr)
+{
+}
+
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/// <summary>
+/// Maps the file read only and checks it can be trusted
+/// </summary>
+/// <returns>False if the file is missing, truncated, from another version or has bad references</returns>
+bool SceneFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SceneFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+	mappingHandle = mapping;
+
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	fileHandle = reinterpret_cast<void*>((intptr_t)file + 1);
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(SceneFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	data = view == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(view);
+	size = (size_t)fileStat.st_size;
+#endif
+
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	header = reinterpret_cast<const SceneFileHeader*>(data);
+	if (!Validate())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void SceneFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+#else
+	if (data != nullptr)
+	{
+		munmap(const_cast<unsigned char*>(data), size);
+	}
+	if (fileHandle != nullptr)
+	{
+		close((int)(reinterpret_cast<intptr_t>(fileHandle) - 1));
+	}
+#endif
+
+	data = nullptr;
+	size = 0;
+	header = nullptr;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+/// <summary>
+/// Checks every table fits in the file and every index points somewhere real,
+/// so nothing reading the tables afterwards has to
+/// </summary>
+bool SceneFile::Validate()
+{
+	if (header->Magic != SCENE_FILE_MAGIC || header->Version != SCENE_FILE_VERSION || header->FileSize != size)
+	{
+		return false;
+	}
+
+	auto tableFits = [this](const SceneTable& table, size_t stride)
+	{
+		return table.Stride == stride
+			&& table.Offset % SCENE_TABLE_ALIGNMENT == 0
+			&& table.Offset <= size
+			&& (uint64_t)table.Count * table.Stride <= size - table.Offset;
+	};
+	if (!tableFits(header->Strings, sizeof(char))
+		|| !tableFits(header->Meshes, sizeof(SceneAsset))
+		|| !tableFits(header->Textures, sizeof(SceneAsset))
+		|| !tableFits(header->Shaders, sizeof(SceneShader))
+		|| !tableFits(header->Materials, sizeof(SceneMaterial))
+		|| !tableFits(header->TextureBindings, sizeof(SceneTextureBinding))
+		|| !tableFits(header->Entities, sizeof(SceneEntity))
+		|| !tableFits(header->Lights, sizeof(Light))
+		|| !tableFits(header->Cameras, sizeof(SceneCamera))
+		|| !tableFits(header->Cells, sizeof(SceneCell))
+		|| !tableFits(header->Portals, sizeof(ScenePortal)))
+	{
+		return false;
+	}
+
+	//The last string has to be terminated, then any offset in range reads a whole string
+	uint32_t stringBytes = header->Strings.Count;
+	if (stringBytes > 0 && GetTable<char>(header->Strings)[stringBytes - 1] != '\0')
+	{
+		return false;
+	}
+
+	for (int i = 0; i < GetMeshCount(); i++)
+	{
+		//Pointing backwards only, so following a chain of LODs always ends
+		uint32_t lod = GetMeshes()[i].Lod;
+		if (GetMeshes()[i].Path >= stringBytes || (lod != SCENE_NO_INDEX && lod >= (uint32_t)i))
+		{
+			return false;
+		}
+	}
+	for (int i = 0; i < GetTextureCount(); i++)
+	{
+		if (GetTextures()[i].Path >= stringBytes)
+		{
+			return false;
+		}
+	}
+	for (int i = 0; i < GetShaderCount(); i++)
+	{
+		const SceneShader& shader = GetShaders()[i];
+		if (shader.Path >= stringBytes || (shader.Stage != SCENE_SHADER_VERTEX && shader.Stage != SCENE_SHADER_PIXEL))
+		{
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->TextureBindings.Count; i++)
+	{
+		const SceneTextureBinding& binding = GetTextureBindings()[i];
+		if (binding.Name >= stringBytes || (binding.Texture != SCENE_NO_INDEX && binding.Texture >= header->Textures.Count))
+		{
+			return false;
+		}
+	}
+	for (int i = 0; i < GetMaterialCount(); i++)
+	{
+		const SceneMaterial& material = GetMaterials()[i];
+		if (material.VertexShader >= header->Shaders.Count || GetShaders()[material.VertexShader].Stage != SCENE_SHADER_VERTEX
+			|| material.PixelShader >= header->Shaders.Count || GetShaders()[material.PixelShader].Stage != SCENE_SHADER_PIXEL
+			|| material.FirstBinding > header->TextureBindings.Count
+			|| material.BindingCount > header->TextureBindings.Count - material.FirstBinding)
+		{
+			return false;
+		}
+	}
+
+	const SceneEntity* entities = GetEntities();
+	for (uint32_t i = 0; i < header->Entities.Count; i++)
+	{
+		if (entities[i].Mesh >= header->Meshes.Count
+			|| entities[i].Material >= header->Materials.Count
+			|| (entities[i].Parent != SCENE_NO_INDEX && entities[i].Parent >= i))
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < GetCellCount(); i++)
+	{
+		const SceneCell& cell = GetCells()[i];
+		if (!(cell.Min.x <= cell.Max.x && cell.Min.y <= cell.Max.y && cell.Min.z <= cell.Max.z))
+		{
+			return false;
+		}
+	}
+	for (int i = 0; i < GetPortalCount(); i++)
+	{
+		const ScenePortal& portal = GetPortals()[i];
+		if (portal.Cells[0] >= header->Cells.Count || portal.Cells[1] >= header->Cells.Count || portal.Cells[0] == portal.Cells[1]
+			|| portal.VertexCount < 3 || portal.VertexCount > SCENE_PORTAL_MAX_VERTICES)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Reads a scene written as text, one statement per line:
+///
+///   mesh name path [lod coarserMesh]    texture name path    shader name vertex|pixel file.cso
+///   material name vertexShader pixelShader    then tint, roughness, uvscale, uvoffset, bind slot texture|none
+///   entity name mesh material                 then position, rotation, scale, parent entity, occluder
+///   light directional|point|spot              then color, intensity, direction, position, range, spot inner outer
+///   camera                                    then position, speed move look, fov
+///   cell name minX minY minZ maxX maxY maxZ   portal cellA cellB x y z x y z x y z ...
+///
+/// Property lines apply to the last material, entity, light or camera. # starts a comment,
+/// names and paths can't contain spaces, and an entity nothing parents to can be named -.
+/// A mesh's coarser LOD has to be declared before it, and a portal's cells before the portal.
+/// </summary>
+bool SceneFile::ConvertText(const std::filesystem::path& textPath, const std::filesystem::path& binaryPath, std::string& error)
+{
+	std::ifstream input(textPath);
+	if (!input)
+	{
+		error = "Couldn't open " + textPath.string();
+		return false;
+	}
+
+	enum class Block { None, Material, Entity, Light, Camera };
+
+	SceneBuilder builder;
+	std::unordered_map<std::string, uint32_t> meshNames;
+	std::unordered_map<std::string, uint32_t> textureNames;
+	std::unordered_map<std::string, uint32_t> shaderNames;
+	std::unordered_map<std::string, uint32_t> materialNames;
+	std::unordered_map<std::string, uint32_t> entityNames;
+	std::unordered_map<std::string, uint32_t> cellNames;
+
+	Block block = Block::None;
+	SceneMaterial material = {};
+	SceneEntity entity = {};
+	Light light = {};
+	SceneCamera camera = {};
+	std::vector<std::pair<std::string, uint32_t>> bindings;
+	std::string entityName;
+
+	//Blocks are only added once they're complete, when the next one starts
+	auto finishBlock = [&]()
+	{
+		switch (block)
+		{
+		case Block::Material:
+		{
+			uint32_t index = builder.AddMaterial(material);
+			for (auto& binding : bindings)
+			{
+				builder.AddTextureBinding(index, binding.first, binding.second);
+			}
+			bindings.clear();
+			break;
+		}
+		case Block::Entity:
+		{
+			uint32_t index = builder.AddEntity(entity);
+			if (entityName != "-")
+			{
+				entityNames[entityName] = index;
+			}
+			break;
+		}
+		case Block::Light:
+			builder.AddLight(light);
+			break;
+		case Block::Camera:
+			builder.AddCamera(camera);
+			break;
+		default:
+			break;
+		}
+		block = Block::None;
+	};
+
+	auto lookup = [](std::unordered_map<std::string, uint32_t>& names, const std::string& name, uint32_t& index)
+	{
+		auto found = names.find(name);
+		if (found == names.end())
+		{
+			return false;
+		}
+		index = found->second;
+		return true;
+	};
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string keyword;
+		if (!(tokens >> keyword))
+		{
+			continue;
+		}
+
+		bool valid = true;
+		auto readFloat3 = [&](DirectX::XMFLOAT3& value) { valid = valid && (tokens >> value.x >> value.y >> value.z); };
+		auto fail = [&](const std::string& problem)
+		{
+			error = std::to_string(lineNumber) + ": " + problem;
+			return false;
+		};
+
+		if (keyword == "mesh" || keyword == "texture")
+		{
+			std::string name, path;
+			valid = (bool)(tokens >> name >> path);
+			if (valid)
+			{
+				if (keyword == "mesh")
+				{
+					std::string lodKeyword, lodName;
+					uint32_t lod = SCENE_NO_INDEX;
+					if (tokens >> lodKeyword)
+					{
+						valid = lodKeyword == "lod" && (bool)(tokens >> lodName);
+						if (valid && !lookup(meshNames, lodName, lod))
+						{
+							return fail("lod mesh " + lodName + " has to be defined before " + name);
+						}
+					}
+					meshNames[name] = builder.AddMesh(path, lod);
+				}
+				else
+				{
+					textureNames[name] = builder.AddTexture(path);
+				}
+			}
+		}
+		else if (keyword == "shader")
+		{
+			std::string name, stage, path;
+			valid = (bool)(tokens >> name >> stage >> path) && (stage == "vertex" || stage == "pixel");
+			if (valid)
+			{
+				shaderNames[name] = builder.AddShader(path, stage == "vertex" ? SCENE_SHADER_VERTEX : SCENE_SHADER_PIXEL);
+			}
+		}
+		else if (keyword == "material")
+		{
+			finishBlock();
+			std::string name, vertexShader, pixelShader;
+			material = {};
+			material.ColorTint = DirectX::XMFLOAT4(1, 1, 1, 1);
+			material.UVScale = DirectX::XMFLOAT2(1, 1);
+			valid = (bool)(tokens >> name >> vertexShader >> pixelShader);
+			if (valid && (!lookup(shaderNames, vertexShader, material.VertexShader) || !lookup(shaderNames, pixelShader, material.PixelShader)))
+			{
+				return fail("unknown shader");
+			}
+			materialNames[name] = (uint32_t)builder.GetMaterialCount();
+			block = Block::Material;
+		}
+		else if (keyword == "entity")
+		{
+			finishBlock();
+			std::string mesh, materialName;
+			entity = {};
+			entity.Scale = DirectX::XMFLOAT3(1, 1, 1);
+			entity.Parent = SCENE_NO_INDEX;
+			valid = (bool)(tokens >> entityName >> mesh >> materialName);
+			if (valid && (!lookup(meshNames, mesh, entity.Mesh) || !lookup(materialNames, materialName, entity.Material)))
+			{
+				return fail("unknown mesh or material");
+			}
+			block = Block::Entity;
+		}
+		else if (keyword == "light")
+		{
+			finishBlock();
+			std::string type;
+			light = {};
+			light.Intensity = 1;
+			light.Color = DirectX::XMFLOAT3(1, 1, 1);
+			valid = (bool)(tokens >> type);
+			if (type == "directional")
+			{
+				light.Type = LIGHT_TYPE_DIRECTIONAL;
+			}
+			else if (type == "point")
+			{
+				light.Type = LIGHT_TYPE_POINT;
+			}
+			else if (type == "spot")
+			{
+				light.Type = LIGHT_TYPE_SPOT;
+			}
+			else
+			{
+				valid = false;
+			}
+			block = Block::Light;
+		}
+		else if (keyword == "camera")
+		{
+			finishBlock();
+			camera = {};
+			camera.MoveSpeed = 10.0f;
+			camera.LookSpeed = 2.0f;
+			camera.FieldOfView = DirectX::XM_PIDIV4;
+			block = Block::Camera;
+		}
+		else if (keyword == "cell")
+		{
+			std::string name;
+			SceneCell cell = {};
+			valid = (bool)(tokens >> name);
+			readFloat3(cell.Min);
+			readFloat3(cell.Max);
+			if (valid && !(cell.Min.x <= cell.Max.x && cell.Min.y <= cell.Max.y && cell.Min.z <= cell.Max.z))
+			{
+				return fail("cell " + name + " has its min past its max");
+			}
+			cellNames[name] = builder.AddCell(cell);
+		}
+		else if (keyword == "portal")
+		{
+			std::string cellA, cellB;
+			ScenePortal portal = {};
+			valid = (bool)(tokens >> cellA >> cellB);
+			if (valid && (!lookup(cellNames, cellA, portal.Cells[0]) || !lookup(cellNames, cellB, portal.Cells[1]) || portal.Cells[0] == portal.Cells[1]))
+			{
+				return fail("a portal needs two different cells defined before it");
+			}
+
+			//Corners run to the end of the line
+			DirectX::XMFLOAT3 corner;
+			while (valid && tokens >> corner.x)
+			{
+				if (!(tokens >> corner.y >> corner.z) || portal.VertexCount == SCENE_PORTAL_MAX_VERTICES)
+				{
+					return fail("a portal has 3 to " + std::to_string(SCENE_PORTAL_MAX_VERTICES) + " corners of x y z");
+				}
+				portal.Vertices[portal.VertexCount++] = corner;
+			}
+			if (valid && portal.VertexCount < 3)
+			{
+				return fail("a portal has 3 to " + std::to_string(SCENE_PORTAL_MAX_VERTICES) + " corners of x y z");
+			}
+			builder.AddPortal(portal);
+		}
+		else if (block == Block::Material && keyword == "tint")
+		{
+			valid = (bool)(tokens >> material.ColorTint.x >> material.ColorTint.y >> material.ColorTint.z >> material.ColorTint.w);
+		}
+		else if (block == Block::Material && keyword == "roughness")
+		{
+			valid = (bool)(tokens >> material.Roughness);
+		}
+		else if (block == Block::Material && (keyword == "uvscale" || keyword == "uvoffset"))
+		{
+			DirectX::XMFLOAT2& uv = keyword == "uvscale" ? material.UVScale : material.UVOffset;
+			valid = (bool)(tokens >> uv.x >> uv.y);
+		}
+		else if (block == Block::Material && keyword == "bind")
+		{
+			std::string slot, texture;
+			uint32_t index = SCENE_NO_INDEX;
+			valid = (bool)(tokens >> slot >> texture);
+			if (valid && texture != "none" && !lookup(textureNames, texture, index))
+			{
+				return fail("unknown texture " + texture);
+			}
+			bindings.push_back({ slot, index });
+		}
+		else if (block == Block::Entity && keyword == "parent")
+		{
+			std::string parent;
+			valid = (bool)(tokens >> parent);
+			if (valid && !lookup(entityNames, parent, entity.Parent))
+			{
+				return fail("parent " + parent + " has to be defined before its children");
+			}
+		}
+		else if (keyword == "position" && (block == Block::Entity || block == Block::Light || block == Block::Camera))
+		{
+			readFloat3(block == Block::Entity ? entity.Position : block == Block::Light ? light.Position : camera.Position);
+		}
+		else if (block == Block::Entity && keyword == "rotation")
+		{
+			readFloat3(entity.Rotation);
+		}
+		else if (block == Block::Entity && keyword == "scale")
+		{
+			readFloat3(entity.Scale);
+		}
+		else if (block == Block::Entity && keyword == "occluder")
+		{
+			entity.Flags |= SCENE_ENTITY_OCCLUDER;
+		}
+		else if (block == Block::Light && keyword == "color")
+		{
+			readFloat3(light.Color);
+		}
+		else if (block == Block::Light && keyword == "direction")
+		{
+			readFloat3(light.Direction);
+		}
+		else if (block == Block::Light && keyword == "intensity")
+		{
+			valid = (bool)(tokens >> light.Intensity);
+		}
+		else if (block == Block::Light && keyword == "range")
+		{
+			valid = (bool)(tokens >> light.Range);
+		}
+		else if (block == Block::Light && keyword == "spot")
+		{
+			valid = (bool)(tokens >> light.SpotInnerAngle >> light.SpotOuterAngle);
+		}
+		else if (block == Block::Camera && keyword == "speed")
+		{
+			valid = (bool)(tokens >> camera.MoveSpeed >> camera.LookSpeed);
+		}
+		else if (block == Block::Camera && keyword == "fov")
+		{
+			valid = (bool)(tokens >> camera.FieldOfView);
+		}
+		else
+		{
+			return fail("unexpected " + keyword);
+		}
+
+		if (!valid)
+		{
+			return fail("bad arguments for " + keyword);
+		}
+	}
+	finishBlock();
+
+	if (!builder.Write(binaryPath))
+	{
+		error = "Couldn't write " + binaryPath.string();
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ SCENE BUILDER -------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+/// <summary>
+/// Stores the string once, repeats give back the same offset
+/// </summary>
+uint32_t SceneBuilder::AddString(const std::string& text)
+{
+	auto found = stringLookup.find(text);
+	if (found != stringLookup.end())
+	{
+		return found->second;
+	}
+
+	uint32_t offset = (uint32_t)strings.size();
+	strings.insert(strings.end(), text.begin(), text.end());
+	strings.push_back('\0');
+	stringLookup.insert({ text, offset });
+	return offset;
+}
+
+uint32_t SceneBuilder::AddMesh(const std::string& path, uint32_t lod)
+{
+	meshes.push_back({ AddString(path), lod });
+	return (uint32_t)meshes.size() - 1;
+}
+
+uint32_t SceneBuilder::AddTexture(const std::string& path)
+{
+	textures.push_back({ AddString(path), SCENE_NO_INDEX });
+	return (uint32_t)textures.size() - 1;
+}
+
+uint32_t SceneBuilder::AddShader(const std::string& path, uint32_t stage)
+{
+	shaders.push_back({ AddString(path), stage });
+	return (uint32_t)shaders.size() - 1;
+}
+
+uint32_t SceneBuilder::AddMaterial(const SceneMaterial& material)
+{
+	materials.push_back(material);
+	return (uint32_t)materials.size() - 1;
+}
+
+void SceneBuilder::AddTextureBinding(uint32_t material, const std::string& name, uint32_t texture)
+{
+	pendingBindings.push_back({ material, { AddString(name), texture } });
+}
+
+uint32_t SceneBuilder::AddEntity(const SceneEntity& entity)
+{
+	entities.push_back(entity);
+	return (uint32_t)entities.size() - 1;
+}
+
+uint32_t SceneBuilder::AddLight(const Light& light)
+{
+	lights.push_back(light);
+	return (uint32_t)lights.size() - 1;
+}
+
+uint32_t SceneBuilder::AddCamera(const SceneCamera& camera)
+{
+	cameras.push_back(camera);
+	return (uint32_t)cameras.size() - 1;
+}
+
+uint32_t SceneBuilder::AddCell(const SceneCell& cell)
+{
+	cells.push_back(cell);
+	return (uint32_t)cells.size() - 1;
+}
+
+uint32_t SceneBuilder::AddPortal(const ScenePortal& portal)
+{
+	portals.push_back(portal);
+	return (uint32_t)portals.size() - 1;
+}
+
+/// <summary>
+/// Lays the header out first, then each table on its own aligned offset
+/// </summary>
+bool SceneBuilder::Write(const std::filesystem::path& path)
+{
+	//Each material's bindings have to sit next to each other
+	std::stable_sort(pendingBindings.begin(), pendingBindings.end(),
+		[](const auto& a, const auto& b) { return a.first < b.first; });
+
+	std::vector<SceneTextureBinding> bindings;
+	std::vector<SceneMaterial> finalMaterials = materials;
+	for (SceneMaterial& material : finalMaterials)
+	{
+		material.FirstBinding = 0;
+		material.BindingCount = 0;
+	}
+	for (auto& binding : pendingBindings)
+	{
+		SceneMaterial& material = finalMaterials[binding.first];
+		if (material.BindingCount == 0)
+		{
+			material.FirstBinding = (uint32_t)bindings.size();
+		}
+		material.BindingCount++;
+		bindings.push_back(binding.second);
+	}
+
+	SceneFileHeader header = {};
+	header.Magic = SCENE_FILE_MAGIC;
+	header.Version = SCENE_FILE_VERSION;
+
+	struct Section
+	{
+		SceneTable* Table;
+		const void* Data;
+		size_t Count;
+		size_t Stride;
+	};
+	Section sections[] =
+	{
+		{ &header.Strings, strings.data(), strings.size(), sizeof(char) },
+		{ &header.Meshes, meshes.data(), meshes.size(), sizeof(SceneAsset) },
+		{ &header.Textures, textures.data(), textures.size(), sizeof(SceneAsset) },
+		{ &header.Shaders, shaders.data(), shaders.size(), sizeof(SceneShader) },
+		{ &header.Materials, finalMaterials.data(), finalMaterials.size(), sizeof(SceneMaterial) },
+		{ &header.TextureBindings, bindings.data(), bindings.size(), sizeof(SceneTextureBinding) },
+		{ &header.Entities, entities.data(), entities.size(), sizeof(SceneEntity) },
+		{ &header.Lights, lights.data(), lights.size(), sizeof(Light) },
+		{ &header.Cameras, cameras.data(), cameras.size(), sizeof(SceneCamera) },
+		{ &header.Cells, cells.data(), cells.size(), sizeof(SceneCell) },
+		{ &header.Portals, portals.data(), portals.size(), sizeof(ScenePortal) },
+	};
+
+	uint64_t offset = AlignUp(sizeof(SceneFileHeader), SCENE_TABLE_ALIGNMENT);
+	for (Section& section : sections)
+	{
+		section.Table->Offset = offset;
+		section.Table->Count = (uint32_t)section.Count;
+		section.Table->Stride = (uint32_t)section.Stride;
+		offset = AlignUp(offset + section.Count * section.Stride, SCENE_TABLE_ALIGNMENT);
+	}
+	header.FileSize = offset;
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	if (!output)
+	{
+		return false;
+	}
+
+	const char padding[SCENE_TABLE_ALIGNMENT] = {};
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t written = sizeof(header);
+	for (Section& section : sections)
+	{
+		output.write(padding, (std::streamsize)(section.Table->Offset - written));
+		output.write(static_cast<const char*>(section.Data), (std::streamsize)(section.Count * section.Stride));
+		written = section.Table->Offset + section.Count * section.Stride;
+	}
+	output.write(padding, (std::streamsize)(header.FileSize - written));
+
+	return (bool)output;
+}
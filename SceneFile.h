@@ -0,0 +1,229 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Lights.h"
+
+#define SCENE_FILE_MAGIC 0x314E4353u //"SCN1"
+#define SCENE_FILE_VERSION 4
+#define SCENE_TABLE_ALIGNMENT 16
+#define SCENE_NO_INDEX 0xFFFFFFFFu
+
+#define SCENE_SHADER_VERTEX 0
+#define SCENE_SHADER_PIXEL 1
+
+#define SCENE_ENTITY_OCCLUDER 0x1u //Drawn into the software depth buffer that hides other entities
+
+#define SCENE_PORTAL_MAX_VERTICES 8
+
+// --------------------------------------------------------
+// Where one flat array lives in the file. Offsets are from
+// the start of the file, so the whole file can be mapped
+// anywhere and each table is one pointer add away.
+// --------------------------------------------------------
+struct SceneTable
+{
+	uint64_t Offset;
+	uint32_t Count;
+	uint32_t Stride; //sizeof the element when written, checked on load
+};
+
+struct SceneFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t FileSize;
+
+	SceneTable Strings; //chars, every string NUL terminated, referenced by byte offset
+	SceneTable Meshes; //SceneAsset
+	SceneTable Textures; //SceneAsset
+	SceneTable Shaders; //SceneShader
+	SceneTable Materials; //SceneMaterial
+	SceneTable TextureBindings; //SceneTextureBinding, each material owns a contiguous run
+	SceneTable Entities; //SceneEntity, parents always come before their children
+	SceneTable Lights; //Light, exactly as the shaders want it
+	SceneTable Cameras; //SceneCamera
+	SceneTable Cells; //SceneCell
+	SceneTable Portals; //ScenePortal
+};
+
+//Asset paths are relative to the project root
+struct SceneAsset
+{
+	uint32_t Path;
+	uint32_t Lod; //Meshes only, the next coarser mesh. Always an earlier one, or SCENE_NO_INDEX.
+};
+
+struct SceneShader
+{
+	uint32_t Path; //Compiled .cso next to the executable
+	uint32_t Stage; //SCENE_SHADER_VERTEX or SCENE_SHADER_PIXEL
+};
+
+struct SceneMaterial
+{
+	DirectX::XMFLOAT4 ColorTint;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+	float Roughness;
+	uint32_t VertexShader;
+	uint32_t PixelShader;
+	uint32_t FirstBinding;
+	uint32_t BindingCount;
+	uint32_t Padding[3];
+};
+
+struct SceneTextureBinding
+{
+	uint32_t Name; //Shader variable name
+	uint32_t Texture; //SCENE_NO_INDEX binds nothing
+};
+
+struct SceneEntity
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Rotation;
+	DirectX::XMFLOAT3 Scale;
+	uint32_t Mesh;
+	uint32_t Material;
+	uint32_t Parent; //SCENE_NO_INDEX for roots
+	uint32_t Flags; //SCENE_ENTITY_* bits
+	uint32_t Padding[3];
+};
+
+struct SceneCamera
+{
+	DirectX::XMFLOAT3 Position;
+	float MoveSpeed;
+	float LookSpeed;
+	float FieldOfView;
+	uint32_t Padding[2];
+};
+
+//A convex zone of an indoor scene, for portal visibility
+struct SceneCell
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	uint32_t Padding[2];
+};
+
+//The convex opening between two cells
+struct ScenePortal
+{
+	uint32_t Cells[2];
+	uint32_t VertexCount;
+	uint32_t Padding;
+	DirectX::XMFLOAT3 Vertices[SCENE_PORTAL_MAX_VERTICES];
+};
+
+// --------------------------------------------------------
+// A binary scene mapped straight into memory
+//
+// Nothing is parsed or copied on load. Open checks the
+// header, table bounds and every cross reference once, then
+// the getters just point into the mapping. Pointers are only
+// good until Close.
+// --------------------------------------------------------
+class SceneFile
+{
+public:
+	SceneFile();
+	~SceneFile();
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+	bool IsOpen() { return data != nullptr; }
+
+	//Turns a text scene into the binary format, error holds "line: problem" on failure
+	static bool ConvertText(const std::filesystem::path& textPath, const std::filesystem::path& binaryPath, std::string& error);
+
+	//Getters
+	const char* GetString(uint32_t offset) { return GetTable<char>(header->Strings) + offset; }
+	const SceneAsset* GetMeshes() { return GetTable<SceneAsset>(header->Meshes); }
+	const SceneAsset* GetTextures() { return GetTable<SceneAsset>(header->Textures); }
+	const SceneShader* GetShaders() { return GetTable<SceneShader>(header->Shaders); }
+	const SceneMaterial* GetMaterials() { return GetTable<SceneMaterial>(header->Materials); }
+	const SceneTextureBinding* GetTextureBindings() { return GetTable<SceneTextureBinding>(header->TextureBindings); }
+	const SceneEntity* GetEntities() { return GetTable<SceneEntity>(header->Entities); }
+	const Light* GetLights() { return GetTable<Light>(header->Lights); }
+	const SceneCamera* GetCameras() { return GetTable<SceneCamera>(header->Cameras); }
+	const SceneCell* GetCells() { return GetTable<SceneCell>(header->Cells); }
+	const ScenePortal* GetPortals() { return GetTable<ScenePortal>(header->Portals); }
+
+	int GetMeshCount() { return (int)header->Meshes.Count; }
+	int GetTextureCount() { return (int)header->Textures.Count; }
+	int GetShaderCount() { return (int)header->Shaders.Count; }
+	int GetMaterialCount() { return (int)header->Materials.Count; }
+	int GetEntityCount() { return (int)header->Entities.Count; }
+	int GetLightCount() { return (int)header->Lights.Count; }
+	int GetCameraCount() { return (int)header->Cameras.Count; }
+	int GetCellCount() { return (int)header->Cells.Count; }
+	int GetPortalCount() { return (int)header->Portals.Count; }
+
+private:
+	const unsigned char* data;
+	size_t size;
+	const SceneFileHeader* header;
+
+	//Platform mapping handles
+	void* fileHandle;
+	void* mappingHandle;
+
+	template<typename T>
+	const T* GetTable(const SceneTable& table) { return reinterpret_cast<const T*>(data + table.Offset); }
+
+	bool Validate();
+};
+
+// --------------------------------------------------------
+// Collects scene tables in memory and writes them out in
+// the SceneFile layout. Indices returned by the Add methods
+// are what the other tables refer to.
+// --------------------------------------------------------
+class SceneBuilder
+{
+public:
+	uint32_t AddString(const std::string& text);
+	uint32_t AddMesh(const std::string& path, uint32_t lod = SCENE_NO_INDEX);
+	uint32_t AddTexture(const std::string& path);
+	uint32_t AddShader(const std::string& path, uint32_t stage);
+	uint32_t AddMaterial(const SceneMaterial& material);
+	void AddTextureBinding(uint32_t material, const std::string& name, uint32_t texture);
+	uint32_t AddEntity(const SceneEntity& entity);
+	uint32_t AddLight(const Light& light);
+	uint32_t AddCamera(const SceneCamera& camera);
+	uint32_t AddCell(const SceneCell& cell);
+	uint32_t AddPortal(const ScenePortal& portal);
+
+	bool Write(const std::filesystem::path& path);
+
+	//Getters
+	int GetMaterialCount() { return (int)materials.size(); }
+	int GetEntityCount() { return (int)entities.size(); }
+	const SceneEntity* GetEntities() { return entities.data(); }
+
+private:
+	std::vector<char> strings;
+	std::unordered_map<std::string, uint32_t> stringLookup;
+	std::vector<SceneAsset> meshes;
+	std::vector<SceneAsset> textures;
+	std::vector<SceneShader> shaders;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneEntity> entities;
+	std::vector<Light> lights;
+	std::vector<SceneCamera> cameras;
+	std::vector<SceneCell> cells;
+	std::vector<ScenePortal> portals;
+
+	//Bindings are grouped per material when written
+	std::vector<std::pair<uint32_t, SceneTextureBinding>> pendingBindings;
+};
@@ -0,0 +1,353 @@
+#include "ShadowCasterCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	//Corners are numbered by bits, x in bit 0 and y in bit 1 from -1 to 1, z in bit 2 from near to far
+	XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		return XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+
+	//Plane with the given normal through point, flipped if need be so inside is on its positive side.
+	//False if the normal is too short to trust.
+	bool OrientedPlane(XMVECTOR normal, XMVECTOR point, XMVECTOR inside, XMFLOAT4& plane)
+	{
+		float length = XMVectorGetX(XMVector3Length(normal));
+		if (length < 1e-6f)
+		{
+			return false;
+		}
+		normal = XMVectorScale(normal, 1.0f / length);
+		float distance = -XMVectorGetX(XMVector3Dot(normal, point));
+		if (XMVectorGetX(XMVector3Dot(normal, inside)) + distance < 0.0f)
+		{
+			normal = XMVectorNegate(normal);
+			distance = -distance;
+		}
+		plane = XMFLOAT4(XMVectorGetX(normal), XMVectorGetY(normal), XMVectorGetZ(normal), distance);
+		return true;
+	}
+
+	//The hull of a hexahedron and a light, which is where anything shadowing the hexahedron has to be.
+	//light is a position with w = 1, or the direction towards the light with w = 0 for one infinitely far
+	//away. Faces the light is behind are dropped, and every edge between one of those and a face it's in
+	//front of becomes a plane through the edge and the light.
+	int BuildReachPlanes(const XMFLOAT3 corners[8], const XMFLOAT4& light, XMFLOAT4* planes, int maxPlanes)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		for (int c = 0; c < 8; c++)
+		{
+			centroid = XMVectorAdd(centroid, XMLoadFloat3(&corners[c]));
+		}
+		centroid = XMVectorScale(centroid, 1.0f / 8.0f);
+
+		//Face f holds bit f / 2 at f % 2
+		XMFLOAT4 faces[6];
+		bool valid[6];
+		bool behind[6];
+		for (int f = 0; f < 6; f++)
+		{
+			int axis = f / 2;
+			int fixed = (f % 2) << axis;
+			int a = (axis + 1) % 3;
+			int b = (axis + 2) % 3;
+			XMVECTOR p0 = XMLoadFloat3(&corners[fixed]);
+			XMVECTOR p1 = XMLoadFloat3(&corners[fixed | (1 << a)]);
+			XMVECTOR p2 = XMLoadFloat3(&corners[fixed | (1 << b)]);
+			valid[f] = OrientedPlane(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)), p0, centroid, faces[f]);
+			behind[f] = valid[f] && faces[f].x * light.x + faces[f].y * light.y + faces[f].z * light.z + faces[f].w * light.w < 0.0f;
+		}
+
+		int count = 0;
+		for (int f = 0; f < 6 && count < maxPlanes; f++)
+		{
+			if (valid[f] && !behind[f])
+			{
+				planes[count++] = faces[f];
+			}
+		}
+
+		//Edge along bit axis, with the other two bits at values va and vb
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int a = (axis + 1) % 3;
+			int b = (axis + 2) % 3;
+			for (int values = 0; values < 4 && count < maxPlanes; values++)
+			{
+				int va = values & 1;
+				int vb = values >> 1;
+				int faceA = a * 2 + va;
+				int faceB = b * 2 + vb;
+				if (!valid[faceA] || !valid[faceB] || behind[faceA] == behind[faceB])
+				{
+					continue;
+				}
+
+				int start = (va << a) | (vb << b);
+				XMVECTOR p0 = XMLoadFloat3(&corners[start]);
+				XMVECTOR p1 = XMLoadFloat3(&corners[start | (1 << axis)]);
+				XMVECTOR towardLight = light.w != 0.0f
+					? XMVectorSubtract(XMVectorSet(light.x / light.w, light.y / light.w, light.z / light.w, 0.0f), p0)
+					: XMVectorSet(light.x, light.y, light.z, 0.0f);
+				if (OrientedPlane(XMVector3Cross(XMVectorSubtract(p1, p0), towardLight), p0, centroid, planes[count]))
+				{
+					count++;
+				}
+			}
+		}
+		return count;
+	}
+
+	//The axes XMMatrixLookToLH uses for a view looking along direction
+	void LightAxes(XMVECTOR direction, XMVECTOR& right, XMVECTOR& up, XMVECTOR& forward)
+	{
+		forward = XMVector3Normalize(direction);
+		up = fabsf(XMVectorGetY(forward)) > 0.99f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+		right = XMVector3Normalize(XMVector3Cross(up, forward));
+		up = XMVector3Cross(forward, right);
+	}
+}
+
+/// <summary>
+/// Builds every light's views from the camera, then culls the culler's bounds against them a pass
+/// of SHADOW_VIEWS_PER_PASS at a time and gathers each view's casters in slot order
+/// </summary>
+void ShadowCasterCuller::Update(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, const Light* lights, int lightCount,
+	const ShadowCasterSettings& settings, FrustumCuller& culler, JobSystem* jobSystem)
+{
+	views.clear();
+	lightStats.assign(lightCount, {});
+	casterTotal = 0;
+	inVolumeTotal = 0;
+
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	XMMATRIX inverse = XMMatrixInverse(nullptr, XMMatrixMultiply(viewMatrix, XMLoadFloat4x4(&projection)));
+	XMFLOAT3 corners[8];
+	for (int c = 0; c < 8; c++)
+	{
+		XMVECTOR ndc = XMVectorSet((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : 0.0f, 1.0f);
+		XMStoreFloat3(&corners[c], XMVector3TransformCoord(ndc, inverse));
+	}
+
+	//Read back off the corners, working them out from the projection loses the far plane to rounding
+	float nearClip = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&corners[0]), viewMatrix));
+	float farClip = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&corners[4]), viewMatrix));
+
+	for (int i = 0; i < lightCount; i++)
+	{
+		lightStats[i].Type = lights[i].Type;
+		if (lights[i].Type == LIGHT_TYPE_SPOT)
+		{
+			AddSpotView(i, lights[i], corners, settings.RejectUnseen);
+		}
+		else if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			AddCascadeViews(i, lights[i], corners, corners + 4, nearClip, farClip, settings);
+		}
+	}
+
+	casters.resize(views.size());
+	masks.resize(culler.GetSlotCount());
+	int capacity = culler.GetCapacity();
+	for (int first = 0; first < (int)views.size(); first += SHADOW_VIEWS_PER_PASS)
+	{
+		int count = std::min((int)views.size() - first, SHADOW_VIEWS_PER_PASS);
+
+		//The light's volume alone, then with the reach planes, so both counts come out of one pass
+		CullVolume volumes[CULL_MAX_VIEWS];
+		for (int v = 0; v < count; v++)
+		{
+			ShadowView& shadowView = views[first + v];
+			volumes[v * 2] = { shadowView.Planes, shadowView.VolumePlaneCount };
+			volumes[v * 2 + 1] = { shadowView.Planes, shadowView.VolumePlaneCount + shadowView.ReachPlaneCount };
+			casters[first + v].clear();
+		}
+		culler.CullVolumes(volumes, count * 2, masks.data(), jobSystem);
+
+		for (int slot = 0; slot < capacity; slot++)
+		{
+			uint8_t mask = masks[slot];
+			for (int v = 0; mask && v < count; v++, mask >>= 2)
+			{
+				views[first + v].InVolume += mask & 1;
+				if (mask & 2)
+				{
+					casters[first + v].push_back((uint32_t)slot);
+				}
+			}
+		}
+	}
+
+	for (int v = 0; v < (int)views.size(); v++)
+	{
+		ShadowView& shadowView = views[v];
+		shadowView.Casters = (int)casters[v].size();
+		if (shadowView.Cascade != SHADOW_NO_CASCADE)
+		{
+			FitCascade(shadowView, lights[shadowView.Light], culler);
+		}
+
+		ShadowLightStats& stats = lightStats[shadowView.Light];
+		stats.Views++;
+		stats.InVolume += shadowView.InVolume;
+		stats.Casters += shadowView.Casters;
+		inVolumeTotal += shadowView.InVolume;
+		casterTotal += shadowView.Casters;
+	}
+}
+
+/// <summary>
+/// The spot's cone as a square frustum as wide as the outer angle, reaching out to the range
+/// </summary>
+void ShadowCasterCuller::AddSpotView(int light, const Light& spot, const DirectX::XMFLOAT3* frustumCorners, bool rejectUnseen)
+{
+	XMVECTOR direction = XMLoadFloat3(&spot.Direction);
+	if (XMVectorGetX(XMVector3Length(direction)) < 1e-6f)
+	{
+		return;
+	}
+
+	XMVECTOR right;
+	XMVECTOR up;
+	XMVECTOR forward;
+	LightAxes(direction, right, up, forward);
+	float angle = std::min(spot.SpotOuterAngle * 2.0f, SHADOW_MAX_SPOT_ANGLE);
+	float range = std::max(spot.Range, SHADOW_SPOT_NEAR * 2.0f);
+	XMMATRIX viewProjection = XMMatrixMultiply(
+		XMMatrixLookToLH(XMLoadFloat3(&spot.Position), forward, up),
+		XMMatrixPerspectiveFovLH(angle, 1.0f, SHADOW_SPOT_NEAR, range));
+
+	ShadowView view = {};
+	view.Light = light;
+	view.Cascade = SHADOW_NO_CASCADE;
+	XMStoreFloat4x4(&view.ViewProjection, viewProjection);
+	Frustum frustum = FrustumFromMatrix(view.ViewProjection);
+	std::copy(frustum.Planes, frustum.Planes + 6, view.Planes);
+	view.VolumePlaneCount = 6;
+	if (rejectUnseen)
+	{
+		XMFLOAT4 position(spot.Position.x, spot.Position.y, spot.Position.z, 1.0f);
+		view.ReachPlaneCount = BuildReachPlanes(frustumCorners, position, view.Planes + 6, CULL_MAX_VOLUME_PLANES - 6);
+	}
+	views.push_back(view);
+}
+
+/// <summary>
+/// Splits the view out to the shadow distance, blending even and logarithmic spacing, and bounds
+/// each slice with a box in light space. The box's near side is left open, FitCascade closes it.
+/// </summary>
+void ShadowCasterCuller::AddCascadeViews(int light, const Light& directional, const DirectX::XMFLOAT3* nearCorners, const DirectX::XMFLOAT3* farCorners,
+	float nearClip, float farClip, const ShadowCasterSettings& settings)
+{
+	XMVECTOR direction = XMLoadFloat3(&directional.Direction);
+	float shadowFar = std::min(farClip, settings.ShadowDistance);
+	if (XMVectorGetX(XMVector3Length(direction)) < 1e-6f || !(shadowFar > nearClip))
+	{
+		return;
+	}
+
+	XMVECTOR right;
+	XMVECTOR up;
+	XMVECTOR forward;
+	LightAxes(direction, right, up, forward);
+	XMFLOAT4 towardLight;
+	XMStoreFloat4(&towardLight, XMVectorNegate(forward));
+	towardLight.w = 0.0f;
+
+	int cascadeCount = std::clamp(settings.CascadeCount, 1, SHADOW_MAX_CASCADES);
+	auto split = [&](int cascade)
+	{
+		float fraction = (float)cascade / cascadeCount;
+		float logarithmic = nearClip * powf(shadowFar / nearClip, fraction);
+		float even = nearClip + (shadowFar - nearClip) * fraction;
+		return settings.SplitBlend * logarithmic + (1.0f - settings.SplitBlend) * even;
+	};
+
+	for (int cascade = 0; cascade < cascadeCount; cascade++)
+	{
+		ShadowView view = {};
+		view.Light = light;
+		view.Cascade = cascade;
+		view.SplitNear = split(cascade);
+		view.SplitFar = split(cascade + 1);
+
+		//The frustum's side edges are straight, so the slice's corners are found along them
+		XMFLOAT3 slice[8];
+		float startT = (view.SplitNear - nearClip) / (farClip - nearClip);
+		float endT = (view.SplitFar - nearClip) / (farClip - nearClip);
+		for (int c = 0; c < 4; c++)
+		{
+			slice[c] = Lerp(nearCorners[c], farCorners[c], startT);
+			slice[c + 4] = Lerp(nearCorners[c], farCorners[c], endT);
+		}
+
+		XMFLOAT3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const XMFLOAT3& corner : slice)
+		{
+			XMVECTOR point = XMLoadFloat3(&corner);
+			XMFLOAT3 local(XMVectorGetX(XMVector3Dot(right, point)), XMVectorGetX(XMVector3Dot(up, point)), XMVectorGetX(XMVector3Dot(forward, point)));
+			min = XMFLOAT3(std::min(min.x, local.x), std::min(min.y, local.y), std::min(min.z, local.z));
+			max = XMFLOAT3(std::max(max.x, local.x), std::max(max.y, local.y), std::max(max.z, local.z));
+		}
+		view.LightMin = min;
+		view.LightMax = max;
+
+		//Sides and the far end, facing in
+		XMFLOAT3 r;
+		XMFLOAT3 u;
+		XMFLOAT3 f;
+		XMStoreFloat3(&r, right);
+		XMStoreFloat3(&u, up);
+		XMStoreFloat3(&f, forward);
+		view.Planes[0] = XMFLOAT4(r.x, r.y, r.z, -min.x);
+		view.Planes[1] = XMFLOAT4(-r.x, -r.y, -r.z, max.x);
+		view.Planes[2] = XMFLOAT4(u.x, u.y, u.z, -min.y);
+		view.Planes[3] = XMFLOAT4(-u.x, -u.y, -u.z, max.y);
+		view.Planes[4] = XMFLOAT4(-f.x, -f.y, -f.z, max.z);
+		view.VolumePlaneCount = 5;
+		if (settings.RejectUnseen)
+		{
+			view.ReachPlaneCount = BuildReachPlanes(slice, towardLight, view.Planes + 5, CULL_MAX_VOLUME_PLANES - 5);
+		}
+		views.push_back(view);
+	}
+}
+
+/// <summary>
+/// Pulls the cascade's near plane back to its furthest caster towards the light and builds the matrix to render it with
+/// </summary>
+void ShadowCasterCuller::FitCascade(ShadowView& view, const Light& directional, FrustumCuller& culler)
+{
+	XMVECTOR right;
+	XMVECTOR up;
+	XMVECTOR forward;
+	LightAxes(XMLoadFloat3(&directional.Direction), right, up, forward);
+	XMFLOAT3 f;
+	XMStoreFloat3(&f, forward);
+
+	const std::vector<uint32_t>& list = casters[&view - views.data()];
+	float nearZ = view.LightMin.z;
+	float lanes[6][CULL_BLOCK_SIZE];
+	for (int first = 0; first < (int)list.size(); first += CULL_BLOCK_SIZE)
+	{
+		int laneCount = std::min((int)list.size() - first, CULL_BLOCK_SIZE);
+		culler.GatherBounds(list.data() + first, laneCount, lanes);
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			float depth = f.x * lanes[0][lane] + f.y * lanes[1][lane] + f.z * lanes[2][lane];
+			float radius = fabsf(f.x) * lanes[3][lane] + fabsf(f.y) * lanes[4][lane] + fabsf(f.z) * lanes[5][lane];
+			nearZ = std::min(nearZ, depth - radius);
+		}
+	}
+
+	XMStoreFloat4x4(&view.ViewProjection, XMMatrixMultiply(
+		XMMatrixLookToLH(XMVectorZero(), forward, up),
+		XMMatrixOrthographicOffCenterLH(view.LightMin.x, view.LightMax.x, view.LightMin.y, view.LightMax.y, nearZ, view.LightMax.z)));
+}
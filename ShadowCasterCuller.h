@@ -0,0 +1,98 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "Lights.h"
+
+#define SHADOW_MAX_CASCADES 4
+#define SHADOW_SPOT_NEAR 0.05f //Near plane of a spot light's frustum
+#define SHADOW_MAX_SPOT_ANGLE 3.0f //Widest spot frustum in radians, a little short of flat
+#define SHADOW_VIEWS_PER_PASS (CULL_MAX_VIEWS / 2) //Every view takes two volumes in a CullVolumes pass
+#define SHADOW_NO_CASCADE -1
+
+struct ShadowCasterSettings
+{
+	int CascadeCount = 4;
+	float ShadowDistance = 150.0f; //Directional shadows end this far from the camera
+	float SplitBlend = 0.75f; //0 spaces the cascades evenly, 1 logarithmically
+	bool RejectUnseen = true; //Drop casters whose shadow can't fall anywhere the camera sees
+};
+
+//One shadow map's worth, a spot light or one cascade of a directional light
+struct ShadowView
+{
+	int Light; //Index into the lights handed to Update
+	int Cascade; //SHADOW_NO_CASCADE for spot lights
+	float SplitNear; //Cascades only, the slice of the view they cover
+	float SplitFar;
+	DirectX::XMFLOAT4X4 ViewProjection; //To render the map with. A cascade's reaches back to its furthest caster.
+	DirectX::XMFLOAT3 LightMin; //Cascades only, the slice's bounds along the light's axes
+	DirectX::XMFLOAT3 LightMax;
+	int InVolume; //Slots inside the light's volume
+	int Casters; //Those whose shadow can also reach what the camera sees
+	int VolumePlaneCount;
+	int ReachPlaneCount;
+	DirectX::XMFLOAT4 Planes[CULL_MAX_VOLUME_PLANES]; //The light's volume, then the reach planes
+};
+
+//Per light totals over its views
+struct ShadowLightStats
+{
+	int Type;
+	int Views;
+	int InVolume;
+	int Casters;
+};
+
+// --------------------------------------------------------
+// Picks the shadow casters for every spot and directional
+// light
+//
+// Each light gets a volume things have to touch to be lit
+// by it at all: a perspective frustum out to the range for
+// a spot light, and for a directional light one ortho box
+// per cascade around its slice of the view, open towards
+// the light so casters any distance back still count.
+//
+// A caster only matters if its shadow can land on
+// something in view. For a spot light that means being in
+// the hull of the light and the camera frustum, for a
+// cascade its slice swept towards the light. Those planes
+// are added to the volume's, and the boxes are tested
+// against both sets at once.
+//
+// Point lights would need six views each and are skipped.
+// The bounds come from the FrustumCuller, up to
+// SHADOW_VIEWS_PER_PASS views per pass over them.
+// --------------------------------------------------------
+class ShadowCasterCuller
+{
+public:
+	void Update(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, const Light* lights, int lightCount,
+		const ShadowCasterSettings& settings, FrustumCuller& culler, JobSystem* jobSystem = nullptr);
+
+	//Getters
+	int GetViewCount() { return (int)views.size(); }
+	const ShadowView& GetView(int view) { return views[view]; }
+	const uint32_t* GetCasters(int view) { return casters[view].data(); }
+	const std::vector<ShadowLightStats>& GetLightStats() { return lightStats; }
+	int GetCasterTotal() { return casterTotal; } //Over every view, so a slot in two maps counts twice
+	int GetInVolumeTotal() { return inVolumeTotal; }
+
+private:
+	std::vector<ShadowView> views;
+	std::vector<std::vector<uint32_t>> casters;
+	std::vector<ShadowLightStats> lightStats;
+	std::vector<uint8_t> masks;
+	int casterTotal = 0;
+	int inVolumeTotal = 0;
+
+	void AddSpotView(int light, const Light& spot, const DirectX::XMFLOAT3* frustumCorners, bool rejectUnseen);
+	void AddCascadeViews(int light, const Light& directional, const DirectX::XMFLOAT3* nearCorners, const DirectX::XMFLOAT3* farCorners,
+		float nearClip, float farClip, const ShadowCasterSettings& settings);
+	void FitCascade(ShadowView& view, const Light& directional, FrustumCuller& culler);
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX 1
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_SSE 1
+#else
+#include <cmath>
+#endif
+
+#define SIMD_WIDTH 8
+
+// --------------------------------------------------------
+// Eight floats worked on together, for the culling kernels
+//
+// Builds with AVX enabled (the ReleaseAVX2 configuration)
+// use one register, everything else on x64 (the project's
+// default, SSE2 is always there) uses two, and other
+// targets fall back to plain loops. Comparisons give lanes
+// that are all ones or all zeros, and comparisons with NaN
+// are always false. Min and Max hand back their second
+// argument when either one is NaN.
+// --------------------------------------------------------
+namespace Simd
+{
+#if defined(SIMD_AVX)
+	typedef __m256 Float8;
+
+	inline Float8 Load(const float* values) { return _mm256_loadu_ps(values); }
+	inline void Store(float* values, Float8 a) { _mm256_storeu_ps(values, a); }
+	inline Float8 Splat(float value) { return _mm256_set1_ps(value); }
+	inline Float8 Sequence(float start) { return _mm256_add_ps(_mm256_set1_ps(start), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)); }
+	inline Float8 Add(Float8 a, Float8 b) { return _mm256_add_ps(a, b); }
+	inline Float8 Sub(Float8 a, Float8 b) { return _mm256_sub_ps(a, b); }
+	inline Float8 Mul(Float8 a, Float8 b) { return _mm256_mul_ps(a, b); }
+	inline Float8 Div(Float8 a, Float8 b) { return _mm256_div_ps(a, b); }
+	inline Float8 Min(Float8 a, Float8 b) { return _mm256_min_ps(a, b); }
+	inline Float8 Max(Float8 a, Float8 b) { return _mm256_max_ps(a, b); }
+	inline Float8 Sqrt(Float8 a) { return _mm256_sqrt_ps(a); }
+	inline Float8 Abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	inline Float8 And(Float8 a, Float8 b) { return _mm256_and_ps(a, b); }
+	inline Float8 AtLeastZero(Float8 a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GE_OQ); }
+	inline Float8 AboveZero(Float8 a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ); }
+	inline Float8 Less(Float8 a, Float8 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline Float8 AllSet() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	inline unsigned int Mask(Float8 a) { return (unsigned int)_mm256_movemask_ps(a); }
+#elif defined(SIMD_SSE)
+	struct Float8
+	{
+		__m128 Low;
+		__m128 High;
+	};
+
+	inline Float8 Load(const float* values) { return { _mm_loadu_ps(values), _mm_loadu_ps(values + 4) }; }
+	inline void Store(float* values, Float8 a) { _mm_storeu_ps(values, a.Low); _mm_storeu_ps(values + 4, a.High); }
+	inline Float8 Splat(float value) { return { _mm_set1_ps(value), _mm_set1_ps(value) }; }
+	inline Float8 Sequence(float start) { return { _mm_add_ps(_mm_set1_ps(start), _mm_setr_ps(0, 1, 2, 3)), _mm_add_ps(_mm_set1_ps(start), _mm_setr_ps(4, 5, 6, 7)) }; }
+	inline Float8 Add(Float8 a, Float8 b) { return { _mm_add_ps(a.Low, b.Low), _mm_add_ps(a.High, b.High) }; }
+	inline Float8 Sub(Float8 a, Float8 b) { return { _mm_sub_ps(a.Low, b.Low), _mm_sub_ps(a.High, b.High) }; }
+	inline Float8 Mul(Float8 a, Float8 b) { return { _mm_mul_ps(a.Low, b.Low), _mm_mul_ps(a.High, b.High) }; }
+	inline Float8 Div(Float8 a, Float8 b) { return { _mm_div_ps(a.Low, b.Low), _mm_div_ps(a.High, b.High) }; }
+	inline Float8 Min(Float8 a, Float8 b) { return { _mm_min_ps(a.Low, b.Low), _mm_min_ps(a.High, b.High) }; }
+	inline Float8 Max(Float8 a, Float8 b) { return { _mm_max_ps(a.Low, b.Low), _mm_max_ps(a.High, b.High) }; }
+	inline Float8 Sqrt(Float8 a) { return { _mm_sqrt_ps(a.Low), _mm_sqrt_ps(a.High) }; }
+	inline Float8 Abs(Float8 a) { __m128 sign = _mm_set1_ps(-0.0f); return { _mm_andnot_ps(sign, a.Low), _mm_andnot_ps(sign, a.High) }; }
+	inline Float8 And(Float8 a, Float8 b) { return { _mm_and_ps(a.Low, b.Low), _mm_and_ps(a.High, b.High) }; }
+	inline Float8 AtLeastZero(Float8 a) { return { _mm_cmpge_ps(a.Low, _mm_setzero_ps()), _mm_cmpge_ps(a.High, _mm_setzero_ps()) }; }
+	inline Float8 AboveZero(Float8 a) { return { _mm_cmpgt_ps(a.Low, _mm_setzero_ps()), _mm_cmpgt_ps(a.High, _mm_setzero_ps()) }; }
+	inline Float8 Less(Float8 a, Float8 b) { return { _mm_cmplt_ps(a.Low, b.Low), _mm_cmplt_ps(a.High, b.High) }; }
+	inline Float8 AllSet() { __m128 ones = _mm_castsi128_ps(_mm_set1_epi32(-1)); return { ones, ones }; }
+	inline unsigned int Mask(Float8 a) { return (unsigned int)(_mm_movemask_ps(a.Low) | (_mm_movemask_ps(a.High) << 4)); }
+#else
+	struct Float8
+	{
+		float V[SIMD_WIDTH];
+	};
+
+	inline Float8 Load(const float* values) { Float8 r; for (int i = 0; i < SIMD_WIDTH; i++) r.V[i] = values[i]; return r; }
+	inline void Store(float* values, Float8 a) { for (int i = 0; i < SIMD_WIDTH; i++) values[i] = a.V[i]; }
+	inline Float8 Splat(float value) { Float8 r; for (int i = 0; i < SIMD_WIDTH; i++) r.V[i] = value; return r; }
+	inline Float8 Sequence(float start) { Float8 r; for (int i = 0; i < SIMD_WIDTH; i++) r.V[i] = start + i; return r; }
+	inline Float8 Add(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] += b.V[i]; return a; }
+	inline Float8 Sub(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] -= b.V[i]; return a; }
+	inline Float8 Mul(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] *= b.V[i]; return a; }
+	inline Float8 Div(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] /= b.V[i]; return a; }
+	inline Float8 Min(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = a.V[i] < b.V[i] ? a.V[i] : b.V[i]; return a; }
+	inline Float8 Max(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = a.V[i] > b.V[i] ? a.V[i] : b.V[i]; return a; }
+	inline Float8 Sqrt(Float8 a) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = std::sqrt(a.V[i]); return a; }
+	inline Float8 Abs(Float8 a) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = std::fabs(a.V[i]); return a; }
+	inline Float8 And(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = (a.V[i] != 0 && b.V[i] != 0) ? 1.0f : 0.0f; return a; }
+	inline Float8 AtLeastZero(Float8 a) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = a.V[i] >= 0 ? 1.0f : 0.0f; return a; }
+	inline Float8 AboveZero(Float8 a) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = a.V[i] > 0 ? 1.0f : 0.0f; return a; }
+	inline Float8 Less(Float8 a, Float8 b) { for (int i = 0; i < SIMD_WIDTH; i++) a.V[i] = a.V[i] < b.V[i] ? 1.0f : 0.0f; return a; }
+	inline Float8 AllSet() { return Splat(1.0f); }
+	inline unsigned int Mask(Float8 a) { unsigned int m = 0; for (int i = 0; i < SIMD_WIDTH; i++) m |= (a.V[i] != 0 ? 1u : 0u) << i; return m; }
+#endif
+}
@@ -4,12 +4,18 @@
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// No state cache by default, binds go straight to the context
+RenderStateCache* ISimpleShader::StateCache = nullptr;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
 // 
 // ISimpleShader::ReportErrors = true;
 // ISimpleShader::ReportWarnings = true;
+//
+// Vertex and pixel shaders bind through StateCache when
+// it's set, so binds that change nothing are dropped.
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -240,10 +246,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(std::string_view name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	auto result =
 		varTable.find(name);
 
 	// Did we find the key?
@@ -264,10 +270,10 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
+	auto result =
 		cbTable.find(name);
 
 	// Did we find the key?
@@ -392,7 +398,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(std::string_view bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
@@ -417,7 +423,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 //
 // Returns true if data is copied, false if variable doesn't exist
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(std::string_view name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
 	SimpleShaderVariable* var = FindVariable(name, -1);
@@ -426,7 +432,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
 		}
 		return false;
@@ -439,7 +445,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
 		}
 		return false;
@@ -458,7 +464,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(std::string_view name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -466,7 +472,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(std::string_view name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -474,7 +480,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(std::string_view name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -482,7 +488,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(std::string_view name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -490,7 +496,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(std::string_view name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -498,7 +504,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(std::string_view name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -506,7 +512,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(std::string_view name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -514,7 +520,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(std::string_view name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -522,7 +528,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(std::string_view name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -530,7 +536,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(std::string_view name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
@@ -539,7 +545,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
 // --------------------------------------------------------
-bool ISimpleShader::HasVariable(std::string name)
+bool ISimpleShader::HasVariable(std::string_view name)
 {
 	return FindVariable(name, -1) != 0;
 }
@@ -547,7 +553,7 @@ bool ISimpleShader::HasVariable(std::string name)
 // --------------------------------------------------------
 // Determines if the shader contains the specified SRV
 // --------------------------------------------------------
-bool ISimpleShader::HasShaderResourceView(std::string name)
+bool ISimpleShader::HasShaderResourceView(std::string_view name)
 {
 	return GetShaderResourceViewInfo(name) != 0;
 }
@@ -555,7 +561,7 @@ bool ISimpleShader::HasShaderResourceView(std::string name)
 // --------------------------------------------------------
 // Determines if the shader contains the specified sampler
 // --------------------------------------------------------
-bool ISimpleShader::HasSamplerState(std::string name)
+bool ISimpleShader::HasSamplerState(std::string_view name)
 {
 	return GetSamplerInfo(name) != 0;
 }
@@ -563,7 +569,7 @@ bool ISimpleShader::HasSamplerState(std::string name)
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string_view name)
 {
 	return FindVariable(name, -1);
 }
@@ -573,10 +579,10 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
+	auto result =
 		textureTable.find(name);
 
 	// Did we find the key?
@@ -608,10 +614,10 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
+	auto result =
 		samplerTable.find(name);
 
 	// Did we find the key?
@@ -661,7 +667,7 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string_view name)
 {
 	return FindConstantBuffer(name);
 }
@@ -869,8 +875,16 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (StateCache)
+	{
+		StateCache->SetInputLayout(inputLayout.Get());
+		StateCache->SetVertexShader(shader.Get());
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout.Get());
+		deviceContext->VSSetShader(shader.Get(), 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -880,10 +894,13 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (StateCache)
+			StateCache->SetConstantBuffer(RENDER_STAGE_VERTEX, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get());
+		else
+			deviceContext->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -895,7 +912,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleVertexShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -904,14 +921,17 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleVertexShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (StateCache)
+		StateCache->SetShaderResource(RENDER_STAGE_VERTEX, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -925,7 +945,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleVertexShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -934,14 +954,17 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleVertexShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set the sampler state
+	if (StateCache)
+		StateCache->SetSampler(RENDER_STAGE_VERTEX, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1012,7 +1035,10 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (StateCache)
+		StateCache->SetPixelShader(shader.Get());
+	else
+		deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1022,10 +1048,13 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (StateCache)
+			StateCache->SetConstantBuffer(RENDER_STAGE_PIXEL, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get());
+		else
+			deviceContext->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1037,7 +1066,7 @@ void SimplePixelShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimplePixelShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1046,14 +1075,17 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 		if (ReportWarnings)
 		{
 			LogWarning("SimplePixelShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (StateCache)
+		StateCache->SetShaderResource(RENDER_STAGE_PIXEL, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1067,7 +1099,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimplePixelShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1076,14 +1108,17 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 		if (ReportWarnings)
 		{
 			LogWarning("SimplePixelShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set the sampler state
+	if (StateCache)
+		StateCache->SetSampler(RENDER_STAGE_PIXEL, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1181,7 +1216,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleDomainShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1190,7 +1225,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleDomainShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1211,7 +1246,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleDomainShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1220,7 +1255,7 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleDomainShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1324,7 +1359,7 @@ void SimpleHullShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleHullShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1333,7 +1368,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleHullShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1354,7 +1389,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleHullShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1363,7 +1398,7 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleHullShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1598,7 +1633,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleGeometryShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1607,7 +1642,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleGeometryShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1628,7 +1663,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleGeometryShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1637,7 +1672,7 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleGeometryShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1856,7 +1891,7 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 // --------------------------------------------------------
 // Determines if this shader has the specified UAV
 // --------------------------------------------------------
-bool SimpleComputeShader::HasUnorderedAccessView(std::string name)
+bool SimpleComputeShader::HasUnorderedAccessView(std::string_view name)
 {
 	return GetUnorderedAccessViewIndex(name) != -1;
 }
@@ -1869,7 +1904,7 @@ bool SimpleComputeShader::HasUnorderedAccessView(std::string name)
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleComputeShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1878,7 +1913,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1899,7 +1934,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleComputeShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1908,7 +1943,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1930,7 +1965,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 //
 // Returns true if a UAV of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset)
+bool SimpleComputeShader::SetUnorderedAccessView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset)
 {
 	// Look for the variable and verify
 	unsigned int bindIndex = GetUnorderedAccessViewIndex(name);
@@ -1939,7 +1974,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetUnorderedAccessView() - UAV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1955,10 +1990,10 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 // --------------------------------------------------------
 // Gets the index of the specified UAV (or -1)
 // --------------------------------------------------------
-int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
+int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, unsigned int>::iterator result =
+	auto result =
 		uavTable.find(name);
 
 	// Did we find the key?
@@ -10,7 +10,23 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 
+#include "RenderStateCache.h"
+
+
+// --------------------------------------------------------
+// Name lookups take string_view, so setting a variable from
+// a literal never builds a temporary std::string
+// --------------------------------------------------------
+struct SimpleNameHash
+{
+	using is_transparent = void;
+	size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
+template<typename T>
+using SimpleNameTable = std::unordered_map<std::string, T, SimpleNameHash, std::equal_to<>>;
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -73,46 +89,46 @@ public:
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(std::string_view bufferName);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(std::string_view name, const void* data, unsigned int size);
+
+	bool SetInt(std::string_view name, int data);
+	bool SetFloat(std::string_view name, float data);
+	bool SetFloat2(std::string_view name, const float data[2]);
+	bool SetFloat2(std::string_view name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(std::string_view name, const float data[3]);
+	bool SetFloat3(std::string_view name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(std::string_view name, const float data[4]);
+	bool SetFloat4(std::string_view name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(std::string_view name, const float data[16]);
+	bool SetMatrix4x4(std::string_view name, const DirectX::XMFLOAT4X4 data);
 
 	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
-	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
+	virtual bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
+	virtual bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
 
 	// Simple resource checking
-	bool HasVariable(std::string name);
-	bool HasShaderResourceView(std::string name);
-	bool HasSamplerState(std::string name);
+	bool HasVariable(std::string_view name);
+	bool HasShaderResourceView(std::string_view name);
+	bool HasSamplerState(std::string_view name);
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(std::string_view name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(std::string_view name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
 	size_t GetShaderResourceViewCount() { return textureTable.size(); }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(std::string_view name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
 	size_t GetSamplerCount() { return samplerTable.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	const SimpleConstantBuffer* GetBufferInfo(std::string_view name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
@@ -122,6 +138,9 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Vertex and pixel shader binds go through this when set
+	static RenderStateCache* StateCache;
+
 protected:
 	
 	bool shaderValid;
@@ -136,10 +155,10 @@ protected:
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	SimpleNameTable<SimpleConstantBuffer*> cbTable;
+	SimpleNameTable<SimpleShaderVariable> varTable;
+	SimpleNameTable<SimpleSRV*> textureTable;
+	SimpleNameTable<SimpleSampler*> samplerTable;
 
 	// Initialization method
 	bool LoadShaderFile(LPCWSTR shaderFile);
@@ -151,8 +170,8 @@ protected:
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(std::string_view name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(std::string_view name);
 
 	// Error logging
 	void Log(std::string message, WORD color);
@@ -178,8 +197,8 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -201,8 +220,8 @@ public:
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
@@ -221,8 +240,8 @@ public:
 	~SimpleDomainShader();
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
@@ -241,8 +260,8 @@ public:
 	~SimpleHullShader();
 	Microsoft::WRL::ComPtr<ID3D11HullShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
@@ -261,8 +280,8 @@ public:
 	~SimpleGeometryShader();
 	Microsoft::WRL::ComPtr<ID3D11GeometryShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -300,17 +319,17 @@ public:
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool HasUnorderedAccessView(std::string name);
+	bool HasUnorderedAccessView(std::string_view name);
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
-	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetUnorderedAccessView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
-	int GetUnorderedAccessViewIndex(std::string name);
+	int GetUnorderedAccessViewIndex(std::string_view name);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11ComputeShader> shader;
-	std::unordered_map<std::string, unsigned int> uavTable;
+	SimpleNameTable<unsigned int> uavTable;
 
 	unsigned int threadsX;
 	unsigned int threadsY;
@@ -0,0 +1,164 @@
+#include "SimulationState.h"
+
+#include <cstring>
+
+#include "Camera.h"
+
+SimulationState::SimulationState(World* world, HandlePool<Camera>* cameras, HandlePool<Light>* lights, IMaterialStateSource* materials, Handle<Camera>* activeCamera, float* motionTime) :
+	world(world),
+	cameras(cameras),
+	lights(lights),
+	materials(materials),
+	activeCamera(activeCamera),
+	motionTime(motionTime),
+	transformQuery(world)
+{
+}
+
+/// <summary>
+/// Writes the current state into snapshot, reusing its memory
+/// </summary>
+void SimulationState::Capture(uint32_t frame, std::vector<unsigned char>& snapshot)
+{
+	SnapshotHeader header = {};
+	header.Magic = SIMULATION_SNAPSHOT_MAGIC;
+	header.Version = SIMULATION_SNAPSHOT_VERSION;
+	header.Frame = frame;
+	header.StructuralVersion = world->GetStructuralVersion();
+	header.EntityCount = (uint32_t)transformQuery.Count();
+	header.CameraCount = (uint32_t)cameras->GetCount();
+	header.LightCount = (uint32_t)lights->GetCount();
+	header.MaterialCount = (uint32_t)materials->GetMaterialCount();
+	header.ActiveCameraIndex = activeCamera->Index;
+	header.ActiveCameraGeneration = activeCamera->Generation;
+	header.MotionTime = *motionTime;
+
+	snapshot.resize(sizeof(SnapshotHeader)
+		+ header.EntityCount * sizeof(EntityState)
+		+ header.CameraCount * sizeof(CameraState)
+		+ header.LightCount * sizeof(Light)
+		+ header.MaterialCount * sizeof(MaterialState));
+	unsigned char* write = snapshot.data();
+
+	std::memcpy(write, &header, sizeof(header));
+	write += sizeof(header);
+
+	transformQuery.ForEach([&write](Entity entity, Transform& transform)
+		{
+			EntityState state = { entity, transform.GetPosition(), transform.GetRotation(), transform.GetScale() };
+			std::memcpy(write, &state, sizeof(state));
+			write += sizeof(state);
+		});
+
+	for (Camera& camera : *cameras)
+	{
+		CameraState state = { camera.GetTransform()->GetPosition(), camera.GetTransform()->GetRotation() };
+		std::memcpy(write, &state, sizeof(state));
+		write += sizeof(state);
+	}
+
+	std::memcpy(write, lights->GetData(), header.LightCount * sizeof(Light));
+	write += header.LightCount * sizeof(Light);
+
+	for (uint32_t i = 0; i < header.MaterialCount; i++)
+	{
+		MaterialState state = materials->GetMaterialState((int)i);
+		std::memcpy(write, &state, sizeof(state));
+		write += sizeof(state);
+	}
+}
+
+/// <summary>
+/// Puts back everything a snapshot holds. Entities that have since been destroyed are
+/// skipped, and pools that have grown or shrunk only get their first entries restored.
+/// </summary>
+bool SimulationState::Restore(const std::vector<unsigned char>& snapshot)
+{
+	if (snapshot.size() < sizeof(SnapshotHeader))
+	{
+		return false;
+	}
+
+	SnapshotHeader header;
+	std::memcpy(&header, snapshot.data(), sizeof(header));
+	size_t expectedSize = sizeof(SnapshotHeader)
+		+ (size_t)header.EntityCount * sizeof(EntityState)
+		+ (size_t)header.CameraCount * sizeof(CameraState)
+		+ (size_t)header.LightCount * sizeof(Light)
+		+ (size_t)header.MaterialCount * sizeof(MaterialState);
+	if (header.Magic != SIMULATION_SNAPSHOT_MAGIC || header.Version != SIMULATION_SNAPSHOT_VERSION || snapshot.size() != expectedSize)
+	{
+		return false;
+	}
+
+	const unsigned char* read = snapshot.data() + sizeof(header);
+	const EntityState* entities = reinterpret_cast<const EntityState*>(read);
+
+	auto apply = [](Transform& transform, const EntityState& state)
+	{
+		transform.SetPosition(state.Position);
+		transform.SetRotation(state.Rotation);
+		transform.SetScale(state.Scale);
+	};
+
+	//Same structure means the rows line up, so skip the id lookups
+	if (header.StructuralVersion == world->GetStructuralVersion() && header.EntityCount == (uint32_t)transformQuery.Count())
+	{
+		uint32_t next = 0;
+		transformQuery.ForEach([&](Entity, Transform& transform)
+			{
+				apply(transform, entities[next++]);
+			});
+	}
+	else
+	{
+		for (uint32_t i = 0; i < header.EntityCount; i++)
+		{
+			Transform* transform = world->GetComponent<Transform>(entities[i].Id);
+			if (transform)
+			{
+				apply(*transform, entities[i]);
+			}
+		}
+	}
+	read += header.EntityCount * sizeof(EntityState);
+
+	const CameraState* cameraStates = reinterpret_cast<const CameraState*>(read);
+	for (uint32_t i = 0; i < header.CameraCount && i < (uint32_t)cameras->GetCount(); i++)
+	{
+		Camera& camera = cameras->GetData()[i];
+		camera.GetTransform()->SetPosition(cameraStates[i].Position);
+		camera.GetTransform()->SetRotation(cameraStates[i].Rotation);
+		camera.UpdateViewMatrix();
+	}
+	read += header.CameraCount * sizeof(CameraState);
+
+	uint32_t lightCount = header.LightCount < (uint32_t)lights->GetCount() ? header.LightCount : (uint32_t)lights->GetCount();
+	std::memcpy(lights->GetData(), read, lightCount * sizeof(Light));
+	read += header.LightCount * sizeof(Light);
+
+	const MaterialState* materialStates = reinterpret_cast<const MaterialState*>(read);
+	for (uint32_t i = 0; i < header.MaterialCount && i < (uint32_t)materials->GetMaterialCount(); i++)
+	{
+		materials->SetMaterialState((int)i, materialStates[i]);
+	}
+
+	Handle<Camera> active = { header.ActiveCameraIndex, header.ActiveCameraGeneration };
+	if (cameras->IsValid(active))
+	{
+		*activeCamera = active;
+	}
+	*motionTime = header.MotionTime;
+	return true;
+}
+
+uint64_t SimulationState::Hash(const std::vector<unsigned char>& snapshot)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char byte : snapshot)
+	{
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
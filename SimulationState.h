@@ -0,0 +1,107 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "ECS.h"
+#include "Handle.h"
+#include "Lights.h"
+#include "Transform.h"
+
+class Camera;
+
+#define SIMULATION_SNAPSHOT_MAGIC 0x50414E53u //"SNAP"
+#define SIMULATION_SNAPSHOT_VERSION 2 //Bumped whenever the layout changes, other versions are rejected
+
+// --------------------------------------------------------
+// Snapshot layout: this header, then EntityCount
+// EntityState, CameraCount CameraState, LightCount Light
+// and MaterialCount MaterialState back to back. Everything
+// is plain 4 byte fields with no padding, so a snapshot is
+// one memcpy-able block and equal state hashes equal.
+// --------------------------------------------------------
+struct SnapshotHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Frame;
+	uint32_t StructuralVersion; //Same version means entities are still in the same rows
+	uint32_t EntityCount;
+	uint32_t CameraCount;
+	uint32_t LightCount;
+	uint32_t MaterialCount;
+	uint32_t ActiveCameraIndex;
+	uint32_t ActiveCameraGeneration;
+	float MotionTime; //Where every Motion component is along its path
+};
+
+struct EntityState
+{
+	Entity Id;
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Rotation;
+	DirectX::XMFLOAT3 Scale;
+};
+
+struct CameraState
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Rotation;
+};
+
+struct MaterialState
+{
+	DirectX::XMFLOAT4 ColorTint;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+	float Roughness;
+};
+
+// --------------------------------------------------------
+// Where snapshots read and write material parameters.
+// Materials drag in the shader headers and D3D, so they're
+// reached through this instead and SimulationState builds
+// without them. MaterialPoolState covers a HandlePool.
+// --------------------------------------------------------
+class IMaterialStateSource
+{
+public:
+	virtual ~IMaterialStateSource() = default;
+
+	virtual int GetMaterialCount() = 0;
+	virtual MaterialState GetMaterialState(int index) = 0;
+	virtual void SetMaterialState(int index, const MaterialState& state) = 0;
+};
+
+// --------------------------------------------------------
+// Captures and restores everything the simulation can
+// change: entity transforms, cameras, lights, material
+// parameters and the motion clock. Matrices and bounds are
+// left out, restoring goes through the setters so they get
+// rebuilt as usual.
+//
+// Cameras, lights and materials are matched by pool order,
+// entities by id (or just by row when the structure hasn't
+// changed since the capture).
+// --------------------------------------------------------
+class SimulationState
+{
+public:
+	SimulationState(World* world, HandlePool<Camera>* cameras, HandlePool<Light>* lights, IMaterialStateSource* materials, Handle<Camera>* activeCamera, float* motionTime);
+
+	void Capture(uint32_t frame, std::vector<unsigned char>& snapshot);
+	bool Restore(const std::vector<unsigned char>& snapshot); //False if the snapshot is malformed
+
+	//FNV-1a over the whole snapshot
+	static uint64_t Hash(const std::vector<unsigned char>& snapshot);
+
+private:
+	World* world;
+	HandlePool<Camera>* cameras;
+	HandlePool<Light>* lights;
+	IMaterialStateSource* materials;
+	Handle<Camera>* activeCamera;
+	float* motionTime;
+	Query<Transform> transformQuery;
+};
@@ -123,8 +123,8 @@ void Sky::CreateRenderStates()
 void Sky::Draw(Camera* camera)
 {
     // Set render states
-    Graphics::Context->RSSetState(m_rasterizerState.Get());
-    Graphics::Context->OMSetDepthStencilState(m_depthStencilState.Get(), 0);
+    Graphics::StateCache.SetRasterizerState(m_rasterizerState.Get());
+    Graphics::StateCache.SetDepthStencilState(m_depthStencilState.Get(), 0);
 
     // Prepare the sky shaders
     m_vertexShader->SetShader();
@@ -142,8 +142,4 @@ void Sky::Draw(Camera* camera)
 
     // Draw the sky mesh
     m_skyMesh->Draw();
-
-    // Reset render states
-    Graphics::Context->RSSetState(nullptr);
-    Graphics::Context->OMSetDepthStencilState(nullptr, 0);
 }
\ No newline at end of file
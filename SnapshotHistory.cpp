@@ -0,0 +1,156 @@
+#include "SnapshotHistory.h"
+
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	void AppendWord(std::vector<unsigned char>& buffer, uint32_t value)
+	{
+		size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(uint32_t));
+		std::memcpy(&buffer[offset], &value, sizeof(uint32_t));
+	}
+
+	uint32_t ReadWord(const unsigned char* data, size_t wordIndex)
+	{
+		uint32_t value;
+		std::memcpy(&value, data + wordIndex * sizeof(uint32_t), sizeof(uint32_t));
+		return value;
+	}
+}
+
+SnapshotHistory::SnapshotHistory(int capacity) : entries(capacity < 1 ? 1 : capacity), newest(-1), count(0)
+{
+}
+
+/// <summary>
+/// Stores a new newest snapshot and turns the previous newest into a delta against it
+/// </summary>
+void SnapshotHistory::Push(uint32_t frame, const std::vector<unsigned char>& snapshot)
+{
+	int capacity = (int)entries.size();
+	if (count > 0 && capacity > 1)
+	{
+		Entry& previous = entries[newest];
+		EncodeDelta(previous.Data, snapshot, scratch);
+		std::swap(previous.Data, scratch);
+	}
+
+	newest = (newest + 1) % capacity;
+	entries[newest].Frame = frame;
+	entries[newest].Data.assign(snapshot.begin(), snapshot.end());
+	if (count < capacity)
+	{
+		count++;
+	}
+}
+
+/// <summary>
+/// Rebuilds a snapshot by walking back from the newest one
+/// </summary>
+bool SnapshotHistory::Get(uint32_t frame, std::vector<unsigned char>& snapshot)
+{
+	int capacity = (int)entries.size();
+	for (int back = 0; back < count; back++)
+	{
+		if (entries[(newest - back + capacity) % capacity].Frame != frame)
+		{
+			continue;
+		}
+
+		scratch2.assign(entries[newest].Data.begin(), entries[newest].Data.end());
+		for (int step = 1; step <= back; step++)
+		{
+			const Entry& older = entries[(newest - step + capacity) % capacity];
+			ApplyDelta(older.Data, scratch2, snapshot);
+			std::swap(snapshot, scratch2);
+		}
+		snapshot.assign(scratch2.begin(), scratch2.end());
+		return true;
+	}
+	return false;
+}
+
+void SnapshotHistory::Clear()
+{
+	newest = -1;
+	count = 0;
+}
+
+uint32_t SnapshotHistory::GetNewestFrame()
+{
+	return count > 0 ? entries[newest].Frame : 0;
+}
+
+uint32_t SnapshotHistory::GetOldestFrame()
+{
+	int capacity = (int)entries.size();
+	return count > 0 ? entries[(newest - count + 1 + capacity) % capacity].Frame : 0;
+}
+
+size_t SnapshotHistory::GetMemoryUsed()
+{
+	size_t bytes = 0;
+	int capacity = (int)entries.size();
+	for (int back = 0; back < count; back++)
+	{
+		bytes += entries[(newest - back + capacity) % capacity].Data.size();
+	}
+	return bytes;
+}
+
+/// <summary>
+/// Writes what it takes to turn base into target:
+/// [target words] then repeated [unchanged words][changed words][the changed words...]
+/// </summary>
+void SnapshotHistory::EncodeDelta(const std::vector<unsigned char>& target, const std::vector<unsigned char>& base, std::vector<unsigned char>& delta)
+{
+	size_t targetWords = target.size() / sizeof(uint32_t);
+	size_t baseWords = base.size() / sizeof(uint32_t);
+
+	delta.clear();
+	AppendWord(delta, (uint32_t)targetWords);
+
+	size_t word = 0;
+	while (word < targetWords)
+	{
+		size_t skipStart = word;
+		while (word < targetWords && word < baseWords && ReadWord(target.data(), word) == ReadWord(base.data(), word))
+		{
+			word++;
+		}
+
+		size_t copyStart = word;
+		while (word < targetWords && (word >= baseWords || ReadWord(target.data(), word) != ReadWord(base.data(), word)))
+		{
+			word++;
+		}
+
+		AppendWord(delta, (uint32_t)(copyStart - skipStart));
+		AppendWord(delta, (uint32_t)(word - copyStart));
+		size_t offset = delta.size();
+		delta.resize(offset + (word - copyStart) * sizeof(uint32_t));
+		std::memcpy(&delta[offset], target.data() + copyStart * sizeof(uint32_t), (word - copyStart) * sizeof(uint32_t));
+	}
+}
+
+void SnapshotHistory::ApplyDelta(const std::vector<unsigned char>& delta, const std::vector<unsigned char>& base, std::vector<unsigned char>& target)
+{
+	size_t targetWords = ReadWord(delta.data(), 0);
+	target.resize(targetWords * sizeof(uint32_t));
+
+	size_t read = 1;
+	size_t word = 0;
+	while (word < targetWords)
+	{
+		size_t skip = ReadWord(delta.data(), read++);
+		size_t copy = ReadWord(delta.data(), read++);
+
+		std::memcpy(target.data() + word * sizeof(uint32_t), base.data() + word * sizeof(uint32_t), skip * sizeof(uint32_t));
+		word += skip;
+		std::memcpy(target.data() + word * sizeof(uint32_t), delta.data() + read * sizeof(uint32_t), copy * sizeof(uint32_t));
+		word += copy;
+		read += copy;
+	}
+}
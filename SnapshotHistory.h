@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Ring buffer of the last N snapshots
+//
+// Only the newest snapshot is stored whole. Every older one
+// is a backward delta against the one after it, so pushing
+// never has to rebuild anything, dropping the oldest is
+// free, and going back k frames applies k deltas. Deltas
+// are word granular runs of (unchanged, changed) words, so
+// snapshots need to be a multiple of 4 bytes.
+//
+// Buffers are reused once the ring is full, so steady state
+// pushes don't allocate.
+// --------------------------------------------------------
+class SnapshotHistory
+{
+public:
+	SnapshotHistory(int capacity);
+
+	void Push(uint32_t frame, const std::vector<unsigned char>& snapshot);
+	bool Get(uint32_t frame, std::vector<unsigned char>& snapshot); //False if the frame has left the ring
+	void Clear();
+
+	//Getters
+	int GetCount() { return count; }
+	int GetCapacity() { return (int)entries.size(); }
+	uint32_t GetNewestFrame();
+	uint32_t GetOldestFrame();
+	size_t GetMemoryUsed(); //Bytes actually holding snapshot data
+
+	//Delta helpers, public so snapshots can be diffed outside the ring too
+	static void EncodeDelta(const std::vector<unsigned char>& target, const std::vector<unsigned char>& base, std::vector<unsigned char>& delta);
+	static void ApplyDelta(const std::vector<unsigned char>& delta, const std::vector<unsigned char>& base, std::vector<unsigned char>& target);
+
+private:
+	struct Entry
+	{
+		uint32_t Frame;
+		std::vector<unsigned char> Data;
+	};
+
+	std::vector<Entry> entries;
+	int newest;
+	int count;
+
+	//Reused by Push and Get
+	std::vector<unsigned char> scratch;
+	std::vector<unsigned char> scratch2;
+};
@@ -0,0 +1,190 @@
+#include "SpatialHashGrid.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+SpatialHashGrid::SpatialHashGrid(float cellSize) :
+	cellSize(cellSize),
+	inverseCellSize(1.0f / cellSize),
+	pointCount(0),
+	tableSize(HASH_GRID_MIN_TABLE)
+{
+	cellStart.assign(tableSize, 0);
+	cellCount.assign(tableSize, 0);
+}
+
+/// <summary>
+/// Parallel counting sort in three passes: each block of points counts its
+/// own buckets, a prefix sum turns the counts into write offsets, then each
+/// block scatters its points. Blocks never share a counter, so no atomics.
+/// </summary>
+void SpatialHashGrid::Build(const DirectX::XMFLOAT3* positions, int count, JobSystem* jobSystem)
+{
+	pointCount = count;
+
+	//Roughly two points per bucket, rounded up to a power of 2
+	tableSize = HASH_GRID_MIN_TABLE;
+	while (tableSize < count / 2 && tableSize < HASH_GRID_MAX_TABLE)
+	{
+		tableSize <<= 1;
+	}
+
+	int blockCount = jobSystem ? (int)jobSystem->GetThreadCount() : 1;
+	if (blockCount > HASH_GRID_MAX_BLOCKS)
+	{
+		blockCount = HASH_GRID_MAX_BLOCKS;
+	}
+	int blockSize = (count + blockCount - 1) / blockCount;
+
+	bucketOfPoint.resize(count);
+	histograms.assign((size_t)blockCount * tableSize, 0);
+	sortedIds.resize(count);
+	sortedPositions.resize(count);
+	cellStart.resize(tableSize);
+	cellCount.assign(tableSize, 0);
+
+	//Runs function(block) for every block, spread across the workers when there are any
+	auto forEachBlock = [&](auto function)
+	{
+		if (jobSystem == nullptr || blockCount == 1)
+		{
+			for (int block = 0; block < blockCount; block++)
+			{
+				function(block);
+			}
+			return;
+		}
+
+		JobCounter counter;
+		jobSystem->ParallelFor(blockCount, [&function](int start, int end)
+			{
+				for (int block = start; block < end; block++)
+				{
+					function(block);
+				}
+			}, &counter);
+		jobSystem->Wait(&counter);
+	};
+
+	//Pass 1: hash every point and count per block
+	forEachBlock([&](int block)
+		{
+			int* histogram = &histograms[(size_t)block * tableSize];
+			int end = (block + 1) * blockSize < count ? (block + 1) * blockSize : count;
+			for (int i = block * blockSize; i < end; i++)
+			{
+				int bucket = HashCell(QuantizeAxis(positions[i].x), QuantizeAxis(positions[i].y), QuantizeAxis(positions[i].z));
+				bucketOfPoint[i] = bucket;
+				histogram[bucket]++;
+			}
+		});
+
+	//Pass 2: bucket major prefix sum, so each block gets its own slice of every bucket
+	int running = 0;
+	for (int bucket = 0; bucket < tableSize; bucket++)
+	{
+		cellStart[bucket] = running;
+		for (int block = 0; block < blockCount; block++)
+		{
+			int& slot = histograms[(size_t)block * tableSize + bucket];
+			int blockBucketCount = slot;
+			slot = running;
+			running += blockBucketCount;
+		}
+		cellCount[bucket] = running - cellStart[bucket];
+	}
+
+	//Pass 3: scatter, keeping the original order inside each bucket
+	forEachBlock([&](int block)
+		{
+			int* offsets = &histograms[(size_t)block * tableSize];
+			int end = (block + 1) * blockSize < count ? (block + 1) * blockSize : count;
+			for (int i = block * blockSize; i < end; i++)
+			{
+				int destination = offsets[bucketOfPoint[i]]++;
+				sortedIds[destination] = i;
+				sortedPositions[destination] = positions[i];
+			}
+		});
+}
+
+void SpatialHashGrid::QueryRadius(DirectX::XMFLOAT3 center, float radius, std::vector<int>& results)
+{
+	if (pointCount == 0)
+	{
+		return;
+	}
+
+	int minX = QuantizeAxis(center.x - radius), maxX = QuantizeAxis(center.x + radius);
+	int minY = QuantizeAxis(center.y - radius), maxY = QuantizeAxis(center.y + radius);
+	int minZ = QuantizeAxis(center.z - radius), maxZ = QuantizeAxis(center.z + radius);
+	float radiusSquared = radius * radius;
+
+	visitedBuckets.clear();
+	for (int z = minZ; z <= maxZ; z++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				int bucket = HashCell(x, y, z);
+
+				//Cells that collide into the same bucket would report its points twice
+				bool visited = false;
+				for (int seen : visitedBuckets)
+				{
+					if (seen == bucket)
+					{
+						visited = true;
+						break;
+					}
+				}
+				if (visited)
+				{
+					continue;
+				}
+				visitedBuckets.push_back(bucket);
+
+				int end = cellStart[bucket] + cellCount[bucket];
+				for (int i = cellStart[bucket]; i < end; i++)
+				{
+					float dx = sortedPositions[i].x - center.x;
+					float dy = sortedPositions[i].y - center.y;
+					float dz = sortedPositions[i].z - center.z;
+					if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+					{
+						results.push_back(sortedIds[i]);
+					}
+				}
+			}
+		}
+	}
+}
+
+int SpatialHashGrid::GetPointCount()
+{
+	return pointCount;
+}
+
+int SpatialHashGrid::GetTableSize()
+{
+	return tableSize;
+}
+
+float SpatialHashGrid::GetCellSize()
+{
+	return cellSize;
+}
+
+int SpatialHashGrid::HashCell(int x, int y, int z)
+{
+	//Large primes from Teschner et al., "Optimized Spatial Hashing for Collision Detection"
+	unsigned int hash = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+	return (int)(hash & (unsigned int)(tableSize - 1));
+}
+
+int SpatialHashGrid::QuantizeAxis(float value)
+{
+	return (int)floorf(value * inverseCellSize);
+}
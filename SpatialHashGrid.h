@@ -0,0 +1,62 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "JobSystem.h"
+
+#define HASH_GRID_MIN_TABLE 1024
+#define HASH_GRID_MAX_TABLE (1 << 20)
+#define HASH_GRID_MAX_BLOCKS 8 //Histograms per build, one per thread up to this many
+
+// --------------------------------------------------------
+// Uniform grid of points, hashed into a fixed size table
+//
+// Meant for lots of small things that move every frame.
+// Instead of updating a structure, the whole grid is
+// rebuilt each frame with a counting sort: points are
+// bucketed by the hash of their cell, so every bucket ends
+// up as one contiguous run (cellStart / cellCount) of the
+// sorted point arrays.
+//
+// Different cells can share a bucket, so queries always do
+// the real distance test.
+// --------------------------------------------------------
+class SpatialHashGrid
+{
+public:
+	SpatialHashGrid(float cellSize);
+
+	//Rebuilds from scratch. Ids are the point's index in the positions array.
+	void Build(const DirectX::XMFLOAT3* positions, int count, JobSystem* jobSystem = nullptr);
+
+	//Appends the ids of every point within radius of center
+	void QueryRadius(DirectX::XMFLOAT3 center, float radius, std::vector<int>& results);
+
+	//Getters
+	int GetPointCount();
+	int GetTableSize();
+	float GetCellSize();
+
+private:
+	float cellSize;
+	float inverseCellSize;
+	int pointCount;
+	int tableSize;
+
+	//Per bucket runs into the sorted arrays
+	std::vector<int> cellStart;
+	std::vector<int> cellCount;
+
+	//Points in bucket order, positions copied so queries stay in cache
+	std::vector<int> sortedIds;
+	std::vector<DirectX::XMFLOAT3> sortedPositions;
+
+	//Build scratch, kept around so rebuilding doesn't allocate
+	std::vector<int> bucketOfPoint;
+	std::vector<int> histograms; //[block][bucket]
+	std::vector<int> visitedBuckets;
+
+	int HashCell(int x, int y, int z);
+	int QuantizeAxis(float value);
+};
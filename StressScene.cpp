@@ -0,0 +1,368 @@
+#include "StressScene.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//Every model the stress scene can pick from, roughly cheapest last
+	const char* stressMeshes[] =
+	{
+		"Assets/Models/sphere.obj",
+		"Assets/Models/cube.obj",
+		"Assets/Models/cylinder.obj",
+		"Assets/Models/helix.obj",
+		"Assets/Models/torus.obj",
+		"Assets/Models/TopHat.obj",
+		"Assets/Models/quad_double_sided.obj",
+		"Assets/Models/quad.obj",
+	};
+
+	//Each model's coarser stand in, an earlier entry in stressMeshes. There are no simplified models to
+	//use, so LODs fall back on the cheaper shapes, which is plenty to exercise switching.
+	const uint32_t stressMeshLods[] = { SCENE_NO_INDEX, SCENE_NO_INDEX, 1, 2, 2, 2, SCENE_NO_INDEX, SCENE_NO_INDEX };
+
+	const char* stressTextures[] =
+	{
+		"Assets/Textures/BrickTexture.png",
+		"Assets/Textures/OakTexture.png",
+		"Assets/Textures/BrokenWallTexture.png",
+		"Assets/Textures/CobblestoneTexture.png",
+	};
+
+	//Small and fast, and unlike the std engines its sequence is the same on every platform
+	struct StressRandom
+	{
+		uint32_t state;
+
+		uint32_t Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		float Range(float min, float max)
+		{
+			return min + (max - min) * (float)(Next() >> 8) / (float)(1 << 24);
+		}
+
+		uint32_t Below(uint32_t count)
+		{
+			return (uint32_t)(((uint64_t)Next() * count) >> 32);
+		}
+	};
+
+	void AddWall(SceneBuilder& builder, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, uint32_t mesh, uint32_t material)
+	{
+		SceneEntity wall = {};
+		wall.Position = DirectX::XMFLOAT3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+		wall.Scale = DirectX::XMFLOAT3(max.x - min.x, max.y - min.y, max.z - min.z);
+		wall.Mesh = mesh;
+		wall.Material = material;
+		wall.Parent = SCENE_NO_INDEX;
+		wall.Flags = SCENE_ENTITY_OCCLUDER;
+		builder.AddEntity(wall);
+	}
+
+	//A rooms x rooms grid of cells centred on the origin, floor at zero. Every wall between two
+	//rooms has a doorway in the middle with a portal across it, the outside walls are solid.
+	//Walls straddle the cell boundaries, so they belong to no cell and are never hidden by one.
+	//They're occluders too, the best there are indoors.
+	void BuildRooms(SceneBuilder& builder, int rooms, float width, float height, uint32_t mesh, uint32_t material)
+	{
+		const float thickness = 0.25f;
+		float doorWidth = width * 0.3f;
+		float doorHeight = height * 0.75f;
+		float origin = -0.5f * width * rooms;
+
+		for (int z = 0; z < rooms; z++)
+		{
+			for (int x = 0; x < rooms; x++)
+			{
+				SceneCell cell = {};
+				cell.Min = DirectX::XMFLOAT3(origin + x * width, 0.0f, origin + z * width);
+				cell.Max = DirectX::XMFLOAT3(cell.Min.x + width, height, cell.Min.z + width);
+				builder.AddCell(cell);
+			}
+		}
+
+		//First the walls running along x, a line of them on every boundary between rows, then the ones along z
+		for (int axis = 0; axis < 2; axis++)
+		{
+			for (int line = 0; line <= rooms; line++)
+			{
+				float across = origin + line * width;
+				for (int run = 0; run < rooms; run++)
+				{
+					float start = origin + run * width;
+					float middle = start + width * 0.5f;
+
+					//Along and across are x and z for the first axis, swapped for the second
+					auto wall = [&](float alongMin, float alongMax, float bottom, float top)
+					{
+						DirectX::XMFLOAT3 min = axis == 0 ? DirectX::XMFLOAT3(alongMin, bottom, across - thickness * 0.5f) : DirectX::XMFLOAT3(across - thickness * 0.5f, bottom, alongMin);
+						DirectX::XMFLOAT3 max = axis == 0 ? DirectX::XMFLOAT3(alongMax, top, across + thickness * 0.5f) : DirectX::XMFLOAT3(across + thickness * 0.5f, top, alongMax);
+						AddWall(builder, min, max, mesh, material);
+					};
+
+					if (line == 0 || line == rooms)
+					{
+						wall(start, start + width, 0.0f, height);
+						continue;
+					}
+					wall(start, middle - doorWidth * 0.5f, 0.0f, height);
+					wall(middle + doorWidth * 0.5f, start + width, 0.0f, height);
+					wall(middle - doorWidth * 0.5f, middle + doorWidth * 0.5f, doorHeight, height);
+
+					ScenePortal portal = {};
+					portal.Cells[0] = axis == 0 ? (line - 1) * rooms + run : run * rooms + line - 1;
+					portal.Cells[1] = axis == 0 ? line * rooms + run : run * rooms + line;
+					portal.VertexCount = 4;
+					for (int corner = 0; corner < 4; corner++)
+					{
+						float along = middle + ((corner == 1 || corner == 2) ? doorWidth : -doorWidth) * 0.5f;
+						float up = corner >= 2 ? doorHeight : 0.0f;
+						portal.Vertices[corner] = axis == 0 ? DirectX::XMFLOAT3(along, up, across) : DirectX::XMFLOAT3(across, up, along);
+					}
+					builder.AddPortal(portal);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Fills the builder with a scene made from the settings
+/// </summary>
+/// <returns>False if the entity count is out of range, the builder is untouched then</returns>
+bool BuildStressScene(const StressSceneSettings& settings, SceneBuilder& builder, std::string& error)
+{
+	if (settings.EntityCount < 0 || settings.EntityCount > STRESS_SCENE_MAX_ENTITIES)
+	{
+		error = "entity count has to be between 0 and " + std::to_string(STRESS_SCENE_MAX_ENTITIES);
+		return false;
+	}
+	if (settings.CameraCount < 1)
+	{
+		error = "there has to be at least one camera";
+		return false;
+	}
+	if (settings.OccluderCount < 0 || settings.OccluderCount > STRESS_SCENE_MAX_OCCLUDERS)
+	{
+		error = "occluder count has to be between 0 and " + std::to_string(STRESS_SCENE_MAX_OCCLUDERS);
+		return false;
+	}
+	if (settings.Rooms < 0 || settings.Rooms > STRESS_SCENE_MAX_ROOMS)
+	{
+		error = "rooms has to be between 0 and " + std::to_string(STRESS_SCENE_MAX_ROOMS);
+		return false;
+	}
+	if (settings.HierarchyDepth < 1 || settings.HierarchyDepth > STRESS_SCENE_MAX_DEPTH)
+	{
+		error = "hierarchy depth has to be between 1 and " + std::to_string(STRESS_SCENE_MAX_DEPTH);
+		return false;
+	}
+	if (settings.HierarchyDepth > 1 && settings.Rooms > 0)
+	{
+		error = "hierarchy depth only works in the open cube, not with rooms";
+		return false;
+	}
+
+	//Zero would get stuck at zero forever
+	StressRandom random{ settings.Seed ? settings.Seed : 1u };
+
+	int meshCount = std::clamp(settings.MeshVariety, 1, (int)(sizeof(stressMeshes) / sizeof(stressMeshes[0])));
+	for (int i = 0; i < meshCount; i++)
+	{
+		builder.AddMesh(stressMeshes[i], settings.UseLods ? stressMeshLods[i] : SCENE_NO_INDEX);
+	}
+
+	//Walls are stretched cubes, which are only in the list above from two meshes up
+	uint32_t wallMesh = meshCount > 1 ? 1 : (settings.OccluderCount > 0 || settings.Rooms > 0 ? builder.AddMesh(stressMeshes[1]) : 0);
+
+	uint32_t textures[sizeof(stressTextures) / sizeof(stressTextures[0])];
+	int textureCount = (int)(sizeof(stressTextures) / sizeof(stressTextures[0]));
+	for (int i = 0; i < textureCount; i++)
+	{
+		textures[i] = builder.AddTexture(stressTextures[i]);
+	}
+	uint32_t cobblestoneNormals = builder.AddTexture("Assets/NormalMaps/cobblestone_normals.png");
+
+	uint32_t vertexShader = builder.AddShader("VertexShader.cso", SCENE_SHADER_VERTEX);
+	uint32_t pixelShader = builder.AddShader("PixelShader.cso", SCENE_SHADER_PIXEL);
+	uint32_t multiTexturePixelShader = builder.AddShader("MultiTexturePixelShader.cso", SCENE_SHADER_PIXEL);
+
+	//Cycle through the textures and shaders so every material really is different state to bind
+	int materialCount = std::max(settings.MaterialVariety, 1);
+	for (int i = 0; i < materialCount; i++)
+	{
+		bool multiTexture = i % 4 == 3;
+
+		SceneMaterial material = {};
+		material.ColorTint = DirectX::XMFLOAT4(random.Range(0.5f, 1.0f), random.Range(0.5f, 1.0f), random.Range(0.5f, 1.0f), 1.0f);
+		material.UVScale = DirectX::XMFLOAT2(1, 1);
+		material.UVOffset = DirectX::XMFLOAT2(0, 0);
+		material.Roughness = random.Range(0.0f, 1.0f);
+		material.VertexShader = vertexShader;
+		material.PixelShader = multiTexture ? multiTexturePixelShader : pixelShader;
+		uint32_t index = builder.AddMaterial(material);
+
+		uint32_t surface = textures[i % textureCount];
+		builder.AddTextureBinding(index, "SurfaceTexture", surface);
+		if (multiTexture)
+		{
+			builder.AddTextureBinding(index, "SecondaryTexture", textures[(i + 1) % textureCount]);
+		}
+		builder.AddTextureBinding(index, "NormalMapTexture", surface == textures[3] ? cobblestoneNormals : SCENE_NO_INDEX);
+	}
+
+	//A cube holding every entity at roughly Spacing apart, centred on the origin
+	float spacing = std::max(settings.Spacing, 0.1f);
+	float halfSize = 0.5f * spacing * std::cbrt((float)std::max(settings.EntityCount, 1));
+
+	//Or the same density in rooms twice as wide as they are tall, the whole level centred on the origin.
+	//Entities keep a metre off the walls, so each one sits wholly inside its room's cell.
+	int rooms = settings.Rooms;
+	int roomCount = rooms * rooms;
+	float roomWidth = 0;
+	float roomHeight = 0;
+	if (rooms > 0)
+	{
+		float perRoom = (float)std::max((settings.EntityCount + roomCount - 1) / roomCount, 1);
+		roomWidth = std::max(std::cbrt(2.0f * perRoom) * spacing, 6.0f);
+		roomHeight = roomWidth * 0.5f;
+		halfSize = 0.5f * roomWidth * rooms;
+	}
+	auto roomMin = [&](int room) { return DirectX::XMFLOAT3(-halfSize + (room % rooms) * roomWidth, 0.0f, -halfSize + (room / rooms) * roomWidth); };
+
+	int depth = settings.HierarchyDepth;
+	float rootScale = 1.0f;
+	for (int i = 0; i < settings.EntityCount; i++)
+	{
+		//Further down a chain everything is relative to the parent, which already carries the root's scale
+		if (i % depth != 0)
+		{
+			SceneEntity link = {};
+			float step = spacing / rootScale;
+			link.Position = DirectX::XMFLOAT3(random.Range(-step, step), random.Range(-step, step), random.Range(-step, step));
+			link.Rotation = DirectX::XMFLOAT3(0, random.Range(-0.5f, 0.5f), 0);
+			link.Scale = DirectX::XMFLOAT3(1, 1, 1);
+			link.Mesh = random.Below(meshCount);
+			link.Material = random.Below(materialCount);
+			link.Parent = (uint32_t)(i - 1);
+			builder.AddEntity(link);
+			continue;
+		}
+
+		SceneEntity entity = {};
+		if (rooms > 0)
+		{
+			DirectX::XMFLOAT3 corner = roomMin(i % roomCount);
+			entity.Position = DirectX::XMFLOAT3(corner.x + random.Range(1.0f, roomWidth - 1.0f), random.Range(1.0f, roomHeight - 1.0f), corner.z + random.Range(1.0f, roomWidth - 1.0f));
+		}
+		else
+		{
+			entity.Position = DirectX::XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+		}
+		entity.Rotation = DirectX::XMFLOAT3(random.Range(0, DirectX::XM_2PI), random.Range(0, DirectX::XM_2PI), 0);
+		float scale = random.Range(0.25f, 0.75f);
+		entity.Scale = DirectX::XMFLOAT3(scale, scale, scale);
+		rootScale = scale;
+		entity.Mesh = random.Below(meshCount);
+		entity.Material = random.Below(materialCount);
+		entity.Parent = SCENE_NO_INDEX;
+		builder.AddEntity(entity);
+	}
+
+	//Walls standing across the view of the outside camera, a few cubes tall and wide and thin enough to hide what's behind
+	for (int i = 0; i < settings.OccluderCount; i++)
+	{
+		SceneEntity wall = {};
+		wall.Position = DirectX::XMFLOAT3(random.Range(-halfSize, halfSize), random.Range(-halfSize * 0.5f, halfSize * 0.5f), random.Range(-halfSize, halfSize));
+		wall.Rotation = DirectX::XMFLOAT3(0, random.Range(-0.5f, 0.5f), 0);
+		wall.Scale = DirectX::XMFLOAT3(halfSize * 0.3f + 1.0f, halfSize * 0.3f + 1.0f, 0.25f);
+		wall.Mesh = wallMesh;
+		wall.Material = random.Below(materialCount);
+		wall.Parent = SCENE_NO_INDEX;
+		wall.Flags = SCENE_ENTITY_OCCLUDER;
+		builder.AddEntity(wall);
+	}
+
+	if (rooms > 0)
+	{
+		BuildRooms(builder, rooms, roomWidth, roomHeight, wallMesh, random.Below(materialCount));
+	}
+
+	//One sun, the rest are points spread through the volume
+	for (int i = 0; i < settings.LightCount; i++)
+	{
+		Light light = {};
+		light.Color = DirectX::XMFLOAT3(random.Range(0.25f, 1.0f), random.Range(0.25f, 1.0f), random.Range(0.25f, 1.0f));
+		light.Intensity = 1.0f;
+		if (i == 0)
+		{
+			light.Type = LIGHT_TYPE_DIRECTIONAL;
+			light.Direction = DirectX::XMFLOAT3(0.5f, -1.0f, 0.25f);
+		}
+		else
+		{
+			light.Type = LIGHT_TYPE_POINT;
+			light.Position = DirectX::XMFLOAT3(random.Range(-halfSize, halfSize), rooms > 0 ? roomHeight * 0.75f : random.Range(-halfSize, halfSize), random.Range(-halfSize, halfSize));
+			light.Range = std::max(halfSize * 0.5f, 10.0f);
+		}
+		builder.AddLight(light);
+	}
+
+	//Indoors every camera stands in the middle of a room, the first in a corner room looking down a row of doorways
+	if (rooms > 0)
+	{
+		for (int i = 0; i < settings.CameraCount; i++)
+		{
+			SceneCamera camera = {};
+			DirectX::XMFLOAT3 corner = roomMin(i * roomCount / settings.CameraCount);
+			camera.Position = DirectX::XMFLOAT3(corner.x + roomWidth * 0.5f, roomHeight * 0.5f, corner.z + roomWidth * 0.5f);
+			camera.MoveSpeed = std::max(roomWidth * 0.5f, 5.0f);
+			camera.LookSpeed = 2.0f;
+			camera.FieldOfView = DirectX::XM_PIDIV4;
+			builder.AddCamera(camera);
+		}
+		return true;
+	}
+
+	//Outside the cube looking in, and one in the middle of it
+	SceneCamera outside = {};
+	outside.Position = DirectX::XMFLOAT3(0, 0, -halfSize - 20.0f);
+	outside.MoveSpeed = std::max(halfSize * 0.25f, 10.0f);
+	outside.LookSpeed = 2.0f;
+	outside.FieldOfView = DirectX::XM_PIDIV4;
+	builder.AddCamera(outside);
+
+	if (settings.CameraCount > 1)
+	{
+		SceneCamera inside = outside;
+		inside.Position = DirectX::XMFLOAT3(0, 0, 0);
+		builder.AddCamera(inside);
+	}
+
+	//Scene cameras all start out looking down +z, so the rest just stand in different places along the front
+	for (int i = 2; i < settings.CameraCount; i++)
+	{
+		SceneCamera extra = outside;
+		float angle = DirectX::XM_2PI * (i - 2) / (settings.CameraCount - 2);
+		extra.Position = DirectX::XMFLOAT3(halfSize * std::cos(angle), halfSize * std::sin(angle), -halfSize - 20.0f);
+		builder.AddCamera(extra);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// How many entities at the front of the scene should move, from MovingPercent
+/// </summary>
+int GetStressMovingCount(const StressSceneSettings& settings)
+{
+	float percent = std::clamp(settings.MovingPercent, 0.0f, 100.0f);
+	return (int)std::lround(settings.EntityCount * percent / 100.0f);
+}
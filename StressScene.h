@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "SceneFile.h"
+
+#define STRESS_SCENE_MAX_ENTITIES 1000000
+#define STRESS_SCENE_MAX_OCCLUDERS 256
+#define STRESS_SCENE_MAX_ROOMS 32
+#define STRESS_SCENE_MAX_DEPTH 1024
+
+// --------------------------------------------------------
+// Knobs for a generated scene. Anything out of range is
+// clamped by BuildStressScene rather than rejected, except
+// the entity count.
+// --------------------------------------------------------
+struct StressSceneSettings
+{
+	int EntityCount = 10000;
+	int MeshVariety = 5; //Distinct meshes, up to the number of models in Assets/Models
+	int MaterialVariety = 8; //Distinct materials, each its own set of constants and textures
+	int LightCount = 3; //Only the first MAX_SHADER_LIGHTS reach the shaders
+	float MovingPercent = 10.0f; //Share of entities animated every frame
+	float Spacing = 2.5f; //Average distance between neighbouring entities
+	bool UseLods = true; //Chain every model to a cheaper one as its coarser LOD
+	int OccluderCount = 0; //Big flat walls flagged as occluders, added after everything else
+	int CameraCount = 2; //One outside the volume looking in, one in the middle, any more spread around the outside
+	int Rooms = 0; //Rooms along each side of an indoor level, 0 for the open cube
+	int HierarchyDepth = 1; //Entities per parent chain, 1 leaves every one a root
+	uint32_t Seed = 1;
+};
+
+// --------------------------------------------------------
+// Builds a large scene in memory from a handful of knobs
+//
+// Entities are scattered through a cube that grows with
+// the entity count, so density stays the same whatever N
+// is. The output is an ordinary SceneBuilder, so a stress
+// scene loads through exactly the same path as a hand
+// written one. The same settings always give the same
+// scene.
+//
+// With Rooms set the entities are shared out over a grid
+// of walled rooms instead, each one a portal cell with a
+// doorway into each neighbour, and the cameras start in
+// rooms rather than outside.
+//
+// With HierarchyDepth above 1 the entities come in chains
+// that long, each parented to the one before it and placed
+// a step away from it, so the chain wanders off from its
+// root. A root that moves carries its whole chain along.
+// Chains only go in the open cube, since they'd wander
+// through the walls of a room.
+//
+// Scene files have nothing to say about motion, so the
+// moving entities are always the first
+// GetStressMovingCount of them. Occluder walls come last
+// and never move.
+// --------------------------------------------------------
+bool BuildStressScene(const StressSceneSettings& settings, SceneBuilder& builder, std::string& error);
+int GetStressMovingCount(const StressSceneSettings& settings);
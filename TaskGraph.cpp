@@ -0,0 +1,233 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+TaskGraph::TaskGraph(JobSystem* jobSystem) : jobSystem(jobSystem), compiled(false), lastMilliseconds(0)
+{
+}
+
+/// <summary>
+/// Adds a stage. Reads and writes are just names, stages that share a name share data.
+/// </summary>
+/// <param name="mainThreadOnly">Stages that talk to the D3D context or ImGui need this</param>
+void TaskGraph::AddStage(std::string name, std::vector<std::string> reads, std::vector<std::string> writes, std::function<void()> function, bool mainThreadOnly)
+{
+	TaskStage stage;
+	stage.Name = name;
+	stage.Function = function;
+	stage.MainThreadOnly = mainThreadOnly;
+
+	for (const std::string& read : reads)
+	{
+		stage.Reads.push_back(GetResourceId(read));
+	}
+	for (const std::string& write : writes)
+	{
+		stage.Writes.push_back(GetResourceId(write));
+	}
+
+	stages.push_back(stage);
+	compiled = false;
+}
+
+/// <summary>
+/// Works out the dependencies between stages and groups them into levels
+/// </summary>
+void TaskGraph::Compile()
+{
+	auto overlaps = [](const std::vector<int>& a, const std::vector<int>& b)
+	{
+		for (int id : a)
+		{
+			if (std::find(b.begin(), b.end(), id) != b.end())
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	int levelCount = 0;
+	for (int j = 0; j < (int)stages.size(); j++)
+	{
+		TaskStage& stage = stages[j];
+		stage.DependsOn.clear();
+		stage.Level = 0;
+
+		//Stages added earlier that conflict with this one have to finish first
+		for (int i = 0; i < j; i++)
+		{
+			TaskStage& earlier = stages[i];
+			bool writeAfterRead = overlaps(earlier.Reads, stage.Writes);
+			bool readAfterWrite = overlaps(earlier.Writes, stage.Reads);
+			bool writeAfterWrite = overlaps(earlier.Writes, stage.Writes);
+			if (writeAfterRead || readAfterWrite || writeAfterWrite)
+			{
+				stage.DependsOn.push_back(i);
+				stage.Level = std::max(stage.Level, earlier.Level + 1);
+			}
+		}
+
+		levelCount = std::max(levelCount, stage.Level + 1);
+	}
+
+	schedule.clear();
+	schedule.resize(levelCount);
+	for (int i = 0; i < (int)stages.size(); i++)
+	{
+		schedule[stages[i].Level].push_back(i);
+	}
+
+	compiled = true;
+}
+
+/// <summary>
+/// Runs every stage once, one level at a time
+/// </summary>
+void TaskGraph::Execute()
+{
+	if (!compiled)
+	{
+		Compile();
+	}
+
+	auto frameStart = std::chrono::high_resolution_clock::now();
+
+	for (const std::vector<int>& level : schedule)
+	{
+		//Nothing to overlap with, or nowhere to overlap it
+		if (jobSystem == nullptr || level.size() == 1)
+		{
+			for (int index : level)
+			{
+				RunStage(index);
+			}
+			continue;
+		}
+
+		//Hand the free threaded stages to the workers, then do our own share
+		JobCounter levelCounter;
+		for (int index : level)
+		{
+			if (!stages[index].MainThreadOnly)
+			{
+				jobSystem->Run([this, index]() { RunStage(index); }, &levelCounter);
+			}
+		}
+		for (int index : level)
+		{
+			if (stages[index].MainThreadOnly)
+			{
+				RunStage(index);
+			}
+		}
+		jobSystem->Wait(&levelCounter);
+	}
+
+	auto frameEnd = std::chrono::high_resolution_clock::now();
+	lastMilliseconds = std::chrono::duration<float, std::milli>(frameEnd - frameStart).count();
+}
+
+/// <summary>
+/// Human readable schedule with the last measured timings
+/// </summary>
+std::string TaskGraph::DumpSchedule()
+{
+	if (!compiled)
+	{
+		Compile();
+	}
+
+	std::string result;
+	char line[256];
+	for (int level = 0; level < (int)schedule.size(); level++)
+	{
+		snprintf(line, sizeof(line), "Level %d\n", level);
+		result += line;
+
+		for (int index : schedule[level])
+		{
+			const TaskStage& stage = stages[index];
+			snprintf(line, sizeof(line), "  %-24s %8.3f ms%s\n", stage.Name.c_str(), stage.LastMilliseconds, stage.MainThreadOnly ? "  [main thread]" : "");
+			result += line;
+
+			auto appendList = [&](const char* label, const std::vector<int>& ids)
+			{
+				if (ids.empty())
+				{
+					return;
+				}
+				result += "    ";
+				result += label;
+				for (int id : ids)
+				{
+					result += " " + resourceNames[id];
+				}
+				result += "\n";
+			};
+			appendList("reads:", stage.Reads);
+			appendList("writes:", stage.Writes);
+
+			if (!stage.DependsOn.empty())
+			{
+				result += "    after:";
+				for (int dependency : stage.DependsOn)
+				{
+					result += " " + stages[dependency].Name;
+				}
+				result += "\n";
+			}
+		}
+	}
+
+	snprintf(line, sizeof(line), "Total %.3f ms\n", lastMilliseconds);
+	result += line;
+	return result;
+}
+
+int TaskGraph::GetStageCount()
+{
+	return (int)stages.size();
+}
+
+int TaskGraph::GetLevelCount()
+{
+	return (int)schedule.size();
+}
+
+const TaskStage& TaskGraph::GetStage(int index)
+{
+	return stages[index];
+}
+
+float TaskGraph::GetLastMilliseconds()
+{
+	return lastMilliseconds;
+}
+
+int TaskGraph::GetResourceId(const std::string& name)
+{
+	auto found = resourceIds.find(name);
+	if (found != resourceIds.end())
+	{
+		return found->second;
+	}
+
+	int id = (int)resourceNames.size();
+	resourceIds.insert({ name, id });
+	resourceNames.push_back(name);
+	return id;
+}
+
+void TaskGraph::RunStage(int index)
+{
+	TaskStage& stage = stages[index];
+
+	auto start = std::chrono::high_resolution_clock::now();
+	stage.Function();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	stage.LastMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// One system in the frame (input, culling, submission...)
+// along with the data it reads and writes
+// --------------------------------------------------------
+struct TaskStage
+{
+	std::string Name;
+	std::vector<int> Reads;
+	std::vector<int> Writes;
+	std::function<void()> Function;
+	bool MainThreadOnly = false;
+
+	//Filled in by Compile
+	int Level = 0;
+	std::vector<int> DependsOn;
+
+	//Filled in by Execute
+	float LastMilliseconds = 0;
+};
+
+// --------------------------------------------------------
+// Declarative per frame task graph
+//
+// Stages declare what they read and write. Compile turns
+// that into levels: everything in a level is independent
+// and can run at the same time, and each level only starts
+// once the previous one is done. When two stages touch the
+// same data, the one added first runs first.
+//
+// Nothing here knows about D3D, so a graph can be run with
+// no window at all (and with no JobSystem it runs serially).
+// --------------------------------------------------------
+class TaskGraph
+{
+public:
+	TaskGraph(JobSystem* jobSystem = nullptr);
+
+	void AddStage(std::string name, std::vector<std::string> reads, std::vector<std::string> writes, std::function<void()> function, bool mainThreadOnly = false);
+	void Compile();
+	void Execute();
+
+	//Debug helpers
+	std::string DumpSchedule();
+	int GetStageCount();
+	int GetLevelCount();
+	const TaskStage& GetStage(int index);
+	float GetLastMilliseconds();
+
+private:
+	JobSystem* jobSystem;
+	std::vector<TaskStage> stages;
+	std::unordered_map<std::string, int> resourceIds;
+	std::vector<std::string> resourceNames;
+
+	//Stage indices grouped by level
+	std::vector<std::vector<int>> schedule;
+	bool compiled;
+	float lastMilliseconds;
+
+	int GetResourceId(const std::string& name);
+	void RunStage(int index);
+};
@@ -1,10 +1,15 @@
 #include "Transform.h"
 
+#include "ChangeJournal.h"
+
 using namespace DirectX;
 
-Transform::Transform() : position(0, 0, 0), pitchYawRoll(0, 0, 0), scale(1, 1, 1), dirty(false)
+Transform::Transform() : position(0, 0, 0), pitchYawRoll(0, 0, 0), scale(1, 1, 1), dirtyFlags(TRANSFORM_DIRTY_HIERARCHY)
 {
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&localMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&localInverseTranspose, XMMatrixIdentity());
+	XMStoreFloat4x4(&hierarchyWorldMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&hierarchyInverseTranspose, XMMatrixIdentity());
 
 	up = XMFLOAT3(0, 1, 0);
 	right = XMFLOAT3(1, 0, 0);
@@ -17,13 +22,12 @@ void Transform::SetPosition(float x, float y, float z)
 	position.x = x;
 	position.y = y;
 	position.z = z;
-	dirty = true;
+	MarkDirty(TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY);
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 pos)
 {
-	position = pos;
-	dirty = true;
+	SetPosition(pos.x, pos.y, pos.z);
 }
 
 void Transform::SetPosition(float* array)
@@ -37,13 +41,12 @@ void Transform::SetRotation(float ptich, float yaw, float roll)
 	pitchYawRoll.x = ptich;
 	pitchYawRoll.y = yaw;
 	pitchYawRoll.z = roll;
-	dirty = true;
-	UpdateVectors();
+	MarkDirty(TRANSFORM_DIRTY_ALL);
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 {
-	pitchYawRoll = rotation;
+	SetRotation(rotation.x, rotation.y, rotation.z);
 }
 
 void Transform::SetRotation(float* array)
@@ -56,13 +59,12 @@ void Transform::SetScale(float x, float y, float z)
 	scale.x = x;
 	scale.y = y;
 	scale.z = z;
-	dirty = true;
-
+	MarkDirty(TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY);
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 _scale)
 {
-	scale = _scale;
+	SetScale(_scale.x, _scale.y, _scale.z);
 }
 
 void Transform::SetScale(float* array)
@@ -73,17 +75,18 @@ void Transform::SetScale(float* array)
 void Transform::MoveAbsolute(float x, float y, float z)
 {
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + XMVectorSet(x, y, z, 0));
+	MarkDirty(TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY);
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 {
-
+	MoveAbsolute(offset.x, offset.y, offset.z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
 	//Move along our "local" axes
-	
+
 	// Step 1: Create a vector
 	XMVECTOR movment = XMVectorSet(x, y, z, 0);
 
@@ -96,8 +99,7 @@ void Transform::MoveRelative(float x, float y, float z)
 
 	//Step 4: Add this rotated direction to our position
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + dir);
-	dirty = true;
-	UpdateVectors();
+	MarkDirty(TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY);
 }
 
 void Transform::Rotate(float ptich, float yaw, float roll)
@@ -105,8 +107,7 @@ void Transform::Rotate(float ptich, float yaw, float roll)
 	pitchYawRoll.x += ptich;
 	pitchYawRoll.y += yaw;
 	pitchYawRoll.z += roll;
-
-	UpdateVectors();
+	MarkDirty(TRANSFORM_DIRTY_ALL);
 }
 
 void Transform::Scale(float x, float y, float z)
@@ -114,6 +115,7 @@ void Transform::Scale(float x, float y, float z)
 	scale.x *= x;
 	scale.y *= y;
 	scale.z *= z;
+	MarkDirty(TRANSFORM_DIRTY_LOCAL | TRANSFORM_DIRTY_NORMAL | TRANSFORM_DIRTY_HIERARCHY);
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
@@ -133,19 +135,28 @@ DirectX::XMFLOAT3 Transform::GetScale()
 
 DirectX::XMFLOAT3 Transform::GetUp()
 {
+	UpdateVectors();
 	return up;
 }
+
+DirectX::XMFLOAT3 Transform::GetRight()
+{
+	UpdateVectors();
+	return right;
+}
+
 DirectX::XMFLOAT3 Transform::GetForward()
 {
+	UpdateVectors();
 	return forward;
 }
 
-DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
+DirectX::XMFLOAT4X4 Transform::GetLocalMatrix()
 {
 	//Guard clause is cleaner :)
-	if (!dirty)
+	if (!(dirtyFlags & TRANSFORM_DIRTY_LOCAL))
 	{
-		return worldMatrix;
+		return localMatrix;
 	}
 
 	//Make translation, rotation, and scale matricies
@@ -158,35 +169,122 @@ DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 
 
 
-	//World Matrix is a combo of tranlateion rotation and scale matricies
+	//Local Matrix is a combo of tranlateion rotation and scale matricies
 
-	XMMATRIX _worldMatrix = scMatrix * rotMatrix * trMatrix;
+	XMMATRIX _localMatrix = scMatrix * rotMatrix * trMatrix;
 
-	XMStoreFloat4x4(&worldMatrix, _worldMatrix);
+	XMStoreFloat4x4(&localMatrix, _localMatrix);
 
-	dirty = false;
+	dirtyFlags &= ~TRANSFORM_DIRTY_LOCAL;
 
-	UpdateVectors();
+	return localMatrix;
+}
+
+/// <summary>
+/// Inverse transpose of the local matrix, built straight from the TRS parts.
+/// (S * R * T)^-T = S^-1 * R * T^-T, so no general 4x4 inverse is needed.
+/// </summary>
+DirectX::XMFLOAT4X4 Transform::GetLocalInverseTransposeMatrix()
+{
+	if (!(dirtyFlags & TRANSFORM_DIRTY_NORMAL))
+	{
+		return localInverseTranspose;
+	}
+
+	//A zero scale axis can't be inverted, so just collapse it
+	XMFLOAT3 inverseScale(
+		scale.x != 0 ? 1.0f / scale.x : 0.0f,
+		scale.y != 0 ? 1.0f / scale.y : 0.0f,
+		scale.z != 0 ? 1.0f / scale.z : 0.0f);
+
+	XMMATRIX rotMatrix = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+	XMStoreFloat4x4(&localInverseTranspose, XMMatrixScalingFromVector(XMLoadFloat3(&inverseScale)) * rotMatrix);
+
+	//Transposing the inverse translation puts it in the last column
+	XMFLOAT4X4& m = localInverseTranspose;
+	m._14 = -(m._11 * position.x + m._12 * position.y + m._13 * position.z);
+	m._24 = -(m._21 * position.x + m._22 * position.y + m._23 * position.z);
+	m._34 = -(m._31 * position.x + m._32 * position.y + m._33 * position.z);
+
+	dirtyFlags &= ~TRANSFORM_DIRTY_NORMAL;
+
+	return localInverseTranspose;
+}
 
-	return worldMatrix;
+DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
+{
+	//Parented transforms get their world matrix from the hierarchy pass
+	if (hasParent)
+	{
+		return hierarchyWorldMatrix;
+	}
+
+	return GetLocalMatrix();
 }
 
 DirectX::XMFLOAT4X4 Transform::GetInverseTransposeMatrix()
 {
-	DirectX::XMMATRIX matrix = DirectX::XMLoadFloat4x4(&worldMatrix);
+	if (hasParent)
+	{
+		return hierarchyInverseTranspose;
+	}
 
-	// Inverse-transpose: First, invert the matrix, then transpose it
-	DirectX::XMMATRIX inverseTranspose = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, matrix));
+	return GetLocalInverseTransposeMatrix();
+}
 
-	// Store the result back into a float4x4
-	DirectX::XMFLOAT4X4 result;
-	DirectX::XMStoreFloat4x4(&result, inverseTranspose);
+unsigned int Transform::GetDirtyFlags()
+{
+	return dirtyFlags;
+}
 
-	return result;
+/// <summary>
+/// Returns true (once) if the local matrix changed since the hierarchy last looked
+/// </summary>
+bool Transform::ConsumeHierarchyDirty()
+{
+	bool wasDirty = (dirtyFlags & TRANSFORM_DIRTY_HIERARCHY) != 0;
+	dirtyFlags &= ~TRANSFORM_DIRTY_HIERARCHY;
+	return wasDirty;
+}
+
+void Transform::SetHierarchyMatrices(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 inverseTranspose)
+{
+	hierarchyWorldMatrix = world;
+	hierarchyInverseTranspose = inverseTranspose;
+	hasParent = true;
+}
+
+void Transform::ClearHierarchyWorldMatrix()
+{
+	hasParent = false;
+}
+
+/// <summary>
+/// Where to report changes from now on, nullptr once the node is gone
+/// </summary>
+void Transform::BindHierarchy(DirtyBitset* dirtyNodes, int node)
+{
+	hierarchyDirty = dirtyNodes;
+	hierarchyNode = node;
+}
+
+void Transform::MarkDirty(unsigned int flags)
+{
+	//Only the first change since the hierarchy last looked needs reporting
+	if ((flags & ~dirtyFlags & TRANSFORM_DIRTY_HIERARCHY) && hierarchyDirty != nullptr)
+	{
+		hierarchyDirty->Mark((uint32_t)hierarchyNode);
+	}
+	dirtyFlags |= flags;
 }
 
 void Transform::UpdateVectors()
 {
+	if (!(dirtyFlags & TRANSFORM_DIRTY_VECTORS))
+	{
+		return;
+	}
+
 	// Create a rotation matrix from the pitchYawRoll angles
 	XMMATRIX rotMatrix = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
 
@@ -199,4 +297,6 @@ void Transform::UpdateVectors()
 	XMStoreFloat3(&forward, XMVector3Normalize(XMLoadFloat3(&forward)));
 	XMStoreFloat3(&up, XMVector3Normalize(XMLoadFloat3(&up)));
 	XMStoreFloat3(&right, XMVector3Normalize(XMLoadFloat3(&right)));
+
+	dirtyFlags &= ~TRANSFORM_DIRTY_VECTORS;
 }
@@ -2,6 +2,15 @@
 
 #include <DirectXMath.h>
 
+class DirtyBitset;
+
+//Dirty bits, each cached output is rebuilt lazily the first time it's asked for
+#define TRANSFORM_DIRTY_LOCAL 0x1 //Local TRS matrix
+#define TRANSFORM_DIRTY_NORMAL 0x2 //Local inverse transpose
+#define TRANSFORM_DIRTY_VECTORS 0x4 //Up, right and forward
+#define TRANSFORM_DIRTY_HIERARCHY 0x8 //TransformHierarchy hasn't seen the change yet
+#define TRANSFORM_DIRTY_ALL 0xF
+
 //Header files are copy and pasted into cpp files at run time
 class Transform
 {
@@ -34,12 +43,23 @@ public:
 	DirectX::XMFLOAT3 GetScale();
 
 	DirectX::XMFLOAT3 GetUp();
+	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetForward();
 
 
+	DirectX::XMFLOAT4X4 GetLocalMatrix();
+	DirectX::XMFLOAT4X4 GetLocalInverseTransposeMatrix();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetInverseTransposeMatrix();
 
+	unsigned int GetDirtyFlags();
+
+	//Hierarchy hooks (called by TransformHierarchy)
+	bool ConsumeHierarchyDirty();
+	void SetHierarchyMatrices(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 inverseTranspose);
+	void ClearHierarchyWorldMatrix();
+	void BindHierarchy(DirtyBitset* dirtyNodes, int node);
+
 
 private:
 
@@ -55,10 +75,21 @@ private:
 	DirectX::XMFLOAT3 forward;
 
 	//Matrix
-	bool dirty;
-	DirectX::XMFLOAT4X4 worldMatrix;
+	unsigned int dirtyFlags;
+	DirectX::XMFLOAT4X4 localMatrix;
+	DirectX::XMFLOAT4X4 localInverseTranspose;
+
+	//Matrices pushed down from a parent, only valid while hasParent is set
+	bool hasParent = false;
+	DirectX::XMFLOAT4X4 hierarchyWorldMatrix;
+	DirectX::XMFLOAT4X4 hierarchyInverseTranspose;
+
+	//The hierarchy's list of changed nodes and this transform's node in it, so it never
+	//has to look at transforms that haven't changed
+	DirtyBitset* hierarchyDirty = nullptr;
+	int hierarchyNode = -1;
 
+	void MarkDirty(unsigned int flags);
 	void UpdateVectors();
-	bool vectorDirty = false;
 };
 
@@ -0,0 +1,385 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+TransformHierarchy::TransformHierarchy() : lastUpdateCount(0)
+{
+}
+
+/// <summary>
+/// Adds a transform to the graph, either as a new root or as the last child of parentNode
+/// </summary>
+/// <returns>The node id used for every other call</returns>
+int TransformHierarchy::AddNode(Transform* transform, int parentNode)
+{
+	if (parentNode >= 0 && !IsValidNode(parentNode))
+	{
+		parentNode = -1;
+	}
+
+	//Reuse an old node id if we have one
+	int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		node = (int)slotOfNode.size();
+		slotOfNode.push_back(-1);
+		dirtyNodes.Resize((uint32_t)slotOfNode.size());
+	}
+
+	//Append at the end, then slide it into its parent's subtree
+	int slot = (int)nodeOfSlot.size();
+	nodeOfSlot.push_back(node);
+	parentOfSlot.push_back(parentNode);
+	depthOfSlot.push_back(parentNode < 0 ? 0 : depthOfSlot[slotOfNode[parentNode]] + 1);
+	subtreeSize.push_back(1);
+	transforms.push_back(transform);
+	worldMatrices.push_back(transform->GetLocalMatrix());
+	inverseTransposes.push_back(transform->GetLocalInverseTransposeMatrix());
+	slotOfNode[node] = slot;
+	transform->BindHierarchy(&dirtyNodes, node);
+	dirtyNodes.Mark(node);
+
+	if (parentNode >= 0)
+	{
+		int parentSlot = slotOfNode[parentNode];
+		int insertSlot = parentSlot + subtreeSize[parentSlot];
+		if (insertSlot != slot)
+		{
+			MoveBlock(slot, 1, insertSlot);
+		}
+		AdjustAncestorSizes(parentNode, 1);
+	}
+
+	return node;
+}
+
+/// <summary>
+/// Removes a node along with its entire subtree
+/// </summary>
+void TransformHierarchy::RemoveNode(int node)
+{
+	if (!IsValidNode(node))
+	{
+		return;
+	}
+
+	int slot = slotOfNode[node];
+	int count = subtreeSize[slot];
+	int parentNode = parentOfSlot[slot];
+
+	for (int i = slot; i < slot + count; i++)
+	{
+		transforms[i]->ClearHierarchyWorldMatrix();
+		transforms[i]->BindHierarchy(nullptr, -1);
+		slotOfNode[nodeOfSlot[i]] = -1;
+		freeNodes.push_back(nodeOfSlot[i]);
+	}
+
+	nodeOfSlot.erase(nodeOfSlot.begin() + slot, nodeOfSlot.begin() + slot + count);
+	parentOfSlot.erase(parentOfSlot.begin() + slot, parentOfSlot.begin() + slot + count);
+	depthOfSlot.erase(depthOfSlot.begin() + slot, depthOfSlot.begin() + slot + count);
+	subtreeSize.erase(subtreeSize.begin() + slot, subtreeSize.begin() + slot + count);
+	transforms.erase(transforms.begin() + slot, transforms.begin() + slot + count);
+	worldMatrices.erase(worldMatrices.begin() + slot, worldMatrices.begin() + slot + count);
+	inverseTransposes.erase(inverseTransposes.begin() + slot, inverseTransposes.begin() + slot + count);
+
+	AdjustAncestorSizes(parentNode, -count);
+	RefreshSlots(slot, (int)nodeOfSlot.size());
+}
+
+/// <summary>
+/// Removes a node on its own. Its children move up to its parent (or become roots),
+/// keeping their local transforms, and take their own subtrees with them.
+/// </summary>
+void TransformHierarchy::DetachNode(int node)
+{
+	if (!IsValidNode(node))
+	{
+		return;
+	}
+
+	//The first child always sits right after the node, and moving it out brings the next one up
+	int parentNode = parentOfSlot[slotOfNode[node]];
+	while (subtreeSize[slotOfNode[node]] > 1)
+	{
+		SetParent(nodeOfSlot[slotOfNode[node] + 1], parentNode);
+	}
+	RemoveNode(node);
+}
+
+/// <summary>
+/// Moves a node (and its subtree) under a new parent, or to the root with -1.
+/// The local transform is kept, so the world position follows the new parent.
+/// </summary>
+/// <returns>False if the new parent is inside the node's own subtree</returns>
+bool TransformHierarchy::SetParent(int node, int parentNode)
+{
+	if (!IsValidNode(node) || (parentNode >= 0 && !IsValidNode(parentNode)))
+	{
+		return false;
+	}
+
+	int slot = slotOfNode[node];
+	int count = subtreeSize[slot];
+	int oldParent = parentOfSlot[slot];
+	if (oldParent == parentNode)
+	{
+		return true;
+	}
+
+	//Can't parent something to its own child
+	if (parentNode >= 0)
+	{
+		int parentSlot = slotOfNode[parentNode];
+		if (parentSlot >= slot && parentSlot < slot + count)
+		{
+			return false;
+		}
+	}
+
+	//Only the slots between the old and new spots get shuffled
+	int insertSlot = (int)nodeOfSlot.size();
+	if (parentNode >= 0)
+	{
+		int parentSlot = slotOfNode[parentNode];
+		insertSlot = parentSlot + subtreeSize[parentSlot];
+	}
+	if (insertSlot < slot || insertSlot > slot + count)
+	{
+		MoveBlock(slot, count, insertSlot);
+	}
+
+	AdjustAncestorSizes(oldParent, -count);
+	AdjustAncestorSizes(parentNode, count);
+
+	//Fix up the depths of the moved block
+	slot = slotOfNode[node];
+	parentOfSlot[slot] = parentNode;
+	int depthDelta = (parentNode < 0 ? 0 : depthOfSlot[slotOfNode[parentNode]] + 1) - depthOfSlot[slot];
+	for (int i = slot; i < slot + count; i++)
+	{
+		depthOfSlot[i] += depthDelta;
+	}
+
+	if (parentNode < 0)
+	{
+		transforms[slot]->ClearHierarchyWorldMatrix();
+	}
+	dirtyNodes.Mark(node);
+
+	return true;
+}
+
+void TransformHierarchy::SetTransform(int node, Transform* transform)
+{
+	if (!IsValidNode(node))
+	{
+		return;
+	}
+
+	int slot = slotOfNode[node];
+	transforms[slot] = transform;
+	transform->BindHierarchy(&dirtyNodes, node);
+	dirtyNodes.Mark(node);
+}
+
+void TransformHierarchy::MarkDirty(int node)
+{
+	if (IsValidNode(node))
+	{
+		dirtyNodes.Mark(node);
+	}
+}
+
+/// <summary>
+/// Rebuilds world matrices for every marked node plus everything underneath them.
+/// Marked nodes are visited in slot order, so an ancestor's run always comes first
+/// and anything inside a run already rebuilt is skipped.
+/// </summary>
+void TransformHierarchy::UpdateWorldMatrices()
+{
+	lastUpdateCount = 0;
+	updatedNodes.clear();
+	if (dirtyNodes.IsEmpty())
+	{
+		return;
+	}
+
+	//Removed nodes can still be marked
+	dirtySlots.clear();
+	dirtyNodes.ForEach([this](uint32_t node)
+		{
+			if (IsValidNode((int)node))
+			{
+				dirtySlots.push_back(slotOfNode[node]);
+			}
+		});
+	dirtyNodes.Clear();
+	std::sort(dirtySlots.begin(), dirtySlots.end());
+
+	int runEnd = 0;
+	for (int dirtySlot : dirtySlots)
+	{
+		if (dirtySlot < runEnd)
+		{
+			continue;
+		}
+
+		runEnd = dirtySlot + subtreeSize[dirtySlot];
+		for (int slot = dirtySlot; slot < runEnd; slot++)
+		{
+			RebuildSlot(slot);
+		}
+	}
+}
+
+/// <summary>
+/// One node's world matrices from its local ones and its parent's, which are already up to date
+/// </summary>
+void TransformHierarchy::RebuildSlot(int slot)
+{
+	int parentNode = parentOfSlot[slot];
+	int parentSlot = parentNode < 0 ? -1 : slotOfNode[parentNode];
+
+	transforms[slot]->ConsumeHierarchyDirty();
+	lastUpdateCount++;
+	updatedNodes.push_back(nodeOfSlot[slot]);
+
+	XMFLOAT4X4 local = transforms[slot]->GetLocalMatrix();
+	XMFLOAT4X4 localInverseTranspose = transforms[slot]->GetLocalInverseTransposeMatrix();
+	if (parentSlot < 0)
+	{
+		worldMatrices[slot] = local;
+		inverseTransposes[slot] = localInverseTranspose;
+		return;
+	}
+
+	XMMATRIX world = XMLoadFloat4x4(&local) * XMLoadFloat4x4(&worldMatrices[parentSlot]);
+	XMMATRIX inverseTranspose = XMLoadFloat4x4(&localInverseTranspose) * XMLoadFloat4x4(&inverseTransposes[parentSlot]);
+	XMStoreFloat4x4(&worldMatrices[slot], world);
+	XMStoreFloat4x4(&inverseTransposes[slot], inverseTranspose);
+	transforms[slot]->SetHierarchyMatrices(worldMatrices[slot], inverseTransposes[slot]);
+}
+
+int TransformHierarchy::GetParent(int node)
+{
+	return IsValidNode(node) ? parentOfSlot[slotOfNode[node]] : -1;
+}
+
+int TransformHierarchy::GetDepth(int node)
+{
+	return IsValidNode(node) ? depthOfSlot[slotOfNode[node]] : -1;
+}
+
+int TransformHierarchy::GetNodeCount()
+{
+	return (int)nodeOfSlot.size();
+}
+
+/// <summary>
+/// How many nodes actually had their world matrix rebuilt last update
+/// </summary>
+int TransformHierarchy::GetLastUpdateCount()
+{
+	return lastUpdateCount;
+}
+
+const std::vector<int>& TransformHierarchy::GetUpdatedNodes()
+{
+	return updatedNodes;
+}
+
+Transform* TransformHierarchy::GetTransform(int node)
+{
+	return IsValidNode(node) ? transforms[slotOfNode[node]] : nullptr;
+}
+
+DirectX::XMFLOAT4X4 TransformHierarchy::GetWorldMatrix(int node)
+{
+	if (!IsValidNode(node))
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	return worldMatrices[slotOfNode[node]];
+}
+
+DirectX::XMFLOAT4X4 TransformHierarchy::GetInverseTransposeMatrix(int node)
+{
+	if (!IsValidNode(node))
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	return inverseTransposes[slotOfNode[node]];
+}
+
+bool TransformHierarchy::IsValidNode(int node)
+{
+	return node >= 0 && node < (int)slotOfNode.size() && slotOfNode[node] >= 0;
+}
+
+/// <summary>
+/// Slides the block [from, from + count) so it sits right before slot "to".
+/// Only the slots between the two positions are touched.
+/// </summary>
+void TransformHierarchy::MoveBlock(int from, int count, int to)
+{
+	int begin, middle, end;
+	if (to < from)
+	{
+		begin = to;
+		middle = from;
+		end = from + count;
+	}
+	else
+	{
+		begin = from;
+		middle = from + count;
+		end = to;
+	}
+
+	auto rotateRange = [begin, middle, end](auto& list)
+	{
+		std::rotate(list.begin() + begin, list.begin() + middle, list.begin() + end);
+	};
+
+	rotateRange(nodeOfSlot);
+	rotateRange(parentOfSlot);
+	rotateRange(depthOfSlot);
+	rotateRange(subtreeSize);
+	rotateRange(transforms);
+	rotateRange(worldMatrices);
+	rotateRange(inverseTransposes);
+
+	RefreshSlots(begin, end);
+}
+
+void TransformHierarchy::RefreshSlots(int begin, int end)
+{
+	for (int slot = begin; slot < end; slot++)
+	{
+		slotOfNode[nodeOfSlot[slot]] = slot;
+	}
+}
+
+void TransformHierarchy::AdjustAncestorSizes(int parentNode, int delta)
+{
+	while (parentNode >= 0)
+	{
+		int slot = slotOfNode[parentNode];
+		subtreeSize[slot] += delta;
+		parentNode = parentOfSlot[slot];
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "ChangeJournal.h"
+#include "Transform.h"
+
+// --------------------------------------------------------
+// Parent/child relationships between Transforms
+//
+// Nodes are stored in flat arrays in pre-order (every parent
+// sits before all of its children and each subtree is one
+// contiguous run of slots), so world matrices can be built
+// front to back as local * parentWorld. Normal matrices
+// compose the same way, since (A * B)^-T = A^-T * B^-T.
+//
+// Each transform marks its node as it changes, so an update
+// only walks the runs under marked nodes and a frame where
+// nothing moved costs next to nothing. The hierarchy can't
+// be moved or copied once transforms point back at it.
+//
+// Node ids handed out by AddNode stay valid until the node is
+// removed, even though the slot a node lives in can move.
+// --------------------------------------------------------
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+	TransformHierarchy(const TransformHierarchy&) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+	//Building the graph
+	int AddNode(Transform* transform, int parentNode = -1);
+	void RemoveNode(int node);
+	void DetachNode(int node); //Removes only the node, its children move up to its parent
+	bool SetParent(int node, int parentNode);
+	void SetTransform(int node, Transform* transform);
+
+	//Forces a node (and therefore its subtree) to rebuild next update
+	void MarkDirty(int node);
+
+	//Rebuilds every marked node's subtree, parents first
+	void UpdateWorldMatrices();
+
+	//Getters
+	int GetParent(int node);
+	int GetDepth(int node);
+	int GetNodeCount();
+	int GetLastUpdateCount();
+	const std::vector<int>& GetUpdatedNodes(); //Nodes rebuilt by the last update, parents first
+	Transform* GetTransform(int node);
+	DirectX::XMFLOAT4X4 GetWorldMatrix(int node);
+	DirectX::XMFLOAT4X4 GetInverseTransposeMatrix(int node);
+
+private:
+	//Per slot data, kept in pre-order
+	std::vector<int> nodeOfSlot;
+	std::vector<int> parentOfSlot; //Parent NODE id (not slot) so moving blocks never touches children
+	std::vector<int> depthOfSlot;
+	std::vector<int> subtreeSize; //Including the node itself
+	std::vector<Transform*> transforms;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> inverseTransposes;
+
+	//Per node data
+	std::vector<int> slotOfNode;
+	std::vector<int> freeNodes;
+
+	//Nodes changed since the last update, marked by their transforms or by MarkDirty
+	DirtyBitset dirtyNodes;
+	std::vector<int> dirtySlots;
+
+	int lastUpdateCount;
+	std::vector<int> updatedNodes;
+
+	bool IsValidNode(int node);
+	void MoveBlock(int from, int count, int to);
+	void RefreshSlots(int begin, int end);
+	void RebuildSlot(int slot);
+	void AdjustAncestorSizes(int parentNode, int delta);
+};
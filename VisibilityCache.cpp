@@ -0,0 +1,201 @@
+#include "VisibilityCache.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	//Whether every plane of one frustum is close enough to the other's for settled slots to keep their answers
+	bool WithinMargins(const Frustum& from, const Frustum& to, const CullMargins& margins)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const DirectX::XMFLOAT4& now = to.Planes[p];
+			const DirectX::XMFLOAT4& then = from.Planes[p];
+			float dx = now.x - then.x;
+			float dy = now.y - then.y;
+			float dz = now.z - then.z;
+
+			//The plane's turn, and how far it moved where it passes the eye
+			float normalChange = std::sqrt(dx * dx + dy * dy + dz * dz);
+			float offsetChange = std::fabs(dx * margins.Eye.x + dy * margins.Eye.y + dz * margins.Eye.z + now.w - then.w);
+			if (normalChange > margins.NormalDrift || offsetChange > margins.OffsetDrift)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+VisibilityCache::VisibilityCache() :
+	valid(false),
+	anchor{},
+	lastFrustum{},
+	margins{ DirectX::XMFLOAT3(0, 0, 0), VISIBILITY_CACHE_TURN_THRESHOLD, VISIBILITY_CACHE_MOVE_THRESHOLD },
+	framesSinceRefresh(0),
+	refreshInterval(VISIBILITY_CACHE_REFRESH_FRAMES),
+	validate(false),
+	stats{}
+{
+}
+
+void VisibilityCache::Invalidate()
+{
+	valid = false;
+	moved.clear();
+}
+
+void VisibilityCache::MarkMoved(uint32_t slot)
+{
+	//Anything out of range is new since the last refresh, and Update will refresh anyway
+	if (!valid || slot >= states.size() || (states[slot] & VISIBILITY_CACHE_DIRTY))
+	{
+		return;
+	}
+
+	states[slot] |= VISIBILITY_CACHE_DIRTY;
+	moved.push_back(slot);
+}
+
+void VisibilityCache::SetThresholds(float move, float turn)
+{
+	margins.OffsetDrift = move;
+	margins.NormalDrift = turn;
+	valid = false;
+}
+
+/// <summary>
+/// Brings the visible list up to date for this frame's frustum, refreshing in full when the
+/// cached answers can't be trusted any more. While the camera keeps moving faster than the
+/// margins allow, the plain cull is cheaper than classifying, so that's used until it slows down.
+/// </summary>
+/// <returns>How many slots are visible</returns>
+int VisibilityCache::Update(FrustumCuller& culler, const Frustum& frustum, const DirectX::XMFLOAT3& eye, JobSystem* jobSystem)
+{
+	stats = {};
+	stats.Moved = (int)moved.size();
+
+	CullMargins here = margins;
+	here.Eye = eye;
+	if (!valid || states.size() != (size_t)culler.GetSlotCount() || ++framesSinceRefresh >= refreshInterval || !WithinMargins(anchor, frustum, margins))
+	{
+		if (!WithinMargins(lastFrustum, frustum, here))
+		{
+			//Nothing would come of a refresh, the next frame would be outside its margins too
+			culler.Cull(frustum, jobSystem);
+			visible.assign(culler.GetVisible(), culler.GetVisible() + culler.GetVisibleCount());
+			valid = false;
+			moved.clear();
+			lastFrustum = frustum;
+			stats.FullRefresh = true;
+			stats.CameraMoving = true;
+			stats.Retested = culler.GetCapacity();
+			return (int)visible.size();
+		}
+		Refresh(culler, frustum, eye, jobSystem);
+	}
+	else
+	{
+		//Moved slots are classified again against the anchor, so the margins still hold for them
+		culler.ClassifySlots(anchor, margins, moved.data(), (int)moved.size(), states.data());
+		for (uint32_t slot : moved)
+		{
+			uint8_t& state = states[slot];
+			state &= ~VISIBILITY_CACHE_DIRTY;
+			if ((state & CULL_STATE_BOUNDARY) && !(state & VISIBILITY_CACHE_LISTED))
+			{
+				state |= VISIBILITY_CACHE_LISTED;
+				boundary.push_back(slot);
+			}
+		}
+
+		//Slots that moved off the boundary stay in the list until the next refresh. An exact test is right for them too.
+		culler.TestSlots(frustum, boundary.data(), (int)boundary.size(), states.data());
+
+		stats.Boundary = (int)boundary.size();
+		stats.Retested = (int)(moved.size() + boundary.size());
+		stats.Skipped = culler.GetCapacity() - stats.Retested;
+	}
+	moved.clear();
+	lastFrustum = frustum;
+
+	//Eight states at a time. The multiply gathers the low bit of every byte into the top byte, slot order kept.
+	static_assert(CULL_STATE_VISIBLE == 0x1, "The gather below expects the visible bit to be the lowest");
+	visible.clear();
+	for (size_t first = 0; first < states.size(); first += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, states.data() + first, sizeof(word));
+		unsigned int mask = (unsigned int)(((word & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56);
+		while (mask)
+		{
+			visible.push_back((uint32_t)(first + std::countr_zero(mask)));
+			mask &= mask - 1;
+		}
+	}
+
+	if (validate)
+	{
+		Validate(culler, frustum, jobSystem);
+	}
+	return (int)visible.size();
+}
+
+/// <summary>
+/// Classifies every slot against the frustum, which becomes the new anchor
+/// </summary>
+void VisibilityCache::Refresh(FrustumCuller& culler, const Frustum& frustum, const DirectX::XMFLOAT3& eye, JobSystem* jobSystem)
+{
+	anchor = frustum;
+	margins.Eye = eye;
+	states.resize(culler.GetSlotCount());
+	culler.Classify(frustum, margins, states.data(), jobSystem);
+
+	boundary.clear();
+	for (size_t slot = 0; slot < states.size(); slot++)
+	{
+		if (states[slot] & CULL_STATE_BOUNDARY)
+		{
+			states[slot] |= VISIBILITY_CACHE_LISTED;
+			boundary.push_back((uint32_t)slot);
+		}
+	}
+
+	valid = true;
+	framesSinceRefresh = 0;
+	stats.FullRefresh = true;
+	stats.Retested = culler.GetCapacity();
+	stats.Boundary = (int)boundary.size();
+}
+
+/// <summary>
+/// Runs the plain full cull and counts the slots where it and the cache disagree. Both lists are in slot order.
+/// </summary>
+void VisibilityCache::Validate(FrustumCuller& culler, const Frustum& frustum, JobSystem* jobSystem)
+{
+	int count = culler.Cull(frustum, jobSystem);
+	const uint32_t* reference = culler.GetVisible();
+
+	int mine = 0;
+	int theirs = 0;
+	while (mine < (int)visible.size() || theirs < count)
+	{
+		if (theirs == count || (mine < (int)visible.size() && visible[mine] < reference[theirs]))
+		{
+			stats.Mismatches++;
+			mine++;
+		}
+		else if (mine == (int)visible.size() || reference[theirs] < visible[mine])
+		{
+			stats.Mismatches++;
+			theirs++;
+		}
+		else
+		{
+			mine++;
+			theirs++;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+#define VISIBILITY_CACHE_MOVE_THRESHOLD 0.5f //World units the camera can move before a full refresh
+#define VISIBILITY_CACHE_TURN_THRESHOLD 0.01f //Roughly radians the camera can turn before a full refresh
+#define VISIBILITY_CACHE_REFRESH_FRAMES 30 //Full refresh at least this often, whatever happens
+#define VISIBILITY_CACHE_DIRTY 0x80 //State bit for slots marked moved since the last Update
+#define VISIBILITY_CACHE_LISTED 0x40 //State bit for slots already in the boundary list
+
+//What the last Update did
+struct VisibilityCacheStats
+{
+	bool FullRefresh;
+	bool CameraMoving; //Too fast for the margins, so the plain cull ran and nothing was cached
+	int Retested; //Boundary and moved slots tested again
+	int Skipped; //Slots whose answer was carried over from the last refresh
+	int Boundary; //Slots close enough to the frustum edge to be retested every frame, or that were since the refresh
+	int Moved;
+	int Mismatches; //Only counted with validation on, slots the full test disagreed on
+};
+
+// --------------------------------------------------------
+// Frame to frame reuse of one camera's visibility
+//
+// A full refresh classifies every slot of a FrustumCuller
+// against the camera's frustum (the anchor) and notes how
+// close each one is to changing its answer. While the
+// frustum stays within the move and turn thresholds of the
+// anchor, a slot far enough from the edge provably keeps
+// its answer, so only slots near the edge and slots that
+// were marked moved get tested again. Going past either
+// threshold, a structural change or enough frames since
+// the last refresh all start over with a full refresh,
+// which waits for the camera to slow down so it isn't
+// thrown away on the very next frame.
+//
+// The answers are exact, not approximate. Validation runs
+// the full test as well and counts any disagreement, which
+// should always be zero.
+// --------------------------------------------------------
+class VisibilityCache
+{
+public:
+	VisibilityCache();
+
+	//Drops everything, the next Update refreshes from scratch
+	void Invalidate();
+
+	//The slot's bounds changed in the culler since the last Update
+	void MarkMoved(uint32_t slot);
+
+	//The culler's bounds have to be current. eye is the camera position.
+	int Update(FrustumCuller& culler, const Frustum& frustum, const DirectX::XMFLOAT3& eye, JobSystem* jobSystem = nullptr);
+
+	//Getters
+	const uint32_t* GetVisible() { return visible.data(); }
+	int GetVisibleCount() { return (int)visible.size(); }
+	const VisibilityCacheStats& GetStats() { return stats; }
+	bool GetValidation() { return validate; }
+
+	//Setters
+	void SetThresholds(float move, float turn);
+	void SetRefreshInterval(int frames) { refreshInterval = frames; }
+	void SetValidation(bool enabled) { validate = enabled; }
+
+private:
+	bool valid;
+	Frustum anchor;
+	Frustum lastFrustum;
+	CullMargins margins;
+	int framesSinceRefresh;
+	int refreshInterval;
+	bool validate;
+
+	//CULL_STATE_* bits per slot, plus the VISIBILITY_CACHE_* ones
+	std::vector<uint8_t> states;
+	std::vector<uint32_t> boundary;
+	std::vector<uint32_t> moved;
+	std::vector<uint32_t> visible;
+	VisibilityCacheStats stats;
+
+	void Refresh(FrustumCuller& culler, const Frustum& frustum, const DirectX::XMFLOAT3& eye, JobSystem* jobSystem);
+	void Validate(FrustumCuller& culler, const Frustum& frustum, JobSystem* jobSystem);
+};